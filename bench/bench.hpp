@@ -0,0 +1,44 @@
+#ifndef _BENCH_HPP
+#define _BENCH_HPP
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+/// @brief Written to after every benchmark so that the optimizer cannot discard the benchmarked work
+static volatile double __bench_sink_ = 0.0;
+
+/// @brief Times `iterations` calls to `func` and prints the average time taken per call
+/// @param name The name to report the benchmark under
+/// @param iterations The number of times `func` should be called
+/// @param func The work to benchmark. Its results are accumulated and written to `__bench_sink_`.
+/// @return The average time per call in nanoseconds
+template<typename F>
+double bench(std::string name, size_t iterations, F func)
+{
+    double acc = 0.0;
+    for (size_t i = 0; i < iterations / 10 + 1; i++)
+    {
+        acc += func();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++)
+    {
+        acc += func();
+    }
+    auto stop = std::chrono::steady_clock::now();
+    __bench_sink_ = acc;
+
+    double ns = std::chrono::duration<double, std::nano>(stop - start).count() / iterations;
+    std::cout << "[ BENCH ]......" << name << "......" << ns << " ns/iter" << '\n';
+    return ns;
+}
+
+/// @brief Prints how many times faster `fast_ns` is than `slow_ns`
+inline void report_speedup(std::string name, double slow_ns, double fast_ns)
+{
+    std::cout << "[ SPEEDUP ]...." << name << "......" << slow_ns / fast_ns << "x" << "\n\n";
+}
+
+#endif
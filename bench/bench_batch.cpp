@@ -0,0 +1,66 @@
+#include "bench.hpp"
+#include "compiled.hpp"
+
+using nexsys::compile_to_expression;
+using nexsys::ContextMap;
+using nexsys::VariableIndex;
+
+constexpr size_t POINTS = 50000;
+constexpr size_t ITERATIONS = 200;
+const std::string EXPR = "3 * x ^ 2 + 2 * x * y - y / 4 + (x - y) * (x + y) - 7 * z + z / (x + 1)";
+
+int main()
+{
+    ContextMap ctx;
+    ctx.add_var_to_ctx("x");
+    ctx.add_var_to_ctx("y");
+    ctx.add_var_to_ctx("z");
+
+    VariableIndex index({"x", "y", "z"});
+    auto compiled = compile_to_expression(EXPR, ctx, index);
+    std::function<double (const double*)> closure = compiled;
+
+    std::vector<double> xs(POINTS), ys(POINTS), zs(POINTS), out(POINTS);
+    for (size_t i = 0; i < POINTS; i++)
+    {
+        xs[i] = 0.5 + i * 1e-5;
+        ys[i] = -0.25 + i * 2e-5;
+        zs[i] = 3.0 - i * 1e-5;
+    }
+    const double* columns[] = {xs.data(), ys.data(), zs.data()};
+
+    std::cout << "Expression: " << EXPR << '\n';
+    std::cout << "Points per iteration: " << POINTS << "\n\n";
+
+    double loop_ns = bench("std::function loop", ITERATIONS, [&]() {
+        double x[3];
+        for (size_t i = 0; i < POINTS; i++)
+        {
+            x[0] = xs[i]; x[1] = ys[i]; x[2] = zs[i];
+            out[i] = closure(x);
+        }
+        return out[POINTS - 1];
+    });
+
+    double scalar_ns = bench("evaluate_batch (scalar)", ITERATIONS, [&]() {
+        nexsys::evaluate_batch(compiled.get_bytecode(), columns, POINTS, out.data(), nexsys::Scalar);
+        return out[POINTS - 1];
+    });
+
+    double avx2_ns = bench("evaluate_batch (avx2)", ITERATIONS, [&]() {
+        nexsys::evaluate_batch(compiled.get_bytecode(), columns, POINTS, out.data(), nexsys::Avx2);
+        return out[POINTS - 1];
+    });
+
+    double avx512_ns = bench("evaluate_batch (avx512)", ITERATIONS, [&]() {
+        nexsys::evaluate_batch(compiled.get_bytecode(), columns, POINTS, out.data(), nexsys::Avx512);
+        return out[POINTS - 1];
+    });
+
+    std::cout << '\n';
+    report_speedup("scalar batch vs. closure loop", loop_ns, scalar_ns);
+    report_speedup("avx2 batch vs. closure loop", loop_ns, avx2_ns);
+    report_speedup("avx512 batch vs. closure loop", loop_ns, avx512_ns);
+
+    return 0;
+}
@@ -0,0 +1,41 @@
+#include "bench.hpp"
+#include "cache.hpp"
+
+using nexsys::compile_to_expression;
+using nexsys::CompileCache;
+using nexsys::ContextMap;
+using nexsys::VariableIndex;
+
+constexpr size_t ITERATIONS = 20000;
+const std::string EXPR = "3 * x ^ 2 + 2 * x * y - y / 4 + (x - y) * (x + y) - 7 * z + z / (x + 1) + k";
+
+int main()
+{
+    ContextMap ctx;
+    ctx.add_var_to_ctx("x");
+    ctx.add_var_to_ctx("y");
+    ctx.add_var_to_ctx("z");
+    ctx.add_num_to_ctx("k", 2.5);
+    for (size_t i = 0; i < 64; i++)
+    {
+        // Services usually compile against a context holding many more symbols than each expression uses
+        ctx.add_num_to_ctx("unused" + std::to_string(i), (double)i);
+    }
+
+    CompileCache cache;
+    VariableIndex index({"x", "y", "z"});
+
+    std::cout << "Expression: " << EXPR << "\n\n";
+
+    double compile_ns = bench("compile: compile_to_expression", ITERATIONS, [&]() {
+        return compile_to_expression(EXPR, ctx, index).get_depth();
+    });
+    double cached_ns = bench("compile: CompileCache", ITERATIONS, [&]() {
+        return cache.compile(EXPR, ctx, index).get_depth();
+    });
+
+    std::cout << '\n';
+    report_speedup("cached vs. uncached compile", compile_ns, cached_ns);
+
+    return 0;
+}
@@ -0,0 +1,133 @@
+#include <iterator>
+#include <sstream>
+
+#include "bench.hpp"
+#include "compiled.hpp"
+
+using nexsys::compile_all;
+using nexsys::compile_to_expression;
+using nexsys::ContextMap;
+using nexsys::Lexer;
+using nexsys::VariableIndex;
+
+constexpr size_t ITERATIONS = 200;
+constexpr size_t TERMS = 2000;
+constexpr size_t EQUATIONS = 50000;
+constexpr size_t BULK_ITERATIONS = 5;
+
+/// @brief The lexing strategy used before `Lexer`, kept as a baseline
+static std::vector<std::string> split_with_stringstream(const std::string& expr)
+{
+    std::string spaced;
+    for (char c: expr)
+    {
+        if (nexsys::OPTOKENS.find(c) == std::string::npos)
+        {
+            spaced.push_back(c);
+        }
+        else
+        {
+            spaced.push_back(' ');
+            spaced.push_back(c);
+            spaced.push_back(' ');
+        }
+    }
+
+    std::stringstream ss(spaced);
+    return std::vector<std::string>(std::istream_iterator<std::string>(ss), std::istream_iterator<std::string>());
+}
+
+static void report_throughput(std::string name, size_t tokens, double ns)
+{
+    std::cout << "[ THROUGHPUT ]." << name << "......" << tokens / ns * 1e3 << " M tokens/s" << '\n';
+}
+
+int main()
+{
+    ContextMap ctx;
+    ctx.add_var_to_ctx("x");
+    ctx.add_var_to_ctx("y");
+    ctx.add_num_to_ctx("k", 0.5);
+
+    // A long generated expression, like those produced by discretizing a model
+    std::string expr = "0";
+    for (size_t i = 0; i < TERMS; i++)
+    {
+        expr += i % 2 ? " + " : " - ";
+        expr += "(" + std::to_string(i) + ".25e-2 * x ^ 2 - k * y) / " + std::to_string(i + 1);
+    }
+
+    size_t tokens = 0;
+    Lexer counter(expr);
+    while (counter.next().type != nexsys::LexEnd)
+    {
+        tokens++;
+    }
+
+    std::cout << "Expression: " << TERMS << " generated terms, " << tokens << " tokens\n\n";
+
+    double split_ns = bench("lex: punctuate + stringstream", ITERATIONS, [&]() {
+        return (double)split_with_stringstream(expr).size();
+    });
+    double lex_ns = bench("lex: Lexer", ITERATIONS, [&]() {
+        Lexer lexer(expr);
+        double sum = 0.0;
+        for (auto lex = lexer.next(); lex.type != nexsys::LexEnd; lex = lexer.next())
+        {
+            sum += lex.value;
+        }
+        return sum;
+    });
+    double compile_ns = bench("compile: compile_to_expression", ITERATIONS, [&]() {
+        VariableIndex index;
+        return (double)compile_to_expression(expr, ctx, index).get_depth();
+    });
+
+    std::cout << '\n';
+    report_throughput("lex: punctuate + stringstream", tokens, split_ns);
+    report_throughput("lex: Lexer", tokens, lex_ns);
+    report_throughput("compile: compile_to_expression", tokens, compile_ns);
+    std::cout << '\n';
+    report_speedup("Lexer vs. punctuate + stringstream", split_ns, lex_ns);
+
+    // A large model of short equations, each coupling a few of many unknowns
+    ContextMap model;
+    model.add_num_to_ctx("k", 0.5);
+    std::vector<std::string> equations;
+    for (size_t i = 0; i < EQUATIONS; i++)
+    {
+        model.add_var_to_ctx("u" + std::to_string(i));
+    }
+    for (size_t i = 0; i < EQUATIONS; i++)
+    {
+        std::string a = "u" + std::to_string(i), b = "u" + std::to_string((i + 1) % EQUATIONS), c = "u" + std::to_string((i * 31) % EQUATIONS);
+        equations.push_back(a + " ^ 2 - k * " + b + " * exp(-" + c + ") + (" + a + " - " + c + ") / 3 - " + std::to_string(i));
+    }
+    nexsys::ContextView view(model);
+
+    std::cout << "Model: " << EQUATIONS << " equations, " << nexsys::ThreadPool::shared().size() << " thread(s)\n\n";
+
+    double serial_ns = bench("bulk: compile_to_expression in a loop", BULK_ITERATIONS, [&]() {
+        VariableIndex index;
+        double depth = 0.0;
+        for (auto& equation: equations)
+        {
+            depth += compile_to_expression(equation, view, index).get_depth();
+        }
+        return depth;
+    });
+    double bulk_ns = bench("bulk: compile_all", BULK_ITERATIONS, [&]() {
+        VariableIndex index;
+        double depth = 0.0;
+        for (auto& result: compile_all(equations, view, index))
+        {
+            depth += result.expr.get_depth();
+        }
+        return depth;
+    });
+
+    std::cout << '\n';
+    report_speedup("compile_all vs. compile_to_expression in a loop", serial_ns, bulk_ns);
+
+    return 0;
+}
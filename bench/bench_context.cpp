@@ -0,0 +1,70 @@
+#include "bench.hpp"
+#include "compiled.hpp"
+
+using nexsys::compile_to_expression;
+using nexsys::ContextMap;
+using nexsys::ContextView;
+using nexsys::Lexer;
+using nexsys::VariableIndex;
+
+/// @brief Builds a sum of `terms` products of constants and variables drawn from the context
+static std::string make_expression(size_t terms, size_t symbols)
+{
+    std::string expr = "0";
+    for (size_t i = 0; i < terms; i++)
+    {
+        expr += " + c" + std::to_string((i * 7919) % symbols) + " * v" + std::to_string(i % 16);
+    }
+    return expr;
+}
+
+static size_t count_tokens(const std::string& expr)
+{
+    size_t tokens = 0;
+    Lexer lexer(expr);
+    while (lexer.next().type != nexsys::LexEnd)
+    {
+        tokens++;
+    }
+    return tokens;
+}
+
+int main()
+{
+    std::cout << "Compile cost per token should not depend on the size of the context or of the expression\n\n";
+
+    for (size_t symbols: {100, 1000, 10000})
+    {
+        ContextMap ctx;
+        for (size_t i = 0; i < symbols; i++)
+        {
+            ctx.add_num_to_ctx("c" + std::to_string(i), (double)i);
+        }
+        for (size_t i = 0; i < 16; i++)
+        {
+            ctx.add_var_to_ctx("v" + std::to_string(i));
+        }
+        ContextView view(ctx);
+
+        for (size_t terms: {100, 1000, 10000})
+        {
+            std::string expr = make_expression(terms, symbols);
+            size_t tokens = count_tokens(expr);
+            size_t iterations = 2000000 / tokens + 1;
+            std::string label = std::to_string(symbols) + " symbols, " + std::to_string(tokens) + " tokens";
+
+            double map_ns = bench("ContextMap:  " + label, iterations, [&]() {
+                VariableIndex index;
+                return (double)compile_to_expression(expr, ctx, index).get_depth();
+            });
+            double view_ns = bench("ContextView: " + label, iterations, [&]() {
+                VariableIndex index;
+                return (double)compile_to_expression(expr, view, index).get_depth();
+            });
+
+            std::cout << "[ PER TOKEN ]..ContextMap " << map_ns / tokens << " ns, ContextView " << view_ns / tokens << " ns" << "\n\n";
+        }
+    }
+
+    return 0;
+}
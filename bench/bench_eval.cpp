@@ -0,0 +1,86 @@
+#include "bench.hpp"
+#include "compiled.hpp"
+
+using nexsys::compile_to_expression;
+using nexsys::compile_to_function_of_umap;
+using nexsys::ContextMap;
+using nexsys::eval_rpn_expression;
+using nexsys::rpnify;
+using nexsys::SlotToken;
+using nexsys::Variable;
+using nexsys::VariableIndex;
+
+constexpr size_t ITERATIONS = 2000000;
+const std::string EXPR = "3 * x ^ 2 + 2 * x * y - y / 4 + (x - y) * (x + y) - 7 * z + z / (x + 1)";
+
+// Generated models are full of unary minus, unit factors and constant subexpressions
+const std::string GENERATED = "-(-x) * 1 + -y * (2 * 0.5) - -(z / 2) + 0 * 1 + x ^ 1 / 8 - -(3 * 4 / 2) * -y + (1 + 1) * z";
+
+/// @brief Builds the bytecode of an expression exactly as written, without `simplify_program`
+static nexsys::Bytecode lower_unsimplified(const std::string& expr, const ContextMap& ctx, const VariableIndex& index)
+{
+    std::vector<std::string_view> symbols;
+    std::vector<SlotToken> program;
+    auto tokens = rpnify(expr, ctx, symbols);
+    for (size_t i = 0; i < tokens.size(); i++)
+    {
+        SlotToken tok;
+        tok.type = tokens[i].get_type();
+        tok.operand = 0;
+        tok.value = 0.0;
+        if (tok.type == nexsys::Num)
+        {
+            (void)tokens[i].try_unwrap_num(tok.value);
+        }
+        else if (tok.type == nexsys::Var)
+        {
+            (void)index.try_get_slot(std::string(symbols[i]), tok.operand);
+        }
+        program.push_back(tok);
+    }
+    return nexsys::Bytecode(program);
+}
+
+int main()
+{
+    Variable x(1.5), y(-0.25), z(3.0);
+    ContextMap ctx;
+    ctx.add_var_to_ctx("x", &x);
+    ctx.add_var_to_ctx("y", &y);
+    ctx.add_var_to_ctx("z", &z);
+
+    VariableIndex index({"x", "y", "z"});
+    auto compiled = compile_to_expression(EXPR, ctx, index);
+    auto rpn_expr = rpnify(EXPR, ctx);
+    auto closure = compile_to_function_of_umap(EXPR, ctx);
+
+    double slots[] = {1.5, -0.25, 3.0};
+    std::unordered_map<std::string, double> values = {{"x", 1.5}, {"y", -0.25}, {"z", 3.0}};
+
+    std::cout << "Expression: " << EXPR << '\n';
+    std::cout << "RPN tokens: " << rpn_expr.size() << ", bytecode instructions: " << compiled.get_bytecode().get_code().size() << "\n\n";
+
+    double umap_ns = bench("compile_to_function_of_umap", ITERATIONS / 10, [&]() { return closure(values); });
+    double rpn_ns = bench("eval_rpn_expression", ITERATIONS, [&]() { return eval_rpn_expression(rpn_expr); });
+    double vm_ns = bench("CompiledExpression::evaluate", ITERATIONS, [&]() { return compiled.evaluate(slots); });
+
+    std::cout << '\n';
+    report_speedup("bytecode vs. rpn walker", rpn_ns, vm_ns);
+    report_speedup("bytecode vs. umap closure", umap_ns, vm_ns);
+
+    auto raw = lower_unsimplified(GENERATED, ctx, index);
+    auto simplified = compile_to_expression(GENERATED, ctx, index);
+    double frame[64];
+
+    std::cout << "Expression: " << GENERATED << '\n';
+    std::cout << "Simplifier removed " << simplified.get_removed_count() << " of " << rpnify(GENERATED, ctx).size() << " RPN tokens, bytecode instructions: "
+        << raw.get_code().size() << " -> " << simplified.get_bytecode().get_code().size() << "\n\n";
+
+    double raw_ns = bench("bytecode: as written", ITERATIONS, [&]() { return raw.run(slots, frame); });
+    double simplified_ns = bench("bytecode: simplified", ITERATIONS, [&]() { return simplified.evaluate(slots, frame); });
+
+    std::cout << '\n';
+    report_speedup("simplified vs. as written", raw_ns, simplified_ns);
+
+    return 0;
+}
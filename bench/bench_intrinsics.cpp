@@ -0,0 +1,86 @@
+#include "bench.hpp"
+#include "compiled.hpp"
+
+using nexsys::compile_to_expression;
+using nexsys::ContextMap;
+using nexsys::VariableIndex;
+
+constexpr size_t ITERATIONS = 2000000;
+constexpr size_t POINTS = 50000;
+constexpr size_t BATCH_ITERATIONS = 100;
+const std::string EXPR = "exp(-x / 4) * sqrt(y) + log(x + 1) * abs(x - y) - max(x, y) + x ^ 3 - hypot(x, y) / (y ^ 2 + 1)";
+
+// The same functions registered as user functions, as they had to be before built-ins existed
+static double user_exp(double args[])   { return exp(args[0]); }
+static double user_log(double args[])   { return log(args[0]); }
+static double user_sqrt(double args[])  { return sqrt(args[0]); }
+static double user_abs(double args[])   { return fabs(args[0]); }
+static double user_max(double args[])   { return args[0] > args[1] ? args[0] : args[1]; }
+static double user_hypot(double args[]) { return hypot(args[0], args[1]); }
+static double user_pow(double args[])   { return pow(args[0], args[1]); }
+
+int main()
+{
+    ContextMap builtin_ctx;
+    builtin_ctx.add_var_to_ctx("x");
+    builtin_ctx.add_var_to_ctx("y");
+
+    ContextMap user_ctx;
+    user_ctx.add_var_to_ctx("x");
+    user_ctx.add_var_to_ctx("y");
+    user_ctx.add_func_to_ctx("exp", 1, user_exp);
+    user_ctx.add_func_to_ctx("log", 1, user_log);
+    user_ctx.add_func_to_ctx("sqrt", 1, user_sqrt);
+    user_ctx.add_func_to_ctx("abs", 1, user_abs);
+    user_ctx.add_func_to_ctx("max", 2, user_max);
+    user_ctx.add_func_to_ctx("hypot", 2, user_hypot);
+    user_ctx.add_func_to_ctx("pow", 2, user_pow);
+
+    VariableIndex index({"x", "y"});
+    auto builtin = compile_to_expression(EXPR, builtin_ctx, index);
+    auto user = compile_to_expression("exp(-x / 4) * sqrt(y) + log(x + 1) * abs(x - y) - max(x, y) + pow(x, 3) - hypot(x, y) / (pow(y, 2) + 1)", user_ctx, index);
+
+    double slots[] = {1.5, 0.75};
+
+    std::cout << "Expression: " << EXPR << "\n\n";
+
+    double user_ns = bench("interpreter: user functions", ITERATIONS, [&]() { slots[0] += 1e-9; return user.evaluate(slots); });
+    double builtin_ns = bench("interpreter: intrinsics", ITERATIONS, [&]() { slots[0] += 1e-9; return builtin.evaluate(slots); });
+
+    double user_jit_ns = 0.0, builtin_jit_ns = 0.0;
+    auto user_native = user;
+    auto builtin_native = builtin;
+    bool jit = user_native.try_set_backend(nexsys::Jit) && builtin_native.try_set_backend(nexsys::Jit);
+    if (jit)
+    {
+        user_jit_ns = bench("jit: user functions", ITERATIONS, [&]() { slots[0] += 1e-9; return user_native.evaluate(slots); });
+        builtin_jit_ns = bench("jit: intrinsics", ITERATIONS, [&]() { slots[0] += 1e-9; return builtin_native.evaluate(slots); });
+    }
+
+    std::vector<double> xs(POINTS), ys(POINTS), out(POINTS);
+    for (size_t i = 0; i < POINTS; i++)
+    {
+        xs[i] = 0.5 + i * 1e-5;
+        ys[i] = 0.25 + i * 2e-5;
+    }
+    const double* columns[] = {xs.data(), ys.data()};
+
+    double user_batch_ns = bench("evaluate_batch (avx2): user functions", BATCH_ITERATIONS, [&]() {
+        nexsys::evaluate_batch(user.get_bytecode(), columns, POINTS, out.data(), nexsys::Avx2);
+        return out[POINTS - 1];
+    });
+    double builtin_batch_ns = bench("evaluate_batch (avx2): intrinsics", BATCH_ITERATIONS, [&]() {
+        nexsys::evaluate_batch(builtin.get_bytecode(), columns, POINTS, out.data(), nexsys::Avx2);
+        return out[POINTS - 1];
+    });
+
+    std::cout << '\n';
+    report_speedup("intrinsics vs. user functions (interpreter)", user_ns, builtin_ns);
+    if (jit)
+    {
+        report_speedup("intrinsics vs. user functions (jit)", user_jit_ns, builtin_jit_ns);
+    }
+    report_speedup("intrinsics vs. user functions (avx2 batch)", user_batch_ns, builtin_batch_ns);
+
+    return 0;
+}
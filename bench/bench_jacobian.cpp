@@ -0,0 +1,109 @@
+#include "bench.hpp"
+#include "jacobian.hpp"
+
+using nexsys::ColoredJacobian;
+using nexsys::compile_to_expression;
+using nexsys::CompiledExpression;
+using nexsys::CompiledSystem;
+using nexsys::ContextMap;
+using nexsys::DualJacobian;
+using nexsys::Matrix;
+using nexsys::SymbolicJacobian;
+using nexsys::VariableIndex;
+
+constexpr size_t ITERATIONS = 20000;
+constexpr size_t N = 12;
+constexpr size_t SPARSE_N = 400;
+
+int main()
+{
+    ContextMap ctx;
+    VariableIndex index;
+    std::vector<CompiledExpression> system;
+
+    for (size_t i = 0; i < N; i++)
+    {
+        ctx.add_var_to_ctx("x" + std::to_string(i));
+        index.insert("x" + std::to_string(i));
+    }
+    for (size_t i = 0; i < N; i++)
+    {
+        // A chain of coupled nonlinear equations, like a discretized boundary value problem
+        std::string xi = "x" + std::to_string(i);
+        std::string prev = "x" + std::to_string((i + N - 1) % N);
+        std::string next = "x" + std::to_string((i + 1) % N);
+        std::string eq = prev + " - 2 * " + xi + " + " + next + " + 0.1 * " + xi + " ^ 3 - " + prev + " * " + next + " / (1 + " + xi + " ^ 2)";
+        system.push_back(compile_to_expression(eq, ctx, index));
+    }
+
+    SymbolicJacobian exact(system);
+    DualJacobian automatic(system);
+    std::vector<double> x(N, 0.5);
+    std::vector<double> f(N);
+    Matrix<double> jacobian(N, N);
+
+    std::cout << "System: " << N << " coupled equations, " << exact.get_entry_count() << " nonzero partial derivatives\n\n";
+
+    double fd_ns = bench("jacobian: FiniteDifference", ITERATIONS, [&]() {
+        x[0] += 1e-9;
+        for (size_t i = 0; i < N; i++) f[i] = system[i].evaluate(x);
+        nexsys::finite_difference_jacobian(system, x, f, jacobian);
+        return jacobian.get_index_ref(0, 0);
+    });
+    double sym_ns = bench("jacobian: Symbolic", ITERATIONS, [&]() {
+        x[0] += 1e-9;
+        for (size_t i = 0; i < N; i++) f[i] = system[i].evaluate(x);
+        exact.evaluate(system, x, f, jacobian);
+        return jacobian.get_index_ref(0, 0);
+    });
+    double ad_ns = bench("jacobian: Automatic", ITERATIONS, [&]() {
+        x[0] += 1e-9;
+        automatic.evaluate(system, x, f, jacobian);
+        return jacobian.get_index_ref(0, 0);
+    });
+
+    std::cout << '\n';
+    report_speedup("symbolic vs. finite difference", fd_ns, sym_ns);
+    report_speedup("automatic vs. finite difference", fd_ns, ad_ns);
+
+    ContextMap sparse_ctx;
+    VariableIndex sparse_index;
+    std::vector<CompiledExpression> sparse_system;
+    for (size_t i = 0; i < SPARSE_N; i++)
+    {
+        sparse_ctx.add_var_to_ctx("x" + std::to_string(i));
+        sparse_index.insert("x" + std::to_string(i));
+    }
+    for (size_t i = 0; i < SPARSE_N; i++)
+    {
+        // Each equation of a large model touches a handful of unknowns
+        std::string xi = "x" + std::to_string(i);
+        std::string a = "x" + std::to_string((i + 1) % SPARSE_N);
+        std::string b = "x" + std::to_string((i * 17 + 3) % SPARSE_N);
+        std::string c = "x" + std::to_string((i * 31 + 11) % SPARSE_N);
+        sparse_system.push_back(compile_to_expression(xi + " * " + a + " - exp(" + b + " / 10) + " + c + " ^ 2 - 1", sparse_ctx, sparse_index));
+    }
+
+    CompiledSystem fused(sparse_system);
+    ColoredJacobian colored(sparse_system, SPARSE_N);
+    std::vector<double> sx(SPARSE_N, 0.5), sf(SPARSE_N);
+    Matrix<double> sparse_jacobian(SPARSE_N, SPARSE_N);
+    fused.evaluate(sx, sf);
+
+    std::cout << "System: " << SPARSE_N << " equations, " << colored.get_nonzero_count() << " nonzero partial derivatives, "
+        << colored.get_color_count() << " colors\n\n";
+
+    double dense_ns = bench("jacobian: FiniteDifference, every column", ITERATIONS / 1000, [&]() {
+        nexsys::finite_difference_jacobian(fused, sx, sf, sparse_jacobian);
+        return sparse_jacobian.get_index_ref(0, 0);
+    });
+    double colored_ns = bench("jacobian: FiniteDifference, colored", ITERATIONS / 1000, [&]() {
+        colored.evaluate(sparse_system, sx, sf, sparse_jacobian);
+        return sparse_jacobian.get_index_ref(0, 0);
+    });
+
+    std::cout << '\n';
+    report_speedup("colored vs. every column", dense_ns, colored_ns);
+
+    return 0;
+}
@@ -0,0 +1,38 @@
+#include "bench.hpp"
+#include "compiled.hpp"
+
+using nexsys::compile_to_expression;
+using nexsys::ContextMap;
+using nexsys::VariableIndex;
+
+constexpr size_t ITERATIONS = 5000000;
+const std::string EXPR = "3 * x ^ 2 + 2 * x * y - y / 4 + (x - y) * (x + y) - 7 * z + z / (x + 1)";
+
+int main()
+{
+    ContextMap ctx;
+    ctx.add_var_to_ctx("x");
+    ctx.add_var_to_ctx("y");
+    ctx.add_var_to_ctx("z");
+
+    VariableIndex index({"x", "y", "z"});
+    auto interpreted = compile_to_expression(EXPR, ctx, index);
+    auto native = interpreted;
+    if (!native.try_set_backend(nexsys::Jit))
+    {
+        std::cout << "Native code generation is not supported on this platform" << '\n';
+        return 0;
+    }
+
+    double slots[] = {1.5, -0.25, 3.0};
+
+    std::cout << "Expression: " << EXPR << "\n\n";
+
+    double vm_ns = bench("backend: Interpreter", ITERATIONS, [&]() { slots[0] += 1e-9; return interpreted.evaluate(slots); });
+    double jit_ns = bench("backend: Jit", ITERATIONS, [&]() { slots[0] += 1e-9; return native.evaluate(slots); });
+
+    std::cout << '\n';
+    report_speedup("jit vs. interpreter", vm_ns, jit_ns);
+
+    return 0;
+}
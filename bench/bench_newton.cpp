@@ -0,0 +1,450 @@
+#include "bench.hpp"
+#include "newton.hpp"
+
+#include <random>
+
+using nexsys::BatchScalarSolver;
+using nexsys::BlockSolver;
+using nexsys::compile_to_expression;
+using nexsys::CompiledExpression;
+using nexsys::CompiledSystem;
+using nexsys::DX;
+using nexsys::ContextMap;
+using nexsys::LU;
+using nexsys::Matrix;
+using nexsys::newton_raphson_multivariate;
+using nexsys::NewtonSolver;
+using nexsys::ParameterSweep;
+using nexsys::ScalarSolver;
+using nexsys::SparseLU;
+using nexsys::SparseMatrix;
+using nexsys::VariableIndex;
+
+constexpr size_t ITERATIONS = 20000;
+constexpr size_t N = 12;
+constexpr size_t SPARSE_N = 500;
+constexpr size_t GRID_WIDTH = 20;
+constexpr size_t BLOCK_WIDTH = 5;
+constexpr size_t STARTS = 500;
+constexpr size_t SWEEP_POINTS = 2000;
+constexpr size_t CELLS = 1 << 18;
+
+int main()
+{
+    ContextMap ctx;
+    VariableIndex index;
+    std::vector<CompiledExpression> system;
+
+    std::string sum = "0";
+    for (size_t i = 0; i < N; i++)
+    {
+        ctx.add_var_to_ctx("x" + std::to_string(i));
+        index.insert("x" + std::to_string(i));
+        sum += " + x" + std::to_string(i);
+    }
+    for (size_t i = 0; i < N; i++)
+    {
+        // A discretized boundary value problem with a nonlinear source term that depends on the whole domain
+        std::string xi = "x" + std::to_string(i);
+        std::string prev = i == 0 ? "0" : "x" + std::to_string(i - 1);
+        std::string next = i == N - 1 ? "1" : "x" + std::to_string(i + 1);
+        system.push_back(compile_to_expression(prev + " - 2 * " + xi + " + " + next + " - 0.05 * exp(" + xi + ") * (1 + 0.01 * (" + sum + "))", ctx, index));
+    }
+
+    std::vector<double> guess(N, 0.5);
+    NewtonSolver solver(system);
+    solver.solve(guess, 1e-9, 50);
+
+    std::cout << "System: " << N << " coupled equations, " << solver.get_iteration_count() << " iterations per solve\n\n";
+
+    double fresh_ns = bench("newton_raphson_multivariate", ITERATIONS, [&]() {
+        guess[0] += 1e-12;
+        return newton_raphson_multivariate(system, guess, 1e-9, 50)[0];
+    });
+    double reused_ns = bench("NewtonSolver::solve", ITERATIONS, [&]() {
+        guess[0] += 1e-12;
+        return solver.solve(guess, 1e-9, 50)[0];
+    });
+
+    std::cout << '\n';
+    report_speedup("reused workspace vs. fresh solve", fresh_ns, reused_ns);
+
+    solver.solve(guess, 1e-9, 50);
+    size_t newton_evaluations = solver.get_evaluation_count();
+    solver.solve(guess, 1e-9, 50, nexsys::Broyden);
+    std::cout << "System evaluations per solve: " << newton_evaluations << " with a fresh jacobian every iteration, " 
+        << solver.get_evaluation_count() << " with Broyden updates (" << solver.get_jacobian_count() << " jacobians, " 
+        << solver.get_iteration_count() << " iterations)\n\n";
+
+    double broyden_ns = bench("NewtonSolver::solve, Broyden", ITERATIONS, [&]() {
+        guess[0] += 1e-12;
+        return solver.solve(guess, 1e-9, 50, nexsys::Broyden)[0];
+    });
+
+    std::cout << '\n';
+    report_speedup("Broyden vs. fresh jacobians", reused_ns, broyden_ns);
+
+    std::vector<double> f(N), step(N);
+    Matrix<double> jacobian(N, N);
+    LU<double> lu(N);
+    CompiledSystem fused(system);
+    fused.evaluate(guess, f);
+    nexsys::finite_difference_jacobian(fused, guess, f, jacobian);
+
+    double invert_ns = bench("step: invert and multiply", ITERATIONS * 10, [&]() {
+        Matrix<double> inverse = jacobian;
+        inverse.try_inplace_invert();
+        for (size_t j = 0; j < N; j++)
+        {
+            step[j] = 0.0;
+            for (size_t k = 0; k < N; k++)
+            {
+                step[j] += inverse.get_index(j, k) * f[k];
+            }
+        }
+        return step[0];
+    });
+    double lu_ns = bench("step: LU factor and solve", ITERATIONS * 10, [&]() {
+        lu.try_factor(jacobian);
+        lu.solve(f, step);
+        return step[0];
+    });
+
+    std::cout << '\n';
+    report_speedup("LU vs. inversion", invert_ns, lu_ns);
+
+    ContextMap sparse_ctx;
+    VariableIndex sparse_index;
+    std::vector<CompiledExpression> sparse_system;
+    for (size_t i = 0; i < SPARSE_N; i++)
+    {
+        sparse_ctx.add_var_to_ctx("x" + std::to_string(i));
+        sparse_index.insert("x" + std::to_string(i));
+    }
+    for (size_t i = 0; i < SPARSE_N; i++)
+    {
+        // A large model: a grid of unknowns, each coupled to its four neighbours
+        auto at = [&](size_t row, size_t col) { return "x" + std::to_string(row * GRID_WIDTH + col); };
+        size_t row = i / GRID_WIDTH, col = i % GRID_WIDTH;
+        std::string neighbours = "1";
+        neighbours += col > 0 ? " + " + at(row, col - 1) : "";
+        neighbours += col + 1 < GRID_WIDTH ? " + " + at(row, col + 1) : "";
+        neighbours += row > 0 ? " + " + at(row - 1, col) : "";
+        neighbours += row + 1 < SPARSE_N / GRID_WIDTH ? " + " + at(row + 1, col) : "";
+        sparse_system.push_back(compile_to_expression(neighbours + " - 5 * " + at(row, col) + " - 0.01 * exp(" + at(row, col) + ")", sparse_ctx, sparse_index));
+    }
+
+    std::vector<double> sparse_guess(SPARSE_N, 0.5), sparse_f(SPARSE_N), sparse_step(SPARSE_N);
+    SparseMatrix<double> sparse_jacobian = nexsys::jacobian_pattern(sparse_system, SPARSE_N);
+    nexsys::ColoredJacobian colored(sparse_system, SPARSE_N);
+    for (size_t i = 0; i < SPARSE_N; i++)
+    {
+        sparse_f[i] = sparse_system[i].evaluate(sparse_guess);
+    }
+    colored.evaluate(sparse_system, sparse_guess, sparse_f, sparse_jacobian);
+    Matrix<double> dense_jacobian = sparse_jacobian.to_dense();
+
+    LU<double> dense_lu(SPARSE_N);
+    SparseLU<double> sparse_lu;
+    sparse_lu.analyze(sparse_jacobian);
+    sparse_lu.try_factor(sparse_jacobian);
+
+    std::cout << "System: " << SPARSE_N << " equations, " << sparse_jacobian.get_nonzero_count() << " nonzero partial derivatives, " 
+        << sparse_lu.get_nonzero_count() << " entries in L and U\n\n";
+
+    double dense_ns = bench("step: dense LU factor and solve", 10, [&]() {
+        dense_lu.try_factor(dense_jacobian);
+        dense_lu.solve(sparse_f, sparse_step);
+        return sparse_step[0];
+    });
+    double sparse_ns = bench("step: sparse LU factor and solve", ITERATIONS / 10, [&]() {
+        sparse_lu.try_factor(sparse_jacobian);
+        std::copy(sparse_f.begin(), sparse_f.end(), sparse_step.begin());
+        sparse_lu.solve(sparse_step.data());
+        return sparse_step[0];
+    });
+
+    std::cout << '\n';
+    report_speedup("sparse LU vs. dense LU", dense_ns, sparse_ns);
+
+    NewtonSolver sparse_solver(sparse_system);
+    sparse_solver.solve(sparse_guess, 1e-9, 50);
+    std::cout << "Sparse solve: " << sparse_solver.get_iteration_count() << " iterations\n\n";
+    bench("NewtonSolver::solve, sparse", ITERATIONS / 100, [&]() {
+        sparse_guess[0] += 1e-12;
+        return sparse_solver.solve(sparse_guess, 1e-9, 50)[0];
+    });
+
+    NewtonSolver serial_solver(sparse_system, nexsys::Symbolic);
+    NewtonSolver parallel_solver(sparse_system, nexsys::Symbolic);
+    serial_solver.set_parallel_threshold(SIZE_MAX);
+    parallel_solver.set_parallel_threshold(0);
+    std::cout << "\nSplitting evaluation across " << nexsys::ThreadPool::shared().size() << " threads\n\n";
+
+    double serial_ns = bench("NewtonSolver::solve, symbolic, serial", ITERATIONS / 100, [&]() {
+        sparse_guess[0] += 1e-12;
+        return serial_solver.solve(sparse_guess, 1e-9, 50)[0];
+    });
+    double parallel_ns = bench("NewtonSolver::solve, symbolic, parallel", ITERATIONS / 100, [&]() {
+        sparse_guess[0] += 1e-12;
+        return parallel_solver.solve(sparse_guess, 1e-9, 50)[0];
+    });
+
+    std::cout << '\n';
+    report_speedup("parallel vs. serial evaluation", serial_ns, parallel_ns);
+
+    std::vector<CompiledExpression> chain_system;
+    for (size_t i = 0; i < SPARSE_N; i++)
+    {
+        // A chain of small coupled units, each driven by the one before it
+        size_t first = i - i % BLOCK_WIDTH;
+        std::string xi = "x" + std::to_string(i);
+        std::string partner = "x" + std::to_string(first + (i + 1) % BLOCK_WIDTH);
+        std::string driver = first == 0 ? "1" : "x" + std::to_string(first - 1);
+        chain_system.push_back(compile_to_expression("3 * " + xi + " + 0.1 * exp(" + partner + ") - " + driver, sparse_ctx, sparse_index));
+    }
+
+    std::vector<double> chain_guess(SPARSE_N, 0.0);
+    NewtonSolver whole_solver(chain_system);
+    BlockSolver block_solver(chain_system);
+    whole_solver.solve(chain_guess, 1e-9, 50);
+    block_solver.solve(chain_guess, 1e-9, 50);
+    std::cout << "\nSystem: " << SPARSE_N << " equations in " << block_solver.get_decomposition().get_block_count() << " blocks of at most " 
+        << block_solver.get_decomposition().get_largest_block_size() << " unknowns, " << whole_solver.get_iteration_count() << " iterations whole, " 
+        << block_solver.get_iteration_count() << " over every block\n\n";
+
+    double whole_ns = bench("NewtonSolver::solve, whole system", ITERATIONS / 100, [&]() {
+        chain_guess[0] += 1e-12;
+        return whole_solver.solve(chain_guess, 1e-9, 50)[0];
+    });
+    double block_ns = bench("BlockSolver::solve", ITERATIONS / 100, [&]() {
+        chain_guess[0] += 1e-12;
+        return block_solver.solve(chain_guess, 1e-9, 50)[0];
+    });
+
+    std::cout << '\n';
+    report_speedup("block by block vs. whole system", whole_ns, block_ns);
+
+    std::vector<CompiledExpression> saturating_system;
+    for (size_t i = 0; i < N; i++)
+    {
+        // Saturating responses, which send full newton steps far past the root from anywhere but close by
+        std::string xi = "x" + std::to_string(i);
+        std::string next = "x" + std::to_string((i + 1) % N);
+        saturating_system.push_back(compile_to_expression("atan(" + xi + " - 1) + 0.05 * (" + xi + " - " + next + ") + 0.1 * tanh(" + next + ")", ctx, index));
+    }
+
+    std::mt19937_64 rng(42);
+    std::vector<std::vector<double>> starts(STARTS, std::vector<double>(N));
+    for (auto& start: starts)
+    {
+        for (auto& value: start)
+        {
+            value = std::uniform_real_distribution<double>(-10.0, 10.0)(rng);
+        }
+    }
+
+    NewtonSolver saturating_solver(saturating_system, nexsys::Symbolic);
+    std::cout << '\n';
+    for (auto [name, control]: {std::pair{"full steps", nexsys::FullStep}, {"dogleg", nexsys::Dogleg}, {"levenberg-marquardt", nexsys::LevenbergMarquardt}})
+    {
+        size_t failed = 0, iterations = 0, evaluations = 0;
+        for (auto& start: starts)
+        {
+            try
+            {
+                saturating_solver.solve(start, 1e-9, 100, nexsys::Recompute, control);
+                iterations += saturating_solver.get_iteration_count();
+                evaluations += saturating_solver.get_evaluation_count();
+            }
+            catch (const std::runtime_error&)
+            {
+                failed++;
+            }
+        }
+        std::cout << "[ STARTS ]......" << name << "......" << failed << " of " << STARTS << " failed, " 
+            << (STARTS == failed ? 0 : iterations / (STARTS - failed)) << " iterations and " 
+            << (STARTS == failed ? 0 : evaluations / (STARTS - failed)) << " evaluations per solved start\n";
+    }
+
+    std::cout << '\n';
+    size_t next_start = 0;
+    bench("NewtonSolver::solve, dogleg, random starts", ITERATIONS / 10, [&]() {
+        return saturating_solver.solve(starts[next_start++ % STARTS], 1e-9, 100, nexsys::Recompute, nexsys::Dogleg)[0];
+    });
+    bench("NewtonSolver::solve, levenberg-marquardt, random starts", ITERATIONS / 10, [&]() {
+        return saturating_solver.solve(starts[next_start++ % STARTS], 1e-9, 100, nexsys::Recompute, nexsys::LevenbergMarquardt)[0];
+    });
+
+    ctx.add_var_to_ctx("load");
+    index.insert("load");
+    std::vector<CompiledExpression> loaded_system;
+    for (size_t i = 0; i < N; i++)
+    {
+        // The boundary value problem from above, with the strength of its source term swept
+        std::string xi = "x" + std::to_string(i);
+        std::string prev = i == 0 ? "0" : "x" + std::to_string(i - 1);
+        std::string next = i == N - 1 ? "1" : "x" + std::to_string(i + 1);
+        loaded_system.push_back(compile_to_expression(prev + " - 2 * " + xi + " + " + next + " - load * exp(" + xi + ") * (1 + 0.01 * (" + sum + "))", ctx, index));
+    }
+
+    Matrix<double> loads(SWEEP_POINTS, 1);
+    for (size_t k = 0; k < SWEEP_POINTS; k++)
+    {
+        loads.get_index_ref(k, 0) = 0.3 * k / SWEEP_POINTS;
+    }
+
+    std::vector<double> cold_guess(N, 0.5), cold_input(N + 1, 0.5);
+    ParameterSweep sweep(loaded_system);
+    sweep.solve(cold_guess, loads, 1e-9, 50);
+    size_t cold_iterations = 0;
+    for (size_t k = 0; k < SWEEP_POINTS; k++)
+    {
+        cold_input[N] = loads.get_index(k, 0);
+        BlockSolver cold(loaded_system);
+        cold.solve(cold_input, 1e-9, 50);
+        cold_iterations += cold.get_iteration_count();
+    }
+    std::cout << "\nSweep: " << SWEEP_POINTS << " loads, " << cold_iterations << " iterations from cold guesses, " 
+        << sweep.get_iteration_count() << " warm started in " << sweep.get_segment_count() << " segments\n\n";
+
+    double cold_ns = bench("new BlockSolver per point, cold guess", 10, [&]() {
+        double total = 0.0;
+        for (size_t k = 0; k < SWEEP_POINTS; k++)
+        {
+            cold_input[N] = loads.get_index(k, 0);
+            total += BlockSolver(loaded_system).solve(cold_input, 1e-9, 50)[0];
+        }
+        return total;
+    });
+    double sweep_ns = bench("ParameterSweep::solve", 10, [&]() {
+        return sweep.solve(cold_guess, loads, 1e-9, 50).get_index(0, 0);
+    });
+
+    std::cout << '\n';
+    report_speedup("warm started sweep vs. cold solves", cold_ns, sweep_ns);
+
+    // A saturating response with its root near 1.25, searched for from anywhere in its bounds
+    auto response = [](double x) { return std::atan(4.0 * x - 5.0) + 0.02 * x; };
+    auto response_prime = [](double x) { return 4.0 / (1.0 + (4.0 * x - 5.0) * (4.0 * x - 5.0)) + 0.02; };
+    std::vector<double> scalar_starts(STARTS);
+    for (auto& start: scalar_starts)
+    {
+        start = std::uniform_real_distribution<double>(0.0, 10.0)(rng);
+    }
+
+    // Newton's method with a forward difference and no bracket, two evaluations per step
+    auto plain_newton = [&](double x, size_t& evaluations) {
+        for (size_t iteration = 0; iteration < 100; iteration++)
+        {
+            double y = response(x);
+            double step = y * DX / (response(x + DX) - y);
+            evaluations += 2;
+            if (std::fabs(y) < 1e-12 && std::fabs(step) < 1e-12)
+            {
+                return x;
+            }
+            x = std::min(std::max(x - step, 0.0), 10.0);
+        }
+        throw std::runtime_error("did not converge");
+    };
+
+    ScalarSolver scalar;
+    std::cout << '\n';
+    for (size_t engine = 0; engine < 3; engine++)
+    {
+        const char* names[] = {"plain newton", "bracketed secant", "bracketed newton"};
+        size_t failed = 0, evaluations = 0;
+        for (double start: scalar_starts)
+        {
+            try
+            {
+                if (engine == 0)
+                {
+                    size_t used = 0;
+                    plain_newton(start, used);
+                    evaluations += used;
+                }
+                else
+                {
+                    engine == 1 ? scalar.solve(response, start, 0.0, 10.0, 1e-12, 100) : scalar.solve(response, response_prime, start, 0.0, 10.0, 1e-12, 100);
+                    evaluations += scalar.get_evaluation_count() + scalar.get_derivative_count();
+                }
+            }
+            catch (const std::runtime_error&)
+            {
+                failed++;
+            }
+        }
+        std::cout << "[ STARTS ]......" << names[engine] << "......" << failed << " of " << STARTS << " failed, " 
+            << (STARTS == failed ? 0 : evaluations / (STARTS - failed)) << " evaluations per solved start\n";
+    }
+
+    std::cout << '\n';
+    bench("ScalarSolver::solve, secant, random starts", ITERATIONS * 10, [&]() {
+        return scalar.solve(response, scalar_starts[next_start++ % STARTS], 0.0, 10.0, 1e-12, 100);
+    });
+    bench("ScalarSolver::solve, newton, random starts", ITERATIONS * 10, [&]() {
+        return scalar.solve(response, response_prime, scalar_starts[next_start++ % STARTS], 0.0, 10.0, 1e-12, 100);
+    });
+
+    ContextMap kepler_ctx;
+    kepler_ctx.add_var_to_ctx("E");
+    kepler_ctx.add_var_to_ctx("e");
+    kepler_ctx.add_var_to_ctx("M");
+    VariableIndex kepler_index({"E", "e", "M"});
+
+    // Kepler's equation for the eccentric anomaly E, one orbit per cell
+    CompiledExpression kepler = compile_to_expression("E - e * sin(E) - M", kepler_ctx, kepler_index);
+    std::vector<double> eccentricity(CELLS), anomaly(CELLS), cell_min(CELLS, 0.0), cell_max(CELLS, 2.0 * M_PI), cell_roots(CELLS);
+    for (size_t k = 0; k < CELLS; k++)
+    {
+        eccentricity[k] = std::uniform_real_distribution<double>(0.0, 0.99)(rng);
+        anomaly[k] = std::uniform_real_distribution<double>(0.0, 2.0 * M_PI)(rng);
+    }
+    const double* cell_columns[] = {nullptr, eccentricity.data(), anomaly.data()};
+
+    BatchScalarSolver batch(kepler, 0);
+    batch.solve(cell_columns, anomaly.data(), cell_min.data(), cell_max.data(), CELLS, 1e-12, 100, cell_roots.data());
+    size_t cell_evaluations = 0;
+    for (size_t k = 0; k < CELLS; k++)
+    {
+        double point[3] = {0.0, eccentricity[k], anomaly[k]};
+        scalar.solve([&](double E) { point[0] = E; return kepler.evaluate(point); }, anomaly[k], 0.0, 2.0 * M_PI, 1e-12, 100);
+        cell_evaluations += scalar.get_evaluation_count();
+    }
+    std::cout << "\nCells: " << CELLS << " problems, " << (double)cell_evaluations / CELLS << " evaluations each one at a time, " 
+        << (double)batch.get_evaluation_count() / CELLS << " in " << batch.get_iteration_count() << " lockstep rounds, " 
+        << batch.get_failure_count() << " failed\n\n";
+
+    double cells_ns = bench("ScalarSolver::solve per cell", 5, [&]() {
+        double total = 0.0;
+        for (size_t k = 0; k < CELLS; k++)
+        {
+            double point[3] = {0.0, eccentricity[k], anomaly[k]};
+            total += scalar.solve([&](double E) { point[0] = E; return kepler.evaluate(point); }, anomaly[k], 0.0, 2.0 * M_PI, 1e-12, 100);
+        }
+        return total;
+    });
+    BatchScalarSolver batch_scalar(kepler, 0, nexsys::Scalar), batch_avx2(kepler, 0, nexsys::Avx2);
+    double batch_scalar_ns = bench("BatchScalarSolver::solve, scalar lanes", 5, [&]() {
+        batch_scalar.solve(cell_columns, anomaly.data(), cell_min.data(), cell_max.data(), CELLS, 1e-12, 100, cell_roots.data());
+        return cell_roots[0];
+    });
+    double batch_avx2_ns = bench("BatchScalarSolver::solve, AVX2 lanes", 5, [&]() {
+        batch_avx2.solve(cell_columns, anomaly.data(), cell_min.data(), cell_max.data(), CELLS, 1e-12, 100, cell_roots.data());
+        return cell_roots[0];
+    });
+    double batch_ns = bench("BatchScalarSolver::solve, widest lanes", 5, [&]() {
+        batch.solve(cell_columns, anomaly.data(), cell_min.data(), cell_max.data(), CELLS, 1e-12, 100, cell_roots.data());
+        return cell_roots[0];
+    });
+
+    std::cout << '\n';
+    report_speedup("lockstep batch vs. one solve per cell", cells_ns, batch_ns);
+    report_speedup("AVX2 lanes vs. scalar lanes", batch_scalar_ns, batch_avx2_ns);
+    report_speedup("widest lanes vs. scalar lanes", batch_scalar_ns, batch_ns);
+    report_speedup("widest lanes vs. AVX2 lanes", batch_avx2_ns, batch_ns);
+
+    return 0;
+}
@@ -0,0 +1,105 @@
+#include <random>
+
+#include "bench.hpp"
+#include "newton.hpp"
+
+using nexsys::compile_to_expression;
+using nexsys::CompiledExpression;
+using nexsys::ContextMap;
+using nexsys::Interval;
+using nexsys::IntervalPresolve;
+using nexsys::newton_raphson_multivariate;
+using nexsys::Variable;
+using nexsys::VariableIndex;
+
+constexpr size_t STARTS = 500;
+constexpr size_t PRESOLVE_ITERATIONS = 2000;
+
+// An ideal gas state fixed by its enthalpy and entropy, with the wide bounds typical of property tables
+const std::vector<std::string> SYSTEM = {
+    "P * v - 287 * T",
+    "h - 1005 * T",
+    "h - 450000 - 2000 * v",
+    "1005 * log(T / 298) - 287 * log(P / 101325) - 250",
+};
+
+/// @brief Solves from every guess, counting the starts that fail to produce a root
+template<typename F>
+size_t count_failures(const std::vector<std::vector<double>>& guesses, F solve)
+{
+    size_t failures = 0;
+    for (auto& guess: guesses)
+    {
+        try
+        {
+            auto root = solve(guess);
+            for (double value: root)
+            {
+                if (!std::isfinite(value))
+                {
+                    throw std::runtime_error("non-finite root");
+                }
+            }
+        }
+        catch(const std::exception&)
+        {
+            failures++;
+        }
+    }
+    return failures;
+}
+
+int main()
+{
+    ContextMap ctx;
+    ctx.add_var_to_ctx("P", new Variable(101325.0, 1e3, 1e7));
+    ctx.add_var_to_ctx("T", new Variable(300.0, 200.0, 2000.0));
+    ctx.add_var_to_ctx("v", new Variable(1.0, 1e-3, 10.0));
+    ctx.add_var_to_ctx("h", new Variable(3e5, 0.0, 3e6));
+
+    VariableIndex index({"P", "T", "v", "h"});
+    std::vector<CompiledExpression> system;
+    for (auto& expr: SYSTEM)
+    {
+        system.push_back(compile_to_expression(expr, ctx, index));
+    }
+    std::vector<Interval> bounds = nexsys::bounds_from_context(ctx, index);
+
+    // Guesses anywhere from well below to well above each variable's domain, as from a stale or default state
+    std::mt19937_64 rng(42);
+    std::vector<std::vector<double>> guesses(STARTS);
+    for (auto& guess: guesses)
+    {
+        for (auto& domain: bounds)
+        {
+            guess.push_back(std::uniform_real_distribution<double>(-domain.hi, 2.0 * domain.hi)(rng));
+        }
+    }
+
+    IntervalPresolve presolve(system);
+    std::vector<Interval> tightened = bounds;
+    presolve.try_tighten(tightened);
+    std::cout << "Tightened domains:\n";
+    for (size_t slot = 0; slot < index.size(); slot++)
+    {
+        std::cout << "    " << index.get_name(slot) << ": [" << bounds[slot].lo << ", " << bounds[slot].hi << "] -> ["
+            << tightened[slot].lo << ", " << tightened[slot].hi << "]\n";
+    }
+    std::cout << '\n';
+
+    bench("presolve", PRESOLVE_ITERATIONS, [&]() {
+        std::vector<Interval> box = bounds;
+        presolve.try_tighten(box);
+        return box[0].lo;
+    });
+
+    size_t plain = count_failures(guesses, [&](const std::vector<double>& guess) {
+        return newton_raphson_multivariate(system, guess, 1e-6, 100);
+    });
+    size_t bounded = count_failures(guesses, [&](const std::vector<double>& guess) {
+        return newton_raphson_multivariate(system, guess, bounds, 1e-6, 100);
+    });
+
+    std::cout << "[ STARTS ]......unbounded newton......" << plain << " of " << STARTS << " failed\n";
+    std::cout << "[ STARTS ]......presolved newton......" << bounded << " of " << STARTS << " failed\n";
+}
@@ -0,0 +1,67 @@
+#include "bench.hpp"
+#include "system.hpp"
+
+using nexsys::compile_to_expression;
+using nexsys::CompiledExpression;
+using nexsys::CompiledSystem;
+using nexsys::ContextMap;
+using nexsys::VariableIndex;
+
+constexpr size_t ITERATIONS = 500000;
+constexpr size_t N = 16;
+
+int main()
+{
+    ContextMap ctx;
+    VariableIndex index;
+    std::vector<CompiledExpression> system;
+
+    for (size_t i = 0; i <= N; i++)
+    {
+        ctx.add_var_to_ctx("p" + std::to_string(i));
+        index.insert("p" + std::to_string(i));
+    }
+    for (size_t i = 0; i < N; i++)
+    {
+        // A pipe network: each node balances the flow terms of its neighbouring segments
+        std::string pi = "p" + std::to_string(i);
+        std::string pj = "p" + std::to_string(i + 1);
+        std::string pk = "p" + std::to_string((i + 2) % (N + 1));
+        std::string seg = "((" + pi + " - " + pj + ")^2 / (1 + " + pi + " * " + pj + "))";
+        std::string next = "((" + pj + " - " + pk + ")^2 / (1 + " + pj + " * " + pk + "))";
+        system.push_back(compile_to_expression(seg + " - " + next + " + 0.5 * " + seg + " * " + next + " - " + pi, ctx, index));
+    }
+
+    CompiledSystem fused(system);
+    std::vector<double> x(N + 1, 0.75);
+    std::vector<double> out(N);
+
+    std::cout << "System: " << N << " equations, " << fused.get_shared_count() << " shared subexpressions\n\n";
+
+    double separate_ns = bench("residual: per expression", ITERATIONS, [&]() {
+        x[0] += 1e-9;
+        for (size_t i = 0; i < N; i++) out[i] = system[i].evaluate(x);
+        return out[0];
+    });
+    double fused_ns = bench("residual: CompiledSystem", ITERATIONS, [&]() {
+        x[0] += 1e-9;
+        fused.evaluate(x.data(), out.data());
+        return out[0];
+    });
+
+    double jit_ns = fused_ns;
+    if (fused.try_set_backend(nexsys::Jit))
+    {
+        jit_ns = bench("residual: CompiledSystem (jit)", ITERATIONS, [&]() {
+            x[0] += 1e-9;
+            fused.evaluate(x.data(), out.data());
+            return out[0];
+        });
+    }
+
+    std::cout << '\n';
+    report_speedup("fused vs. per expression", separate_ns, fused_ns);
+    report_speedup("fused jit vs. per expression", separate_ns, jit_ns);
+
+    return 0;
+}
@@ -0,0 +1,82 @@
+#ifndef _BATCH_HPP
+#define _BATCH_HPP
+
+#include <vector>
+
+#include "bytecode.hpp" // also includes "context.hpp", "variable.hpp"
+
+namespace nexsys
+{
+    /// @brief The number of points evaluated together by each pass over a `Bytecode` program.
+    /// Must be a multiple of the widest SIMD register in doubles.
+    constexpr size_t BATCH_BLOCK = 256;
+
+    /// @brief The instruction sets that batch evaluation may be performed with
+    enum BatchIsa
+    {
+        Scalar,
+        Avx2,
+        Avx512,
+    };
+
+    /// @brief Finds the widest instruction set supported by the running CPU
+    /// @return The best `BatchIsa` for this machine
+    BatchIsa detect_batch_isa();
+
+    /// @brief Evaluates a bytecode program at many points at once
+    /// @param code The program to evaluate
+    /// @param columns One column of `count` values for each variable slot (i.e. structure-of-arrays input)
+    /// @param count The number of points to evaluate
+    /// @param out A column of at least `count` values to write the results to
+    /// @param isa The instruction set to evaluate with. Falls back to `Scalar` if the CPU does not support it.
+    void evaluate_batch(const Bytecode& code, const double* const* columns, size_t count, double* out, BatchIsa isa);
+
+    /// @brief The state of many independent bracketed secant iterations, one problem per entry of each
+    /// column, for `propose_roots` and `update_roots` to advance in lockstep. Flags are `0.0` or `1.0`
+    /// so that they can be blended like any other lane.
+    struct RootColumns
+    {
+        double* x;          // The current iterate
+        double* f;          // The function's value at `x`
+        double* previous;   // The iterate before `x`, the other end of the secant
+        double* f_previous; // The function's value at `previous`
+        double* lo;         // The lower end of the bracket, or the lower bound until there is one
+        double* hi;         // The upper end of the bracket, or the upper bound until there is one
+        double* f_lo;       // The function's value at `lo` once bracketed
+        double* last_step;  // The step from `previous` to `x`
+        double* older_step; // The step before `last_step`
+        double* bracketed;  // Whether the function is known to change sign within `[lo, hi]`
+        double* done;       // `0.0` while solving, `1.0` once converged, `2.0` once stuck. Problems that are done are left alone.
+        double* point;      // Where each problem next needs the function evaluated
+        double* value;      // The function's value at `point`
+    };
+
+    /// @brief Takes the next step of every problem that is not done, writing each new iterate to `point`.
+    /// Steps are secant steps, clamped to the bounds until a problem is bracketed. After that, a step
+    /// is replaced by bisection if it leaves the bracket or is longer than half the step before last.
+    /// @param roots The problems
+    /// @param count The number of problems
+    /// @param isa The instruction set to step with. Falls back to `Scalar` if the CPU does not support it.
+    void propose_roots(const RootColumns& roots, size_t count, BatchIsa isa);
+
+    /// @brief Takes in the function's value at each new iterate from `value`, shrinking or forming
+    /// each bracket and marking problems whose value and step (or bracket) are within `margin` as
+    /// converged, and unbracketed problems that could not move as stuck
+    /// @param roots The problems
+    /// @param count The number of problems
+    /// @param margin The margin of error for both each root and the function's value there
+    /// @param isa The instruction set to update with. Falls back to `Scalar` if the CPU does not support it.
+    void update_roots(const RootColumns& roots, size_t count, double margin, BatchIsa isa);
+
+    /// @brief Evaluates a bytecode program at many points at once using the best instruction set available
+    /// @param code The program to evaluate
+    /// @param columns One column of `count` values for each variable slot (i.e. structure-of-arrays input)
+    /// @param count The number of points to evaluate
+    /// @param out A column of at least `count` values to write the results to
+    inline void evaluate_batch(const Bytecode& code, const double* const* columns, size_t count, double* out)
+    {
+        evaluate_batch(code, columns, count, out, detect_batch_isa());
+    }
+}
+
+#endif
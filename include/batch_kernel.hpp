@@ -0,0 +1,720 @@
+#ifndef _BATCH_KERNEL_HPP
+#define _BATCH_KERNEL_HPP
+// NOTE: This header is an implementation detail of "batch.hpp". It is included by each
+// translation unit that instantiates the kernel for a particular instruction set. Those units
+// are compiled with different `-m` flags, so the kernel must not instantiate any shared inline
+// code (e.g. `std::vector` methods) that the linker could pick for a less capable unit.
+
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#include "batch.hpp"
+
+namespace nexsys
+{
+    /// @brief Lane traits for plain `double` arithmetic. Every instruction set's traits
+    /// provide the same static members so that `run_batch_block` can be written once.
+    struct ScalarLanes
+    {
+        typedef double V;
+        static constexpr size_t width = 1;
+
+        static inline V load(const double* p) { return *p; }
+        static inline void store(double* p, V v) { *p = v; }
+        static inline V set1(double v) { return v; }
+        static inline V add(V a, V b) { return a + b; }
+        static inline V sub(V a, V b) { return a - b; }
+        static inline V mul(V a, V b) { return a * b; }
+        static inline V div(V a, V b) { return a / b; }
+        static inline V min(V a, V b) { return a < b ? a : b; }
+        static inline V max(V a, V b) { return a > b ? a : b; }
+        static inline V abs(V a) { return fabs(a); }
+        static inline V sqrt(V a) { return ::sqrt(a); }
+        static inline V exp(V a) { return ::exp(a); }
+        static inline V log(V a) { return ::log(a); }
+        static inline V log10(V a) { return ::log10(a); }
+        static inline V sin(V a) { return ::sin(a); }
+        static inline V cos(V a) { return ::cos(a); }
+        static inline V tan(V a) { return ::tan(a); }
+        static inline V asin(V a) { return ::asin(a); }
+        static inline V acos(V a) { return ::acos(a); }
+        static inline V atan(V a) { return ::atan(a); }
+        static inline V sinh(V a) { return ::sinh(a); }
+        static inline V cosh(V a) { return ::cosh(a); }
+        static inline V tanh(V a) { return ::tanh(a); }
+        static inline V hypot(V a, V b) { return ::hypot(a, b); }
+
+        /// @brief `a < b ? t : f`
+        static inline V select_lt(V a, V b, V t, V f) { return a < b ? t : f; }
+
+        /// @brief `a <= b ? t : f`
+        static inline V select_le(V a, V b, V t, V f) { return a <= b ? t : f; }
+    };
+
+    /// @brief Raises every lane of `base` to the same integer power by repeated squaring
+    template<typename L>
+    static inline typename L::V lanes_powi(typename L::V base, long exponent)
+    {
+        typename L::V result = L::set1(1.0);
+        unsigned long n = exponent < 0 ? -exponent : exponent;
+
+        while (n != 0)
+        {
+            if (n & 1)
+            {
+                result = L::mul(result, base);
+            }
+            base = L::mul(base, base);
+            n >>= 1;
+        }
+
+        return exponent < 0 ? L::div(L::set1(1.0), result) : result;
+    }
+
+    /// @brief Raises each lane of `base` to the power in the same lane of `exponent`. There is no
+    /// vector `pow` instruction, so this is done one lane at a time.
+    template<typename L>
+    static inline typename L::V lanes_pow(typename L::V base, typename L::V exponent)
+    {
+        double b[L::width], e[L::width];
+        L::store(b, base);
+        L::store(e, exponent);
+
+        for (size_t i = 0; i < L::width; i++)
+        {
+            b[i] = pow(b[i], e[i]);
+        }
+
+        return L::load(b);
+    }
+
+    /// @brief Applies a scalar function to each lane of `v`, for functions with no vector instruction
+    template<typename L, typename F>
+    static inline typename L::V lanes_map(typename L::V v, F func)
+    {
+        double vals[L::width];
+        L::store(vals, v);
+
+        for (size_t i = 0; i < L::width; i++)
+        {
+            vals[i] = func(vals[i]);
+        }
+
+        return L::load(vals);
+    }
+
+    /// @brief Applies a scalar function of two arguments to each pair of lanes of `a` and `b`
+    template<typename L, typename F>
+    static inline typename L::V lanes_map(typename L::V a, typename L::V b, F func)
+    {
+        double as[L::width], bs[L::width];
+        L::store(as, a);
+        L::store(bs, b);
+
+        for (size_t i = 0; i < L::width; i++)
+        {
+            as[i] = func(as[i], bs[i]);
+        }
+
+        return L::load(as);
+    }
+
+    /// @brief `intrinsic_min` in every lane. `L::min` follows `minpd`, which drops a NaN first operand,
+    /// so lanes that compare neither way are summed to NaN instead. Requires lane traits to provide `select_lt` and `select_le`.
+    template<typename L>
+    static inline typename L::V lanes_min(typename L::V a, typename L::V b)
+    {
+        return L::select_lt(a, b, a, L::select_le(b, a, b, L::add(a, b)));
+    }
+
+    /// @brief `intrinsic_max` in every lane, with NaN in either operand giving NaN as for `lanes_min`
+    template<typename L>
+    static inline typename L::V lanes_max(typename L::V a, typename L::V b)
+    {
+        return L::select_lt(b, a, a, L::select_le(a, b, b, L::add(a, b)));
+    }
+
+    /// @brief Evaluates `exp` in every lane with the Cephes rational approximation, accurate to
+    /// about 1 ulp. Lanes whose result would overflow, be subnormal or is NaN use `exp` from libm.
+    /// Requires lane traits to provide `round`, `scale2` and `all_within`.
+    template<typename L>
+    static inline typename L::V lanes_exp(typename L::V x)
+    {
+        typedef typename L::V V;
+        if (!L::all_within(x, -708.0, 708.0))
+        {
+            return lanes_map<L>(x, [](double v) { return ::exp(v); });
+        }
+
+        // exp(x) = 2^n * exp(r), where |r| <= ln(2) / 2
+        V n = L::round(L::mul(x, L::set1(1.4426950408889634073599)));
+        V r = L::sub(x, L::mul(n, L::set1(6.93145751953125E-1)));
+        r = L::sub(r, L::mul(n, L::set1(1.42860682030941723212E-6)));
+
+        // exp(r) = 1 + 2 * r * P(r^2) / (Q(r^2) - r * P(r^2))
+        V rr = L::mul(r, r);
+        V p = L::set1(1.26177193074810590878E-4);
+        p = L::add(L::mul(p, rr), L::set1(3.02994407707441961300E-2));
+        p = L::add(L::mul(p, rr), L::set1(9.99999999999999999910E-1));
+        p = L::mul(p, r);
+        V q = L::set1(3.00198505138664455042E-6);
+        q = L::add(L::mul(q, rr), L::set1(2.52448340349684104192E-3));
+        q = L::add(L::mul(q, rr), L::set1(2.27265548208155028766E-1));
+        q = L::add(L::mul(q, rr), L::set1(2.00000000000000000009E0));
+        V e = L::div(p, L::sub(q, p));
+        e = L::add(L::add(e, e), L::set1(1.0));
+
+        return L::scale2(e, n);
+    }
+
+    /// @brief Evaluates the natural logarithm in every lane with the Cephes rational approximation,
+    /// accurate to about 1 ulp. Lanes that are not positive normal numbers use `log` from libm.
+    /// Requires lane traits to provide `split`, `select_lt` and `all_within`.
+    template<typename L>
+    static inline typename L::V lanes_log(typename L::V x)
+    {
+        typedef typename L::V V;
+        if (!L::all_within(x, DBL_MIN, DBL_MAX))
+        {
+            return lanes_map<L>(x, [](double v) { return ::log(v); });
+        }
+
+        // x = m * 2^e with m in [sqrt(1/2), sqrt(2)), then log(x) = log(1 + f) + e * ln(2) where f = m - 1
+        V e;
+        V m = L::split(x, e);
+        V below = L::set1(0.70710678118654752440);
+        e = L::select_lt(m, below, L::sub(e, L::set1(1.0)), e);
+        V f = L::sub(L::select_lt(m, below, L::add(m, m), m), L::set1(1.0));
+
+        // log(1 + f) = f - f^2 / 2 + f^3 * P(f) / Q(f)
+        V ff = L::mul(f, f);
+        V p = L::set1(1.01875663804580931796E-4);
+        p = L::add(L::mul(p, f), L::set1(4.97494994976747001425E-1));
+        p = L::add(L::mul(p, f), L::set1(4.70579119878881725854E0));
+        p = L::add(L::mul(p, f), L::set1(1.44989225341610930846E1));
+        p = L::add(L::mul(p, f), L::set1(1.79368678507819816313E1));
+        p = L::add(L::mul(p, f), L::set1(7.70838733755885391666E0));
+        V q = L::add(f, L::set1(1.12873587189167450590E1));
+        q = L::add(L::mul(q, f), L::set1(4.52279145837532221105E1));
+        q = L::add(L::mul(q, f), L::set1(8.29875266912776603211E1));
+        q = L::add(L::mul(q, f), L::set1(7.11544750618563894466E1));
+        q = L::add(L::mul(q, f), L::set1(2.31251620126765340583E1));
+
+        V y = L::mul(f, L::div(L::mul(ff, p), q));
+        y = L::sub(y, L::mul(e, L::set1(2.121944400546905827679E-4)));
+        y = L::sub(y, L::mul(ff, L::set1(0.5)));
+        return L::add(L::add(f, y), L::mul(e, L::set1(0.693359375)));
+    }
+
+    /// @brief Evaluates the base 10 logarithm in every lane as `lanes_log` scaled by `1 / ln(10)`, accurate to
+    /// about 2 ulp. Falls back to libm in the same lanes as `lanes_log`.
+    template<typename L>
+    static inline typename L::V lanes_log10(typename L::V x)
+    {
+        return L::mul(lanes_log<L>(x), L::set1(0.43429448190325182765));
+    }
+
+    /// @brief Gives `x` itself wherever it is zero or subnormal, so odd functions keep the sign of zero
+    template<typename L>
+    static inline typename L::V lanes_keep_tiny(typename L::V x, typename L::V res)
+    {
+        return L::select_lt(L::abs(x), L::set1(DBL_MIN), x, res);
+    }
+
+    /// @brief The largest magnitude `lanes_sin`, `lanes_cos` and `lanes_tan` reduce themselves. Below it,
+    /// every multiple of pi/2 times the 23 bit leading parts of pi/2 is exact.
+    constexpr double LANES_TRIG_LIMIT = 1073741824.0;
+
+    /// @brief Reduces every lane to `z` in `[-pi/4, pi/4]` and a quadrant `k` in `{-2, ..., 2}`, where
+    /// `x = z + (4m + k) pi/2` for some integer `m`. Requires lane traits to provide `round`.
+    template<typename L>
+    static inline typename L::V lanes_reduce_pio2(typename L::V x, typename L::V& k)
+    {
+        typedef typename L::V V;
+        V q = L::round(L::mul(x, L::set1(0.63661977236758134308)));
+
+        // pi/2 in three 23 bit parts and a full last part, which keeps the relative error small next to every zero
+        V z = L::sub(x, L::mul(q, L::set1(1.57079625129699707031E+00)));
+        z = L::sub(z, L::mul(q, L::set1(7.54978941586159635335E-08)));
+        z = L::sub(z, L::mul(q, L::set1(5.39030252995776476554E-15)));
+        z = L::sub(z, L::mul(q, L::set1(3.28200354287350047444E-22)));
+
+        k = L::sub(q, L::mul(L::set1(4.0), L::round(L::mul(q, L::set1(0.25)))));
+        return z;
+    }
+
+    /// @brief The Cephes polynomial for `sin(z)` on `[-pi/4, pi/4]`, given `zz = z * z`
+    template<typename L>
+    static inline typename L::V lanes_sin_poly(typename L::V z, typename L::V zz)
+    {
+        typedef typename L::V V;
+        V p = L::set1(1.58962301576546568060E-10);
+        p = L::add(L::mul(p, zz), L::set1(-2.50507477628578072866E-8));
+        p = L::add(L::mul(p, zz), L::set1(2.75573136213857245213E-6));
+        p = L::add(L::mul(p, zz), L::set1(-1.98412698295895385996E-4));
+        p = L::add(L::mul(p, zz), L::set1(8.33333333332211858878E-3));
+        p = L::add(L::mul(p, zz), L::set1(-1.66666666666666307295E-1));
+        return L::add(z, L::mul(L::mul(z, zz), p));
+    }
+
+    /// @brief The Cephes polynomial for `cos(z)` on `[-pi/4, pi/4]`, given `zz = z * z`
+    template<typename L>
+    static inline typename L::V lanes_cos_poly(typename L::V zz)
+    {
+        typedef typename L::V V;
+        V p = L::set1(-1.13585365213876817300E-11);
+        p = L::add(L::mul(p, zz), L::set1(2.08757008419747316778E-9));
+        p = L::add(L::mul(p, zz), L::set1(-2.75573141792967388112E-7));
+        p = L::add(L::mul(p, zz), L::set1(2.48015872888517045348E-5));
+        p = L::add(L::mul(p, zz), L::set1(-1.38888888888730564116E-3));
+        p = L::add(L::mul(p, zz), L::set1(4.16666666666665929218E-2));
+        return L::add(L::sub(L::set1(1.0), L::mul(zz, L::set1(0.5))), L::mul(L::mul(zz, zz), p));
+    }
+
+    /// @brief Evaluates `sin` in every lane with the Cephes polynomials, accurate to about 2 ulp.
+    /// Lanes beyond `LANES_TRIG_LIMIT`, infinite or NaN use `sin` from libm.
+    /// Requires lane traits to provide `round`, `select_lt` and `all_within`.
+    template<typename L>
+    static inline typename L::V lanes_sin(typename L::V x)
+    {
+        typedef typename L::V V;
+        if (!L::all_within(x, -LANES_TRIG_LIMIT, LANES_TRIG_LIMIT))
+        {
+            return lanes_map<L>(x, [](double v) { return ::sin(v); });
+        }
+
+        V k;
+        V z = lanes_reduce_pio2<L>(x, k);
+        V zz = L::mul(z, z);
+        V s = lanes_sin_poly<L>(z, zz), c = lanes_cos_poly<L>(zz);
+
+        // Quadrants -1 and 1 take the cosine, and quadrants -2, -1 and 2 are negated
+        V half = L::set1(0.5);
+        V res = L::select_lt(L::abs(L::sub(L::abs(k), L::set1(1.0))), half, c, s);
+        V neg = L::sub(L::set1(0.0), res);
+        res = L::select_lt(k, L::set1(-0.5), neg, L::select_lt(L::set1(1.5), k, neg, res));
+        return lanes_keep_tiny<L>(x, res);
+    }
+
+    /// @brief Evaluates `cos` in every lane with the Cephes polynomials, accurate to about 2 ulp.
+    /// Lanes beyond `LANES_TRIG_LIMIT`, infinite or NaN use `cos` from libm.
+    /// Requires lane traits to provide `round`, `select_lt` and `all_within`.
+    template<typename L>
+    static inline typename L::V lanes_cos(typename L::V x)
+    {
+        typedef typename L::V V;
+        if (!L::all_within(x, -LANES_TRIG_LIMIT, LANES_TRIG_LIMIT))
+        {
+            return lanes_map<L>(x, [](double v) { return ::cos(v); });
+        }
+
+        V k;
+        V z = lanes_reduce_pio2<L>(x, k);
+        V zz = L::mul(z, z);
+        V s = lanes_sin_poly<L>(z, zz), c = lanes_cos_poly<L>(zz);
+
+        // Quadrants -1 and 1 take the sine, and quadrants -2, 1 and 2 are negated
+        V half = L::set1(0.5);
+        V res = L::select_lt(L::abs(L::sub(L::abs(k), L::set1(1.0))), half, s, c);
+        V neg = L::sub(L::set1(0.0), res);
+        return L::select_lt(k, L::set1(-1.5), neg, L::select_lt(half, k, neg, res));
+    }
+
+    /// @brief Evaluates `tan` in every lane with the Cephes rational approximation, accurate to about
+    /// 3 ulp. Lanes beyond `LANES_TRIG_LIMIT`, infinite or NaN use `tan` from libm.
+    /// Requires lane traits to provide `round`, `select_lt` and `all_within`.
+    template<typename L>
+    static inline typename L::V lanes_tan(typename L::V x)
+    {
+        typedef typename L::V V;
+        if (!L::all_within(x, -LANES_TRIG_LIMIT, LANES_TRIG_LIMIT))
+        {
+            return lanes_map<L>(x, [](double v) { return ::tan(v); });
+        }
+
+        V k;
+        V z = lanes_reduce_pio2<L>(x, k);
+        V zz = L::mul(z, z);
+
+        // tan(z) = z + z^3 * P(z^2) / Q(z^2)
+        V p = L::set1(-1.30936939181383777646E4);
+        p = L::add(L::mul(p, zz), L::set1(1.15351664838587416140E6));
+        p = L::add(L::mul(p, zz), L::set1(-1.79565251976484877988E7));
+        V q = L::add(zz, L::set1(1.36812963470692954678E4));
+        q = L::add(L::mul(q, zz), L::set1(-1.32089234440210967447E6));
+        q = L::add(L::mul(q, zz), L::set1(2.50083801823357915839E7));
+        q = L::add(L::mul(q, zz), L::set1(-5.38695755929454629881E7));
+        V res = L::add(z, L::mul(L::mul(z, zz), L::div(p, q)));
+
+        // Odd quadrants are a quarter turn away, where tan(z + pi/2) = -1 / tan(z)
+        res = L::select_lt(L::abs(L::sub(L::abs(k), L::set1(1.0))), L::set1(0.5), L::div(L::set1(-1.0), res), res);
+        return lanes_keep_tiny<L>(x, res);
+    }
+
+    /// @brief Evaluates `atan` in every lane with the Cephes rational approximation, accurate to about
+    /// 1 ulp. Handles every input, including infinities and NaN, without falling back.
+    /// Requires lane traits to provide `select_lt`.
+    template<typename L>
+    static inline typename L::V lanes_atan(typename L::V x)
+    {
+        typedef typename L::V V;
+        V zero = L::set1(0.0);
+        V a = L::abs(x);
+
+        // Reduce to |t| <= 0.66 by atan(a) = pi/2 + atan(-1/a) above tan(3pi/8), or pi/4 + atan((a-1)/(a+1)) above 0.66
+        V big = L::set1(2.41421356237309504880), mid = L::set1(0.66);
+        V t = L::select_lt(big, a, L::div(L::set1(-1.0), a), L::select_lt(mid, a, L::div(L::sub(a, L::set1(1.0)), L::add(a, L::set1(1.0))), a));
+        V base = L::select_lt(big, a, L::set1(M_PI_2), L::select_lt(mid, a, L::set1(M_PI_4), zero));
+        V extra = L::select_lt(big, a, L::set1(6.123233995736765886130E-17), L::select_lt(mid, a, L::set1(3.061616997868382943065E-17), zero));
+
+        // atan(t) = t + t^3 * P(t^2) / Q(t^2)
+        V tt = L::mul(t, t);
+        V p = L::set1(-8.750608600031904122785E-1);
+        p = L::add(L::mul(p, tt), L::set1(-1.615753718733365076637E1));
+        p = L::add(L::mul(p, tt), L::set1(-7.500855792314704667340E1));
+        p = L::add(L::mul(p, tt), L::set1(-1.228866684490136173410E2));
+        p = L::add(L::mul(p, tt), L::set1(-6.485021904942025371773E1));
+        V q = L::add(tt, L::set1(2.485846490142306297962E1));
+        q = L::add(L::mul(q, tt), L::set1(1.650270098316988542046E2));
+        q = L::add(L::mul(q, tt), L::set1(4.328810604912902668951E2));
+        q = L::add(L::mul(q, tt), L::set1(4.853903996359136964868E2));
+        q = L::add(L::mul(q, tt), L::set1(1.945506571482613964425E2));
+        V res = L::add(base, L::add(L::add(L::mul(t, L::div(L::mul(tt, p), q)), t), extra));
+
+        res = L::select_lt(x, zero, L::sub(zero, res), res);
+        return lanes_keep_tiny<L>(x, res);
+    }
+
+    /// @brief Evaluates `asin` in every lane as `atan(x / sqrt(1 - x^2))`, accurate to about 3 ulp.
+    /// Lanes outside `[-1, 1]` or NaN use `asin` from libm. Requires lane traits to provide `select_lt` and `all_within`.
+    template<typename L>
+    static inline typename L::V lanes_asin(typename L::V x)
+    {
+        if (!L::all_within(x, -1.0, 1.0))
+        {
+            return lanes_map<L>(x, [](double v) { return ::asin(v); });
+        }
+
+        // 1 - x and 1 + x are exact where x is near -1 or 1, unlike 1 - x^2
+        typename L::V one = L::set1(1.0);
+        return lanes_atan<L>(L::div(x, L::sqrt(L::mul(L::sub(one, x), L::add(one, x)))));
+    }
+
+    /// @brief Evaluates `acos` in every lane as `2 atan(sqrt((1 - x) / (1 + x)))`, accurate to about 3 ulp.
+    /// Lanes outside `[-1, 1]` or NaN use `acos` from libm. Requires lane traits to provide `select_lt` and `all_within`.
+    template<typename L>
+    static inline typename L::V lanes_acos(typename L::V x)
+    {
+        if (!L::all_within(x, -1.0, 1.0))
+        {
+            return lanes_map<L>(x, [](double v) { return ::acos(v); });
+        }
+
+        typename L::V one = L::set1(1.0);
+        typename L::V half = lanes_atan<L>(L::sqrt(L::div(L::sub(one, x), L::add(one, x))));
+        return L::add(half, half);
+    }
+
+    /// @brief Evaluates `sinh` in every lane with the Cephes rational approximation below 1 and `L::exp`
+    /// above, accurate to about 3 ulp. Lanes beyond 708, where `exp` would overflow, or NaN use `sinh` from libm.
+    /// Requires lane traits to provide `exp`, `select_lt` and `all_within`.
+    template<typename L>
+    static inline typename L::V lanes_sinh(typename L::V x)
+    {
+        typedef typename L::V V;
+        if (!L::all_within(x, -708.0, 708.0))
+        {
+            return lanes_map<L>(x, [](double v) { return ::sinh(v); });
+        }
+
+        V zero = L::set1(0.0), half = L::set1(0.5), a = L::abs(x);
+        V e = L::exp(a);
+        V large = L::sub(L::mul(half, e), L::div(half, e));
+        large = L::select_lt(x, zero, L::sub(zero, large), large);
+
+        // sinh(x) = x + x^3 * P(x^2) / Q(x^2)
+        V xx = L::mul(x, x);
+        V p = L::set1(-7.89474443963537015605E-1);
+        p = L::add(L::mul(p, xx), L::set1(-1.63725857525983828727E2));
+        p = L::add(L::mul(p, xx), L::set1(-1.15614435765005216044E4));
+        p = L::add(L::mul(p, xx), L::set1(-3.51754964808151394800E5));
+        V q = L::add(xx, L::set1(-2.77711081420602794433E2));
+        q = L::add(L::mul(q, xx), L::set1(3.61578279834431989373E4));
+        q = L::add(L::mul(q, xx), L::set1(-2.11052978884890840399E6));
+        V small = L::add(x, L::mul(L::mul(x, xx), L::div(p, q)));
+
+        return lanes_keep_tiny<L>(x, L::select_lt(L::set1(1.0), a, large, small));
+    }
+
+    /// @brief Evaluates `cosh` in every lane from `L::exp`, accurate to about 2 ulp. Lanes beyond 708,
+    /// where `exp` would overflow, or NaN use `cosh` from libm. Requires lane traits to provide `exp` and `all_within`.
+    template<typename L>
+    static inline typename L::V lanes_cosh(typename L::V x)
+    {
+        if (!L::all_within(x, -708.0, 708.0))
+        {
+            return lanes_map<L>(x, [](double v) { return ::cosh(v); });
+        }
+
+        typename L::V half = L::set1(0.5), e = L::exp(L::abs(x));
+        return L::add(L::mul(half, e), L::div(half, e));
+    }
+
+    /// @brief Evaluates `tanh` in every lane with the Cephes rational approximation below 0.625 and
+    /// `L::exp` above, accurate to about 2 ulp. Lanes beyond 354, where `exp(2x)` would overflow, or NaN
+    /// use `tanh` from libm. Requires lane traits to provide `exp`, `select_lt` and `all_within`.
+    template<typename L>
+    static inline typename L::V lanes_tanh(typename L::V x)
+    {
+        typedef typename L::V V;
+        if (!L::all_within(x, -354.0, 354.0))
+        {
+            return lanes_map<L>(x, [](double v) { return ::tanh(v); });
+        }
+
+        V zero = L::set1(0.0), one = L::set1(1.0), a = L::abs(x);
+        V large = L::sub(one, L::div(L::set1(2.0), L::add(L::exp(L::add(a, a)), one)));
+        large = L::select_lt(x, zero, L::sub(zero, large), large);
+
+        // tanh(x) = x + x^3 * P(x^2) / Q(x^2)
+        V xx = L::mul(x, x);
+        V p = L::set1(-9.64399179425052238628E-1);
+        p = L::add(L::mul(p, xx), L::set1(-9.92877231001918586564E1));
+        p = L::add(L::mul(p, xx), L::set1(-1.61468768441708447952E3));
+        V q = L::add(xx, L::set1(1.12811678491632931402E2));
+        q = L::add(L::mul(q, xx), L::set1(2.23548839060100448583E3));
+        q = L::add(L::mul(q, xx), L::set1(4.84406305325125486048E3));
+        V small = L::add(x, L::mul(L::mul(x, xx), L::div(p, q)));
+
+        return lanes_keep_tiny<L>(x, L::select_lt(a, L::set1(0.625), small, large));
+    }
+
+    /// @brief Evaluates `hypot` in every lane as `m sqrt(1 + (n / m)^2)`, where `m` and `n` are the larger
+    /// and smaller magnitude, so nothing overflows early. Accurate to about 2 ulp. Lanes where either
+    /// argument is infinite or NaN use `hypot` from libm. Requires lane traits to provide `select_lt` and `all_within`.
+    template<typename L>
+    static inline typename L::V lanes_hypot(typename L::V a, typename L::V b)
+    {
+        typedef typename L::V V;
+        if (!L::all_within(a, -DBL_MAX, DBL_MAX) || !L::all_within(b, -DBL_MAX, DBL_MAX))
+        {
+            return lanes_map<L>(a, b, [](double u, double v) { return ::hypot(u, v); });
+        }
+
+        V u = L::abs(a), v = L::abs(b);
+        V m = L::max(u, v), n = L::min(u, v);
+        V t = L::div(n, m);
+        V res = L::mul(m, L::sqrt(L::add(L::set1(1.0), L::mul(t, t))));
+
+        // Both zero leaves 0 / 0 above
+        return L::select_lt(L::set1(0.0), m, res, m);
+    }
+
+    /// @brief Checks if a constant exponent can be evaluated by repeated squaring
+    static inline bool is_small_integer(double exponent)
+    {
+        return exponent == (double)(long)exponent && fabs(exponent) <= 64.0;
+    }
+
+    /// @brief Evaluates a bytecode program at up to `BATCH_BLOCK` points.
+    /// @param code The instructions to run, ending with `OpReturn`
+    /// @param x One column per variable slot. Each must be readable for `n` values starting at `offset`.
+    /// @param offset The index of the first point of this block within each column
+    /// @param r A frame of `BATCH_BLOCK` values per register
+    /// @param n The number of points to compute, rounded up to a multiple of `L::width`
+    /// @param out A column to write the first `out_n` results to
+    /// @param out_n The number of results to keep
+    /// @param args Scratch space for the arguments of the program's widest function call
+    template<typename L>
+    void run_batch_block(const Instruction* code, const double* const* x, size_t offset, double* r, size_t n, double* out, size_t out_n, double* args)
+    {
+        typedef typename L::V V;
+
+// Applies `expr` to each group of lanes, where `i` is the index of the group's first point
+#define LANES(expr) for (size_t i = 0; i < n; i += L::width) { L::store(d + i, (expr)); }
+
+        for (const Instruction* ip = code; ; ip++)
+        {
+            const Instruction& ins = *ip;
+            double* d = r + ins.dst * BATCH_BLOCK;
+            const double* a = r + ins.a * BATCH_BLOCK;
+            const double* b = r + ins.b * BATCH_BLOCK;
+            V imm = L::set1(ins.imm);
+
+            switch(ins.op)
+            {
+                case OpNum:    LANES(imm) break;
+                case OpVar:    memcpy(d, x[ins.a] + offset, n * sizeof(double)); break;
+                case OpAdd:    LANES(L::add(L::load(a + i), L::load(b + i))) break;
+                case OpSub:    LANES(L::sub(L::load(a + i), L::load(b + i))) break;
+                case OpMul:    LANES(L::mul(L::load(a + i), L::load(b + i))) break;
+                case OpDiv:    LANES(L::div(L::load(a + i), L::load(b + i))) break;
+                case OpPow:    LANES(lanes_pow<L>(L::load(a + i), L::load(b + i))) break;
+                case OpAddNum: LANES(L::add(L::load(a + i), imm)) break;
+                case OpSubNum: LANES(L::sub(L::load(a + i), imm)) break;
+                case OpMulNum: LANES(L::mul(L::load(a + i), imm)) break;
+                case OpDivNum: LANES(L::div(L::load(a + i), imm)) break;
+                case OpNumSub: LANES(L::sub(imm, L::load(a + i))) break;
+                case OpNumDiv: LANES(L::div(imm, L::load(a + i))) break;
+                case OpAddVar: LANES(L::add(L::load(a + i), L::load(x[ins.b] + offset + i))) break;
+                case OpSubVar: LANES(L::sub(L::load(a + i), L::load(x[ins.b] + offset + i))) break;
+                case OpMulVar: LANES(L::mul(L::load(a + i), L::load(x[ins.b] + offset + i))) break;
+                case OpDivVar: LANES(L::div(L::load(a + i), L::load(x[ins.b] + offset + i))) break;
+                case OpVarSub: LANES(L::sub(L::load(x[ins.b] + offset + i), L::load(a + i))) break;
+                case OpVarDiv: LANES(L::div(L::load(x[ins.b] + offset + i), L::load(a + i))) break;
+
+                case OpPowNum:
+                    if (is_small_integer(ins.imm))
+                    {
+                        LANES(lanes_powi<L>(L::load(a + i), (long)ins.imm))
+                    }
+                    else
+                    {
+                        LANES(lanes_pow<L>(L::load(a + i), imm))
+                    }
+                    break;
+
+                case OpPowI:   LANES(lanes_powi<L>(L::load(a + i), (int32_t)ins.b)) break;
+
+                case OpSin:    LANES(L::sin(L::load(a + i))) break;
+                case OpCos:    LANES(L::cos(L::load(a + i))) break;
+                case OpTan:    LANES(L::tan(L::load(a + i))) break;
+                case OpAsin:   LANES(L::asin(L::load(a + i))) break;
+                case OpAcos:   LANES(L::acos(L::load(a + i))) break;
+                case OpAtan:   LANES(L::atan(L::load(a + i))) break;
+                case OpSinh:   LANES(L::sinh(L::load(a + i))) break;
+                case OpCosh:   LANES(L::cosh(L::load(a + i))) break;
+                case OpTanh:   LANES(L::tanh(L::load(a + i))) break;
+                case OpLog10:  LANES(L::log10(L::load(a + i))) break;
+                case OpHypot:  LANES(L::hypot(L::load(a + i), L::load(b + i))) break;
+                case OpExp:    LANES(L::exp(L::load(a + i))) break;
+                case OpLog:    LANES(L::log(L::load(a + i))) break;
+                case OpSqrt:   LANES(L::sqrt(L::load(a + i))) break;
+                case OpAbs:    LANES(L::abs(L::load(a + i))) break;
+                case OpMin:    LANES(lanes_min<L>(L::load(a + i), L::load(b + i))) break;
+                case OpMax:    LANES(lanes_max<L>(L::load(a + i), L::load(b + i))) break;
+
+                case OpCall:
+                {
+                    // User functions only know how to take one point at a time
+                    double (*func)(double[]) = ins.function->func;
+                    for (size_t i = 0; i < n; i++)
+                    {
+                        for (size_t k = 0; k < ins.b; k++)
+                        {
+                            args[k] = a[k * BATCH_BLOCK + i];
+                        }
+                        d[i] = func(args);
+                    }
+                    break;
+                }
+
+                case OpReturn:
+                    memcpy(out, a, out_n * sizeof(double));
+                    return;
+            }
+        }
+
+#undef LANES
+    }
+
+    /// @brief Steps problems `[begin, end)` of a `RootColumns` as `propose_roots` describes.
+    /// `end - begin` must be a multiple of `L::width`. Requires lane traits to provide `select_lt`.
+    template<typename L>
+    void propose_root_lanes(const RootColumns& s, size_t begin, size_t end)
+    {
+        typedef typename L::V V;
+        V zero = L::set1(0.0), half = L::set1(0.5);
+
+        for (size_t i = begin; i < end; i += L::width)
+        {
+            V x = L::load(s.x + i), f = L::load(s.f + i), lo = L::load(s.lo + i), hi = L::load(s.hi + i);
+            V next = L::sub(x, L::div(L::mul(f, L::sub(x, L::load(s.previous + i))), L::sub(f, L::load(s.f_previous + i))));
+
+            // Compares with NaN are false, so a NaN step bisects
+            V mid = L::mul(half, L::add(lo, hi));
+            V limit = L::mul(half, L::abs(L::load(s.older_step + i)));
+            V safe = L::select_lt(limit, L::abs(L::sub(next, x)), mid, next);
+            V bisected = L::select_lt(lo, next, L::select_lt(next, hi, safe, mid), mid);
+            V clamped = L::min(L::max(next, lo), hi);
+
+            next = L::select_lt(zero, L::load(s.bracketed + i), bisected, clamped);
+            next = L::select_lt(zero, L::load(s.done + i), x, next);
+
+            L::store(s.older_step + i, L::load(s.last_step + i));
+            L::store(s.last_step + i, L::sub(next, x));
+            L::store(s.previous + i, x);
+            L::store(s.f_previous + i, f);
+            L::store(s.x + i, next);
+            L::store(s.point + i, next);
+        }
+    }
+
+    /// @brief Updates problems `[begin, end)` of a `RootColumns` as `update_roots` describes.
+    /// `end - begin` must be a multiple of `L::width`. Requires lane traits to provide `select_lt` and `select_le`.
+    template<typename L>
+    void update_root_lanes(const RootColumns& s, size_t begin, size_t end, double margin)
+    {
+        typedef typename L::V V;
+        V zero = L::set1(0.0), half = L::set1(0.5), one = L::set1(1.0), two = L::set1(2.0), tolerance = L::set1(margin);
+
+        for (size_t i = begin; i < end; i += L::width)
+        {
+            V value = L::load(s.value + i), x = L::load(s.x + i), previous = L::load(s.previous + i);
+            V f = L::load(s.f + i), lo = L::load(s.lo + i), hi = L::load(s.hi + i), f_lo = L::load(s.f_lo + i);
+            V bracketed = L::load(s.bracketed + i), done = L::load(s.done + i);
+
+            // Signs as 0 or 1, so that "the sign changed" is a difference of at least a half
+            V negative = L::select_lt(value, zero, one, zero);
+            V low_change = L::abs(L::sub(negative, L::select_lt(f_lo, zero, one, zero)));
+            V fresh = L::mul(L::sub(one, bracketed), L::abs(L::sub(negative, L::select_lt(L::load(s.f_previous + i), zero, one, zero))));
+
+            // A bracketed problem replaces the end whose sign it shares, and a fresh bracket spans the last step
+            V new_lo = L::select_lt(low_change, half, x, lo);
+            V new_hi = L::select_lt(low_change, half, hi, x);
+            V new_f_lo = L::select_lt(low_change, half, value, f_lo);
+            new_lo = L::select_lt(zero, bracketed, new_lo, L::select_lt(half, fresh, L::min(x, previous), lo));
+            new_hi = L::select_lt(zero, bracketed, new_hi, L::select_lt(half, fresh, L::max(x, previous), hi));
+            new_f_lo = L::select_lt(zero, bracketed, new_f_lo, L::select_lt(half, fresh, L::select_lt(x, previous, value, L::load(s.f_previous + i)), f_lo));
+            V new_bracketed = L::max(bracketed, fresh);
+
+            V residual = L::abs(value), step = L::abs(L::load(s.last_step + i));
+            V small_width = L::mul(new_bracketed, L::select_le(L::sub(new_hi, new_lo), tolerance, one, zero));
+            V small_step = L::max(L::select_le(step, tolerance, one, zero), small_width);
+            V converged = L::max(L::select_le(residual, zero, one, zero), L::select_le(residual, tolerance, small_step, zero));
+
+            // NaN steps and steps pinned to a bound with no sign change across it go nowhere
+            V stuck = L::select_lt(zero, step, zero, L::sub(one, new_bracketed));
+            V finished = L::select_lt(zero, converged, one, L::select_lt(zero, stuck, two, zero));
+
+            L::store(s.f + i, L::select_lt(zero, done, f, value));
+            L::store(s.lo + i, L::select_lt(zero, done, lo, new_lo));
+            L::store(s.hi + i, L::select_lt(zero, done, hi, new_hi));
+            L::store(s.f_lo + i, L::select_lt(zero, done, f_lo, new_f_lo));
+            L::store(s.bracketed + i, L::select_lt(zero, done, bracketed, new_bracketed));
+            L::store(s.done + i, L::select_lt(zero, done, done, finished));
+        }
+    }
+
+    /// @brief Runs `run_batch_block` with `ScalarLanes`
+    void run_batch_block_scalar(const Instruction* code, const double* const* x, size_t offset, double* r, size_t n, double* out, size_t out_n, double* args);
+
+    /// @brief Runs `run_batch_block` with AVX2 lanes. Only callable if the CPU supports AVX2.
+    void run_batch_block_avx2(const Instruction* code, const double* const* x, size_t offset, double* r, size_t n, double* out, size_t out_n, double* args);
+
+    /// @brief Runs `run_batch_block` with AVX-512 lanes. Only callable if the CPU supports AVX-512F.
+    void run_batch_block_avx512(const Instruction* code, const double* const* x, size_t offset, double* r, size_t n, double* out, size_t out_n, double* args);
+
+    /// @brief Runs `propose_root_lanes` and `update_root_lanes` over the whole registers of `[0, count)` with AVX2 lanes,
+    /// returning where they stopped. Only callable if the CPU supports AVX2.
+    size_t propose_roots_avx2(const RootColumns& s, size_t count);
+    size_t update_roots_avx2(const RootColumns& s, size_t count, double margin);
+
+    /// @brief Runs `propose_root_lanes` and `update_root_lanes` over the whole registers of `[0, count)` with AVX-512 lanes,
+    /// returning where they stopped. Only callable if the CPU supports AVX-512F.
+    size_t propose_roots_avx512(const RootColumns& s, size_t count);
+    size_t update_roots_avx512(const RootColumns& s, size_t count, double margin);
+}
+
+#endif
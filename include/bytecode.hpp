@@ -0,0 +1,256 @@
+#ifndef _BYTECODE_HPP
+#define _BYTECODE_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "context.hpp" // also includes "variable.hpp"
+
+namespace nexsys
+{
+    /// @brief A single operation in a compiled expression. Similar to `Token`, but
+    /// variables are referred to by their slot in a `VariableIndex` instead of a `Variable*`.
+    struct SlotToken
+    {
+        /// @brief The kind of operation. Only `Plus`, `Minus`, `Mul`, `Div`, `Exp`, `Num`, `Var` and `Func` are legal.
+        TokenType type;
+
+        /// @brief The slot of a `Var` token or the argument count of a `Func` token.
+        size_t operand;
+
+        union
+        {
+            /// @brief The value of a `Num` token
+            double value;
+
+            /// @brief The function called by a `Func` token
+            FunctionDataPtr function;
+        };
+    };
+
+    /// @brief The operations understood by the bytecode interpreter. `r` is the evaluation
+    /// frame, `x` holds the values of each variable slot and `imm` is an embedded constant.
+    enum OpCode : uint32_t
+    {
+        OpNum,      // r[dst] = imm
+        OpVar,      // r[dst] = x[a]
+        OpAdd,      // r[dst] = r[a] + r[b]
+        OpSub,      // r[dst] = r[a] - r[b]
+        OpMul,      // r[dst] = r[a] * r[b]
+        OpDiv,      // r[dst] = r[a] / r[b]
+        OpPow,      // r[dst] = r[a] ^ r[b]
+        OpAddNum,   // r[dst] = r[a] + imm
+        OpSubNum,   // r[dst] = r[a] - imm
+        OpMulNum,   // r[dst] = r[a] * imm
+        OpDivNum,   // r[dst] = r[a] / imm
+        OpPowNum,   // r[dst] = r[a] ^ imm
+        OpPowI,     // r[dst] = r[a] ^ (int32_t)b, by repeated squaring
+        OpNumSub,   // r[dst] = imm - r[a]
+        OpNumDiv,   // r[dst] = imm / r[a]
+        OpAddVar,   // r[dst] = r[a] + x[b]
+        OpSubVar,   // r[dst] = r[a] - x[b]
+        OpMulVar,   // r[dst] = r[a] * x[b]
+        OpDivVar,   // r[dst] = r[a] / x[b]
+        OpVarSub,   // r[dst] = x[b] - r[a]
+        OpVarDiv,   // r[dst] = x[b] / r[a]
+        OpSin,      // r[dst] = sin(r[a])
+        OpCos,      // r[dst] = cos(r[a])
+        OpTan,      // r[dst] = tan(r[a])
+        OpAsin,     // r[dst] = asin(r[a])
+        OpAcos,     // r[dst] = acos(r[a])
+        OpAtan,     // r[dst] = atan(r[a])
+        OpSinh,     // r[dst] = sinh(r[a])
+        OpCosh,     // r[dst] = cosh(r[a])
+        OpTanh,     // r[dst] = tanh(r[a])
+        OpExp,      // r[dst] = exp(r[a])
+        OpLog,      // r[dst] = log(r[a])
+        OpLog10,    // r[dst] = log10(r[a])
+        OpSqrt,     // r[dst] = sqrt(r[a])
+        OpAbs,      // r[dst] = |r[a]|
+        OpMin,      // r[dst] = r[a] < r[b] ? r[a] : r[b]
+        OpMax,      // r[dst] = r[a] > r[b] ? r[a] : r[b]
+        OpHypot,    // r[dst] = hypot(r[a], r[b])
+        OpCall,     // r[dst] = function(&r[a]), taking `b` arguments
+        OpReturn,   // return r[a]
+    };
+
+    /// @brief A single bytecode instruction
+    struct Instruction
+    {
+        OpCode op;
+        uint32_t dst;
+        uint32_t a;
+        uint32_t b;
+
+        union
+        {
+            double imm;
+            FunctionDataPtr function;
+        };
+    };
+
+    /// @brief The largest magnitude of constant exponent evaluated with `OpPowI`
+    constexpr double MAX_POWI_EXPONENT = 64.0;
+
+    /// @brief Checks if a constant exponent is evaluated with `OpPowI` rather than `OpPowNum`
+    /// @return a `bool` indicating if `exponent` is an integer no larger in magnitude than `MAX_POWI_EXPONENT`
+    bool is_powi_exponent(double exponent);
+
+    /// @brief Provides the instruction evaluating a built-in function inline. Unary functions read
+    /// `r[a]` and binary functions read `r[a]` and `r[b]`.
+    /// @param id The function. Must not be `IntrNone`.
+    /// @return The `OpCode` of the function
+    OpCode intrinsic_opcode(Intrinsic id);
+
+    /// @brief Raises a value to an integer power the way `OpPowI` does, i.e. by repeated squaring
+    /// from the lowest bit of the exponent so that every evaluator rounds identically.
+    template<typename T>
+    inline T powi(T base, int32_t exponent)
+    {
+        T result(1.0);
+        uint32_t n = exponent < 0 ? 0u - (uint32_t)exponent : (uint32_t)exponent;
+        bool first = true;
+
+        while (n != 0)
+        {
+            if (n & 1)
+            {
+                result = first ? base : result * base;
+                first = false;
+            }
+            n >>= 1;
+            if (n != 0)
+            {
+                base = base * base;
+            }
+        }
+
+        return exponent < 0 ? T(1.0) / result : result;
+    }
+
+    /// @brief The minimum as evaluated by `OpMin`. Like every other operation, a NaN in either argument gives NaN,
+    /// so a point where one side is undefined is never a root, as `IntervalPresolve` assumes.
+    inline double intrinsic_min(double a, double b)
+    {
+        return a < b || a != a ? a : b;
+    }
+
+    /// @brief The maximum as evaluated by `OpMax`. Like every other operation, a NaN in either argument gives NaN.
+    inline double intrinsic_max(double a, double b)
+    {
+        return a > b || a != a ? a : b;
+    }
+
+    /// @brief Calls a user function with `double` arguments. Overloaded by other scalar types
+    /// that `Bytecode::run` may be instantiated with, e.g. `Dual<N>`.
+    inline double call_function(FunctionDataPtr function, double* args)
+    {
+        return function->func(args);
+    }
+
+    /// @brief A register-based bytecode program. Registers are the positions an equivalent stack
+    /// machine would use, so the frame size is the maximum stack depth and is known at compile time.
+    class Bytecode
+    {
+    private:
+        std::vector<Instruction> code;
+        size_t frame_size;
+
+    public:
+        Bytecode();
+
+        /// @brief Lowers a reverse polish notation program to bytecode, fusing constant and
+        /// variable operands into the instructions that consume them.
+        /// @param program A valid reverse polish notation program
+        Bytecode(const std::vector<SlotToken>& program);
+
+        /// @brief Wraps instructions that have already been lowered, e.g. by `CompiledSystem`
+        /// @param code The instructions of the program. Throws `std::invalid_argument` if the last is not `OpReturn`.
+        /// @param frame_size The number of registers the instructions use
+        Bytecode(std::vector<Instruction> code, size_t frame_size);
+
+        /// @brief Runs the program
+        /// @param x The values of each variable slot
+        /// @param frame Scratch space of at least `get_frame_size()` values
+        /// @return The value produced by the program
+        double run(const double* x, double* frame) const;
+
+        /// @brief Runs the program over any scalar type supporting `+`, `-`, `*` and `/`, along
+        /// with overloads of `pow`, `call_function` and each built-in function found by
+        /// argument-dependent lookup.
+        /// @param x The values of each variable slot
+        /// @param frame Scratch space of at least `get_frame_size()` values
+        /// @return The value produced by the program
+        template<typename T>
+        T run(const T* x, T* frame) const;
+
+        /// @brief Provides the number of registers the program needs
+        /// @return The size of the evaluation frame
+        size_t get_frame_size() const;
+
+        /// @brief Provides read-only access to the instructions of the program
+        /// @return The program's `Instruction`s
+        const std::vector<Instruction>& get_code() const;
+    };
+
+    template<typename T>
+    T Bytecode::run(const T* x, T* r) const
+    {
+        using std::pow;
+        using std::sin;   using std::cos;   using std::tan;
+        using std::asin;  using std::acos;  using std::atan;
+        using std::sinh;  using std::cosh;  using std::tanh;
+        using std::exp;   using std::log;   using std::log10;
+        using std::sqrt;  using std::fabs;  using std::hypot;
+
+        for (const Instruction* ip = code.data(); ; ip++)
+        {
+            switch(ip->op)
+            {
+                case OpNum:    r[ip->dst] = T(ip->imm);                        break;
+                case OpVar:    r[ip->dst] = x[ip->a];                          break;
+                case OpAdd:    r[ip->dst] = r[ip->a] + r[ip->b];               break;
+                case OpSub:    r[ip->dst] = r[ip->a] - r[ip->b];               break;
+                case OpMul:    r[ip->dst] = r[ip->a] * r[ip->b];               break;
+                case OpDiv:    r[ip->dst] = r[ip->a] / r[ip->b];               break;
+                case OpPow:    r[ip->dst] = pow(r[ip->a], r[ip->b]);           break;
+                case OpAddNum: r[ip->dst] = r[ip->a] + ip->imm;                break;
+                case OpSubNum: r[ip->dst] = r[ip->a] - ip->imm;                break;
+                case OpMulNum: r[ip->dst] = r[ip->a] * ip->imm;                break;
+                case OpDivNum: r[ip->dst] = r[ip->a] / ip->imm;                break;
+                case OpPowNum: r[ip->dst] = pow(r[ip->a], ip->imm);            break;
+                case OpPowI:   r[ip->dst] = powi(r[ip->a], (int32_t)ip->b);    break;
+                case OpNumSub: r[ip->dst] = ip->imm - r[ip->a];                break;
+                case OpNumDiv: r[ip->dst] = ip->imm / r[ip->a];                break;
+                case OpAddVar: r[ip->dst] = r[ip->a] + x[ip->b];               break;
+                case OpSubVar: r[ip->dst] = r[ip->a] - x[ip->b];               break;
+                case OpMulVar: r[ip->dst] = r[ip->a] * x[ip->b];               break;
+                case OpDivVar: r[ip->dst] = r[ip->a] / x[ip->b];               break;
+                case OpVarSub: r[ip->dst] = x[ip->b] - r[ip->a];               break;
+                case OpVarDiv: r[ip->dst] = x[ip->b] / r[ip->a];               break;
+                case OpSin:    r[ip->dst] = sin(r[ip->a]);                     break;
+                case OpCos:    r[ip->dst] = cos(r[ip->a]);                     break;
+                case OpTan:    r[ip->dst] = tan(r[ip->a]);                     break;
+                case OpAsin:   r[ip->dst] = asin(r[ip->a]);                    break;
+                case OpAcos:   r[ip->dst] = acos(r[ip->a]);                    break;
+                case OpAtan:   r[ip->dst] = atan(r[ip->a]);                    break;
+                case OpSinh:   r[ip->dst] = sinh(r[ip->a]);                    break;
+                case OpCosh:   r[ip->dst] = cosh(r[ip->a]);                    break;
+                case OpTanh:   r[ip->dst] = tanh(r[ip->a]);                    break;
+                case OpExp:    r[ip->dst] = exp(r[ip->a]);                     break;
+                case OpLog:    r[ip->dst] = log(r[ip->a]);                     break;
+                case OpLog10:  r[ip->dst] = log10(r[ip->a]);                   break;
+                case OpSqrt:   r[ip->dst] = sqrt(r[ip->a]);                    break;
+                case OpAbs:    r[ip->dst] = fabs(r[ip->a]);                    break;
+                case OpMin:    r[ip->dst] = intrinsic_min(r[ip->a], r[ip->b]); break;
+                case OpMax:    r[ip->dst] = intrinsic_max(r[ip->a], r[ip->b]); break;
+                case OpHypot:  r[ip->dst] = hypot(r[ip->a], r[ip->b]);         break;
+                case OpCall:   r[ip->dst] = call_function(ip->function, r + ip->a); break;
+                case OpReturn: return r[ip->a];
+            }
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef _CACHE_HPP
+#define _CACHE_HPP
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "compiled.hpp" // also includes "bytecode.hpp", "shunting.hpp", "context.hpp", "variable.hpp"
+
+namespace nexsys
+{
+    /// @brief A bounded, thread-safe cache of compiled expressions. Entries are keyed by the
+    /// expression's normalized text and by what each symbol in it resolves to in the `ContextMap`,
+    /// so a changed constant or function misses instead of returning a stale program. Entries are
+    /// spread over independently locked shards so that concurrent lookups rarely contend.
+    class CompileCache
+    {
+    private:
+        /// @brief A compiled program whose variables are numbered in order of first appearance
+        struct _Entry
+        {
+            CompiledExpression expr;
+            std::vector<std::string> names;
+            std::list<std::string>::iterator recency;
+        };
+
+        struct _Shard
+        {
+            std::mutex lock;
+            std::unordered_map<std::string, _Entry> entries;
+            std::list<std::string> recency; // Most recently used first
+        };
+
+        std::vector<std::unique_ptr<_Shard>> shards;
+        size_t shard_capacity;
+        std::atomic<size_t> hits;
+        std::atomic<size_t> misses;
+        std::atomic<size_t> evictions;
+
+    public:
+        /// @brief Creates an empty cache
+        /// @param capacity The most compiled expressions to hold before evicting the least recently used
+        /// @param shard_count The number of independently locked shards to spread entries over
+        CompileCache(size_t capacity = 1024, size_t shard_count = 16);
+
+        CompileCache(const CompileCache&) = delete;
+        CompileCache& operator=(const CompileCache&) = delete;
+
+        /// @brief Compiles an expression, reusing a previous compilation of it if possible. Behaves exactly like `compile_to_expression`.
+        /// @param expr The expression to compile
+        /// @param ctx The `ContextMap` describing what any variables, functions, or constants in the expression are
+        /// @param index The `VariableIndex` to resolve variables with. Variables not yet in the index are added to it.
+        /// @return The compiled expression
+        CompiledExpression compile(const std::string& expr, const ContextMap& ctx, VariableIndex& index);
+
+        /// @brief Removes every entry. Counters are left untouched.
+        void clear();
+
+        /// @brief Provides the number of compiled expressions currently held
+        /// @return The number of entries across all shards
+        size_t size() const;
+
+        /// @brief Provides the number of calls to `compile` that reused an entry
+        size_t get_hits() const;
+
+        /// @brief Provides the number of calls to `compile` that had to compile the expression
+        size_t get_misses() const;
+
+        /// @brief Provides the number of entries removed to stay within capacity
+        size_t get_evictions() const;
+    };
+}
+
+#endif
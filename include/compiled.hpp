@@ -0,0 +1,215 @@
+#ifndef _COMPILED_HPP
+#define _COMPILED_HPP
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "batch.hpp" // also includes "bytecode.hpp"
+#include "jit.hpp"
+#include "shunting.hpp" // also includes "context.hpp", "variable.hpp"
+#include "simplifier.hpp"
+#include "thread_pool.hpp"
+
+namespace nexsys
+{
+    /// @brief Maps the names of a system's unknowns to dense integer slots. This should be built
+    /// once per system so that compiled expressions never need to hash a name while being evaluated.
+    class VariableIndex
+    {
+    private:
+        std::unordered_map<std::string, size_t> slots;
+        std::vector<std::string> names;
+
+    public:
+        VariableIndex() = default;
+
+        /// @brief Creates a `VariableIndex` whose slots follow the order of `names`
+        /// @param names The names of the variables to index
+        VariableIndex(std::vector<std::string> names);
+
+        /// @brief Adds a variable to the index if it is not already present
+        /// @param name The name of the variable
+        /// @return The slot assigned to the variable
+        size_t insert(std::string name);
+
+        /// @brief Looks up the slot assigned to a variable, if any
+        /// @param name The name of the variable
+        /// @param slot A read/write reference to hold the slot
+        /// @return A `bool` indicating if the variable is in the index
+        bool try_get_slot(const std::string& name, size_t& slot) const;
+
+        /// @brief Provides read-only access to the name of the variable in a given slot
+        /// @param slot The slot to look up
+        /// @return The name of the variable in the slot
+        const std::string& get_name(size_t slot) const;
+
+        /// @brief Provides the number of slots in the index
+        /// @return The number of indexed variables
+        size_t size() const;
+
+        /// @brief Packs a map of variable values into a dense vector ordered by slot
+        /// @param values The values of the indexed variables
+        /// @return A `std::vector<double>` where element `i` holds the value of slot `i`
+        std::vector<double> to_slots(const std::unordered_map<std::string, double>& values) const;
+
+        /// @brief Unpacks a dense vector ordered by slot into a map of variable values
+        /// @param x The values of each slot
+        /// @return A `std::unordered_map` from each variable's name to its value
+        std::unordered_map<std::string, double> from_slots(const double* x) const;
+    };
+
+    /// @brief The ways a `CompiledExpression` may be evaluated
+    enum Backend
+    {
+        /// @brief Evaluate with the bytecode interpreter. Always available.
+        Interpreter,
+
+        /// @brief Evaluate natively compiled x86-64 code. Only available if `JitCode::is_supported()`.
+        Jit,
+    };
+
+    /// @brief A math expression in reverse polish notation whose variables have been resolved
+    /// to slots at compile time. Evaluating one does not allocate or hash any strings.
+    class CompiledExpression
+    {
+    private:
+        std::vector<SlotToken> program;
+        Bytecode code;
+        std::shared_ptr<JitCode> jit;
+        size_t removed;
+
+    public:
+        CompiledExpression();
+
+        /// @brief Creates a `CompiledExpression` from a reverse polish notation program, simplifying it with `simplify_program`
+        /// @param program The program to evaluate. Throws `std::invalid_argument` if it does not produce exactly one value.
+        CompiledExpression(std::vector<SlotToken> program);
+
+        /// @brief Evaluates the expression
+        /// @param x The values of each slot in the `VariableIndex` used to compile this expression
+        /// @return The value of the expression
+        double evaluate(const double* x) const;
+
+        /// @brief Evaluates the expression in a caller-provided frame. Useful when evaluating from several threads.
+        /// @param x The values of each slot in the `VariableIndex` used to compile this expression
+        /// @param frame Scratch space of at least `get_depth()` values
+        /// @return The value of the expression
+        inline double evaluate(const double* x, double* frame) const
+        {
+            return jit ? jit->run(x, frame) : code.run(x, frame);
+        }
+
+        /// @brief Evaluates the expression over another scalar type, e.g. `Dual<N>`. Always uses the interpreter.
+        /// @param x The values of each slot in the `VariableIndex` used to compile this expression
+        /// @param frame Scratch space of at least `get_depth()` values
+        /// @return The value of the expression
+        template<typename T>
+        inline T evaluate(const T* x, T* frame) const
+        {
+            return code.run(x, frame);
+        }
+
+        /// @brief Evaluates the expression
+        /// @param x The values of each slot in the `VariableIndex` used to compile this expression
+        /// @return The value of the expression
+        inline double evaluate(const std::vector<double>& x) const
+        {
+            return evaluate(x.data());
+        }
+
+        /// @brief Evaluates the expression
+        /// @param x The values of each slot in the `VariableIndex` used to compile this expression
+        /// @return The value of the expression
+        inline double operator()(const double* x) const
+        {
+            return evaluate(x);
+        }
+
+        /// @brief Evaluates the expression at many points at once using the widest SIMD instruction set available
+        /// @param columns One column of `count` values for each slot in the `VariableIndex` used to compile this expression
+        /// @param count The number of points to evaluate
+        /// @param out A column of at least `count` values to write the results to
+        inline void evaluate_batch(const double* const* columns, size_t count, double* out) const
+        {
+            nexsys::evaluate_batch(code, columns, count, out);
+        }
+
+        /// @brief Picks how this expression is evaluated, natively compiling it if needed. Copies of 
+        /// this expression made afterwards share the same native code.
+        /// @param backend The `Backend` to evaluate with
+        /// @return A `bool` indicating success. On failure, the previous backend is kept.
+        bool try_set_backend(Backend backend);
+
+        /// @brief Provides read-only visibility to how this expression is evaluated
+        /// @return The `Backend` in use
+        Backend get_backend() const;
+
+        /// @brief Provides read-only access to the simplified reverse polish notation program
+        /// @return The `SlotToken`s of this expression
+        const std::vector<SlotToken>& get_program() const;
+
+        /// @brief Provides the number of instructions `simplify_program` removed from the program this expression was created from
+        /// @return The number of removed `SlotToken`s
+        size_t get_removed_count() const;
+
+        /// @brief Provides read-only access to the bytecode the expression is evaluated with
+        /// @return The lowered `Bytecode` of this expression
+        const Bytecode& get_bytecode() const;
+
+        /// @brief Finds every variable slot the expression reads
+        /// @return The slots read by the expression in ascending order, without duplicates
+        std::vector<size_t> get_slots() const;
+
+        /// @brief Provides the maximum number of values held on the stack during evaluation
+        /// @return The maximum stack depth, i.e. the size of the evaluation frame
+        size_t get_depth() const;
+    };
+
+    /// @brief Compiles an expression in infix notation to a function of dense variable slots
+    /// @param expr The expression to compile
+    /// @param ctx The `ContextMap` describing what any variables, functions, or constants in the expression are
+    /// @param index The `VariableIndex` to resolve variables with. Variables not yet in the index are added to it.
+    /// @return The compiled expression
+    CompiledExpression compile_to_expression(const std::string& expr, const ContextMap& ctx, VariableIndex& index);
+
+    /// @brief Compiles an expression in infix notation to a function of dense variable slots. Prefer this
+    /// overload when compiling many expressions against a large context, since it never copies or scans the context.
+    /// @param expr The expression to compile
+    /// @param ctx The `ContextView` describing what any variables, functions, or constants in the expression are
+    /// @param index The `VariableIndex` to resolve variables with. Variables not yet in the index are added to it.
+    /// @return The compiled expression
+    CompiledExpression compile_to_expression(const std::string& expr, const ContextView& ctx, VariableIndex& index);
+
+    /// @brief The outcome of compiling one expression with `compile_all`
+    struct CompileResult
+    {
+        /// @brief The compiled expression, if compilation succeeded
+        CompiledExpression expr;
+
+        /// @brief Empty on success, else the message `compile_to_expression` would have thrown
+        std::string error;
+
+        /// @brief Checks if compilation succeeded
+        inline bool ok() const
+        {
+            return error.empty();
+        }
+    };
+
+    /// @brief Compiles many expressions at once across a thread pool. Each worker parses into its own
+    /// reusable buffers, so the batch allocates little beyond the compiled programs themselves.
+    /// Variables are added to `index` exactly as compiling the expressions one after another would add them.
+    /// @param exprs The expressions to compile
+    /// @param ctx The `ContextView` describing what any variables, functions, or constants in the expressions are
+    /// @param index The `VariableIndex` to resolve variables with. Variables not yet in the index are added to it.
+    /// @param pool The `ThreadPool` to compile on
+    /// @return One `CompileResult` per expression, in the order given. A failed expression does not affect the others.
+    std::vector<CompileResult> compile_all(const std::vector<std::string>& exprs, const ContextView& ctx, VariableIndex& index, ThreadPool& pool = ThreadPool::shared());
+
+    /// @brief Compiles many expressions at once across a thread pool. Takes a snapshot of `ctx` and behaves like the `ContextView` overload.
+    std::vector<CompileResult> compile_all(const std::vector<std::string>& exprs, const ContextMap& ctx, VariableIndex& index, ThreadPool& pool = ThreadPool::shared());
+}
+
+#endif
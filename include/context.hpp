@@ -1,7 +1,10 @@
 #ifndef _CONTEXT_HPP
 #define _CONTEXT_HPP
 
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -32,8 +35,50 @@ namespace nexsys
         double _phantom_double;    
     };
 
-    /// @brief Type alias for a `std::pair` containing a `std::function` and the number of arguments it takes. 
-    typedef std::pair<size_t, double (*)(double[])>* FunctionDataPtr;
+    /// @brief The built-in math functions that evaluators may run inline instead of through a
+    /// function pointer. `IntrNone` marks a user function.
+    enum Intrinsic
+    {
+        IntrNone,
+        IntrSin,
+        IntrCos,
+        IntrTan,
+        IntrAsin,
+        IntrAcos,
+        IntrAtan,
+        IntrSinh,
+        IntrCosh,
+        IntrTanh,
+        IntrExp,
+        IntrLog,
+        IntrLog10,
+        IntrSqrt,
+        IntrAbs,
+        IntrMin,
+        IntrMax,
+        IntrHypot,
+    };
+
+    /// @brief A user function, the number of arguments it takes and, optionally, its partial derivatives.
+    struct FunctionData
+    {
+        /// @brief The number of arguments the function takes
+        size_t argc;
+
+        /// @brief The function itself
+        double (*func)(double[]);
+
+        /// @brief Either empty or `argc` functions, where element `k` takes the same arguments 
+        /// as `func` and returns its partial derivative with respect to argument `k`.
+        std::vector<double (*)(double[])> derivatives;
+
+        /// @brief The built-in function this is, or `IntrNone` for a user function. `func` and
+        /// `derivatives` are always usable, so code unaware of intrinsics may treat them as user functions.
+        Intrinsic intrinsic;
+    };
+
+    /// @brief Type alias for a pointer to the `FunctionData` of a function token. 
+    typedef const FunctionData* FunctionDataPtr;
 
     /// @brief A tagged union (i.e. Rust-style enum) that represents a single 
     /// token in a math expression, possibly also containing a constant, variable, 
@@ -85,6 +130,16 @@ namespace nexsys
         /// @return a new `Token` 
         static Token func(size_t argc, double (*value)(double[]));
 
+        /// @brief Creates a new token for a function whose partial derivatives are known
+        /// @param derivatives Either empty or one function per argument returning the partial derivative with respect to that argument
+        /// @return a new `Token` 
+        static Token func(size_t argc, double (*value)(double[]), std::vector<double (*)(double[])> derivatives);
+
+        /// @brief Creates a new token for a built-in function
+        /// @param id The function. Must not be `IntrNone`.
+        /// @return a new `Token` 
+        static Token intrinsic(Intrinsic id);
+
         /// @brief Provides read-only visibility to this `Token`'s type.
         /// @return this `Token`'s `TokenType`
         TokenType get_type() const;
@@ -103,6 +158,11 @@ namespace nexsys
         /// @param value A read/write reference to hold the wrapped function pointer value
         /// @return A `bool` indicating success or failure.
         bool try_unwrap_func(size_t& argc, double (*&value)(double[])) const;
+
+        /// @brief Unwraps all known data about a function `Token`, if possible.
+        /// @param value A read/write reference to hold the wrapped `FunctionDataPtr`
+        /// @return A `bool` indicating success or failure.
+        bool try_unwrap_func_data(FunctionDataPtr& value) const;
     };
 
     /// @brief Similar to `std::unordered_map`, but with additional methods for specifying 
@@ -125,9 +185,69 @@ namespace nexsys
 
         void add_func_to_ctx(std::string symbol, size_t argc, double (*value)(double[]));
 
+        /// @brief Adds a function whose partial derivatives are known, allowing expressions using it to be differentiated symbolically
+        /// @param derivatives One function per argument, taking the same arguments as `value` and returning its partial derivative with respect to that argument
+        void add_func_to_ctx(std::string symbol, size_t argc, double (*value)(double[]), std::vector<double (*)(double[])> derivatives);
+
         ~ContextMap();
     };
 
+    /// @brief An immutable snapshot of a `ContextMap` whose symbols are interned to dense integer
+    /// IDs. Build one once per context and share it between compilations: it is taken by reference,
+    /// looks symbols up without allocating, and is cheap to copy and safe to read from many threads.
+    class ContextView
+    {
+    private:
+        struct _Data
+        {
+            std::vector<std::string> names;
+            std::vector<Token> tokens;
+            std::unordered_map<std::string_view, uint32_t> ids; // Keys refer into `names`
+        };
+
+        std::shared_ptr<const _Data> data;
+
+    public:
+        /// @brief Creates a view of an empty context
+        ContextView();
+
+        /// @brief Creates a snapshot of a context. Later changes to `ctx` are not reflected in the view.
+        /// @param ctx The context to snapshot
+        ContextView(const ContextMap& ctx);
+
+        /// @brief Looks up the ID of a symbol, if any
+        /// @param symbol The symbol to look up
+        /// @param id A read/write reference to hold the symbol's ID
+        /// @return A `bool` indicating if the symbol is in the context
+        bool try_get_id(std::string_view symbol, uint32_t& id) const;
+
+        /// @brief Provides read-only access to the `Token` of a symbol
+        /// @param id The ID of the symbol
+        /// @return The symbol's `Token`
+        const Token& get_token(uint32_t id) const;
+
+        /// @brief Provides read-only access to the name of a symbol
+        /// @param id The ID of the symbol
+        /// @return The symbol's name
+        const std::string& get_name(uint32_t id) const;
+
+        /// @brief Provides the number of symbols in the view
+        /// @return The number of interned symbols
+        size_t size() const;
+    };
+
+    /// @brief Provides the `FunctionData` of a built-in function
+    /// @param id The function. Must not be `IntrNone`.
+    /// @return A `FunctionDataPtr` that is valid for the lifetime of the program
+    FunctionDataPtr intrinsic_function(Intrinsic id);
+
+    /// @brief Looks up a built-in function by name, e.g. `sin`, `log` or `hypot`. Expressions may use
+    /// these without adding them to their context; a symbol in the context takes precedence.
+    /// @param symbol The name to look up
+    /// @param token A read/write reference to hold a pointer to the function's `Token`
+    /// @return A `bool` indicating if `symbol` names a built-in function
+    bool try_get_intrinsic(std::string_view symbol, const Token*& token);
+
     /// @brief Converts a string to a `Token`, if possible
     /// @param token_like the string to try and convert to a `Token`
     /// @param token a `Token` reference whose value should be set to the parsed token's value
@@ -140,7 +260,7 @@ namespace nexsys
     /// @param token a token, passed by reference, whose value should reflect the token contained in `token_like`
     /// @param ctx a `ContextMap` containing any constants, variables, or functions that should be parsable
     /// @return a `bool` indicating if the token could be converted
-    Token tokenize_with_context(std::string token_like, ContextMap ctx);
+    Token tokenize_with_context(const std::string& token_like, const ContextMap& ctx);
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,55 @@
+#ifndef _DECOMPOSE_HPP
+#define _DECOMPOSE_HPP
+
+#include <vector>
+
+#include "compiled.hpp" // also includes "bytecode.hpp", "shunting.hpp", "context.hpp", "variable.hpp"
+
+namespace nexsys
+{
+    /// @brief One diagonal block of a `BlockDecomposition`: a set of equations that must be solved
+    /// together for the same number of unknowns
+    struct Block
+    {
+        /// @brief The indices of the block's expressions in the system, ascending
+        std::vector<size_t> equations;
+
+        /// @brief The slots of the block's unknowns, ascending
+        std::vector<size_t> unknowns;
+    };
+
+    /// @brief Splits a system into the blocks of its block lower-triangular form, so that it can be
+    /// solved one small block after another. Each equation is first matched to an unknown it reads
+    /// (so the matched unknowns form a structurally nonsingular diagonal), then the strongly connected
+    /// components of the graph of which equations need which others' unknowns are found with Tarjan's
+    /// algorithm. Blocks are ordered so that each only reads unknowns of itself and the blocks before it.
+    class BlockDecomposition
+    {
+    private:
+        std::vector<Block> blocks;
+        size_t largest;
+
+    public:
+        BlockDecomposition();
+
+        /// @brief Decomposes a system. Throws `std::runtime_error` if it is structurally singular,
+        /// i.e. if no way of pairing each equation with a different unknown it reads exists.
+        /// @param system The expressions in the system, all compiled against the same `VariableIndex`.
+        /// Its first `system.size()` slots are the unknowns, and any later slots are parameters.
+        BlockDecomposition(const std::vector<CompiledExpression>& system);
+
+        /// @brief Provides read-only access to the blocks
+        /// @return The blocks in the order they must be solved
+        const std::vector<Block>& get_blocks() const;
+
+        /// @brief Provides the number of blocks
+        /// @return The number of separate systems the decomposed system is solved as
+        size_t get_block_count() const;
+
+        /// @brief Provides the size of the largest block
+        /// @return The number of unknowns in the largest block
+        size_t get_largest_block_size() const;
+    };
+}
+
+#endif
@@ -0,0 +1,424 @@
+#ifndef _DUAL_HPP
+#define _DUAL_HPP
+// NOTE: This header has no .cpp file counterpart to allow for ease of use with generics
+
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+#include "context.hpp" // also includes "variable.hpp"
+
+namespace nexsys
+{
+    /// @brief A dual number holding a value and its derivative along `N` directions at once.
+    /// Evaluating an expression over `Dual<N>` values seeded with unit tangents yields the
+    /// expression's value along with `N` of its partial derivatives, exact to machine precision.
+    template<size_t N>
+    struct Dual
+    {
+        /// @brief The value of the number
+        double value;
+
+        /// @brief The derivative of `value` along each seeded direction
+        double tangent[N];
+
+        /// @brief Creates a new constant, i.e. a number whose tangents are all zero
+        Dual(double value = 0.0);
+
+        /// @brief Creates a new independent variable, seeded with a unit tangent in one direction
+        /// @param direction The direction to seed, or a value of at least `N` to seed none
+        static Dual<N> variable(double value, size_t direction);
+
+        /// @brief Checks if every tangent is zero
+        bool is_constant() const;
+    };
+
+    // Arithmetic
+    template<size_t N> Dual<N> operator+(const Dual<N>& lhs, const Dual<N>& rhs);
+    template<size_t N> Dual<N> operator-(const Dual<N>& lhs, const Dual<N>& rhs);
+    template<size_t N> Dual<N> operator*(const Dual<N>& lhs, const Dual<N>& rhs);
+    template<size_t N> Dual<N> operator/(const Dual<N>& lhs, const Dual<N>& rhs);
+    template<size_t N> Dual<N> operator+(const Dual<N>& lhs, double rhs);
+    template<size_t N> Dual<N> operator-(const Dual<N>& lhs, double rhs);
+    template<size_t N> Dual<N> operator*(const Dual<N>& lhs, double rhs);
+    template<size_t N> Dual<N> operator/(const Dual<N>& lhs, double rhs);
+    template<size_t N> Dual<N> operator-(double lhs, const Dual<N>& rhs);
+    template<size_t N> Dual<N> operator/(double lhs, const Dual<N>& rhs);
+
+    /// @brief Raises a dual number to a constant power
+    template<size_t N> Dual<N> pow(const Dual<N>& base, double exponent);
+
+    /// @brief Raises a dual number to a dual power
+    template<size_t N> Dual<N> pow(const Dual<N>& base, const Dual<N>& exponent);
+
+    // Built-in functions, as evaluated by `Bytecode::run`
+    template<size_t N> Dual<N> sin(const Dual<N>& arg);
+    template<size_t N> Dual<N> cos(const Dual<N>& arg);
+    template<size_t N> Dual<N> tan(const Dual<N>& arg);
+    template<size_t N> Dual<N> asin(const Dual<N>& arg);
+    template<size_t N> Dual<N> acos(const Dual<N>& arg);
+    template<size_t N> Dual<N> atan(const Dual<N>& arg);
+    template<size_t N> Dual<N> sinh(const Dual<N>& arg);
+    template<size_t N> Dual<N> cosh(const Dual<N>& arg);
+    template<size_t N> Dual<N> tanh(const Dual<N>& arg);
+    template<size_t N> Dual<N> exp(const Dual<N>& arg);
+    template<size_t N> Dual<N> log(const Dual<N>& arg);
+    template<size_t N> Dual<N> log10(const Dual<N>& arg);
+    template<size_t N> Dual<N> sqrt(const Dual<N>& arg);
+    template<size_t N> Dual<N> fabs(const Dual<N>& arg);
+    template<size_t N> Dual<N> hypot(const Dual<N>& lhs, const Dual<N>& rhs);
+
+    /// @brief Picks the operand `OpMin` would, along with its tangents
+    template<size_t N> Dual<N> intrinsic_min(const Dual<N>& lhs, const Dual<N>& rhs);
+
+    /// @brief Picks the operand `OpMax` would, along with its tangents
+    template<size_t N> Dual<N> intrinsic_max(const Dual<N>& lhs, const Dual<N>& rhs);
+
+    /// @brief Calls a user function with dual arguments. The function's partial derivatives are
+    /// used if it was registered with them, otherwise they are estimated with central differences.
+    /// @param function The function to call
+    /// @param args The `function->argc` arguments to pass
+    /// @return The function's value and derivatives
+    template<size_t N> Dual<N> call_function(FunctionDataPtr function, const Dual<N>* args);
+
+    template<size_t N>
+    Dual<N>::Dual(double value): value(value)
+    {
+        for (size_t k = 0; k < N; k++)
+        {
+            tangent[k] = 0.0;
+        }
+    }
+
+    template<size_t N>
+    Dual<N> Dual<N>::variable(double value, size_t direction)
+    {
+        Dual<N> var(value);
+        if (direction < N)
+        {
+            var.tangent[direction] = 1.0;
+        }
+        return var;
+    }
+
+    template<size_t N>
+    bool Dual<N>::is_constant() const
+    {
+        for (size_t k = 0; k < N; k++)
+        {
+            if (tangent[k] != 0.0)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    template<size_t N>
+    Dual<N> operator+(const Dual<N>& lhs, const Dual<N>& rhs)
+    {
+        Dual<N> res(lhs.value + rhs.value);
+        for (size_t k = 0; k < N; k++)
+        {
+            res.tangent[k] = lhs.tangent[k] + rhs.tangent[k];
+        }
+        return res;
+    }
+
+    template<size_t N>
+    Dual<N> operator-(const Dual<N>& lhs, const Dual<N>& rhs)
+    {
+        Dual<N> res(lhs.value - rhs.value);
+        for (size_t k = 0; k < N; k++)
+        {
+            res.tangent[k] = lhs.tangent[k] - rhs.tangent[k];
+        }
+        return res;
+    }
+
+    template<size_t N>
+    Dual<N> operator*(const Dual<N>& lhs, const Dual<N>& rhs)
+    {
+        Dual<N> res(lhs.value * rhs.value);
+        for (size_t k = 0; k < N; k++)
+        {
+            res.tangent[k] = lhs.tangent[k] * rhs.value + lhs.value * rhs.tangent[k];
+        }
+        return res;
+    }
+
+    template<size_t N>
+    Dual<N> operator/(const Dual<N>& lhs, const Dual<N>& rhs)
+    {
+        Dual<N> res(lhs.value / rhs.value);
+        for (size_t k = 0; k < N; k++)
+        {
+            res.tangent[k] = (lhs.tangent[k] - res.value * rhs.tangent[k]) / rhs.value;
+        }
+        return res;
+    }
+
+    template<size_t N>
+    Dual<N> operator+(const Dual<N>& lhs, double rhs)
+    {
+        Dual<N> res = lhs;
+        res.value += rhs;
+        return res;
+    }
+
+    template<size_t N>
+    Dual<N> operator-(const Dual<N>& lhs, double rhs)
+    {
+        Dual<N> res = lhs;
+        res.value -= rhs;
+        return res;
+    }
+
+    template<size_t N>
+    Dual<N> operator*(const Dual<N>& lhs, double rhs)
+    {
+        Dual<N> res(lhs.value * rhs);
+        for (size_t k = 0; k < N; k++)
+        {
+            res.tangent[k] = lhs.tangent[k] * rhs;
+        }
+        return res;
+    }
+
+    template<size_t N>
+    Dual<N> operator/(const Dual<N>& lhs, double rhs)
+    {
+        Dual<N> res(lhs.value / rhs);
+        for (size_t k = 0; k < N; k++)
+        {
+            res.tangent[k] = lhs.tangent[k] / rhs;
+        }
+        return res;
+    }
+
+    template<size_t N>
+    Dual<N> operator-(double lhs, const Dual<N>& rhs)
+    {
+        return rhs * -1.0 + lhs;
+    }
+
+    /// @brief Helper function to scale a tangent by a partial derivative. Directions the argument does
+    /// not depend on stay zero even where the partial is infinite or NaN, e.g. `sqrt` at zero.
+    inline double _scale(double partial, double tangent)
+    {
+        return tangent == 0.0 ? 0.0 : partial * tangent;
+    }
+
+    template<size_t N>
+    Dual<N> operator/(double lhs, const Dual<N>& rhs)
+    {
+        Dual<N> res(lhs / rhs.value);
+        double scale = -res.value / rhs.value;
+        for (size_t k = 0; k < N; k++)
+        {
+            res.tangent[k] = _scale(scale, rhs.tangent[k]);
+        }
+        return res;
+    }
+
+    template<size_t N>
+    Dual<N> pow(const Dual<N>& base, double exponent)
+    {
+        Dual<N> res(std::pow(base.value, exponent));
+        double scale = exponent * std::pow(base.value, exponent - 1.0);
+        for (size_t k = 0; k < N; k++)
+        {
+            res.tangent[k] = _scale(scale, base.tangent[k]);
+        }
+        return res;
+    }
+
+    template<size_t N>
+    Dual<N> pow(const Dual<N>& base, const Dual<N>& exponent)
+    {
+        // Avoids taking the log of a negative base when the exponent is constant
+        if (exponent.is_constant())
+        {
+            return pow(base, exponent.value);
+        }
+
+        // d(u^v) = u^v * (dv * ln(u) + v * du / u)
+        Dual<N> res(std::pow(base.value, exponent.value));
+        double ln_base = std::log(base.value);
+        for (size_t k = 0; k < N; k++)
+        {
+            res.tangent[k] = res.value * (_scale(ln_base, exponent.tangent[k]) + _scale(exponent.value / base.value, base.tangent[k]));
+        }
+        return res;
+    }
+
+    /// @brief Helper function to apply a scalar function to a dual number
+    /// @param value The function's value at `arg.value`
+    /// @param slope The function's derivative at `arg.value`
+    template<size_t N>
+    Dual<N> _chain(const Dual<N>& arg, double value, double slope)
+    {
+        Dual<N> res(value);
+        for (size_t k = 0; k < N; k++)
+        {
+            res.tangent[k] = _scale(slope, arg.tangent[k]);
+        }
+        return res;
+    }
+
+    template<size_t N>
+    Dual<N> sin(const Dual<N>& arg)
+    {
+        return _chain(arg, std::sin(arg.value), std::cos(arg.value));
+    }
+
+    template<size_t N>
+    Dual<N> cos(const Dual<N>& arg)
+    {
+        return _chain(arg, std::cos(arg.value), -std::sin(arg.value));
+    }
+
+    template<size_t N>
+    Dual<N> tan(const Dual<N>& arg)
+    {
+        double value = std::tan(arg.value);
+        return _chain(arg, value, 1.0 + value * value);
+    }
+
+    template<size_t N>
+    Dual<N> asin(const Dual<N>& arg)
+    {
+        return _chain(arg, std::asin(arg.value), 1.0 / std::sqrt(1.0 - arg.value * arg.value));
+    }
+
+    template<size_t N>
+    Dual<N> acos(const Dual<N>& arg)
+    {
+        return _chain(arg, std::acos(arg.value), -1.0 / std::sqrt(1.0 - arg.value * arg.value));
+    }
+
+    template<size_t N>
+    Dual<N> atan(const Dual<N>& arg)
+    {
+        return _chain(arg, std::atan(arg.value), 1.0 / (1.0 + arg.value * arg.value));
+    }
+
+    template<size_t N>
+    Dual<N> sinh(const Dual<N>& arg)
+    {
+        return _chain(arg, std::sinh(arg.value), std::cosh(arg.value));
+    }
+
+    template<size_t N>
+    Dual<N> cosh(const Dual<N>& arg)
+    {
+        return _chain(arg, std::cosh(arg.value), std::sinh(arg.value));
+    }
+
+    template<size_t N>
+    Dual<N> tanh(const Dual<N>& arg)
+    {
+        double value = std::tanh(arg.value);
+        return _chain(arg, value, 1.0 - value * value);
+    }
+
+    template<size_t N>
+    Dual<N> exp(const Dual<N>& arg)
+    {
+        double value = std::exp(arg.value);
+        return _chain(arg, value, value);
+    }
+
+    template<size_t N>
+    Dual<N> log(const Dual<N>& arg)
+    {
+        return _chain(arg, std::log(arg.value), 1.0 / arg.value);
+    }
+
+    template<size_t N>
+    Dual<N> log10(const Dual<N>& arg)
+    {
+        return _chain(arg, std::log10(arg.value), 1.0 / (arg.value * M_LN10));
+    }
+
+    template<size_t N>
+    Dual<N> sqrt(const Dual<N>& arg)
+    {
+        double value = std::sqrt(arg.value);
+        return _chain(arg, value, 0.5 / value);
+    }
+
+    template<size_t N>
+    Dual<N> fabs(const Dual<N>& arg)
+    {
+        return _chain(arg, std::fabs(arg.value), arg.value > 0.0 ? 1.0 : (arg.value < 0.0 ? -1.0 : 0.0));
+    }
+
+    template<size_t N>
+    Dual<N> hypot(const Dual<N>& lhs, const Dual<N>& rhs)
+    {
+        Dual<N> res(std::hypot(lhs.value, rhs.value));
+        for (size_t k = 0; k < N; k++)
+        {
+            res.tangent[k] = _scale(lhs.value / res.value, lhs.tangent[k]) + _scale(rhs.value / res.value, rhs.tangent[k]);
+        }
+        return res;
+    }
+
+    template<size_t N>
+    Dual<N> intrinsic_min(const Dual<N>& lhs, const Dual<N>& rhs)
+    {
+        return lhs.value < rhs.value || lhs.value != lhs.value ? lhs : rhs;
+    }
+
+    template<size_t N>
+    Dual<N> intrinsic_max(const Dual<N>& lhs, const Dual<N>& rhs)
+    {
+        return lhs.value > rhs.value || lhs.value != lhs.value ? lhs : rhs;
+    }
+
+    template<size_t N>
+    Dual<N> call_function(FunctionDataPtr function, const Dual<N>* args)
+    {
+        thread_local std::vector<double> vals;
+        vals.resize(function->argc);
+        for (size_t k = 0; k < function->argc; k++)
+        {
+            vals[k] = args[k].value;
+        }
+
+        Dual<N> res(function->func(vals.data()));
+        for (size_t k = 0; k < function->argc; k++)
+        {
+            if (args[k].is_constant())
+            {
+                continue;
+            }
+
+            double partial;
+            if (function->derivatives.size() != 0)
+            {
+                partial = function->derivatives[k](vals.data());
+            }
+            else
+            {
+                double stored = vals[k];
+                double h = std::cbrt(DBL_EPSILON) * std::fmax(1.0, std::fabs(stored));
+                vals[k] = stored + h;
+                double above = function->func(vals.data());
+                vals[k] = stored - h;
+                double below = function->func(vals.data());
+                vals[k] = stored;
+                partial = (above - below) / (2.0 * h);
+            }
+
+            for (size_t j = 0; j < N; j++)
+            {
+                res.tangent[j] += _scale(partial, args[k].tangent[j]);
+            }
+        }
+        return res;
+    }
+}
+
+#endif
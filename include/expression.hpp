@@ -0,0 +1,89 @@
+#ifndef _EXPRESSION_HPP
+#define _EXPRESSION_HPP
+
+#include <memory>
+#include <vector>
+
+#include "compiled.hpp" // also includes "bytecode.hpp", "shunting.hpp", "context.hpp", "variable.hpp"
+
+namespace nexsys
+{
+    struct ExprNode;
+
+    /// @brief Type alias for a shared pointer to an immutable node in an expression tree. Nodes
+    /// are never modified after being built, so subtrees may be shared between trees.
+    typedef std::shared_ptr<const ExprNode> ExprPtr;
+
+    /// @brief A node in an expression tree. Trees are built from `SlotToken` programs, so
+    /// variables are referred to by their slot.
+    struct ExprNode
+    {
+        /// @brief One of `Num`, `Var`, `Plus`, `Minus`, `Mul`, `Div`, `Exp` or `Func`
+        TokenType type;
+
+        /// @brief The value of a `Num` node
+        double value;
+
+        /// @brief The slot of a `Var` node
+        size_t slot;
+
+        /// @brief The function called by a `Func` node
+        FunctionDataPtr function;
+
+        /// @brief The operands of an operator or the arguments of a function
+        std::vector<ExprPtr> args;
+    };
+
+    /// @brief Creates a new constant node
+    /// @return a new `ExprPtr`
+    ExprPtr make_num(double value);
+
+    /// @brief Creates a new variable node
+    /// @return a new `ExprPtr`
+    ExprPtr make_var(size_t slot);
+
+    /// @brief Creates a new operator node, simplifying it if the operands allow. Constant
+    /// operands are folded and identities such as `x + 0`, `x * 1` and `x ^ 1` are removed.
+    /// @param type One of `Plus`, `Minus`, `Mul`, `Div` or `Exp`
+    /// @return a new `ExprPtr`, or one of the operands if the operation is an identity
+    ExprPtr make_binary(TokenType type, ExprPtr lhs, ExprPtr rhs);
+
+    /// @brief Creates a new function call node
+    /// @return a new `ExprPtr`
+    ExprPtr make_call(FunctionDataPtr function, std::vector<ExprPtr> args);
+
+    /// @brief Checks if a node is a constant with the given value
+    /// @return a `bool` indicating if `node` is a `Num` equal to `value`
+    bool is_num(const ExprPtr& node, double value);
+
+    /// @brief Converts a reverse polish notation program to an expression tree
+    /// @param program A valid reverse polish notation program
+    /// @return The root of the tree
+    ExprPtr to_tree(const std::vector<SlotToken>& program);
+
+    /// @brief Converts an expression tree to a reverse polish notation program
+    /// @param tree The root of the tree
+    /// @return The equivalent program
+    std::vector<SlotToken> to_rpn(const ExprPtr& tree);
+
+    /// @brief Rebuilds an expression tree bottom-up, folding constants and removing identities
+    /// @param tree The root of the tree
+    /// @return The root of the simplified tree
+    ExprPtr simplify(const ExprPtr& tree);
+
+    /// @brief Symbolically differentiates an expression tree
+    /// @param tree The root of the tree
+    /// @param slot The slot of the variable to differentiate with respect to
+    /// @param derivative A read/write reference to hold the simplified derivative
+    /// @return A `bool` indicating success. Fails if the derivative depends on a function registered without derivatives.
+    bool try_differentiate(const ExprPtr& tree, size_t slot, ExprPtr& derivative);
+
+    /// @brief Symbolically differentiates a compiled expression and compiles the simplified result
+    /// @param expr The expression to differentiate
+    /// @param slot The slot of the variable to differentiate with respect to
+    /// @param derivative A read/write reference to hold the compiled derivative
+    /// @return A `bool` indicating success. Fails if the derivative depends on a function registered without derivatives.
+    bool try_differentiate(const CompiledExpression& expr, size_t slot, CompiledExpression& derivative);
+}
+
+#endif
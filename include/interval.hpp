@@ -0,0 +1,590 @@
+#ifndef _INTERVAL_HPP
+#define _INTERVAL_HPP
+// NOTE: This header has no .cpp file counterpart to allow for ease of use with generics
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "context.hpp" // also includes "variable.hpp"
+
+namespace nexsys
+{
+    /// @brief A closed interval of real numbers. Every operation rounds its bounds outward, so
+    /// evaluating an expression over intervals yields an interval containing the expression's
+    /// value at every point of its inputs. An interval whose bounds are out of order is empty.
+    struct Interval
+    {
+        /// @brief The lower bound, which may be `-INFINITY`
+        double lo;
+
+        /// @brief The upper bound, which may be `INFINITY`
+        double hi;
+
+        /// @brief Creates an interval holding a single value
+        Interval(double value = 0.0);
+
+        /// @brief Creates an interval holding every value from `lo` to `hi`. NaN bounds are widened to infinities.
+        Interval(double lo, double hi);
+
+        /// @brief Creates an interval holding every real number
+        static Interval entire();
+
+        /// @brief Creates an interval holding nothing
+        static Interval empty();
+
+        /// @brief Checks if the interval holds no values
+        bool is_empty() const;
+
+        /// @brief Checks if the interval holds a value
+        bool contains(double value) const;
+
+        /// @brief Provides the distance between the bounds, or `0.0` if the interval is empty
+        double width() const;
+
+        /// @brief Provides a representative point of the interval. Half-bounded intervals use their
+        /// finite bound and the entire real line uses `0.0`.
+        double midpoint() const;
+    };
+
+    /// @brief Provides the values held by both intervals
+    Interval intersect(const Interval& lhs, const Interval& rhs);
+
+    /// @brief Provides the smallest interval holding both intervals
+    Interval hull(const Interval& lhs, const Interval& rhs);
+
+    // Arithmetic. Constants convert implicitly, which is how `Bytecode::run` embeds them.
+    Interval operator+(const Interval& lhs, const Interval& rhs);
+    Interval operator-(const Interval& lhs, const Interval& rhs);
+    Interval operator*(const Interval& lhs, const Interval& rhs);
+    Interval operator/(const Interval& lhs, const Interval& rhs);
+
+    /// @brief Raises an interval to an integer power. Even powers are never negative, unlike repeated multiplication.
+    Interval powi(const Interval& base, int32_t exponent);
+
+    /// @brief Raises an interval to a constant power. Non-integer powers are only defined for non-negative bases.
+    Interval pow(const Interval& base, double exponent);
+
+    /// @brief Raises an interval to an interval power
+    Interval pow(const Interval& base, const Interval& exponent);
+
+    // Built-in functions, as evaluated by `Bytecode::run`. Values outside a function's domain are dropped.
+    Interval sin(const Interval& arg);
+    Interval cos(const Interval& arg);
+    Interval tan(const Interval& arg);
+    Interval asin(const Interval& arg);
+    Interval acos(const Interval& arg);
+    Interval atan(const Interval& arg);
+    Interval sinh(const Interval& arg);
+    Interval cosh(const Interval& arg);
+    Interval tanh(const Interval& arg);
+    Interval exp(const Interval& arg);
+    Interval log(const Interval& arg);
+    Interval log10(const Interval& arg);
+    Interval sqrt(const Interval& arg);
+    Interval fabs(const Interval& arg);
+    Interval hypot(const Interval& lhs, const Interval& rhs);
+    Interval intrinsic_min(const Interval& lhs, const Interval& rhs);
+    Interval intrinsic_max(const Interval& lhs, const Interval& rhs);
+
+    /// @brief Calls a user function with interval arguments. Nothing is known about the range of
+    /// a user function, so the result is only narrower than `Interval::entire()` if every argument is a single value.
+    /// @param function The function to call
+    /// @param args The `function->argc` arguments to pass
+    /// @return An interval holding every value the function may take
+    Interval call_function(FunctionDataPtr function, const Interval* args);
+
+    /// @brief Helper function to step a value towards negative infinity
+    inline double _next_down(double value)
+    {
+        return value > -INFINITY ? std::nextafter(value, -INFINITY) : value;
+    }
+
+    /// @brief Helper function to step a value towards positive infinity
+    inline double _next_up(double value)
+    {
+        return value < INFINITY ? std::nextafter(value, INFINITY) : value;
+    }
+
+    /// @brief Helper function to bound a libm result from below. libm is accurate to within an ulp or
+    /// two but not correctly rounded, so results are widened by two ulps.
+    inline double _libm_down(double value)
+    {
+        return _next_down(_next_down(value));
+    }
+
+    /// @brief Helper function to bound a libm result from above
+    inline double _libm_up(double value)
+    {
+        return _next_up(_next_up(value));
+    }
+
+    /// @brief Helper function to round a sum whose exact value may not be representable. `up` selects the direction.
+    inline double _add_rounded(double a, double b, bool up)
+    {
+        double s = a + b;
+        if (!std::isfinite(s))
+        {
+            // A finite sum that overflowed lies just past the largest finite value
+            if (std::isfinite(a) && std::isfinite(b))
+            {
+                return s > 0.0 ? (up ? s : DBL_MAX) : (up ? -DBL_MAX : s);
+            }
+            return s;
+        }
+
+        // Knuth's TwoSum gives the exact rounding error of `s`
+        double bb = s - a;
+        double err = (a - (s - bb)) + (b - bb);
+        if (up)
+        {
+            return err > 0.0 ? _next_up(s) : s;
+        }
+        return err < 0.0 ? _next_down(s) : s;
+    }
+
+    /// @brief Helper function to round a product whose exact value may not be representable
+    inline double _mul_rounded(double a, double b, bool up)
+    {
+        // Zero times anything is zero here, since bounds are limits rather than values
+        if (a == 0.0 || b == 0.0)
+        {
+            return 0.0;
+        }
+
+        double p = a * b;
+        if (!std::isfinite(p))
+        {
+            if (std::isfinite(a) && std::isfinite(b))
+            {
+                return p > 0.0 ? (up ? p : DBL_MAX) : (up ? -DBL_MAX : p);
+            }
+            return p;
+        }
+
+        // The error of a product is exact only while it does not underflow
+        if (std::fabs(p) < 0x1p-900)
+        {
+            return up ? _next_up(p) : _next_down(p);
+        }
+
+        double err = std::fma(a, b, -p);
+        if (up)
+        {
+            return err > 0.0 ? _next_up(p) : p;
+        }
+        return err < 0.0 ? _next_down(p) : p;
+    }
+
+    /// @brief Helper function to round a quotient whose exact value may not be representable. `b` must not be zero.
+    inline double _div_rounded(double a, double b, bool up)
+    {
+        if (a == 0.0 || std::isinf(b))
+        {
+            return std::isinf(a) ? (((a > 0.0) == (b > 0.0)) ? (up ? INFINITY : DBL_MAX) : (up ? -DBL_MAX : -INFINITY)) : 0.0;
+        }
+
+        double q = a / b;
+        if (!std::isfinite(q))
+        {
+            if (std::isfinite(a))
+            {
+                return q > 0.0 ? (up ? q : DBL_MAX) : (up ? -DBL_MAX : q);
+            }
+            return q;
+        }
+
+        if (std::fabs(q) < 0x1p-900 || std::fabs(a) < 0x1p-900)
+        {
+            return up ? _next_up(q) : _next_down(q);
+        }
+
+        // a - q * b has the sign of the exact quotient's error, flipped for negative divisors
+        double residual = std::fma(-q, b, a);
+        double err = b > 0.0 ? residual : -residual;
+        if (up)
+        {
+            return err > 0.0 ? _next_up(q) : q;
+        }
+        return err < 0.0 ? _next_down(q) : q;
+    }
+
+    /// @brief Helper function to apply a non-decreasing libm function to an interval
+    template<typename F>
+    inline Interval _increasing(const Interval& arg, F func)
+    {
+        if (arg.is_empty())
+        {
+            return Interval::empty();
+        }
+        return Interval(_libm_down(func(arg.lo)), _libm_up(func(arg.hi)));
+    }
+
+    /// @brief Helper function to apply a non-increasing libm function to an interval
+    template<typename F>
+    inline Interval _decreasing(const Interval& arg, F func)
+    {
+        if (arg.is_empty())
+        {
+            return Interval::empty();
+        }
+        return Interval(_libm_down(func(arg.hi)), _libm_up(func(arg.lo)));
+    }
+
+    /// @brief Helper function to check if an interval holds `offset + k * period` for some integer `k`.
+    /// Errs on the side of reporting that it does.
+    inline bool _holds_periodic(const Interval& arg, double offset, double period)
+    {
+        double k = std::ceil((arg.lo - offset) / period - 1e-9);
+        return offset + k * period <= arg.hi + 1e-9 * std::max(1.0, std::fabs(arg.hi));
+    }
+
+    inline Interval::Interval(double value): lo(value), hi(value) {}
+
+    inline Interval::Interval(double lo, double hi): lo(std::isnan(lo) ? -INFINITY : lo), hi(std::isnan(hi) ? INFINITY : hi) {}
+
+    inline Interval Interval::entire()
+    {
+        return Interval(-INFINITY, INFINITY);
+    }
+
+    inline Interval Interval::empty()
+    {
+        return Interval(INFINITY, -INFINITY);
+    }
+
+    inline bool Interval::is_empty() const
+    {
+        return !(lo <= hi);
+    }
+
+    inline bool Interval::contains(double value) const
+    {
+        return lo <= value && value <= hi;
+    }
+
+    inline double Interval::width() const
+    {
+        return is_empty() ? 0.0 : hi - lo;
+    }
+
+    inline double Interval::midpoint() const
+    {
+        if (std::isfinite(lo) && std::isfinite(hi))
+        {
+            return lo / 2.0 + hi / 2.0;
+        }
+        if (std::isfinite(lo))
+        {
+            return lo;
+        }
+        return std::isfinite(hi) ? hi : 0.0;
+    }
+
+    inline Interval intersect(const Interval& lhs, const Interval& rhs)
+    {
+        if (lhs.is_empty() || rhs.is_empty())
+        {
+            return Interval::empty();
+        }
+        return Interval(std::max(lhs.lo, rhs.lo), std::min(lhs.hi, rhs.hi));
+    }
+
+    inline Interval hull(const Interval& lhs, const Interval& rhs)
+    {
+        if (lhs.is_empty())
+        {
+            return rhs;
+        }
+        if (rhs.is_empty())
+        {
+            return lhs;
+        }
+        return Interval(std::min(lhs.lo, rhs.lo), std::max(lhs.hi, rhs.hi));
+    }
+
+    inline Interval operator+(const Interval& lhs, const Interval& rhs)
+    {
+        if (lhs.is_empty() || rhs.is_empty())
+        {
+            return Interval::empty();
+        }
+        return Interval(_add_rounded(lhs.lo, rhs.lo, false), _add_rounded(lhs.hi, rhs.hi, true));
+    }
+
+    inline Interval operator-(const Interval& lhs, const Interval& rhs)
+    {
+        if (lhs.is_empty() || rhs.is_empty())
+        {
+            return Interval::empty();
+        }
+        return Interval(_add_rounded(lhs.lo, -rhs.hi, false), _add_rounded(lhs.hi, -rhs.lo, true));
+    }
+
+    inline Interval operator*(const Interval& lhs, const Interval& rhs)
+    {
+        if (lhs.is_empty() || rhs.is_empty())
+        {
+            return Interval::empty();
+        }
+
+        double lo = INFINITY, hi = -INFINITY;
+        for (double a: {lhs.lo, lhs.hi})
+        {
+            for (double b: {rhs.lo, rhs.hi})
+            {
+                lo = std::min(lo, _mul_rounded(a, b, false));
+                hi = std::max(hi, _mul_rounded(a, b, true));
+            }
+        }
+        return Interval(lo, hi);
+    }
+
+    inline Interval operator/(const Interval& lhs, const Interval& rhs)
+    {
+        if (lhs.is_empty() || rhs.is_empty())
+        {
+            return Interval::empty();
+        }
+
+        // Dividing by an interval around zero can produce values of any size
+        if (rhs.contains(0.0))
+        {
+            return Interval::entire();
+        }
+
+        double lo = INFINITY, hi = -INFINITY;
+        for (double a: {lhs.lo, lhs.hi})
+        {
+            for (double b: {rhs.lo, rhs.hi})
+            {
+                lo = std::min(lo, _div_rounded(a, b, false));
+                hi = std::max(hi, _div_rounded(a, b, true));
+            }
+        }
+        return Interval(lo, hi);
+    }
+
+    inline Interval powi(const Interval& base, int32_t exponent)
+    {
+        if (base.is_empty())
+        {
+            return Interval::empty();
+        }
+        if (exponent == 0)
+        {
+            return Interval(1.0);
+        }
+        if (exponent < 0)
+        {
+            return Interval(1.0) / powi(base, -exponent);
+        }
+
+        auto raise = [exponent](double v) { return std::pow(v, (double)exponent); };
+        if (exponent % 2 == 1)
+        {
+            return _increasing(base, raise);
+        }
+        return intersect(_increasing(fabs(base), raise), Interval(0.0, INFINITY));
+    }
+
+    inline Interval pow(const Interval& base, double exponent)
+    {
+        if (exponent == std::trunc(exponent) && std::fabs(exponent) <= 1024.0)
+        {
+            return powi(base, (int32_t)exponent);
+        }
+
+        auto raise = [exponent](double v) { return std::pow(v, exponent); };
+        Interval domain = intersect(base, Interval(0.0, INFINITY));
+        Interval res = exponent > 0.0 ? _increasing(domain, raise) : _decreasing(domain, raise);
+        return intersect(res, Interval(0.0, INFINITY));
+    }
+
+    inline Interval pow(const Interval& base, const Interval& exponent)
+    {
+        if (exponent.lo == exponent.hi)
+        {
+            return pow(base, exponent.lo);
+        }
+
+        // u^v = exp(v * ln(u)), which is only defined for non-negative u
+        return exp(exponent * log(base));
+    }
+
+    inline Interval sin(const Interval& arg)
+    {
+        if (arg.is_empty())
+        {
+            return Interval::empty();
+        }
+        if (!(arg.width() < 2.0 * M_PI))
+        {
+            return Interval(-1.0, 1.0);
+        }
+
+        double a = std::sin(arg.lo), b = std::sin(arg.hi);
+        double lo = _holds_periodic(arg, -M_PI_2, 2.0 * M_PI) ? -1.0 : _libm_down(std::min(a, b));
+        double hi = _holds_periodic(arg, M_PI_2, 2.0 * M_PI) ? 1.0 : _libm_up(std::max(a, b));
+        return intersect(Interval(lo, hi), Interval(-1.0, 1.0));
+    }
+
+    inline Interval cos(const Interval& arg)
+    {
+        if (arg.is_empty())
+        {
+            return Interval::empty();
+        }
+        if (!(arg.width() < 2.0 * M_PI))
+        {
+            return Interval(-1.0, 1.0);
+        }
+
+        double a = std::cos(arg.lo), b = std::cos(arg.hi);
+        double lo = _holds_periodic(arg, M_PI, 2.0 * M_PI) ? -1.0 : _libm_down(std::min(a, b));
+        double hi = _holds_periodic(arg, 0.0, 2.0 * M_PI) ? 1.0 : _libm_up(std::max(a, b));
+        return intersect(Interval(lo, hi), Interval(-1.0, 1.0));
+    }
+
+    inline Interval tan(const Interval& arg)
+    {
+        if (arg.is_empty())
+        {
+            return Interval::empty();
+        }
+        if (!(arg.width() < M_PI) || _holds_periodic(arg, M_PI_2, M_PI))
+        {
+            return Interval::entire();
+        }
+        return _increasing(arg, [](double v) { return std::tan(v); });
+    }
+
+    inline Interval asin(const Interval& arg)
+    {
+        Interval res = _increasing(intersect(arg, Interval(-1.0, 1.0)), [](double v) { return std::asin(v); });
+        return intersect(res, Interval(_libm_down(-M_PI_2), _libm_up(M_PI_2)));
+    }
+
+    inline Interval acos(const Interval& arg)
+    {
+        Interval res = _decreasing(intersect(arg, Interval(-1.0, 1.0)), [](double v) { return std::acos(v); });
+        return intersect(res, Interval(0.0, _libm_up(M_PI)));
+    }
+
+    inline Interval atan(const Interval& arg)
+    {
+        Interval res = _increasing(arg, [](double v) { return std::atan(v); });
+        return intersect(res, Interval(_libm_down(-M_PI_2), _libm_up(M_PI_2)));
+    }
+
+    inline Interval sinh(const Interval& arg)
+    {
+        return _increasing(arg, [](double v) { return std::sinh(v); });
+    }
+
+    inline Interval cosh(const Interval& arg)
+    {
+        Interval res = _increasing(fabs(arg), [](double v) { return std::cosh(v); });
+        return intersect(res, Interval(1.0, INFINITY));
+    }
+
+    inline Interval tanh(const Interval& arg)
+    {
+        return intersect(_increasing(arg, [](double v) { return std::tanh(v); }), Interval(-1.0, 1.0));
+    }
+
+    inline Interval exp(const Interval& arg)
+    {
+        return intersect(_increasing(arg, [](double v) { return std::exp(v); }), Interval(0.0, INFINITY));
+    }
+
+    inline Interval log(const Interval& arg)
+    {
+        return _increasing(intersect(arg, Interval(0.0, INFINITY)), [](double v) { return std::log(v); });
+    }
+
+    inline Interval log10(const Interval& arg)
+    {
+        return _increasing(intersect(arg, Interval(0.0, INFINITY)), [](double v) { return std::log10(v); });
+    }
+
+    inline Interval sqrt(const Interval& arg)
+    {
+        Interval res = _increasing(intersect(arg, Interval(0.0, INFINITY)), [](double v) { return std::sqrt(v); });
+        return intersect(res, Interval(0.0, INFINITY));
+    }
+
+    inline Interval fabs(const Interval& arg)
+    {
+        if (arg.is_empty())
+        {
+            return Interval::empty();
+        }
+        if (arg.lo >= 0.0)
+        {
+            return arg;
+        }
+        if (arg.hi <= 0.0)
+        {
+            return Interval(-arg.hi, -arg.lo);
+        }
+        return Interval(0.0, std::max(-arg.lo, arg.hi));
+    }
+
+    inline Interval hypot(const Interval& lhs, const Interval& rhs)
+    {
+        Interval a = fabs(lhs), b = fabs(rhs);
+        if (a.is_empty() || b.is_empty())
+        {
+            return Interval::empty();
+        }
+
+        // Non-decreasing in the magnitude of each argument
+        Interval res(_libm_down(std::hypot(a.lo, b.lo)), _libm_up(std::hypot(a.hi, b.hi)));
+        return intersect(res, Interval(0.0, INFINITY));
+    }
+
+    /// @brief Encloses `intrinsic_min`, which gives NaN wherever either side is undefined, so an empty side leaves nothing
+    inline Interval intrinsic_min(const Interval& lhs, const Interval& rhs)
+    {
+        if (lhs.is_empty() || rhs.is_empty())
+        {
+            return Interval::empty();
+        }
+        return Interval(std::min(lhs.lo, rhs.lo), std::min(lhs.hi, rhs.hi));
+    }
+
+    /// @brief Encloses `intrinsic_max`, which gives NaN wherever either side is undefined
+    inline Interval intrinsic_max(const Interval& lhs, const Interval& rhs)
+    {
+        if (lhs.is_empty() || rhs.is_empty())
+        {
+            return Interval::empty();
+        }
+        return Interval(std::max(lhs.lo, rhs.lo), std::max(lhs.hi, rhs.hi));
+    }
+
+    inline Interval call_function(FunctionDataPtr function, const Interval* args)
+    {
+        std::vector<double> vals(function->argc);
+        for (size_t k = 0; k < function->argc; k++)
+        {
+            if (args[k].is_empty())
+            {
+                return Interval::empty();
+            }
+            if (args[k].lo != args[k].hi)
+            {
+                return Interval::entire();
+            }
+            vals[k] = args[k].lo;
+        }
+
+        double value = function->func(vals.data());
+        return std::isnan(value) ? Interval::empty() : Interval(value);
+    }
+}
+
+#endif
@@ -0,0 +1,219 @@
+#ifndef _JACOBIAN_HPP
+#define _JACOBIAN_HPP
+
+#include <vector>
+
+#include "dual.hpp"
+#include "matrix.hpp"
+#include "system.hpp" // also includes "expression.hpp", "compiled.hpp", "bytecode.hpp", "shunting.hpp", "context.hpp", "variable.hpp"
+
+namespace nexsys
+{
+    /// @brief A constant used by `nexsys` newton-raphson solver functions. It represents the quantity represented by 'dx' in calculus.
+    constexpr double DX = 0.0001;
+
+    /// @brief The ways the jacobian of a system may be computed
+    enum JacobianMode
+    {
+        /// @brief Perturb each variable by `DX` and re-evaluate the system. Costs `n` extra system evaluations,
+        /// or one per color of a `ColoredJacobian` for sparse systems.
+        FiniteDifference,
+
+        /// @brief Evaluate exact partial derivatives compiled once from the system's expressions
+        Symbolic,
+
+        /// @brief Evaluate the system over `Dual<DUAL_WIDTH>` numbers, producing the residual and a
+        /// block of exact jacobian columns in each pass. Costs `ceil(n / DUAL_WIDTH)` passes.
+        Automatic,
+    };
+
+    /// @brief The number of jacobian columns computed by each pass of forward-mode automatic differentiation
+    constexpr size_t DUAL_WIDTH = 8;
+
+    /// @brief Approximates the jacobian of a system with one-sided finite differences
+    /// @param system The expressions in the system
+    /// @param x The point to evaluate the jacobian at. Temporarily perturbed, but left unchanged on return.
+    /// @param f The value of each expression at `x`
+    /// @param jacobian A square `Matrix<double>` to write the jacobian to. Slots past its last column are held fixed.
+    void finite_difference_jacobian(const std::vector<CompiledExpression>& system, std::vector<double>& x, const std::vector<double>& f, Matrix<double>& jacobian);
+
+    /// @brief Approximates the jacobian of a merged system with one-sided finite differences. Each
+    /// column costs a single dispatch of the merged program rather than one per expression.
+    /// @param system The merged system
+    /// @param x The point to evaluate the jacobian at. Temporarily perturbed, but left unchanged on return.
+    /// @param f The value of each expression at `x`
+    /// @param jacobian A square `Matrix<double>` to write the jacobian to. Slots past its last column are held fixed.
+    /// @param pool The `ThreadPool` to split the columns across, or `nullptr` to evaluate on the calling thread. The result is identical, bit for bit, either way.
+    void finite_difference_jacobian(const CompiledSystem& system, std::vector<double>& x, const std::vector<double>& f, Matrix<double>& jacobian, ThreadPool* pool = nullptr);
+
+    /// @brief Finds the sparsity pattern of a system's jacobian, i.e. which variables each expression reads
+    /// @param system The expressions in the system, all compiled against the same `VariableIndex`
+    /// @param slots The number of columns in the jacobian. Slots read past it are parameters, and left out.
+    /// @return A `SparseMatrix<double>` with an entry, set to zero, for each variable each expression reads
+    SparseMatrix<double> jacobian_pattern(const std::vector<CompiledExpression>& system, size_t slots);
+
+    /// @brief A finite difference jacobian that uses the sparsity of a system. Columns whose 
+    /// variables are never read by the same expression are colored alike (Curtis-Powell-Reid), 
+    /// so that each color is estimated by perturbing all of its columns at once, re-evaluating 
+    /// only the expressions that read one of them.
+    class ColoredJacobian
+    {
+    private:
+        size_t n;
+        std::vector<size_t> colors;
+
+        // The columns of each color, and the (row, column) entries each color estimates
+        std::vector<size_t> column_start;
+        std::vector<size_t> columns;
+        std::vector<size_t> entry_start;
+        std::vector<size_t> rows;
+        std::vector<size_t> cols;
+
+        std::vector<double> stored;
+        std::vector<std::vector<double>> worker_x;
+        std::vector<std::vector<double>> worker_saved;
+
+        template<typename M>
+        void evaluate_into(const std::vector<CompiledExpression>& system, std::vector<double>& x, const std::vector<double>& f, M& jacobian, ThreadPool* pool);
+
+        template<typename M>
+        void evaluate_colors(const std::vector<CompiledExpression>& system, std::vector<double>& x, std::vector<double>& saved, const std::vector<double>& f, M& jacobian, size_t begin, size_t end) const;
+
+    public:
+        ColoredJacobian();
+
+        /// @brief Finds the sparsity pattern of a system's jacobian and colors its columns
+        /// @param system The expressions in the system, all compiled against the same `VariableIndex`
+        /// @param slots The number of columns in the jacobian. Slots read past it are parameters, and never perturbed.
+        ColoredJacobian(const std::vector<CompiledExpression>& system, size_t slots);
+
+        /// @brief Approximates the jacobian with one-sided finite differences, one pass per color.
+        /// Entries outside the sparsity pattern are set to zero.
+        /// @param system The expressions this jacobian was built from
+        /// @param x The point to evaluate the jacobian at. Temporarily perturbed, but left unchanged on return.
+        /// @param f The value of each expression at `x`
+        /// @param jacobian A `Matrix<double>` with a row per expression and a column per slot to write the jacobian to
+        /// @param pool The `ThreadPool` to split the colors across, or `nullptr` to evaluate on the calling thread. The result is identical, bit for bit, either way.
+        void evaluate(const std::vector<CompiledExpression>& system, std::vector<double>& x, const std::vector<double>& f, Matrix<double>& jacobian, ThreadPool* pool = nullptr);
+
+        /// @brief Approximates the jacobian with one-sided finite differences, one pass per color
+        /// @param system The expressions this jacobian was built from
+        /// @param x The point to evaluate the jacobian at. Temporarily perturbed, but left unchanged on return.
+        /// @param f The value of each expression at `x`
+        /// @param jacobian A `SparseMatrix<double>` with the system's `jacobian_pattern` to write the jacobian to
+        /// @param pool The `ThreadPool` to split the colors across, or `nullptr` to evaluate on the calling thread. The result is identical, bit for bit, either way.
+        void evaluate(const std::vector<CompiledExpression>& system, std::vector<double>& x, const std::vector<double>& f, SparseMatrix<double>& jacobian, ThreadPool* pool = nullptr);
+
+        /// @brief Provides the number of colors, i.e. the number of passes each evaluation makes
+        /// @return The number of colors
+        size_t get_color_count() const;
+
+        /// @brief Provides the number of structurally nonzero entries, i.e. the number of expression evaluations each evaluation makes
+        /// @return The number of nonzero entries in the sparsity pattern
+        size_t get_nonzero_count() const;
+
+        /// @brief Provides the color of each column
+        /// @return The color of each slot, all below `get_color_count()`
+        const std::vector<size_t>& get_colors() const;
+    };
+
+    /// @brief The exact jacobian of a system of compiled expressions. Each nonzero partial
+    /// derivative is differentiated, simplified and compiled once when this is constructed.
+    class SymbolicJacobian
+    {
+    private:
+        size_t n;
+        std::vector<size_t> rows;
+        std::vector<size_t> cols;
+        std::vector<CompiledExpression> entries;
+        std::vector<size_t> fallback_rows;
+        std::vector<std::vector<size_t>> fallback_slots;
+        mutable std::vector<std::vector<double>> worker_x;
+
+        template<typename M>
+        void evaluate_into(const std::vector<CompiledExpression>& system, std::vector<double>& x, const std::vector<double>& f, M& jacobian, ThreadPool* pool) const;
+
+        template<typename M>
+        void evaluate_entries(const std::vector<double>& x, M& jacobian, size_t begin, size_t end) const;
+
+        template<typename M>
+        void evaluate_fallbacks(const std::vector<CompiledExpression>& system, std::vector<double>& x, const std::vector<double>& f, M& jacobian, size_t begin, size_t end) const;
+
+    public:
+        SymbolicJacobian();
+
+        /// @brief Differentiates every expression in a system with respect to each unknown it reads
+        /// @param system The expressions in the system, all compiled against the same `VariableIndex`. 
+        /// Its first `system.size()` slots are the unknowns, and any later slots are parameters.
+        SymbolicJacobian(const std::vector<CompiledExpression>& system);
+
+        /// @brief Evaluates the jacobian. Rows of expressions that could not be differentiated 
+        /// (i.e. that call user functions registered without derivatives) use finite differences.
+        /// @param system The expressions this jacobian was built from
+        /// @param x The point to evaluate the jacobian at. Temporarily perturbed, but left unchanged on return.
+        /// @param f The value of each expression at `x`
+        /// @param jacobian A square `Matrix<double>` to write the jacobian to
+        /// @param pool The `ThreadPool` to split the entries across, or `nullptr` to evaluate on the calling thread. The result is identical, bit for bit, either way.
+        void evaluate(const std::vector<CompiledExpression>& system, std::vector<double>& x, const std::vector<double>& f, Matrix<double>& jacobian, ThreadPool* pool = nullptr) const;
+
+        /// @brief Evaluates the jacobian, like the dense overload
+        /// @param system The expressions this jacobian was built from
+        /// @param x The point to evaluate the jacobian at. Temporarily perturbed, but left unchanged on return.
+        /// @param f The value of each expression at `x`
+        /// @param jacobian A `SparseMatrix<double>` with the system's `jacobian_pattern` to write the jacobian to
+        /// @param pool The `ThreadPool` to split the entries across, or `nullptr` to evaluate on the calling thread. The result is identical, bit for bit, either way.
+        void evaluate(const std::vector<CompiledExpression>& system, std::vector<double>& x, const std::vector<double>& f, SparseMatrix<double>& jacobian, ThreadPool* pool = nullptr) const;
+
+        /// @brief Provides the number of partial derivatives that were compiled
+        /// @return The number of structurally nonzero, symbolically differentiated entries
+        size_t get_entry_count() const;
+
+        /// @brief Provides the rows of the jacobian that fall back to finite differences
+        /// @return The indices of expressions that could not be differentiated
+        const std::vector<size_t>& get_fallback_rows() const;
+    };
+
+    /// @brief The exact jacobian of a system of compiled expressions, computed with forward-mode
+    /// automatic differentiation. Holds the workspace needed to evaluate it without allocating.
+    class DualJacobian
+    {
+    private:
+        std::vector<std::vector<size_t>> slots;
+        std::vector<Dual<DUAL_WIDTH>> x;
+        std::vector<Dual<DUAL_WIDTH>> frame;
+        std::vector<std::vector<Dual<DUAL_WIDTH>>> worker_x;
+        std::vector<std::vector<Dual<DUAL_WIDTH>>> worker_frames;
+
+        template<typename M>
+        void evaluate_into(const std::vector<CompiledExpression>& system, const std::vector<double>& x, std::vector<double>& f, M& jacobian, ThreadPool* pool);
+
+        template<typename M>
+        void evaluate_passes(const std::vector<CompiledExpression>& system, const std::vector<double>& x, std::vector<Dual<DUAL_WIDTH>>& duals, std::vector<Dual<DUAL_WIDTH>>& scratch, std::vector<double>& f, M& jacobian, size_t begin, size_t end) const;
+
+    public:
+        DualJacobian();
+
+        /// @brief Prepares to evaluate the jacobian of a system
+        /// @param system The expressions in the system, all compiled against the same `VariableIndex`
+        DualJacobian(const std::vector<CompiledExpression>& system);
+
+        /// @brief Evaluates the system and its jacobian together. Expressions are only re-evaluated
+        /// for the blocks of columns containing a variable they read.
+        /// @param system The expressions this jacobian was prepared for
+        /// @param x The point to evaluate the jacobian at
+        /// @param f A vector to write the value of each expression at `x` to
+        /// @param jacobian A square `Matrix<double>` to write the jacobian to. Slots past its last column are held fixed.
+        /// @param pool The `ThreadPool` to split the passes across, or `nullptr` to evaluate on the calling thread. The result is identical, bit for bit, either way.
+        void evaluate(const std::vector<CompiledExpression>& system, const std::vector<double>& x, std::vector<double>& f, Matrix<double>& jacobian, ThreadPool* pool = nullptr);
+
+        /// @brief Evaluates the system and its jacobian together, like the dense overload
+        /// @param system The expressions this jacobian was prepared for
+        /// @param x The point to evaluate the jacobian at
+        /// @param f A vector to write the value of each expression at `x` to
+        /// @param jacobian A `SparseMatrix<double>` with the system's `jacobian_pattern` to write the jacobian to
+        /// @param pool The `ThreadPool` to split the passes across, or `nullptr` to evaluate on the calling thread. The result is identical, bit for bit, either way.
+        void evaluate(const std::vector<CompiledExpression>& system, const std::vector<double>& x, std::vector<double>& f, SparseMatrix<double>& jacobian, ThreadPool* pool = nullptr);
+    };
+}
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef _JIT_HPP
+#define _JIT_HPP
+
+#include "bytecode.hpp" // also includes "context.hpp", "variable.hpp"
+
+namespace nexsys
+{
+    /// @brief The signature of natively compiled expressions. Takes the values of each
+    /// variable slot and scratch space for the evaluation frame.
+    typedef double (*JitFunction)(const double* x, double* frame);
+
+    /// @brief Native x86-64 machine code for a `Bytecode` program, held in its own executable page.
+    /// Variable slots and frame registers are addressed directly, constants are embedded in the
+    /// instruction stream and user functions are called through their function pointers.
+    class JitCode
+    {
+    private:
+        void* page;
+        size_t page_size;
+        JitFunction entry;
+
+    public:
+        JitCode();
+
+        /// @brief Compiles a bytecode program to machine code. Throws `std::runtime_error` if
+        /// this platform is not supported or executable memory could not be mapped.
+        /// @param code The program to compile
+        JitCode(const Bytecode& code);
+
+        JitCode(const JitCode&) = delete;
+        JitCode& operator=(const JitCode&) = delete;
+
+        ~JitCode();
+
+        /// @brief Checks if native code can be generated on this platform
+        /// @return A `bool` indicating if this is an x86-64 system with `mmap`
+        static bool is_supported();
+
+        /// @brief Runs the compiled code
+        /// @param x The values of each variable slot
+        /// @param frame Scratch space of at least `Bytecode::get_frame_size()` values
+        /// @return The value produced by the program
+        inline double run(const double* x, double* frame) const
+        {
+            return entry(x, frame);
+        }
+    };
+}
+
+#endif
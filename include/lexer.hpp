@@ -0,0 +1,56 @@
+#ifndef _LEXER_HPP
+#define _LEXER_HPP
+
+#include <string_view>
+
+namespace nexsys
+{
+    /// @brief The kinds of lexeme that may be found in a math expression
+    enum LexemeType
+    {
+        LexNum,
+        LexSymbol,
+        LexPlus,
+        LexMinus,
+        LexMul,
+        LexDiv,
+        LexExp,
+        LexLeftParenthesis,
+        LexRightParenthesis,
+        LexComma,
+        LexEnd,
+    };
+
+    /// @brief A single lexeme of a math expression. Refers into the scanned text rather than copying it.
+    struct Lexeme
+    {
+        LexemeType type;
+
+        /// @brief The text of the lexeme. Only valid while the scanned expression is.
+        std::string_view text;
+
+        /// @brief The value of a `LexNum` lexeme
+        double value;
+    };
+
+    /// @brief Splits a math expression into lexemes in a single pass without allocating. Words
+    /// are maximal runs of characters that are neither whitespace nor one of `+-*/^(,)`, except
+    /// that a number may carry a signed exponent such as `1.5e-3`.
+    class Lexer
+    {
+    private:
+        std::string_view expr;
+        size_t pos;
+
+    public:
+        /// @brief Creates a lexer over an expression
+        /// @param expr The expression to scan. Must outlive the lexer and every lexeme it yields.
+        Lexer(std::string_view expr);
+
+        /// @brief Scans the next lexeme
+        /// @return The next `Lexeme`, or one of type `LexEnd` once the expression is exhausted
+        Lexeme next();
+    };
+}
+
+#endif
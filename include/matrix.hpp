@@ -2,11 +2,19 @@
 #define _MATRIX_HPP
 // NOTE: This header has no .cpp file counterpart to allow for ease of use with generics
 
+#include <algorithm>
+#include <cmath>
+#include <set>
+#include <stdexcept>
 #include <vector>
 #include <functional>
+#include <iterator>
 
 namespace nexsys 
 {
+    template<typename T>
+    class LU;
+
     template<typename T>
     class Matrix
     {
@@ -37,6 +45,8 @@ namespace nexsys
         static Matrix<T> from_row_vec(std::vector<T>);
 
         // Getters and setters
+        inline size_t get_rows() const;
+        inline size_t get_cols() const;
         inline T get_index(size_t i, size_t j) const;
         inline T& get_index_ref(size_t i, size_t j);
 
@@ -70,9 +80,7 @@ namespace nexsys
     template<typename T>
     Matrix<T>::Matrix(size_t rows, size_t cols): rows(rows), cols(cols)
     {
-        vals = std::vector<T>();
-        vals.reserve(rows * cols);
-        this->inplace_map_over([](T _elem){ return (T)0; });
+        vals = std::vector<T>(rows * cols, (T)0);
     }
 
     /// @brief Creates a new `Matrix<T>` from the data in `vals`, but only 
@@ -144,6 +152,24 @@ namespace nexsys
         return Matrix<T>(row, row.size());
     }
 
+    /// @brief Returns the number of rows in the `Matrix<T>`
+    /// @tparam T The type of the contained `Matrix<T>` data
+    /// @returns The number of rows
+    template<typename T>
+    inline size_t Matrix<T>::get_rows() const
+    {
+        return rows;
+    }
+
+    /// @brief Returns the number of columns in the `Matrix<T>`
+    /// @tparam T The type of the contained `Matrix<T>` data
+    /// @returns The number of columns
+    template<typename T>
+    inline size_t Matrix<T>::get_cols() const
+    {
+        return cols;
+    }
+
     /// @brief Returns the value stored at the `i`th row and `j`th column of the `Matrix<T>`
     /// @tparam T The type of the contained `Matrix<T>` data
     /// @param i The row to be accessed
@@ -301,13 +327,13 @@ namespace nexsys
     bool Matrix<T>::inplace_invert_3() noexcept
     {
         T a11 = this->get_index(0, 0);
-        T a12 = this->get_index(1, 0);
-        T a13 = this->get_index(2, 0);
-        T a21 = this->get_index(0, 1);
+        T a12 = this->get_index(0, 1);
+        T a13 = this->get_index(0, 2);
+        T a21 = this->get_index(1, 0);
         T a22 = this->get_index(1, 1);
-        T a23 = this->get_index(2, 1);
-        T a31 = this->get_index(0, 2);
-        T a32 = this->get_index(1, 2);
+        T a23 = this->get_index(1, 2);
+        T a31 = this->get_index(2, 0);
+        T a32 = this->get_index(2, 1);
         T a33 = this->get_index(2, 2);
 
         T det = a11*a22*a33 + a21*a32*a13 + a31*a12*a23 
@@ -355,7 +381,7 @@ namespace nexsys
         T det = a11*a22*a33*a44 + a11*a23*a34*a42 + a11*a24*a32*a43 +
                 a12*a21*a34*a43 + a12*a23*a31*a44 + a12*a24*a33*a41 + 
                 a13*a21*a32*a44 + a13*a22*a34*a41 + a13*a24*a31*a42 + 
-                a14*a21*a33*a42 + a14*a22*a34*a43 + a14*a23*a32*a41 -
+                a14*a21*a33*a42 + a14*a22*a31*a43 + a14*a23*a32*a41 -
                 a11*a22*a34*a43 - a11*a23*a32*a44 - a11*a24*a33*a42 -
                 a12*a21*a33*a44 - a12*a23*a34*a41 - a12*a24*a31*a43 -
                 a13*a21*a34*a42 - a13*a22*a31*a44 - a13*a24*a32*a41 -
@@ -391,38 +417,26 @@ namespace nexsys
     bool Matrix<T>::inplace_invert_n() noexcept
     {
         size_t n = rows;
-        Matrix<T> inv = Matrix<T>::identity(n);
-        std::vector<T> backup = vals;
+        LU<T> lu;
+        if (!lu.try_factor(*this))
+        {
+            return false;
+        }
 
+        std::vector<T> column(n);
         for (size_t j = 0; j < n; j++)
         {
             for (size_t i = 0; i < n; i++)
             {
-                if (i == j)
-                {
-                    continue;
-                }
-
-                if (this->get_index(i, j) == (T)0)
-                {
-                    vals = backup;
-                    return false;
-                }
-
-                T scalar = this->get_index(i, j) / this->get_index(j, j);
-                this->inplace_scaled_row_add(i, j, -scalar);
-                inv.inplace_scaled_row_add(i, j, -scalar);
+                column[i] = i == j ? (T)1 : (T)0;
+            }
+            lu.solve(column.data());
+            for (size_t i = 0; i < n; i++)
+            {
+                this->get_index_ref(i, j) = column[i];
             }
         }
 
-        for (size_t i = 0; i < n; i++)
-        {
-            T scalar = ((T)1) / this->get_index(i, i);
-            this->inplace_row_scale(i, scalar);
-            inv.inplace_row_scale(i, scalar);
-        }
-
-        this->vals = inv.vals;
         return true;
     }
 
@@ -458,5 +472,1087 @@ namespace nexsys
                 return inplace_invert_n();
         }
     }
+
+    /// @brief The LU decomposition of a square `Matrix<T>` with partial pivoting, i.e. `PA = LU`. 
+    /// Solving a system with it takes about a third of the work of inverting the matrix and 
+    /// multiplying by the inverse, and it only fails if the matrix is singular.
+    /// @tparam T The type of the contained `Matrix<T>` data
+    template<typename T>
+    class LU
+    {
+    private:
+        // L below the diagonal (its unit diagonal is implied) and U on and above it
+        Matrix<T> factors;
+
+        // Row `k` was swapped with row `pivots[k]` at step `k` of the elimination
+        std::vector<size_t> pivots;
+
+    public:
+        // Constructors
+        LU();
+        LU(size_t n);
+
+        // Getters
+        size_t size() const;
+
+        // Methods
+        bool try_factor(const Matrix<T>& matrix);
+        void solve(T* b) const noexcept;
+        void solve(const std::vector<T>& b, std::vector<T>& x) const;
+        void solve_transpose(T* b) const noexcept;
+    };
+
+    /// @brief Creates an empty `LU<T>`, to be filled in by `try_factor`
+    /// @tparam T The type of the contained `Matrix<T>` data
+    template<typename T>
+    LU<T>::LU(): factors(0, 0) {}
+
+    /// @brief Creates an `LU<T>` with room for the decomposition of an `n` by `n` matrix, so that 
+    /// factoring a matrix of that size does not allocate
+    /// @tparam T The type of the contained `Matrix<T>` data
+    /// @param n The number of rows and columns of the matrices that will be factored
+    template<typename T>
+    LU<T>::LU(size_t n): factors(n, n), pivots(n) {}
+
+    /// @brief Returns the number of rows and columns of the factored matrix
+    /// @tparam T The type of the contained `Matrix<T>` data
+    /// @returns The size of the decomposition
+    template<typename T>
+    size_t LU<T>::size() const
+    {
+        return pivots.size();
+    }
+
+    /// @brief Tries to factor the given matrix, returning a boolean indicating if the operation 
+    /// was successful. Fails if the matrix is not square or is singular, in which case the 
+    /// decomposition must not be used until a later call succeeds.
+    /// @tparam T The type of the contained `Matrix<T>` data
+    /// @param matrix The matrix to factor
+    /// @returns A bool indicating if factoring was successful
+    template<typename T>
+    bool LU<T>::try_factor(const Matrix<T>& matrix)
+    {
+        size_t n = matrix.get_rows();
+        if (n != matrix.get_cols())
+        {
+            return false;
+        }
+
+        factors = matrix;
+        pivots.resize(n);
+
+        for (size_t k = 0; k < n; k++)
+        {
+            // Pivot on the largest remaining element of the column
+            size_t p = k;
+            for (size_t i = k + 1; i < n; i++)
+            {
+                if (std::abs(factors.get_index(i, k)) > std::abs(factors.get_index(p, k)))
+                {
+                    p = i;
+                }
+            }
+
+            if (factors.get_index(p, k) == (T)0)
+            {
+                return false;
+            }
+
+            pivots[k] = p;
+            if (p != k)
+            {
+                factors.inplace_row_swap(k, p);
+            }
+
+            T pivot = factors.get_index(k, k);
+            for (size_t i = k + 1; i < n; i++)
+            {
+                T scalar = factors.get_index(i, k) / pivot;
+                factors.get_index_ref(i, k) = scalar;
+                if (scalar == (T)0)
+                {
+                    continue;
+                }
+
+                for (size_t j = k + 1; j < n; j++)
+                {
+                    factors.get_index_ref(i, j) -= scalar * factors.get_index(k, j);
+                }
+            }
+        }
+
+        return true;
+    }
+
+    /// @brief Solves `Ax = b` by forward and back substitution, where `A` is the factored matrix
+    /// @tparam T The type of the contained `Matrix<T>` data
+    /// @param b The `size()` values of the right hand side, which are overwritten with the solution `x`
+    template<typename T>
+    void LU<T>::solve(T* b) const noexcept
+    {
+        size_t n = pivots.size();
+        for (size_t k = 0; k < n; k++)
+        {
+            if (pivots[k] != k)
+            {
+                T stor = b[k];
+                b[k] = b[pivots[k]];
+                b[pivots[k]] = stor;
+            }
+        }
+
+        // Ly = Pb
+        for (size_t i = 1; i < n; i++)
+        {
+            T acc = b[i];
+            for (size_t j = 0; j < i; j++)
+            {
+                acc -= factors.get_index(i, j) * b[j];
+            }
+            b[i] = acc;
+        }
+
+        // Ux = y
+        for (size_t i = n; i-- > 0;)
+        {
+            T acc = b[i];
+            for (size_t j = i + 1; j < n; j++)
+            {
+                acc -= factors.get_index(i, j) * b[j];
+            }
+            b[i] = acc / factors.get_index(i, i);
+        }
+    }
+
+    /// @brief Solves `A^T x = b` by forward and back substitution, where `A` is the factored matrix
+    /// @tparam T The type of the contained `Matrix<T>` data
+    /// @param b The `size()` values of the right hand side, which are overwritten with the solution `x`
+    template<typename T>
+    void LU<T>::solve_transpose(T* b) const noexcept
+    {
+        size_t n = pivots.size();
+
+        // U^T w = b
+        for (size_t i = 0; i < n; i++)
+        {
+            T acc = b[i];
+            for (size_t j = 0; j < i; j++)
+            {
+                acc -= factors.get_index(j, i) * b[j];
+            }
+            b[i] = acc / factors.get_index(i, i);
+        }
+
+        // L^T z = w
+        for (size_t i = n; i-- > 1;)
+        {
+            T acc = b[i - 1];
+            for (size_t j = i; j < n; j++)
+            {
+                acc -= factors.get_index(j, i - 1) * b[j];
+            }
+            b[i - 1] = acc;
+        }
+
+        // x = P^T z, undoing the row swaps in reverse order
+        for (size_t k = n; k-- > 0;)
+        {
+            if (pivots[k] != k)
+            {
+                T stor = b[k];
+                b[k] = b[pivots[k]];
+                b[pivots[k]] = stor;
+            }
+        }
+    }
+
+    /// @brief Solves `Ax = b` by forward and back substitution, where `A` is the factored matrix
+    /// @tparam T The type of the contained `Matrix<T>` data
+    /// @param b The right hand side
+    /// @param x A vector to write the solution to. Resized to `size()` if needed.
+    template<typename T>
+    void LU<T>::solve(const std::vector<T>& b, std::vector<T>& x) const
+    {
+        x = b;
+        x.resize(pivots.size());
+        solve(x.data());
+    }
+
+    /// @brief A sparse matrix in compressed sparse column (CSC) form. Only the entries in its sparsity 
+    /// pattern are stored, column by column, with ascending row indices within each column. The CSC 
+    /// form of a matrix's transpose is the compressed sparse row (CSR) form of the matrix itself.
+    /// @tparam T The type of the contained `SparseMatrix<T>` data
+    template<typename T>
+    class SparseMatrix
+    {
+    protected:
+        size_t rows;
+        size_t cols;
+        std::vector<size_t> col_start;
+        std::vector<size_t> row_index;
+        std::vector<T> vals;
+
+    public:
+        // Constructors
+        SparseMatrix();
+        SparseMatrix(size_t rows, size_t cols, std::vector<size_t> col_start, std::vector<size_t> row_index);
+
+        // Pseudo-constructors
+        static SparseMatrix<T> from_triplets(size_t rows, size_t cols, const std::vector<size_t>& i, const std::vector<size_t>& j, const std::vector<T>& values);
+        static SparseMatrix<T> from_dense(const Matrix<T>& dense);
+        SparseMatrix<T> transpose() const;
+        Matrix<T> to_dense() const;
+
+        // Getters and setters
+        inline size_t get_rows() const;
+        inline size_t get_cols() const;
+        inline size_t get_nonzero_count() const;
+        inline const std::vector<size_t>& get_col_start() const;
+        inline const std::vector<size_t>& get_row_index() const;
+        inline const std::vector<T>& get_values() const;
+        inline std::vector<T>& get_values_ref();
+        T get_index(size_t i, size_t j) const;
+        T& get_index_ref(size_t i, size_t j);
+        bool try_find(size_t i, size_t j, size_t& k) const;
+
+        // Methods
+        void multiply(const T* x, T* y) const;
+        void multiply_transpose(const T* x, T* y) const;
+    };
+
+    /// @brief Creates an empty `0` by `0` `SparseMatrix<T>`
+    /// @tparam T The type of the contained `SparseMatrix<T>` data
+    template<typename T>
+    SparseMatrix<T>::SparseMatrix(): rows(0), cols(0), col_start(1, 0) {}
+
+    /// @brief Creates a `SparseMatrix<T>` with the given sparsity pattern, with every entry in it set to zero
+    /// @tparam T The type of the contained `SparseMatrix<T>` data
+    /// @param rows The number of rows the matrix should have
+    /// @param cols The number of columns the matrix should have
+    /// @param col_start The position in `row_index` at which each column starts, followed by `row_index.size()`
+    /// @param row_index The row of each entry, ascending within each column
+    template<typename T>
+    SparseMatrix<T>::SparseMatrix(size_t rows, size_t cols, std::vector<size_t> col_start, std::vector<size_t> row_index): 
+        rows(rows), cols(cols), col_start(col_start), row_index(row_index)
+    {
+        if (col_start.size() != cols + 1 || col_start.back() != row_index.size())
+        {
+            throw std::invalid_argument("column starts do not match the row indices");
+        }
+
+        for (size_t j = 0; j < cols; j++)
+        {
+            for (size_t p = col_start[j]; p < col_start[j + 1]; p++)
+            {
+                if (row_index[p] >= rows || (p > col_start[j] && row_index[p] <= row_index[p - 1]))
+                {
+                    throw std::invalid_argument("row indices must be in range and ascending within each column");
+                }
+            }
+        }
+
+        vals = std::vector<T>(row_index.size(), (T)0);
+    }
+
+    /// @brief Creates a new `SparseMatrix<T>` from a list of entries. Values given for the same entry are summed.
+    /// @tparam T The type of the contained `SparseMatrix<T>` data
+    /// @param rows The number of rows the matrix should have
+    /// @param cols The number of columns the matrix should have
+    /// @param i The row of each entry
+    /// @param j The column of each entry
+    /// @param values The value of each entry
+    /// @return A new `SparseMatrix<T>` whose sparsity pattern is the given entries
+    template<typename T>
+    SparseMatrix<T> SparseMatrix<T>::from_triplets(size_t rows, size_t cols, const std::vector<size_t>& i, const std::vector<size_t>& j, const std::vector<T>& values)
+    {
+        if (i.size() != j.size() || i.size() != values.size())
+        {
+            throw std::invalid_argument("every entry needs a row, a column and a value");
+        }
+
+        std::vector<size_t> order(i.size());
+        for (size_t k = 0; k < order.size(); k++)
+        {
+            if (i[k] >= rows || j[k] >= cols)
+            {
+                throw std::invalid_argument("entry is outside the matrix");
+            }
+            order[k] = k;
+        }
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            return j[a] != j[b] ? j[a] < j[b] : i[a] < i[b];
+        });
+
+        SparseMatrix<T> res;
+        res.rows = rows;
+        res.cols = cols;
+        res.col_start = std::vector<size_t>(cols + 1, 0);
+        for (size_t k: order)
+        {
+            if (!res.row_index.empty() && res.col_start[j[k] + 1] != 0 && res.row_index.back() == i[k])
+            {
+                res.vals.back() += values[k];
+                continue;
+            }
+            res.row_index.push_back(i[k]);
+            res.vals.push_back(values[k]);
+            res.col_start[j[k] + 1]++;
+        }
+        for (size_t c = 0; c < cols; c++)
+        {
+            res.col_start[c + 1] += res.col_start[c];
+        }
+        return res;
+    }
+
+    /// @brief Creates a new `SparseMatrix<T>` from the nonzero elements of a `Matrix<T>`
+    /// @tparam T The type of the contained `SparseMatrix<T>` data
+    /// @param dense The matrix to compress
+    /// @return A new `SparseMatrix<T>` with the same values
+    template<typename T>
+    SparseMatrix<T> SparseMatrix<T>::from_dense(const Matrix<T>& dense)
+    {
+        SparseMatrix<T> res;
+        res.rows = dense.get_rows();
+        res.cols = dense.get_cols();
+        res.col_start.clear();
+        for (size_t j = 0; j < res.cols; j++)
+        {
+            res.col_start.push_back(res.row_index.size());
+            for (size_t i = 0; i < res.rows; i++)
+            {
+                if (dense.get_index(i, j) != (T)0)
+                {
+                    res.row_index.push_back(i);
+                    res.vals.push_back(dense.get_index(i, j));
+                }
+            }
+        }
+        res.col_start.push_back(res.row_index.size());
+        return res;
+    }
+
+    /// @brief Creates the transpose of this `SparseMatrix<T>`, which is also this matrix in CSR form
+    /// @tparam T The type of the contained `SparseMatrix<T>` data
+    /// @return A new `SparseMatrix<T>` with the rows and columns of this one swapped
+    template<typename T>
+    SparseMatrix<T> SparseMatrix<T>::transpose() const
+    {
+        SparseMatrix<T> res;
+        res.rows = cols;
+        res.cols = rows;
+        res.col_start = std::vector<size_t>(rows + 1, 0);
+        res.row_index = std::vector<size_t>(row_index.size());
+        res.vals = std::vector<T>(vals.size());
+
+        for (size_t p = 0; p < row_index.size(); p++)
+        {
+            res.col_start[row_index[p] + 1]++;
+        }
+        for (size_t i = 0; i < rows; i++)
+        {
+            res.col_start[i + 1] += res.col_start[i];
+        }
+
+        std::vector<size_t> next(res.col_start.begin(), res.col_start.end() - 1);
+        for (size_t j = 0; j < cols; j++)
+        {
+            for (size_t p = col_start[j]; p < col_start[j + 1]; p++)
+            {
+                size_t q = next[row_index[p]]++;
+                res.row_index[q] = j;
+                res.vals[q] = vals[p];
+            }
+        }
+        return res;
+    }
+
+    /// @brief Creates a dense `Matrix<T>` with the same values as this `SparseMatrix<T>`
+    /// @tparam T The type of the contained `SparseMatrix<T>` data
+    /// @return A new `Matrix<T>`, zero outside the sparsity pattern
+    template<typename T>
+    Matrix<T> SparseMatrix<T>::to_dense() const
+    {
+        Matrix<T> res(rows, cols);
+        for (size_t j = 0; j < cols; j++)
+        {
+            for (size_t p = col_start[j]; p < col_start[j + 1]; p++)
+            {
+                res.get_index_ref(row_index[p], j) = vals[p];
+            }
+        }
+        return res;
+    }
+
+    /// @brief Returns the number of rows in the `SparseMatrix<T>`
+    template<typename T>
+    inline size_t SparseMatrix<T>::get_rows() const
+    {
+        return rows;
+    }
+
+    /// @brief Returns the number of columns in the `SparseMatrix<T>`
+    template<typename T>
+    inline size_t SparseMatrix<T>::get_cols() const
+    {
+        return cols;
+    }
+
+    /// @brief Returns the number of entries in the sparsity pattern of the `SparseMatrix<T>`
+    template<typename T>
+    inline size_t SparseMatrix<T>::get_nonzero_count() const
+    {
+        return row_index.size();
+    }
+
+    /// @brief Returns the position in the row indices and values at which each column starts, followed by the number of entries
+    template<typename T>
+    inline const std::vector<size_t>& SparseMatrix<T>::get_col_start() const
+    {
+        return col_start;
+    }
+
+    /// @brief Returns the row of each entry, ascending within each column
+    template<typename T>
+    inline const std::vector<size_t>& SparseMatrix<T>::get_row_index() const
+    {
+        return row_index;
+    }
+
+    /// @brief Returns the value of each entry, in the same order as `get_row_index()`
+    template<typename T>
+    inline const std::vector<T>& SparseMatrix<T>::get_values() const
+    {
+        return vals;
+    }
+
+    /// @brief Returns a reference to the value of each entry, in the same order as `get_row_index()`
+    template<typename T>
+    inline std::vector<T>& SparseMatrix<T>::get_values_ref()
+    {
+        return vals;
+    }
+
+    /// @brief Returns the value stored at the `i`th row and `j`th column of the `SparseMatrix<T>`
+    /// @tparam T The type of the contained `SparseMatrix<T>` data
+    /// @param i The row to be accessed
+    /// @param j The column to be accessed
+    /// @returns The value stored at the given index, or zero if it is outside the sparsity pattern
+    template<typename T>
+    T SparseMatrix<T>::get_index(size_t i, size_t j) const
+    {
+        size_t k;
+        return try_find(i, j, k) ? vals[k] : (T)0;
+    }
+
+    /// @brief Returns a reference to the value stored at the `i`th row and `j`th column of the `SparseMatrix<T>`. 
+    /// Throws `std::out_of_range` if the index is outside the sparsity pattern.
+    /// @tparam T The type of the contained `SparseMatrix<T>` data
+    /// @param i The row to be accessed
+    /// @param j The column to be accessed
+    /// @returns A reference to the value stored at the given index
+    template<typename T>
+    T& SparseMatrix<T>::get_index_ref(size_t i, size_t j)
+    {
+        size_t k;
+        if (!try_find(i, j, k))
+        {
+            throw std::out_of_range("entry is outside the sparsity pattern");
+        }
+        return vals[k];
+    }
+
+    /// @brief Tries to find the position of an entry in the sparsity pattern
+    /// @tparam T The type of the contained `SparseMatrix<T>` data
+    /// @param i The row of the entry
+    /// @param j The column of the entry
+    /// @param k Set to the position of the entry in `get_values()` if it is found
+    /// @returns A bool indicating if the entry is in the sparsity pattern
+    template<typename T>
+    bool SparseMatrix<T>::try_find(size_t i, size_t j, size_t& k) const
+    {
+        if (j >= cols)
+        {
+            return false;
+        }
+
+        auto first = row_index.begin() + col_start[j];
+        auto last = row_index.begin() + col_start[j + 1];
+        auto p = std::lower_bound(first, last, i);
+        if (p == last || *p != i)
+        {
+            return false;
+        }
+
+        k = p - row_index.begin();
+        return true;
+    }
+
+    /// @brief Computes the matrix-vector product `y = Ax`
+    /// @tparam T The type of the contained `SparseMatrix<T>` data
+    /// @param x The `get_cols()` values to multiply by
+    /// @param y The `get_rows()` values to write the product to
+    template<typename T>
+    void SparseMatrix<T>::multiply(const T* x, T* y) const
+    {
+        for (size_t i = 0; i < rows; i++)
+        {
+            y[i] = (T)0;
+        }
+
+        for (size_t j = 0; j < cols; j++)
+        {
+            for (size_t p = col_start[j]; p < col_start[j + 1]; p++)
+            {
+                y[row_index[p]] += vals[p] * x[j];
+            }
+        }
+    }
+
+    /// @brief Computes the matrix-vector product `y = A^T x`
+    /// @tparam T The type of the contained `SparseMatrix<T>` data
+    /// @param x The `get_rows()` values to multiply by
+    /// @param y The `get_cols()` values to write the product to
+    template<typename T>
+    void SparseMatrix<T>::multiply_transpose(const T* x, T* y) const
+    {
+        for (size_t j = 0; j < cols; j++)
+        {
+            T acc = (T)0;
+            for (size_t p = col_start[j]; p < col_start[j + 1]; p++)
+            {
+                acc += vals[p] * x[row_index[p]];
+            }
+            y[j] = acc;
+        }
+    }
+
+    /// @brief The LU decomposition of a square `SparseMatrix<T>` with its columns reordered to reduce 
+    /// fill and its rows partially pivoted, i.e. `PAQ = LU`. The column order is found by a symbolic 
+    /// analysis of the sparsity pattern, which is reused by every later factorization of a matrix with 
+    /// the same pattern, as are the factors' buffers.
+    /// @tparam T The type of the contained `SparseMatrix<T>` data
+    template<typename T>
+    class SparseLU
+    {
+    private:
+        static constexpr size_t NONE = (size_t)-1;
+
+        size_t n;
+        std::vector<size_t> order; // Column `k` of `AQ` is column `order[k]` of `A`
+        std::vector<size_t> pinv;  // Row `i` of `A` is row `pinv[i]` of `PA`
+
+        // L (with its unit diagonal first in each column) and U (with its diagonal last) in CSC form
+        std::vector<size_t> l_start;
+        std::vector<size_t> l_index;
+        std::vector<T> l_vals;
+        std::vector<size_t> u_start;
+        std::vector<size_t> u_index;
+        std::vector<T> u_vals;
+
+        // Workspace
+        std::vector<T> work;
+        std::vector<size_t> reach;
+        std::vector<size_t> path;
+        std::vector<size_t> mark;
+        size_t stamp;
+        bool factored;
+        size_t factored_nonzeros;
+
+        static void eliminate(T* work, const size_t* index, const T* vals, size_t first, size_t last, T x);
+        size_t find_reach(const SparseMatrix<T>& matrix, size_t col);
+        bool try_refactor(const SparseMatrix<T>& matrix);
+
+    public:
+        /// @brief Columns are only pivoted away from the diagonal of `AQ` if it is smaller than this fraction of the column's largest candidate
+        static constexpr double PIVOT_TOLERANCE = 0.1;
+
+        // Constructors
+        SparseLU();
+
+        // Getters
+        size_t size() const;
+        size_t get_nonzero_count() const;
+        const std::vector<size_t>& get_column_order() const;
+
+        // Methods
+        void analyze(const SparseMatrix<T>& pattern);
+        bool try_factor(const SparseMatrix<T>& matrix);
+        void solve(T* b);
+        void solve_transpose(T* b);
+    };
+
+    /// @brief Creates an empty `SparseLU<T>`, to be filled in by `analyze` and `try_factor`
+    /// @tparam T The type of the contained `SparseMatrix<T>` data
+    template<typename T>
+    SparseLU<T>::SparseLU(): n(0), l_start(1, 0), u_start(1, 0), stamp(0), factored(false), factored_nonzeros(0) {}
+
+    /// @brief Returns the number of rows and columns of the factored matrix
+    template<typename T>
+    size_t SparseLU<T>::size() const
+    {
+        return n;
+    }
+
+    /// @brief Returns the number of entries stored in `L` and `U` together, a measure of the fill the column order produced
+    template<typename T>
+    size_t SparseLU<T>::get_nonzero_count() const
+    {
+        return l_index.size() + u_index.size();
+    }
+
+    /// @brief Returns the column order found by `analyze`. Column `k` of `AQ` is column `get_column_order()[k]` of `A`.
+    template<typename T>
+    const std::vector<size_t>& SparseLU<T>::get_column_order() const
+    {
+        return order;
+    }
+
+    /// @brief Finds a fill-reducing column order for matrices with the given sparsity pattern, by
+    /// minimum degree. If every diagonal entry is in the pattern, as in most jacobians, the diagonal
+    /// is expected to be pivoted on and the graph of `A + A^T` is ordered. Otherwise the graph of 
+    /// `A^T A` is, whose fill bounds the fill of `L` and `U` whichever rows are chosen as pivots. 
+    /// Rows with too many entries to be useful in that graph are set aside, as COLAMD does.
+    /// @tparam T The type of the contained `SparseMatrix<T>` data
+    /// @param pattern A matrix with the sparsity pattern of the matrices that will be factored
+    template<typename T>
+    void SparseLU<T>::analyze(const SparseMatrix<T>& pattern)
+    {
+        n = pattern.get_cols();
+        if (pattern.get_rows() != n)
+        {
+            throw std::invalid_argument("only square matrices can be factored");
+        }
+
+        const std::vector<size_t>& col_start = pattern.get_col_start();
+        const std::vector<size_t>& row_index = pattern.get_row_index();
+
+        std::vector<std::vector<size_t>> adjacent(n);
+        bool diagonal = true;
+        for (size_t j = 0; j < n; j++)
+        {
+            size_t k;
+            diagonal = diagonal && pattern.try_find(j, j, k);
+        }
+
+        if (diagonal)
+        {
+            // Columns are adjacent if either has an entry in the other's row
+            for (size_t j = 0; j < n; j++)
+            {
+                for (size_t p = col_start[j]; p < col_start[j + 1]; p++)
+                {
+                    size_t i = row_index[p];
+                    if (i != j)
+                    {
+                        adjacent[i].push_back(j);
+                        adjacent[j].push_back(i);
+                    }
+                }
+            }
+        }
+        else
+        {
+            std::vector<std::vector<size_t>> row_cols(n);
+            for (size_t j = 0; j < n; j++)
+            {
+                for (size_t p = col_start[j]; p < col_start[j + 1]; p++)
+                {
+                    row_cols[row_index[p]].push_back(j);
+                }
+            }
+
+            // Columns are adjacent if a row has entries in both
+            size_t dense = std::max<size_t>(16, (size_t)(10.0 * std::sqrt((double)n)));
+            for (auto& cols: row_cols)
+            {
+                if (cols.size() > dense)
+                {
+                    continue;
+                }
+                for (size_t a: cols)
+                {
+                    for (size_t b: cols)
+                    {
+                        if (a != b)
+                        {
+                            adjacent[a].push_back(b);
+                        }
+                    }
+                }
+            }
+        }
+
+        std::set<std::pair<size_t, size_t>> queue;
+        for (size_t j = 0; j < n; j++)
+        {
+            std::sort(adjacent[j].begin(), adjacent[j].end());
+            adjacent[j].erase(std::unique(adjacent[j].begin(), adjacent[j].end()), adjacent[j].end());
+            queue.insert({adjacent[j].size(), j});
+        }
+
+        // Eliminating a column joins its neighbours into a clique, so take the one with fewest neighbours each time
+        order.clear();
+        std::vector<size_t> merged;
+        while (!queue.empty())
+        {
+            size_t v = queue.begin()->second;
+            queue.erase(queue.begin());
+            order.push_back(v);
+
+            for (size_t u: adjacent[v])
+            {
+                queue.erase({adjacent[u].size(), u});
+                merged.clear();
+                std::set_union(adjacent[u].begin(), adjacent[u].end(), adjacent[v].begin(), adjacent[v].end(), std::back_inserter(merged));
+                merged.erase(std::remove_if(merged.begin(), merged.end(), [&](size_t w) { return w == u || w == v; }), merged.end());
+                adjacent[u].swap(merged);
+                queue.insert({adjacent[u].size(), u});
+            }
+            std::vector<size_t>().swap(adjacent[v]);
+        }
+
+        pinv.assign(n, NONE);
+        work.assign(n, (T)0);
+        reach.assign(n, 0);
+        path.assign(n, 0);
+        mark.assign(n, 0);
+        stamp = 0;
+        factored = false;
+
+        l_start.assign(n + 1, 0);
+        u_start.assign(n + 1, 0);
+        l_index.clear();
+        l_vals.clear();
+        u_index.clear();
+        u_vals.clear();
+        l_index.reserve(2 * pattern.get_nonzero_count() + n);
+        l_vals.reserve(2 * pattern.get_nonzero_count() + n);
+        u_index.reserve(2 * pattern.get_nonzero_count() + n);
+        u_vals.reserve(2 * pattern.get_nonzero_count() + n);
+    }
+
+    /// @brief Helper function for `try_factor` and `solve`. Subtracts `x` times the entries `first` to `last` of a 
+    /// column of `L` or `U` from `work`. Taking raw pointers lets the compiler keep them in registers across 
+    /// the scattered stores, which it cannot do through the members.
+    template<typename T>
+    inline void SparseLU<T>::eliminate(T* work, const size_t* index, const T* vals, size_t first, size_t last, T x)
+    {
+        for (size_t q = first; q < last; q++)
+        {
+            work[index[q]] -= vals[q] * x;
+        }
+    }
+
+    /// @brief Helper function for `try_factor`. Finds the rows of `L^-1 A(:, col)` that may be nonzero with a 
+    /// depth-first search through the columns of `L` found so far, in topological order.
+    /// @return The position in `reach` at which the rows start. They run to its end.
+    template<typename T>
+    size_t SparseLU<T>::find_reach(const SparseMatrix<T>& matrix, size_t col)
+    {
+        const std::vector<size_t>& col_start = matrix.get_col_start();
+        const std::vector<size_t>& row_index = matrix.get_row_index();
+        size_t top = n;
+        stamp++;
+
+        for (size_t p = col_start[col]; p < col_start[col + 1]; p++)
+        {
+            if (mark[row_index[p]] == stamp)
+            {
+                continue;
+            }
+
+            // `reach` holds the search path from its start, and the finished rows from its end
+            size_t head = 0;
+            reach[0] = row_index[p];
+            while (true)
+            {
+                size_t j = reach[head];
+                size_t jcol = pinv[j];
+                if (mark[j] != stamp)
+                {
+                    mark[j] = stamp;
+                    path[head] = jcol == NONE ? 0 : l_start[jcol] + 1;
+                }
+
+                bool done = true;
+                size_t stop = jcol == NONE ? 0 : l_start[jcol + 1];
+                for (size_t q = path[head]; q < stop; q++)
+                {
+                    size_t i = l_index[q];
+                    if (mark[i] == stamp)
+                    {
+                        continue;
+                    }
+                    path[head] = q + 1;
+                    reach[++head] = i;
+                    done = false;
+                    break;
+                }
+
+                if (done)
+                {
+                    reach[--top] = j;
+                    if (head == 0)
+                    {
+                        break;
+                    }
+                    head--;
+                }
+            }
+        }
+        return top;
+    }
+
+    /// @brief Helper function for `try_factor`. Refactors a matrix with the pattern of the last one factored,
+    /// reusing its row pivots and the structure of its `L` and `U` so that no search is needed. Fails, 
+    /// leaving the factorization unusable, if a pivot is no longer within `PIVOT_TOLERANCE` of its column's largest candidate.
+    template<typename T>
+    bool SparseLU<T>::try_refactor(const SparseMatrix<T>& matrix)
+    {
+        const std::vector<size_t>& col_start = matrix.get_col_start();
+        const std::vector<size_t>& row_index = matrix.get_row_index();
+        const std::vector<T>& vals = matrix.get_values();
+
+        for (size_t k = 0; k < n; k++)
+        {
+            size_t col = order[k];
+            for (size_t p = col_start[col]; p < col_start[col + 1]; p++)
+            {
+                work[pinv[row_index[p]]] = vals[p];
+            }
+
+            // The rows of U are stored in the order the triangular solve visits them
+            for (size_t p = u_start[k]; p + 1 < u_start[k + 1]; p++)
+            {
+                size_t j = u_index[p];
+                T x = work[j];
+                u_vals[p] = x;
+                work[j] = (T)0;
+                eliminate(work.data(), l_index.data(), l_vals.data(), l_start[j] + 1, l_start[j + 1], x);
+            }
+
+            T pivot = work[k];
+            work[k] = (T)0;
+            T largest = std::abs(pivot);
+            for (size_t q = l_start[k] + 1; q < l_start[k + 1]; q++)
+            {
+                largest = std::max(largest, std::abs(work[l_index[q]]));
+            }
+
+            bool stable = largest > (T)0 && std::abs(pivot) >= PIVOT_TOLERANCE * largest;
+            u_vals[u_start[k + 1] - 1] = pivot;
+            for (size_t q = l_start[k] + 1; q < l_start[k + 1]; q++)
+            {
+                l_vals[q] = stable ? work[l_index[q]] / pivot : (T)0;
+                work[l_index[q]] = (T)0;
+            }
+
+            if (!stable)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// @brief Tries to factor the given matrix, returning a boolean indicating if the operation was 
+    /// successful. Fails if the matrix is singular, in which case the decomposition must not be used 
+    /// until a later call succeeds. Runs `analyze` first if the matrix is not the size of the last analysis.
+    /// After a successful call, the next matrix is first refactored with the same pivots, and only 
+    /// searched for new ones if that would be unstable.
+    /// @tparam T The type of the contained `SparseMatrix<T>` data
+    /// @param matrix The matrix to factor, with the sparsity pattern given to `analyze`
+    /// @returns A bool indicating if factoring was successful
+    template<typename T>
+    bool SparseLU<T>::try_factor(const SparseMatrix<T>& matrix)
+    {
+        if (matrix.get_rows() != matrix.get_cols())
+        {
+            return false;
+        }
+
+        if (matrix.get_cols() != n || order.size() != n)
+        {
+            analyze(matrix);
+        }
+        else if (factored && matrix.get_nonzero_count() == factored_nonzeros && try_refactor(matrix))
+        {
+            return true;
+        }
+        factored = false;
+
+        const std::vector<size_t>& col_start = matrix.get_col_start();
+        const std::vector<size_t>& row_index = matrix.get_row_index();
+        const std::vector<T>& vals = matrix.get_values();
+
+        std::fill(pinv.begin(), pinv.end(), NONE);
+        l_index.clear();
+        l_vals.clear();
+        u_index.clear();
+        u_vals.clear();
+
+        for (size_t k = 0; k < n; k++)
+        {
+            l_start[k] = l_index.size();
+            u_start[k] = u_index.size();
+            size_t col = order[k];
+
+            // Solve L x = A(:, col) over the rows it can reach
+            size_t top = find_reach(matrix, col);
+            for (size_t p = col_start[col]; p < col_start[col + 1]; p++)
+            {
+                work[row_index[p]] = vals[p];
+            }
+            for (size_t p = top; p < n; p++)
+            {
+                size_t j = reach[p];
+                size_t jcol = pinv[j];
+                if (jcol == NONE)
+                {
+                    continue;
+                }
+                eliminate(work.data(), l_index.data(), l_vals.data(), l_start[jcol] + 1, l_start[jcol + 1], work[j]);
+            }
+
+            // Rows already pivoted on belong to U, the largest of the others becomes the pivot
+            size_t pivot_row = NONE;
+            T largest = (T)-1;
+            for (size_t p = top; p < n; p++)
+            {
+                size_t i = reach[p];
+                if (pinv[i] == NONE)
+                {
+                    if (std::abs(work[i]) > largest)
+                    {
+                        largest = std::abs(work[i]);
+                        pivot_row = i;
+                    }
+                }
+                else
+                {
+                    u_index.push_back(pinv[i]);
+                    u_vals.push_back(work[i]);
+                }
+            }
+
+            if (pivot_row == NONE || !(largest > (T)0))
+            {
+                for (size_t p = top; p < n; p++)
+                {
+                    work[reach[p]] = (T)0;
+                }
+                return false;
+            }
+
+            // Prefer the diagonal, which keeps the fill close to what the column order predicted
+            if (pinv[col] == NONE && mark[col] == stamp && std::abs(work[col]) >= PIVOT_TOLERANCE * largest)
+            {
+                pivot_row = col;
+            }
+
+            T pivot = work[pivot_row];
+            u_index.push_back(k);
+            u_vals.push_back(pivot);
+            pinv[pivot_row] = k;
+            l_index.push_back(pivot_row);
+            l_vals.push_back((T)1);
+
+            for (size_t p = top; p < n; p++)
+            {
+                size_t i = reach[p];
+                if (pinv[i] == NONE)
+                {
+                    l_index.push_back(i);
+                    l_vals.push_back(work[i] / pivot);
+                }
+                work[i] = (T)0;
+            }
+        }
+
+        l_start[n] = l_index.size();
+        u_start[n] = u_index.size();
+        for (size_t& i: l_index)
+        {
+            i = pinv[i];
+        }
+        factored = true;
+        factored_nonzeros = matrix.get_nonzero_count();
+        return true;
+    }
+
+    /// @brief Solves `Ax = b`, where `A` is the factored matrix
+    /// @tparam T The type of the contained `SparseMatrix<T>` data
+    /// @param b The `size()` values of the right hand side, which are overwritten with the solution `x`
+    template<typename T>
+    void SparseLU<T>::solve(T* b)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            work[pinv[i]] = b[i];
+        }
+
+        // Ly = Pb
+        for (size_t k = 0; k < n; k++)
+        {
+            eliminate(work.data(), l_index.data(), l_vals.data(), l_start[k] + 1, l_start[k + 1], work[k]);
+        }
+
+        // U(Q^T x) = y
+        for (size_t k = n; k-- > 0;)
+        {
+            work[k] /= u_vals[u_start[k + 1] - 1];
+            eliminate(work.data(), u_index.data(), u_vals.data(), u_start[k], u_start[k + 1] - 1, work[k]);
+        }
+
+        for (size_t k = 0; k < n; k++)
+        {
+            b[order[k]] = work[k];
+            work[k] = (T)0;
+        }
+    }
+
+    /// @brief Solves `A^T x = b`, where `A` is the factored matrix
+    /// @tparam T The type of the contained `SparseMatrix<T>` data
+    /// @param b The `size()` values of the right hand side, which are overwritten with the solution `x`
+    template<typename T>
+    void SparseLU<T>::solve_transpose(T* b)
+    {
+        for (size_t k = 0; k < n; k++)
+        {
+            work[k] = b[order[k]];
+        }
+
+        // U^T z = Q^T b
+        for (size_t k = 0; k < n; k++)
+        {
+            T acc = work[k];
+            for (size_t p = u_start[k]; p + 1 < u_start[k + 1]; p++)
+            {
+                acc -= u_vals[p] * work[u_index[p]];
+            }
+            work[k] = acc / u_vals[u_start[k + 1] - 1];
+        }
+
+        // L^T (Px) = z
+        for (size_t k = n; k-- > 0;)
+        {
+            T acc = work[k];
+            for (size_t p = l_start[k] + 1; p < l_start[k + 1]; p++)
+            {
+                acc -= l_vals[p] * work[l_index[p]];
+            }
+            work[k] = acc;
+        }
+
+        for (size_t i = 0; i < n; i++)
+        {
+            b[i] = work[pinv[i]];
+        }
+        for (size_t k = 0; k < n; k++)
+        {
+            work[k] = (T)0;
+        }
+    }
 }
 #endif
\ No newline at end of file
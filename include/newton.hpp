@@ -1,29 +1,510 @@
 #ifndef _NEWTON_HPP
 #define _NEWTON_HPP
 
-#include "matrix.hpp"
-#include "shunting.hpp" // also includes "context.hpp", "variable.hpp"
+#include "decompose.hpp"
+#include "jacobian.hpp" // also includes "matrix.hpp", "expression.hpp", "compiled.hpp", "shunting.hpp", "context.hpp", "variable.hpp"
+#include "presolve.hpp" // also includes "interval.hpp"
 
 namespace nexsys 
 {
-    /// @brief A constant used by `nexsys` newton-raphson solver functions. It represents the quantity represented by 'dx' in calculus.
-    constexpr double DX = 0.0001;
+    /// @brief How a `NewtonSolver` keeps its jacobian up to date between iterations
+    enum JacobianUpdate
+    {
+        /// @brief Evaluate and factor a fresh jacobian every iteration
+        Recompute,
 
-    /// @brief Finds the root of a function of a single unknown variable.
+        /// @brief Evaluate and factor a jacobian, then apply Broyden's "good" rank-one update to 
+        /// its factorization after each step. A fresh jacobian is evaluated whenever the residual 
+        /// fails to shrink by `BROYDEN_STALL`, or after `BROYDEN_UPDATES` consecutive updates.
+        Broyden,
+    };
+
+    /// @brief How a `NewtonSolver` chooses each step. `Dogleg` and `LevenbergMarquardt` are trust region
+    /// methods: a step is only taken if it reduces the residual norm by a fair share of what the
+    /// jacobian predicted, and rejected steps are retried shorter and closer to steepest descent.
+    enum StepControl
+    {
+        /// @brief Take the full newton step every iteration
+        FullStep,
+
+        /// @brief Step to where Powell's dogleg path, from the steepest descent (Cauchy) point to the
+        /// newton step, leaves a trust region. The region grows after steps the jacobian predicted well
+        /// and shrinks after poor ones.
+        Dogleg,
+
+        /// @brief Solve `(J^T J + lambda I) step = J^T f` for each step. `lambda` shrinks after steps the
+        /// jacobian predicted well, approaching the newton step, and grows after rejected ones,
+        /// approaching a short steepest descent step.
+        LevenbergMarquardt,
+    };
+
+    /// @brief The smallest fraction of its predicted reduction in the residual norm that a trust region step must achieve to be taken
+    constexpr double TRUST_ACCEPT = 0.0001;
+
+    /// @brief The initial `LevenbergMarquardt` damping, relative to the largest diagonal entry of `J^T J`
+    constexpr double TRUST_LAMBDA = 0.001;
+
+    /// @brief The fraction of the previous residual norm a `Broyden` step must at least reduce the residual to
+    constexpr double BROYDEN_STALL = 0.9;
+
+    /// @brief The maximum number of rank-one updates applied to a factored jacobian before it is refreshed
+    constexpr size_t BROYDEN_UPDATES = 16;
+
+    /// @brief The fewest unknowns a system must have for `NewtonSolver` to store and factor its jacobian as a sparse matrix
+    constexpr size_t SPARSE_MIN_SIZE = 32;
+
+    /// @brief The largest fraction of a system's jacobian that may be structurally nonzero for `NewtonSolver` to store and factor it as a sparse matrix
+    constexpr double SPARSE_DENSITY = 0.1;
+
+    /// @brief The fewest unknowns a system must have for `NewtonSolver` to split its evaluation across a `ThreadPool` by default
+    constexpr size_t PARALLEL_MIN_SIZE = 512;
+
+    /// @brief Solves a system of compiled expressions with Newton's method. Everything an
+    /// iteration needs (the residual, the jacobian and its factorization, the step and the iterate)
+    /// is allocated once by the constructor, so repeated calls to `solve` do not allocate. Large,
+    /// sparse systems (see `SPARSE_MIN_SIZE` and `SPARSE_DENSITY`) store their jacobian as a 
+    /// `SparseMatrix<double>` and factor it with a `SparseLU<double>` analyzed once, up front.
+    /// The unknowns are the first `size()` slots. Any later slots the system reads are parameters, 
+    /// held at the values given in the guess. Systems of at least `get_parallel_threshold()` unknowns
+    /// evaluate their residual one expression at a time, and their jacobian, across a `ThreadPool`;
+    /// the iterates are identical, bit for bit, whatever the size of the pool.
+    class NewtonSolver
+    {
+    private:
+        std::vector<CompiledExpression> system;
+        CompiledSystem fused;
+        JacobianMode mode;
+        SymbolicJacobian exact;
+        DualJacobian automatic;
+        ColoredJacobian colored;
+        bool colors;
+        bool sparse;
+        ThreadPool* pool;
+        size_t parallel_threshold;
+
+        // Workspace, sized to the system once
+        std::vector<double> x;
+        std::vector<double> error;
+        Matrix<double> jacobian;
+        LU<double> factorization;
+        SparseMatrix<double> sparse_jacobian;
+        SparseLU<double> sparse_factorization;
+        std::vector<double> step;
+        size_t iterations;
+        size_t evaluations;
+        size_t jacobians;
+
+        // Broyden workspace. The inverse jacobian is `LU^-1 + sum(left[k] * right[k]^T)` over the updates so far.
+        std::vector<double> previous;
+        std::vector<double> scratch;
+        std::vector<double> left;
+        std::vector<double> right;
+        size_t updates;
+
+        // Trust region workspace. The normal matrix `J^T J` is only prepared for `LevenbergMarquardt`.
+        std::vector<double> gradient;
+        std::vector<double> newton;
+        std::vector<double> product;
+        std::vector<double> accepted;
+        std::vector<double> gram_diagonal;
+        Matrix<double> normal;
+        LU<double> normal_factorization;
+        SparseMatrix<double> sparse_normal;
+        SparseLU<double> sparse_normal_factorization;
+        std::vector<size_t> normal_diagonal;
+        std::vector<size_t> gram_start;
+        std::vector<std::pair<size_t, size_t>> gram_pairs;
+        bool normal_ready;
+
+        ThreadPool* workers() const;
+        void evaluate_residual();
+        void evaluate_jacobian();
+        bool try_factor();
+        void apply_inverse(std::vector<double>& v);
+        bool try_update(const std::vector<double>& s);
+        void multiply_jacobian(const std::vector<double>& v, std::vector<double>& out) const;
+        void multiply_jacobian_transpose(const std::vector<double>& v, std::vector<double>& out) const;
+        void prepare_normal();
+        void evaluate_gram();
+        bool try_factor_normal(double lambda);
+        void choose_dogleg_step(bool has_newton, double radius);
+        const std::vector<double>& iterate(const std::vector<Interval>* bounds, double margin, size_t limit, JacobianUpdate update, StepControl control);
+        const std::vector<double>& iterate_trust_region(const std::vector<Interval>* bounds, double margin, size_t limit, StepControl control);
+
+    public:
+        /// @brief Prepares to solve a system
+        /// @param system The `std::vector` of expressions in the system, all compiled against the same `VariableIndex`
+        /// @param mode How the jacobian of the system should be computed
+        /// @param pool The `ThreadPool` to evaluate large systems on
+        NewtonSolver(const std::vector<CompiledExpression>& system, JacobianMode mode = FiniteDifference, ThreadPool& pool = ThreadPool::shared());
+
+        /// @brief Finds the root of the system
+        /// @param guess The initial guess for the root of the system, followed by the value of any parameters, ordered by slot
+        /// @param margin The margin of error for the root
+        /// @param limit The maximum number of iterations that should be attempted in finding the root
+        /// @param update How the jacobian should be kept up to date between iterations. Must be `Recompute` for trust region steps.
+        /// @param control How each step is chosen
+        /// @return The root of the system, ordered by slot. Refers to the solver's workspace, so it is overwritten by the next call.
+        const std::vector<double>& solve(const std::vector<double>& guess, double margin, size_t limit, JacobianUpdate update = Recompute, StepControl control = FullStep);
+
+        /// @brief Finds the root of the system, clamping every iterate to `bounds`
+        /// @param guess The initial guess for the root of the system, followed by the value of any parameters, ordered by slot
+        /// @param bounds The domain of each slot. Those of parameters are ignored.
+        /// @param margin The margin of error for the root
+        /// @param limit The maximum number of iterations that should be attempted in finding the root
+        /// @param update How the jacobian should be kept up to date between iterations. Must be `Recompute` for trust region steps.
+        /// @param control How each step is chosen
+        /// @return The root of the system, ordered by slot. Refers to the solver's workspace, so it is overwritten by the next call.
+        const std::vector<double>& solve(const std::vector<double>& guess, const std::vector<Interval>& bounds, double margin, size_t limit, JacobianUpdate update = Recompute, StepControl control = FullStep);
+
+        /// @brief Provides the number of iterations taken by the last call to `solve`
+        /// @return The number of steps computed by the last solve, including the one that met the margin and any rejected trust region steps
+        size_t get_iteration_count() const;
+
+        /// @brief Provides the number of times the system was evaluated by the last call to `solve`.
+        /// Each finite difference column and each `Dual<DUAL_WIDTH>` pass counts as an evaluation,
+        /// while evaluating the compiled partial derivatives of a `Symbolic` jacobian does not.
+        /// @return The number of system evaluations made by the last solve
+        size_t get_evaluation_count() const;
+
+        /// @brief Provides the number of jacobians evaluated and factored by the last call to `solve`
+        /// @return The number of jacobians evaluated by the last solve
+        size_t get_jacobian_count() const;
+
+        /// @brief Provides if the jacobian is stored and factored as a sparse matrix
+        /// @return A bool indicating if the system is large and sparse enough to use `SparseLU<double>`
+        bool is_sparse() const;
+
+        /// @brief Sets the fewest unknowns the system must have to be evaluated across the solver's `ThreadPool`
+        /// @param threshold The parallel threshold. `0` always splits the work, while `SIZE_MAX` never does.
+        void set_parallel_threshold(size_t threshold);
+
+        /// @brief Provides the fewest unknowns the system must have to be evaluated across the solver's `ThreadPool`
+        /// @return The parallel threshold, `PARALLEL_MIN_SIZE` unless set
+        size_t get_parallel_threshold() const;
+
+        /// @brief Provides the number of unknowns in the system
+        /// @return The number of expressions in the system
+        size_t size() const;
+    };
+
+    /// @brief Solves a system one block of its `BlockDecomposition` at a time. Each block is 
+    /// recompiled as a system of its own unknowns, reading the unknowns of earlier blocks as 
+    /// parameters, and gets its own `NewtonSolver`. A system that does not decompose is solved 
+    /// as it was given.
+    class BlockSolver
+    {
+    private:
+        BlockDecomposition decomposition;
+        size_t n;
+        std::vector<NewtonSolver> solvers;
+        std::vector<std::vector<size_t>> slots; // The slot in the system of each slot of each block, its unknowns first
+
+        // Workspace, sized to the system once
+        std::vector<double> x;
+        std::vector<std::vector<double>> guesses;
+        std::vector<std::vector<Interval>> domains;
+        size_t iterations;
+        size_t evaluations;
+
+        const std::vector<double>& iterate(const std::vector<Interval>* bounds, double margin, size_t limit, JacobianUpdate update, StepControl control);
+
+    public:
+        /// @brief Decomposes a system and prepares to solve each of its blocks. Throws `std::runtime_error` if it is structurally singular.
+        /// @param system The `std::vector` of expressions in the system, all compiled against the same `VariableIndex`
+        /// @param mode How the jacobian of each block should be computed
+        /// @param pool The `ThreadPool` to evaluate large blocks on
+        BlockSolver(const std::vector<CompiledExpression>& system, JacobianMode mode = FiniteDifference, ThreadPool& pool = ThreadPool::shared());
+
+        /// @brief Finds the root of the system, solving each block to `margin` in turn
+        /// @param guess The initial guess for the root of the system, followed by the value of any parameters, ordered by slot
+        /// @param margin The margin of error for the root of each block
+        /// @param limit The maximum number of iterations that should be attempted in finding the root of each block
+        /// @param update How the jacobian of each block should be kept up to date between iterations
+        /// @param control How each step of each block is chosen
+        /// @return The root of the system, ordered by slot. Refers to the solver's workspace, so it is overwritten by the next call.
+        const std::vector<double>& solve(const std::vector<double>& guess, double margin, size_t limit, JacobianUpdate update = Recompute, StepControl control = FullStep);
+
+        /// @brief Finds the root of the system, clamping every iterate to `bounds`
+        /// @param guess The initial guess for the root of the system, followed by the value of any parameters, ordered by slot
+        /// @param bounds The domain of each slot. Those of parameters are ignored.
+        /// @param margin The margin of error for the root of each block
+        /// @param limit The maximum number of iterations that should be attempted in finding the root of each block
+        /// @param update How the jacobian of each block should be kept up to date between iterations
+        /// @param control How each step of each block is chosen
+        /// @return The root of the system, ordered by slot. Refers to the solver's workspace, so it is overwritten by the next call.
+        const std::vector<double>& solve(const std::vector<double>& guess, const std::vector<Interval>& bounds, double margin, size_t limit, JacobianUpdate update = Recompute, StepControl control = FullStep);
+
+        /// @brief Provides read-only access to the blocks the system was split into
+        /// @return The `BlockDecomposition` of the system
+        const BlockDecomposition& get_decomposition() const;
+
+        /// @brief Provides the number of iterations taken by the last call to `solve`
+        /// @return The number of steps computed by the last solve, summed over every block
+        size_t get_iteration_count() const;
+
+        /// @brief Provides the number of times a block was evaluated by the last call to `solve`, counted like `NewtonSolver::get_evaluation_count()`
+        /// @return The number of block evaluations made by the last solve, summed over every block
+        size_t get_evaluation_count() const;
+
+        /// @brief Sets the fewest unknowns a block must have for its evaluation to be split across the `ThreadPool`
+        /// @param threshold The new threshold of every block's `NewtonSolver`. `SIZE_MAX` keeps every evaluation on the calling thread.
+        void set_parallel_threshold(size_t threshold);
+
+        /// @brief Provides the number of unknowns in the system
+        /// @return The number of expressions in the system
+        size_t size() const;
+    };
+
+    /// @brief The fewest points each segment of a `ParameterSweep` is given before the points are split across more threads
+    constexpr size_t SWEEP_MIN_SEGMENT = 32;
+
+    /// @brief Solves a system for many values of its parameters (the slots read past its unknowns), as in
+    /// a load or temperature sweep. The system is decomposed and its solvers are set up once. The points
+    /// are sorted so that consecutive ones are close, then split into contiguous segments that are solved
+    /// in parallel. Within a segment each solve starts from a secant extrapolation of the two roots before
+    /// it. A start that does not converge is retried from the previous root and then from the cold guess,
+    /// and a point that never converges gets a row of NaNs and restarts the extrapolation.
+    class ParameterSweep
+    {
+    private:
+        size_t n;
+        size_t parameters;
+        ThreadPool* pool;
+        std::vector<BlockSolver> solvers; // One per worker, so segments never share a workspace
+
+        // Workspace, sized to the system once and to the points when their number changes
+        std::vector<std::vector<double>> inputs;
+        std::vector<size_t> worker_iterations;
+        std::vector<size_t> worker_failures;
+        std::vector<size_t> order;
+        Matrix<double> roots;
+        size_t segments;
+        size_t iterations;
+        size_t failures;
+
+        void predict(size_t k, size_t history, const std::vector<double>& guess, const Matrix<double>& points, std::vector<double>& x) const;
+        void solve_segment(size_t begin, size_t end, size_t worker, const std::vector<double>& guess, const Matrix<double>& points, double margin, size_t limit, StepControl control);
+
+    public:
+        /// @brief Prepares to sweep a system. Throws `std::invalid_argument` if it reads no parameters, or
+        /// `std::runtime_error` if it is structurally singular. Each block's evaluation stays on the
+        /// thread solving its segment.
+        /// @param system The `std::vector` of expressions in the system, all compiled against the same `VariableIndex`.
+        /// Its first `system.size()` slots are the unknowns, and any later slots are the swept parameters.
+        /// @param mode How the jacobian of each block should be computed
+        /// @param pool The `ThreadPool` to solve segments on
+        ParameterSweep(const std::vector<CompiledExpression>& system, JacobianMode mode = FiniteDifference, ThreadPool& pool = ThreadPool::shared());
+
+        /// @brief Finds the root of the system at every point
+        /// @param guess The cold initial guess for the unknowns, ordered by slot, which starts each segment
+        /// @param points A table with one row per point, holding the value of every parameter ordered by slot
+        /// @param margin The margin of error for the root of each block
+        /// @param limit The maximum number of iterations that should be attempted in finding the root of each block
+        /// @param control How each step of each block is chosen
+        /// @return A table with one row per point, in the order given, holding the unknowns of its root ordered by slot.
+        /// Refers to the sweep's workspace, so it is overwritten by the next call.
+        const Matrix<double>& solve(const std::vector<double>& guess, const Matrix<double>& points, double margin, size_t limit, StepControl control = FullStep);
+
+        /// @brief Provides the number of iterations taken by the last call to `solve`
+        /// @return The number of steps computed by the starts that converged, summed over every point and block
+        size_t get_iteration_count() const;
+
+        /// @brief Provides the number of points the last call to `solve` found no root for
+        /// @return The number of rows of NaNs in the last table
+        size_t get_failure_count() const;
+
+        /// @brief Provides the number of segments the last call to `solve` split the points into
+        /// @return The number of chains of warm starts, each begun from the cold guess
+        size_t get_segment_count() const;
+
+        /// @brief Provides the number of unknowns in the system
+        /// @return The number of expressions in the system
+        size_t size() const;
+
+        /// @brief Provides the number of parameters in the system
+        /// @return The number of columns each table of points must have
+        size_t get_parameter_count() const;
+    };
+
+    /// @brief Finds roots of functions of a single unknown. Steps are newton steps when a derivative is
+    /// given and secant steps through the last two iterates otherwise, so each iteration costs one
+    /// evaluation. Every step is confined to the bounds. Once the function is seen to change sign, the
+    /// two points on either side form a bracket that each evaluation shrinks. A step that would then
+    /// leave the bracket, or that is not at most half the step before last, is replaced by bisection,
+    /// as in Brent's method, so convergence is guaranteed.
+    class ScalarSolver
+    {
+    private:
+        size_t iterations;
+        size_t evaluations;
+        size_t derivatives;
+
+        double iterate(const std::function<double (double)>& func, const std::function<double (double)>* derivative, double guess, double min, double max, double margin, size_t limit);
+
+    public:
+        ScalarSolver();
+
+        /// @brief Finds a root of a function within bounds with secant steps. Throws `std::runtime_error`
+        /// if the iterate is pushed against a bound the function does not change sign across, or if the
+        /// limit is reached.
+        /// @param func The function whose root should be found
+        /// @param guess The initial guess for the root, moved inside the bounds if it is outside them
+        /// @param min The lower bound of the root, which may be `-INFINITY`
+        /// @param max The upper bound of the root, which may be `INFINITY`
+        /// @param margin The margin of error for both the root and the function's value there
+        /// @param limit The maximum number of iterations that should be attempted in finding the root
+        /// @return A root of the function within the bounds
+        double solve(const std::function<double (double)>& func, double guess, double min, double max, double margin, size_t limit);
+
+        /// @brief Finds a root of a function within bounds with newton steps, throwing like the secant overload
+        /// @param func The function whose root should be found
+        /// @param derivative The derivative of `func`
+        /// @param guess The initial guess for the root, moved inside the bounds if it is outside them
+        /// @param min The lower bound of the root, which may be `-INFINITY`
+        /// @param max The upper bound of the root, which may be `INFINITY`
+        /// @param margin The margin of error for both the root and the function's value there
+        /// @param limit The maximum number of iterations that should be attempted in finding the root
+        /// @return A root of the function within the bounds
+        double solve(const std::function<double (double)>& func, const std::function<double (double)>& derivative, double guess, double min, double max, double margin, size_t limit);
+
+        /// @brief Provides the number of iterations taken by the last call to `solve`
+        /// @return The number of steps taken by the last solve
+        size_t get_iteration_count() const;
+
+        /// @brief Provides the number of times the function was evaluated by the last call to `solve`
+        /// @return The number of calls to `func` made by the last solve
+        size_t get_evaluation_count() const;
+
+        /// @brief Provides the number of times the derivative was evaluated by the last call to `solve`
+        /// @return The number of calls to `derivative` made by the last solve, `0` for secant steps
+        size_t get_derivative_count() const;
+    };
+
+    /// @brief The number of problems a `BatchScalarSolver` solves together, few enough for their state to stay in cache
+    constexpr size_t BATCH_SCALAR_TILE = 1024;
+
+    /// @brief Finds the roots of many independent problems of a single unknown at once, such as one
+    /// equation per grid cell. Every problem takes the steps a `ScalarSolver` would take with secant
+    /// steps, except that the function is evaluated at both bounds before the first step, so any
+    /// problem whose bounds enclose a sign change is bracketed from the start. The problems advance in
+    /// lockstep, `BATCH_SCALAR_TILE` at a time, and each round evaluates the expression once for all
+    /// of them with the batch evaluator, so each SIMD register carries 4 or 8 problems. Problems that
+    /// converge or fail are masked out, and packed out once they are a quarter of the tile, which
+    /// keeps the registers full.
+    class BatchScalarSolver
+    {
+    private:
+        CompiledExpression expr;
+        size_t unknown;
+        BatchIsa isa;
+        std::vector<size_t> parameters;
+
+        // Workspace with one entry per problem still being solved, sized when the number of problems changes
+        std::vector<size_t> id;
+        std::vector<double> x, fx, previous, f_previous, lo, hi, f_lo, last_step, older_step, bracketed, finished, point, value;
+        std::vector<std::vector<double>> columns;
+        std::vector<const double*> column_ptrs;
+        size_t iterations;
+        size_t evaluations;
+        size_t failures;
+
+        RootColumns state();
+        void evaluate(size_t count);
+        void move_problem(size_t from, size_t to);
+        void solve_tile(const double* const* parameters, size_t offset, const double* guess, const double* min, const double* max, size_t count, double margin, size_t limit, double* roots);
+
+    public:
+        /// @brief Prepares to solve for one slot of an expression
+        /// @param expr The expression whose roots should be found
+        /// @param unknown The slot of the unknown. Every other slot the expression reads is a parameter of each problem.
+        /// @param isa The instruction set to evaluate and step with. Falls back to `Scalar` if the CPU does not support it.
+        BatchScalarSolver(const CompiledExpression& expr, size_t unknown, BatchIsa isa = detect_batch_isa());
+
+        /// @brief Finds a root of the expression for every problem. Problems that do not converge within
+        /// the limit, or that are pushed against a bound the expression does not change sign across,
+        /// get a NaN root and are counted by `get_failure_count()` instead of throwing.
+        /// @param parameters One column of `count` values for each slot the expression reads, as for
+        /// `CompiledExpression::evaluate_batch`. The column of the unknown is ignored and may be `nullptr`.
+        /// @param guess The initial guess for each root, moved inside its bounds if it is outside them
+        /// @param min The lower bound of each root, which may be `-INFINITY`
+        /// @param max The upper bound of each root, which may be `INFINITY`
+        /// @param count The number of problems
+        /// @param margin The margin of error for both each root and the expression's value there
+        /// @param limit The maximum number of iterations that should be attempted for each problem
+        /// @param roots A column of at least `count` values to write the roots to
+        /// @return The number of problems with no root found
+        size_t solve(const double* const* parameters, const double* guess, const double* min, const double* max, size_t count, double margin, size_t limit, double* roots);
+
+        /// @brief Provides the number of lockstep iterations taken by the last call to `solve`
+        /// @return The number of steps taken by the slowest problem of the last solve
+        size_t get_iteration_count() const;
+
+        /// @brief Provides the number of points the expression was evaluated at by the last call to `solve`
+        /// @return The number of evaluations summed over every problem of the last solve
+        size_t get_evaluation_count() const;
+
+        /// @brief Provides the number of problems the last call to `solve` found no root for
+        /// @return The number of NaN roots written by the last solve
+        size_t get_failure_count() const;
+    };
+
+    /// @brief Finds the root of a function of a single unknown variable with a `ScalarSolver`
     /// @param func The function whose root should be found
     /// @param guess The initial guess value for the root of the function
+    /// @param min The lower bound of the root
+    /// @param max The upper bound of the root
     /// @param margin The margin of error for the root
     /// @param limit The maximum number of iterations that should be attempted in finding the root
     /// @return The root of the given function
-    double newton_raphson(std::function<double (double)> func, double guess, double min, double max, double margin, size_t limit);
+    double newton_raphson(const std::function<double (double)>& func, double guess, double min, double max, double margin, size_t limit);
 
-    /// @brief Finds the root of a multivariate system of functions
+    /// @brief Finds the root of a multivariate system of functions. The functions are opaque, so every
+    /// residual and finite difference calls one with a copy of the guess and looks its variables up by
+    /// name. Systems that can be compiled should use the `CompiledExpression` overloads instead, which
+    /// evaluate by slot with the bytecode VM.
     /// @param system The `std::vector` of functions in the system
     /// @param guess The initial guess for the root of the system
     /// @param margin The margin of error for the root
     /// @param limit The maximum number of iterations that chould be attempted in finding the root
     /// @return The root of the given system
     std::unordered_map<std::string, double> newton_raphson_multivariate(std::vector<std::function<double (std::unordered_map<std::string, double>)>> system, std::unordered_map<std::string, double> guess, double margin, size_t limit);
+
+    /// @brief Finds the root of a multivariate system of compiled expressions, one block of its `BlockDecomposition` at a time
+    /// @param system The `std::vector` of expressions in the system, all compiled against the same `VariableIndex`
+    /// @param guess The initial guess for the root of the system, ordered by slot
+    /// @param margin The margin of error for the root
+    /// @param limit The maximum number of iterations that should be attempted in finding the root
+    /// @param mode How the jacobian of the system should be computed
+    /// @param control How each step is chosen
+    /// @return The root of the given system, ordered by slot
+    std::vector<double> newton_raphson_multivariate(const std::vector<CompiledExpression>& system, std::vector<double> guess, double margin, size_t limit, JacobianMode mode = FiniteDifference, StepControl control = FullStep);
+
+    /// @brief Finds the root of a multivariate system of compiled expressions whose unknowns are bounded. The
+    /// bounds are first tightened with an `IntervalPresolve`, the guess is moved inside them with
+    /// `starting_point`, and every iterate is clamped to them while the system is solved one block of its 
+    /// `BlockDecomposition` at a time. Throws `std::runtime_error` without
+    /// iterating if the presolve proves there is no root within the bounds.
+    /// @param system The `std::vector` of expressions in the system, all compiled against the same `VariableIndex`
+    /// @param guess The initial guess for the root of the system, ordered by slot
+    /// @param bounds The domain of each unknown, ordered by slot, e.g. from `bounds_from_context`
+    /// @param margin The margin of error for the root
+    /// @param limit The maximum number of iterations that should be attempted in finding the root
+    /// @param mode How the jacobian of the system should be computed
+    /// @param control How each step is chosen
+    /// @return The root of the given system, ordered by slot
+    std::vector<double> newton_raphson_multivariate(const std::vector<CompiledExpression>& system, std::vector<double> guess, std::vector<Interval> bounds, double margin, size_t limit, JacobianMode mode = FiniteDifference, StepControl control = FullStep);
+
+    /// @brief Finds the root of a multivariate system of compiled expressions, one block of its `BlockDecomposition` at a time
+    /// @param system The `std::vector` of expressions in the system, all compiled against `index`
+    /// @param index The `VariableIndex` the system was compiled against
+    /// @param guess The initial guess for the root of the system
+    /// @param margin The margin of error for the root
+    /// @param limit The maximum number of iterations that should be attempted in finding the root
+    /// @param mode How the jacobian of the system should be computed
+    /// @param control How each step is chosen
+    /// @return The root of the given system
+    std::unordered_map<std::string, double> newton_raphson_multivariate(const std::vector<CompiledExpression>& system, const VariableIndex& index, std::unordered_map<std::string, double> guess, double margin, size_t limit, JacobianMode mode = FiniteDifference, StepControl control = FullStep);
 }
 
 #endif
\ No newline at end of file
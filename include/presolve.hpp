@@ -0,0 +1,83 @@
+#ifndef _PRESOLVE_HPP
+#define _PRESOLVE_HPP
+
+#include <vector>
+
+#include "compiled.hpp" // also includes "bytecode.hpp", "shunting.hpp", "context.hpp", "variable.hpp"
+#include "interval.hpp"
+
+namespace nexsys
+{
+    /// @brief Shrinks the domains of a system's unknowns by constraint propagation before it is
+    /// solved. Each equation `f(x) = 0` is evaluated over the current domains, its value is
+    /// intersected with zero, and that is propagated back down its expression tree to narrow
+    /// every variable it reads (HC4-revise). Equations are revisited whenever a variable they
+    /// read shrinks, so bounds flow across the whole system. All arithmetic rounds outward,
+    /// so a root inside the starting domains is never cut off.
+    class IntervalPresolve
+    {
+    private:
+        /// @brief One operation of an equation's expression tree. Arguments precede the node that consumes them.
+        struct _Node
+        {
+            TokenType type;
+            size_t operand;
+            double value;
+            FunctionDataPtr function;
+            size_t first_arg; // Index into `args`
+        };
+
+        struct _Equation
+        {
+            std::vector<_Node> nodes; // Post-order, so the root is last
+            std::vector<size_t> args;
+        };
+
+        std::vector<_Equation> equations;
+        std::vector<std::vector<size_t>> readers; // The equations reading each slot
+        size_t slot_count;
+
+        void evaluate_forward(const _Equation& eq, const std::vector<Interval>& bounds, std::vector<Interval>& values) const;
+        bool try_revise(const _Equation& eq, std::vector<Interval>& bounds, std::vector<Interval>& values, std::vector<size_t>& narrowed, double min_shrink) const;
+
+    public:
+        IntervalPresolve();
+
+        /// @brief Prepares a system for presolving
+        /// @param system The `std::vector` of expressions in the system, all compiled against the same `VariableIndex`
+        IntervalPresolve(const std::vector<CompiledExpression>& system);
+
+        /// @brief Tightens the domains of the system's unknowns
+        /// @param bounds The domain of each slot, tightened in place. Must hold every slot read by the system.
+        /// @param max_passes The average number of times each equation may be revisited
+        /// @param min_shrink The fraction of a domain's width that must be removed for its readers to be revisited
+        /// @return A `bool` indicating if a root may exist. `false` proves the system has no root within `bounds`.
+        bool try_tighten(std::vector<Interval>& bounds, size_t max_passes = 16, double min_shrink = 0.01) const;
+
+        /// @brief Cheaply checks a box for roots by evaluating each equation over it once, without narrowing anything
+        /// @param bounds The domain of each slot
+        /// @return `false` if the system provably has no root within `bounds`, else `true`
+        bool may_contain_root(const std::vector<Interval>& bounds) const;
+    };
+
+    /// @brief Evaluates an expression over intervals of its variables
+    /// @param expr The expression to evaluate
+    /// @param x The interval of each slot in the `VariableIndex` used to compile `expr`
+    /// @return An interval holding every value `expr` takes over `x`
+    Interval evaluate_interval(const CompiledExpression& expr, const std::vector<Interval>& x);
+
+    /// @brief Reads the domains of a system's unknowns from the `Variable`s in a context
+    /// @param ctx The `ContextMap` holding the variables
+    /// @param index The `VariableIndex` the system was compiled against
+    /// @return The domain of each slot. Slots not bound to a `Variable` in `ctx` are unbounded.
+    std::vector<Interval> bounds_from_context(const ContextMap& ctx, const VariableIndex& index);
+
+    /// @brief Moves an initial guess into a set of domains. Values already inside their domain are
+    /// kept; others move to the domain's midpoint, or one unit (scaled to the bound) inside a half-bounded domain.
+    /// @param bounds The domain of each slot, e.g. as tightened by `IntervalPresolve::try_tighten`
+    /// @param guess The initial guess, ordered by slot
+    /// @return A starting point within `bounds`, ordered by slot
+    std::vector<double> starting_point(const std::vector<Interval>& bounds, std::vector<double> guess);
+}
+
+#endif
@@ -4,19 +4,62 @@
 #include <functional>
 #include <iterator>
 #include <sstream>
+#include <stdexcept>
 #include <stdlib.h>
 
 #include "context.hpp" // also includes "variable.hpp"
+#include "lexer.hpp"
 
 namespace nexsys
 {
     /// Some of the different legal tokens that may be found in a math expression in `char` format.
     const std::string OPTOKENS = "+-*/^(,)";
 
-    /// @brief Compiles an expression in infix notation to a multivariate function
+    /// @brief Converts an expression in infix notation to reverse polish notation using the shunting-yard algorithm
+    /// @param expr The expression to convert
+    /// @param ctx The `ContextMap` describing what any variables, functions, or constants in the expression are
+    /// @return The expression's `Token`s in reverse polish notation
+    std::vector<Token> rpnify(const std::string& expr, const ContextMap& ctx);
+
+    /// @brief Converts an expression in infix notation to reverse polish notation using the shunting-yard algorithm
+    /// @param expr The expression to convert
+    /// @param ctx The `ContextView` describing what any variables, functions, or constants in the expression are
+    /// @return The expression's `Token`s in reverse polish notation
+    std::vector<Token> rpnify(const std::string& expr, const ContextView& ctx);
+
+    /// @brief Converts an expression in infix notation to reverse polish notation, also providing the symbol each token came from
+    /// @param expr The expression to convert
+    /// @param ctx The `ContextMap` describing what any variables, functions, or constants in the expression are
+    /// @param symbols Receives the name each `Num` or `Var` token was resolved from, or an empty view for literals and operators. Valid while `ctx` is.
+    /// @return The expression's `Token`s in reverse polish notation
+    std::vector<Token> rpnify(const std::string& expr, const ContextMap& ctx, std::vector<std::string_view>& symbols);
+
+    /// @brief Converts an expression in infix notation to reverse polish notation, also providing the symbol each token came from
+    /// @param expr The expression to convert
+    /// @param ctx The `ContextView` describing what any variables, functions, or constants in the expression are
+    /// @param symbols Receives the name each `Num` or `Var` token was resolved from, or an empty view for literals and operators. Valid while `ctx` is.
+    /// @return The expression's `Token`s in reverse polish notation
+    std::vector<Token> rpnify(const std::string& expr, const ContextView& ctx, std::vector<std::string_view>& symbols);
+
+    /// @brief Converts an expression in infix notation to reverse polish notation into caller-owned buffers,
+    /// reusing their capacity. Prefer this overload when converting many expressions on one thread.
+    /// @param expr The expression to convert
+    /// @param ctx The `ContextView` describing what any variables, functions, or constants in the expression are
+    /// @param rpn_expr Receives the expression's `Token`s in reverse polish notation
+    /// @param symbols Receives the name each `Num` or `Var` token was resolved from, or an empty view for literals and operators. Valid while `ctx` is.
+    void rpnify(const std::string& expr, const ContextView& ctx, std::vector<Token>& rpn_expr, std::vector<std::string_view>& symbols);
+
+    /// @brief Evaluates a reverse polish notation expression by walking its `Token`s. Kept as the baseline
+    /// the bytecode VM is benchmarked against; `CompiledExpression` is much faster. Throws `std::invalid_argument`
+    /// if the expression is malformed.
+    /// @param rpn_expr The reverse polish notation expression as a `std::vector<Token>`
+    /// @return the value of the expression as a `double`
+    double eval_rpn_expression(std::vector<Token> rpn_expr);
+
+    /// @brief Compiles an expression in infix notation to a multivariate function evaluated with the bytecode VM
     /// @param expr The expression that the given closure should evaluate upon being called
-    /// @param ctx The `ContextMap` describing what any variables, functions, or  in the expression are
-    /// @return 
-    std::function<double (std::unordered_map<std::string, double>)> compile_to_function_of_umap(std::string expr, ContextMap ctx);
+    /// @param ctx The `ContextMap` describing what any variables, functions, or constants in the expression are
+    /// @return A closure that assigns each value it is given to the context's variable of that name, then evaluates the expression
+    std::function<double (std::unordered_map<std::string, double>)> compile_to_function_of_umap(const std::string& expr, const ContextMap& ctx);
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,25 @@
+#ifndef _SIMPLIFIER_HPP
+#define _SIMPLIFIER_HPP
+
+#include <vector>
+
+#include "bytecode.hpp" // also includes "context.hpp", "variable.hpp"
+
+namespace nexsys
+{
+    /// @brief Simplifies a reverse polish notation program in place before it is lowered. Only
+    /// rewrites that leave every result bit-for-bit unchanged are made, except that removing
+    /// `x + 0` keeps the sign of a zero `x`:
+    /// - operations on constants, including calls to built-in functions, are folded
+    /// - `x + 0`, `x - 0`, `x * 1`, `x / 1`, `x ^ 1` and `x ^ 0` are removed
+    /// - double negation is removed, and unary minus is folded into `+`, `-` and constant operands
+    /// - division by a power of two becomes multiplication by its reciprocal
+    /// - operands of `+` and `*` are put in a canonical order, so that equal sums and products compile to equal programs
+    ///
+    /// Small integer exponents are strength-reduced later, when the program is lowered to `OpPowI`.
+    /// @param program The program to simplify
+    /// @return The number of instructions removed
+    size_t simplify_program(std::vector<SlotToken>& program);
+}
+
+#endif
@@ -0,0 +1,89 @@
+#ifndef _SYSTEM_HPP
+#define _SYSTEM_HPP
+
+#include <memory>
+#include <vector>
+
+#include "expression.hpp" // also includes "compiled.hpp", "bytecode.hpp", "shunting.hpp", "context.hpp", "variable.hpp"
+
+namespace nexsys
+{
+    /// @brief A whole system of expressions compiled into a single program that writes every
+    /// residual in one dispatch. Identical subexpressions are merged across all equations when
+    /// compiling, so each is evaluated once per point no matter how many equations share it.
+    class CompiledSystem
+    {
+    private:
+        Bytecode code;
+        std::vector<uint32_t> outputs;
+        std::shared_ptr<JitCode> jit;
+        size_t shared_count;
+
+    public:
+        CompiledSystem();
+
+        /// @brief Merges the expressions of a system into a single program
+        /// @param system The expressions in the system, all compiled against the same `VariableIndex`
+        CompiledSystem(const std::vector<CompiledExpression>& system);
+
+        /// @brief Evaluates every expression in the system
+        /// @param x The values of each slot in the `VariableIndex` used to compile the system
+        /// @param out An array of at least `size()` values to write the value of each expression to
+        void evaluate(const double* x, double* out) const;
+
+        /// @brief Evaluates every expression in the system in a caller-provided frame. Useful when evaluating from several threads.
+        /// @param x The values of each slot in the `VariableIndex` used to compile the system
+        /// @param frame Scratch space of at least `get_frame_size()` values
+        /// @param out An array of at least `size()` values to write the value of each expression to
+        void evaluate(const double* x, double* frame, double* out) const;
+
+        /// @brief Evaluates every expression in the system over another scalar type, e.g. `Dual<N>`. Always uses the interpreter.
+        /// @param x The values of each slot in the `VariableIndex` used to compile the system
+        /// @param frame Scratch space of at least `get_frame_size()` values
+        /// @param out An array of at least `size()` values to write the value of each expression to
+        template<typename T>
+        void evaluate(const T* x, T* frame, T* out) const;
+
+        /// @brief Evaluates every expression in the system
+        /// @param x The values of each slot in the `VariableIndex` used to compile the system
+        /// @param out A vector to write the value of each expression to. Resized to `size()` if needed.
+        void evaluate(const std::vector<double>& x, std::vector<double>& out) const;
+
+        /// @brief Picks how this system is evaluated, natively compiling it if needed
+        /// @param backend The `Backend` to evaluate with
+        /// @return A `bool` indicating success. On failure, the previous backend is kept.
+        bool try_set_backend(Backend backend);
+
+        /// @brief Provides read-only visibility to how this system is evaluated
+        /// @return The `Backend` in use
+        Backend get_backend() const;
+
+        /// @brief Provides read-only access to the merged program
+        /// @return The lowered `Bytecode` of this system
+        const Bytecode& get_bytecode() const;
+
+        /// @brief Provides the number of registers the merged program needs
+        /// @return The size of the evaluation frame
+        size_t get_frame_size() const;
+
+        /// @brief Provides the number of operations that were found in more than one place and merged
+        /// @return The number of operations evaluated once but used several times
+        size_t get_shared_count() const;
+
+        /// @brief Provides the number of expressions in the system
+        /// @return The length of the residual vector
+        size_t size() const;
+    };
+
+    template<typename T>
+    void CompiledSystem::evaluate(const T* x, T* frame, T* out) const
+    {
+        code.run(x, frame);
+        for (size_t i = 0; i < outputs.size(); i++)
+        {
+            out[i] = frame[outputs[i]];
+        }
+    }
+}
+
+#endif
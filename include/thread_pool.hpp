@@ -0,0 +1,71 @@
+#ifndef _THREAD_POOL_HPP
+#define _THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace nexsys
+{
+    /// @brief A fixed set of worker threads that split loops over an index range between them.
+    /// Workers sleep between loops instead of being created for each one, and the calling thread
+    /// takes part in every loop, so a pool of size 1 runs everything inline.
+    class ThreadPool
+    {
+    public:
+        /// @brief The body of a parallel loop. Called as `body(begin, end, worker)` for consecutive
+        /// chunks of the range, where `worker` is below `size()` and is never shared by two concurrent calls.
+        typedef std::function<void (size_t, size_t, size_t)> LoopBody;
+
+    private:
+        std::vector<std::thread> workers;
+        std::mutex submit; // Held for the whole of a loop, so that loops from different threads take turns
+        std::mutex lock;
+        std::condition_variable wake;
+        std::condition_variable done;
+
+        const LoopBody* body;
+        size_t count;
+        size_t chunk;
+        std::atomic<size_t> next;
+        size_t running;
+        uint64_t generation;
+        bool stopping;
+        std::exception_ptr error;
+
+        void work(size_t worker);
+        void run_chunks(size_t worker);
+
+    public:
+        /// @brief Starts a pool
+        /// @param threads The number of threads loops are split across, including the caller's. `0` uses one per hardware thread.
+        ThreadPool(size_t threads = 0);
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        ~ThreadPool();
+
+        /// @brief Provides a pool with one thread per hardware thread, started on first use and shared by the whole program
+        static ThreadPool& shared();
+
+        /// @brief Provides the number of threads loops are split across
+        /// @return The number of workers, including the calling thread
+        size_t size() const;
+
+        /// @brief Runs a loop over `[0, count)`, returning once every chunk has run. If any call to
+        /// `body` throws, remaining chunks are skipped and the first exception is rethrown here.
+        /// Must not be called from inside a loop body running on the same pool.
+        /// @param count The number of indices to loop over
+        /// @param chunk The number of consecutive indices handed to each call of `body`
+        /// @param body The loop body
+        void parallel_for(size_t count, size_t chunk, const LoopBody& body);
+    };
+}
+
+#endif
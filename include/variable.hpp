@@ -92,6 +92,20 @@ namespace nexsys
         {
             return value;
         }
+
+        /// @brief Offers read-only access to `this->min_bound`
+        /// @return The lower bound of this variable's domain as a `double`
+        double get_min_bound() const
+        {
+            return min_bound;
+        }
+
+        /// @brief Offers read-only access to `this->max_bound`
+        /// @return The upper bound of this variable's domain as a `double`
+        double get_max_bound() const
+        {
+            return max_bound;
+        }
     };
 }
 
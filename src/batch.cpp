@@ -0,0 +1,156 @@
+#include "batch_kernel.hpp"
+
+#include <algorithm>
+
+using std::vector;
+
+namespace nexsys
+{
+    void run_batch_block_scalar(const Instruction* code, const double* const* x, size_t offset, double* r, size_t n, double* out, size_t out_n, double* args)
+    {
+        run_batch_block<ScalarLanes>(code, x, offset, r, n, out, out_n, args);
+    }
+
+    void propose_roots(const RootColumns& roots, size_t count, BatchIsa isa)
+    {
+        isa = std::min(isa, detect_batch_isa());
+        size_t done = isa == Avx512 ? propose_roots_avx512(roots, count)
+            : isa == Avx2 ? propose_roots_avx2(roots, count)
+            : 0;
+        propose_root_lanes<ScalarLanes>(roots, done, count);
+    }
+
+    void update_roots(const RootColumns& roots, size_t count, double margin, BatchIsa isa)
+    {
+        isa = std::min(isa, detect_batch_isa());
+        size_t done = isa == Avx512 ? update_roots_avx512(roots, count, margin)
+            : isa == Avx2 ? update_roots_avx2(roots, count, margin)
+            : 0;
+        update_root_lanes<ScalarLanes>(roots, done, count, margin);
+    }
+
+    BatchIsa detect_batch_isa()
+    {
+#if defined(__x86_64__) && defined(__GNUC__)
+        static const BatchIsa detected = __builtin_cpu_supports("avx512f") ? Avx512 
+            : __builtin_cpu_supports("avx2") ? Avx2 
+            : Scalar;
+        return detected;
+#else
+        return Scalar;
+#endif
+    }
+
+    /// @brief Helper function to find the largest variable slot read by a program and the
+    /// most arguments passed to any of its function calls
+    static bool try_get_max_slot(const vector<Instruction>& code, size_t& max_slot, size_t& max_argc)
+    {
+        bool reads_vars = false;
+        max_slot = 0;
+        max_argc = 0;
+
+        for (auto& ins: code)
+        {
+            size_t slot;
+            switch(ins.op)
+            {
+                case OpCall:
+                    if (ins.b > max_argc)
+                    {
+                        max_argc = ins.b;
+                    }
+                    continue;
+
+                case OpVar:
+                    slot = ins.a;
+                    break;
+
+                case OpAddVar:
+                case OpSubVar:
+                case OpMulVar:
+                case OpDivVar:
+                case OpVarSub:
+                case OpVarDiv:
+                    slot = ins.b;
+                    break;
+
+                default:
+                    continue;
+            }
+
+            reads_vars = true;
+            if (slot > max_slot)
+            {
+                max_slot = slot;
+            }
+        }
+
+        return reads_vars;
+    }
+
+    void evaluate_batch(const Bytecode& code, const double* const* columns, size_t count, double* out, BatchIsa isa)
+    {
+        if (isa > detect_batch_isa())
+        {
+            isa = detect_batch_isa();
+        }
+
+        auto run_block = isa == Avx512 ? run_batch_block_avx512
+            : isa == Avx2 ? run_batch_block_avx2
+            : run_batch_block_scalar;
+
+        size_t max_slot, max_argc;
+        bool reads_vars = try_get_max_slot(code.get_code(), max_slot, max_argc);
+
+        thread_local vector<double> frame;
+        thread_local vector<double> args;
+        if (frame.size() < code.get_frame_size() * BATCH_BLOCK)
+        {
+            frame.resize(code.get_frame_size() * BATCH_BLOCK);
+        }
+        if (args.size() < max_argc + 1)
+        {
+            args.resize(max_argc + 1);
+        }
+
+        size_t full = count - count % BATCH_BLOCK;
+        for (size_t offset = 0; offset < full; offset += BATCH_BLOCK)
+        {
+            run_block(code.get_code().data(), columns, offset, frame.data(), BATCH_BLOCK, out + offset, BATCH_BLOCK, args.data());
+        }
+
+        if (full == count)
+        {
+            return;
+        }
+
+        // The last block is evaluated a whole number of registers at a time, so give 
+        // it zero-padded copies of its input columns to read past the end of.
+        size_t remaining = count - full;
+        size_t padded = (remaining + 7) / 8 * 8;
+
+        // Kept between calls like the frame, since callers that shrink their batch every round always have a tail
+        thread_local vector<const double*> tail_columns;
+        thread_local vector<double> tail_values;
+        if (reads_vars)
+        {
+            if (tail_columns.size() < max_slot + 1)
+            {
+                tail_columns.resize(max_slot + 1);
+                tail_values.resize((max_slot + 1) * BATCH_BLOCK);
+            }
+            for (size_t slot = 0; slot <= max_slot; slot++)
+            {
+                double* column = tail_values.data() + slot * BATCH_BLOCK;
+                if (columns[slot] != nullptr)
+                {
+                    memcpy(column, columns[slot] + full, remaining * sizeof(double));
+                }
+                std::fill(column + (columns[slot] != nullptr ? remaining : 0), column + padded, 0.0);
+                tail_columns[slot] = column;
+            }
+        }
+
+        run_block(code.get_code().data(), tail_columns.data(), 0, frame.data(), padded, out + full, remaining, args.data());
+    }
+}
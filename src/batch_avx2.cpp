@@ -0,0 +1,112 @@
+#include "batch_kernel.hpp"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace nexsys
+{
+#if defined(__AVX2__)
+    /// @brief Lane traits for 4 `double`s in an AVX2 register
+    struct Avx2Lanes
+    {
+        typedef __m256d V;
+        static constexpr size_t width = 4;
+
+        static inline V load(const double* p) { return _mm256_loadu_pd(p); }
+        static inline void store(double* p, V v) { _mm256_storeu_pd(p, v); }
+        static inline V set1(double v) { return _mm256_set1_pd(v); }
+        static inline V add(V a, V b) { return _mm256_add_pd(a, b); }
+        static inline V sub(V a, V b) { return _mm256_sub_pd(a, b); }
+        static inline V mul(V a, V b) { return _mm256_mul_pd(a, b); }
+        static inline V div(V a, V b) { return _mm256_div_pd(a, b); }
+        static inline V min(V a, V b) { return _mm256_min_pd(a, b); }
+        static inline V max(V a, V b) { return _mm256_max_pd(a, b); }
+        static inline V abs(V a) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a); }
+        static inline V sqrt(V a) { return _mm256_sqrt_pd(a); }
+        static inline V round(V a) { return _mm256_round_pd(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+
+        /// @brief `a < b ? t : f` in each lane
+        static inline V select_lt(V a, V b, V t, V f) { return _mm256_blendv_pd(f, t, _mm256_cmp_pd(a, b, _CMP_LT_OQ)); }
+
+        /// @brief `a <= b ? t : f` in each lane
+        static inline V select_le(V a, V b, V t, V f) { return _mm256_blendv_pd(f, t, _mm256_cmp_pd(a, b, _CMP_LE_OQ)); }
+
+        /// @brief Checks if every lane is within `[lo, hi]`, which is never the case for NaN
+        static inline bool all_within(V a, double lo, double hi)
+        {
+            V inside = _mm256_and_pd(_mm256_cmp_pd(a, _mm256_set1_pd(lo), _CMP_GE_OQ), _mm256_cmp_pd(a, _mm256_set1_pd(hi), _CMP_LE_OQ));
+            return _mm256_movemask_pd(inside) == 0xF;
+        }
+
+        /// @brief `a * 2^n`, where each lane of `n` is an integer such that `2^n` is a normal number
+        static inline V scale2(V a, V n)
+        {
+            // Adding 1.5 * 2^52 leaves the integer in the low bits of the mantissa
+            __m256i bits = _mm256_castpd_si256(_mm256_add_pd(n, _mm256_set1_pd(6755399441055744.0)));
+            bits = _mm256_slli_epi64(_mm256_add_epi64(bits, _mm256_set1_epi64x(1023)), 52);
+            return _mm256_mul_pd(a, _mm256_castsi256_pd(bits));
+        }
+
+        /// @brief Splits positive normal numbers into a mantissa in `[0.5, 1)` and an exponent `e`
+        static inline V split(V a, V& e)
+        {
+            __m256i bits = _mm256_castpd_si256(a);
+            __m256i biased = _mm256_or_si256(_mm256_srli_epi64(bits, 52), _mm256_set1_epi64x(0x4330000000000000));
+            e = _mm256_sub_pd(_mm256_castsi256_pd(biased), _mm256_set1_pd(4503599627370496.0 + 1022.0));
+            bits = _mm256_and_si256(bits, _mm256_set1_epi64x(0x000FFFFFFFFFFFFF));
+            return _mm256_castsi256_pd(_mm256_or_si256(bits, _mm256_set1_epi64x(0x3FE0000000000000)));
+        }
+
+        static inline V exp(V a) { return lanes_exp<Avx2Lanes>(a); }
+        static inline V log(V a) { return lanes_log<Avx2Lanes>(a); }
+        static inline V log10(V a) { return lanes_log10<Avx2Lanes>(a); }
+        static inline V sin(V a) { return lanes_sin<Avx2Lanes>(a); }
+        static inline V cos(V a) { return lanes_cos<Avx2Lanes>(a); }
+        static inline V tan(V a) { return lanes_tan<Avx2Lanes>(a); }
+        static inline V asin(V a) { return lanes_asin<Avx2Lanes>(a); }
+        static inline V acos(V a) { return lanes_acos<Avx2Lanes>(a); }
+        static inline V atan(V a) { return lanes_atan<Avx2Lanes>(a); }
+        static inline V sinh(V a) { return lanes_sinh<Avx2Lanes>(a); }
+        static inline V cosh(V a) { return lanes_cosh<Avx2Lanes>(a); }
+        static inline V tanh(V a) { return lanes_tanh<Avx2Lanes>(a); }
+        static inline V hypot(V a, V b) { return lanes_hypot<Avx2Lanes>(a, b); }
+    };
+
+    void run_batch_block_avx2(const Instruction* code, const double* const* x, size_t offset, double* r, size_t n, double* out, size_t out_n, double* args)
+    {
+        run_batch_block<Avx2Lanes>(code, x, offset, r, n, out, out_n, args);
+    }
+
+    size_t propose_roots_avx2(const RootColumns& s, size_t count)
+    {
+        size_t end = count - count % Avx2Lanes::width;
+        propose_root_lanes<Avx2Lanes>(s, 0, end);
+        return end;
+    }
+
+    size_t update_roots_avx2(const RootColumns& s, size_t count, double margin)
+    {
+        size_t end = count - count % Avx2Lanes::width;
+        update_root_lanes<Avx2Lanes>(s, 0, end, margin);
+        return end;
+    }
+#else
+    void run_batch_block_avx2(const Instruction* code, const double* const* x, size_t offset, double* r, size_t n, double* out, size_t out_n, double* args)
+    {
+        run_batch_block<ScalarLanes>(code, x, offset, r, n, out, out_n, args);
+    }
+
+    size_t propose_roots_avx2(const RootColumns& s, size_t count)
+    {
+        propose_root_lanes<ScalarLanes>(s, 0, count);
+        return count;
+    }
+
+    size_t update_roots_avx2(const RootColumns& s, size_t count, double margin)
+    {
+        update_root_lanes<ScalarLanes>(s, 0, count, margin);
+        return count;
+    }
+#endif
+}
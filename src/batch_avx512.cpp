@@ -0,0 +1,117 @@
+#include "batch_kernel.hpp"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+// GCC 12 reports the deliberately uninitialized placeholder inside several AVX-512 intrinsics
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+namespace nexsys
+{
+#if defined(__AVX512F__)
+    /// @brief Lane traits for 8 `double`s in an AVX-512 register
+    struct Avx512Lanes
+    {
+        typedef __m512d V;
+        static constexpr size_t width = 8;
+
+        static inline V load(const double* p) { return _mm512_loadu_pd(p); }
+        static inline void store(double* p, V v) { _mm512_storeu_pd(p, v); }
+        static inline V set1(double v) { return _mm512_set1_pd(v); }
+        static inline V add(V a, V b) { return _mm512_add_pd(a, b); }
+        static inline V sub(V a, V b) { return _mm512_sub_pd(a, b); }
+        static inline V mul(V a, V b) { return _mm512_mul_pd(a, b); }
+        static inline V div(V a, V b) { return _mm512_div_pd(a, b); }
+        static inline V min(V a, V b) { return _mm512_min_pd(a, b); }
+        static inline V max(V a, V b) { return _mm512_max_pd(a, b); }
+        static inline V abs(V a) { return _mm512_castsi512_pd(_mm512_and_si512(_mm512_castpd_si512(a), _mm512_set1_epi64(0x7FFFFFFFFFFFFFFF))); }
+        static inline V sqrt(V a) { return _mm512_sqrt_pd(a); }
+        static inline V round(V a) { return _mm512_roundscale_pd(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+
+        /// @brief `a < b ? t : f` in each lane
+        static inline V select_lt(V a, V b, V t, V f) { return _mm512_mask_blend_pd(_mm512_cmp_pd_mask(a, b, _CMP_LT_OQ), f, t); }
+
+        /// @brief `a <= b ? t : f` in each lane
+        static inline V select_le(V a, V b, V t, V f) { return _mm512_mask_blend_pd(_mm512_cmp_pd_mask(a, b, _CMP_LE_OQ), f, t); }
+
+        /// @brief Checks if every lane is within `[lo, hi]`, which is never the case for NaN
+        static inline bool all_within(V a, double lo, double hi)
+        {
+            __mmask8 inside = _mm512_cmp_pd_mask(a, _mm512_set1_pd(lo), _CMP_GE_OQ) & _mm512_cmp_pd_mask(a, _mm512_set1_pd(hi), _CMP_LE_OQ);
+            return inside == 0xFF;
+        }
+
+        /// @brief `a * 2^n`, where each lane of `n` is an integer such that `2^n` is a normal number
+        static inline V scale2(V a, V n)
+        {
+            // Adding 1.5 * 2^52 leaves the integer in the low bits of the mantissa
+            __m512i bits = _mm512_castpd_si512(_mm512_add_pd(n, _mm512_set1_pd(6755399441055744.0)));
+            bits = _mm512_slli_epi64(_mm512_add_epi64(bits, _mm512_set1_epi64(1023)), 52);
+            return _mm512_mul_pd(a, _mm512_castsi512_pd(bits));
+        }
+
+        /// @brief Splits positive normal numbers into a mantissa in `[0.5, 1)` and an exponent `e`
+        static inline V split(V a, V& e)
+        {
+            __m512i bits = _mm512_castpd_si512(a);
+            __m512i biased = _mm512_or_si512(_mm512_srli_epi64(bits, 52), _mm512_set1_epi64(0x4330000000000000));
+            e = _mm512_sub_pd(_mm512_castsi512_pd(biased), _mm512_set1_pd(4503599627370496.0 + 1022.0));
+            bits = _mm512_and_si512(bits, _mm512_set1_epi64(0x000FFFFFFFFFFFFF));
+            return _mm512_castsi512_pd(_mm512_or_si512(bits, _mm512_set1_epi64(0x3FE0000000000000)));
+        }
+
+        static inline V exp(V a) { return lanes_exp<Avx512Lanes>(a); }
+        static inline V log(V a) { return lanes_log<Avx512Lanes>(a); }
+        static inline V log10(V a) { return lanes_log10<Avx512Lanes>(a); }
+        static inline V sin(V a) { return lanes_sin<Avx512Lanes>(a); }
+        static inline V cos(V a) { return lanes_cos<Avx512Lanes>(a); }
+        static inline V tan(V a) { return lanes_tan<Avx512Lanes>(a); }
+        static inline V asin(V a) { return lanes_asin<Avx512Lanes>(a); }
+        static inline V acos(V a) { return lanes_acos<Avx512Lanes>(a); }
+        static inline V atan(V a) { return lanes_atan<Avx512Lanes>(a); }
+        static inline V sinh(V a) { return lanes_sinh<Avx512Lanes>(a); }
+        static inline V cosh(V a) { return lanes_cosh<Avx512Lanes>(a); }
+        static inline V tanh(V a) { return lanes_tanh<Avx512Lanes>(a); }
+        static inline V hypot(V a, V b) { return lanes_hypot<Avx512Lanes>(a, b); }
+    };
+
+    void run_batch_block_avx512(const Instruction* code, const double* const* x, size_t offset, double* r, size_t n, double* out, size_t out_n, double* args)
+    {
+        run_batch_block<Avx512Lanes>(code, x, offset, r, n, out, out_n, args);
+    }
+
+    size_t propose_roots_avx512(const RootColumns& s, size_t count)
+    {
+        size_t end = count - count % Avx512Lanes::width;
+        propose_root_lanes<Avx512Lanes>(s, 0, end);
+        return end;
+    }
+
+    size_t update_roots_avx512(const RootColumns& s, size_t count, double margin)
+    {
+        size_t end = count - count % Avx512Lanes::width;
+        update_root_lanes<Avx512Lanes>(s, 0, end, margin);
+        return end;
+    }
+#else
+    void run_batch_block_avx512(const Instruction* code, const double* const* x, size_t offset, double* r, size_t n, double* out, size_t out_n, double* args)
+    {
+        run_batch_block<ScalarLanes>(code, x, offset, r, n, out, out_n, args);
+    }
+
+    size_t propose_roots_avx512(const RootColumns& s, size_t count)
+    {
+        propose_root_lanes<ScalarLanes>(s, 0, count);
+        return count;
+    }
+
+    size_t update_roots_avx512(const RootColumns& s, size_t count, double margin)
+    {
+        update_root_lanes<ScalarLanes>(s, 0, count, margin);
+        return count;
+    }
+#endif
+}
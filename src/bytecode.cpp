@@ -0,0 +1,343 @@
+#include "bytecode.hpp"
+
+#include <cmath>
+#include <stdexcept>
+
+using std::vector;
+
+// GCC and Clang support jumping through a table of label addresses, which lets every
+// instruction dispatch the next one directly instead of returning to a single `switch`.
+#if defined(__GNUC__)
+#define NEXSYS_THREADED_DISPATCH
+#endif
+
+namespace nexsys
+{
+    /// @brief An entry on the virtual stack used while lowering to bytecode. Constants and
+    /// variables are left pending so that they can be fused into the instruction consuming them.
+    struct _Operand
+    {
+        enum { Register, Constant, Slot } kind;
+        double value;
+        uint32_t slot;
+    };
+
+    /// @brief Helper function to build an `Instruction`
+    static Instruction make_instruction(OpCode op, uint32_t dst, uint32_t a, uint32_t b, double imm)
+    {
+        Instruction ins;
+        ins.op = op;
+        ins.dst = dst;
+        ins.a = a;
+        ins.b = b;
+        ins.imm = imm;
+        return ins;
+    }
+
+    /// @brief Helper function to load a pending operand into its register
+    static void materialize(vector<Instruction>& code, _Operand& operand, uint32_t reg)
+    {
+        switch(operand.kind)
+        {
+            case _Operand::Constant:
+                code.push_back(make_instruction(OpNum, reg, 0, 0, operand.value));
+                break;
+
+            case _Operand::Slot:
+                code.push_back(make_instruction(OpVar, reg, operand.slot, 0, 0.0));
+                break;
+
+            default:
+                break;
+        }
+        operand.kind = _Operand::Register;
+    }
+
+    /// @brief Helper function to emit a binary operation whose left operand lives at `reg` and
+    /// whose right operand lives at `reg + 1`. The result is always left in `reg`.
+    static void lower_binary(vector<Instruction>& code, TokenType type, _Operand& lhs, _Operand& rhs, uint32_t reg)
+    {
+        OpCode reg_op, num_op, var_op;
+        switch(type)
+        {
+            case Plus:  reg_op = OpAdd; num_op = OpAddNum; var_op = OpAddVar; break;
+            case Minus: reg_op = OpSub; num_op = OpSubNum; var_op = OpSubVar; break;
+            case Mul:   reg_op = OpMul; num_op = OpMulNum; var_op = OpMulVar; break;
+            case Div:   reg_op = OpDiv; num_op = OpDivNum; var_op = OpDivVar; break;
+            default:    reg_op = OpPow; num_op = OpPowNum; var_op = OpPow;    break;
+        }
+
+        bool commutes = type == Plus || type == Mul;
+        bool reverses = type == Minus || type == Div;
+
+        if (lhs.kind != _Operand::Register && rhs.kind == _Operand::Register && (commutes || reverses))
+        {
+            if (lhs.kind == _Operand::Constant)
+            {
+                OpCode op = commutes ? num_op : (type == Minus ? OpNumSub : OpNumDiv);
+                code.push_back(make_instruction(op, reg, reg + 1, 0, lhs.value));
+            }
+            else
+            {
+                OpCode op = commutes ? var_op : (type == Minus ? OpVarSub : OpVarDiv);
+                code.push_back(make_instruction(op, reg, reg + 1, lhs.slot, 0.0));
+            }
+            lhs.kind = _Operand::Register;
+            return;
+        }
+
+        materialize(code, lhs, reg);
+        if (rhs.kind == _Operand::Constant && type == Exp && is_powi_exponent(rhs.value))
+        {
+            code.push_back(make_instruction(OpPowI, reg, reg, (uint32_t)(int32_t)rhs.value, 0.0));
+        }
+        else if (rhs.kind == _Operand::Constant)
+        {
+            code.push_back(make_instruction(num_op, reg, reg, 0, rhs.value));
+        }
+        else if (rhs.kind == _Operand::Slot && type != Exp)
+        {
+            code.push_back(make_instruction(var_op, reg, reg, rhs.slot, 0.0));
+        }
+        else
+        {
+            materialize(code, rhs, reg + 1);
+            code.push_back(make_instruction(reg_op, reg, reg, reg + 1, 0.0));
+        }
+    }
+
+    bool is_powi_exponent(double exponent)
+    {
+        return exponent == std::trunc(exponent) && std::fabs(exponent) <= MAX_POWI_EXPONENT;
+    }
+
+    OpCode intrinsic_opcode(Intrinsic id)
+    {
+        switch(id)
+        {
+            case IntrSin:   return OpSin;
+            case IntrCos:   return OpCos;
+            case IntrTan:   return OpTan;
+            case IntrAsin:  return OpAsin;
+            case IntrAcos:  return OpAcos;
+            case IntrAtan:  return OpAtan;
+            case IntrSinh:  return OpSinh;
+            case IntrCosh:  return OpCosh;
+            case IntrTanh:  return OpTanh;
+            case IntrExp:   return OpExp;
+            case IntrLog:   return OpLog;
+            case IntrLog10: return OpLog10;
+            case IntrSqrt:  return OpSqrt;
+            case IntrAbs:   return OpAbs;
+            case IntrMin:   return OpMin;
+            case IntrMax:   return OpMax;
+            case IntrHypot: return OpHypot;
+            default:        throw std::invalid_argument("not a built-in function");
+        }
+    }
+
+    /// @brief Helper function to evaluate a built-in function at compile time if all of its arguments are constant
+    /// @param args The function's pending arguments
+    /// @param result Set to the constant result on success
+    /// @return A `bool` indicating if the call was folded
+    static bool fold_intrinsic(FunctionDataPtr function, const _Operand* args, _Operand& result)
+    {
+        double values[2];
+        for (size_t i = 0; i < function->argc; i++)
+        {
+            if (args[i].kind != _Operand::Constant)
+            {
+                return false;
+            }
+            values[i] = args[i].value;
+        }
+
+        result.kind = _Operand::Constant;
+        result.value = function->func(values);
+        return true;
+    }
+
+    Bytecode::Bytecode(): frame_size(1)
+    {
+        code.push_back(make_instruction(OpNum, 0, 0, 0, 0.0));
+        code.push_back(make_instruction(OpReturn, 0, 0, 0, 0.0));
+    }
+
+    Bytecode::Bytecode(const vector<SlotToken>& program): frame_size(1)
+    {
+        vector<_Operand> stack;
+        code.reserve(program.size() + 1);
+
+        for (auto& tok: program)
+        {
+            _Operand operand;
+            uint32_t reg;
+
+            switch(tok.type)
+            {
+                case Num:
+                    operand.kind = _Operand::Constant;
+                    operand.value = tok.value;
+                    stack.push_back(operand);
+                    break;
+
+                case Var:
+                    operand.kind = _Operand::Slot;
+                    operand.slot = (uint32_t)tok.operand;
+                    stack.push_back(operand);
+                    break;
+
+                case Plus:
+                case Minus:
+                case Mul:
+                case Div:
+                case Exp:
+                    if (stack.size() < 2)
+                    {
+                        throw std::invalid_argument("operator is missing an operand");
+                    }
+                    reg = (uint32_t)stack.size() - 2;
+                    lower_binary(code, tok.type, stack[reg], stack[reg + 1], reg);
+                    stack.pop_back();
+                    break;
+
+                case Func:
+                    if (stack.size() < tok.operand)
+                    {
+                        throw std::invalid_argument("function is missing an argument");
+                    }
+                    reg = (uint32_t)(stack.size() - tok.operand);
+                    if (tok.function->intrinsic != IntrNone && fold_intrinsic(tok.function, &stack[reg], operand))
+                    {
+                        stack.resize(reg);
+                        stack.push_back(operand);
+                        break;
+                    }
+
+                    for (size_t i = 0; i < tok.operand; i++)
+                    {
+                        materialize(code, stack[reg + i], reg + i);
+                    }
+
+                    if (tok.function->intrinsic != IntrNone)
+                    {
+                        code.push_back(make_instruction(intrinsic_opcode(tok.function->intrinsic), reg, reg, reg + 1, 0.0));
+                    }
+                    else
+                    {
+                        code.push_back(make_instruction(OpCall, reg, reg, (uint32_t)tok.operand, 0.0));
+                        code.back().function = tok.function;
+                    }
+
+                    stack.resize(reg);
+                    operand.kind = _Operand::Register;
+                    stack.push_back(operand);
+                    break;
+
+                default:
+                    throw std::invalid_argument("illegal token in compiled expression");
+            }
+
+            if (stack.size() > frame_size)
+            {
+                frame_size = stack.size();
+            }
+        }
+
+        if (stack.size() != 1)
+        {
+            throw std::invalid_argument("expression does not evaluate to a single value");
+        }
+
+        materialize(code, stack[0], 0);
+        code.push_back(make_instruction(OpReturn, 0, 0, 0, 0.0));
+    }
+
+    Bytecode::Bytecode(vector<Instruction> code, size_t frame_size): code(std::move(code)), frame_size(frame_size)
+    {
+        if (this->code.empty() || this->code.back().op != OpReturn)
+        {
+            throw std::invalid_argument("bytecode program does not return a value");
+        }
+    }
+
+    double Bytecode::run(const double* x, double* r) const
+    {
+        const Instruction* ip = code.data();
+
+#ifdef NEXSYS_THREADED_DISPATCH
+        // Must stay in the same order as `OpCode`
+        static const void* labels[] = {
+            &&L_OpNum, &&L_OpVar, &&L_OpAdd, &&L_OpSub, &&L_OpMul, &&L_OpDiv, &&L_OpPow,
+            &&L_OpAddNum, &&L_OpSubNum, &&L_OpMulNum, &&L_OpDivNum, &&L_OpPowNum, &&L_OpPowI,
+            &&L_OpNumSub, &&L_OpNumDiv, &&L_OpAddVar, &&L_OpSubVar, &&L_OpMulVar, &&L_OpDivVar,
+            &&L_OpVarSub, &&L_OpVarDiv,
+            &&L_OpSin, &&L_OpCos, &&L_OpTan, &&L_OpAsin, &&L_OpAcos, &&L_OpAtan,
+            &&L_OpSinh, &&L_OpCosh, &&L_OpTanh, &&L_OpExp, &&L_OpLog, &&L_OpLog10,
+            &&L_OpSqrt, &&L_OpAbs, &&L_OpMin, &&L_OpMax, &&L_OpHypot,
+            &&L_OpCall, &&L_OpReturn,
+        };
+#define CASE(op) L_##op:
+#define NEXT() ip++; goto *labels[ip->op]
+        goto *labels[ip->op];
+#else
+#define CASE(op) case op:
+#define NEXT() ip++; continue
+        for (;;) switch(ip->op)
+#endif
+        {
+            CASE(OpNum)    r[ip->dst] = ip->imm;                     NEXT();
+            CASE(OpVar)    r[ip->dst] = x[ip->a];                    NEXT();
+            CASE(OpAdd)    r[ip->dst] = r[ip->a] + r[ip->b];         NEXT();
+            CASE(OpSub)    r[ip->dst] = r[ip->a] - r[ip->b];         NEXT();
+            CASE(OpMul)    r[ip->dst] = r[ip->a] * r[ip->b];         NEXT();
+            CASE(OpDiv)    r[ip->dst] = r[ip->a] / r[ip->b];         NEXT();
+            CASE(OpPow)    r[ip->dst] = pow(r[ip->a], r[ip->b]);     NEXT();
+            CASE(OpAddNum) r[ip->dst] = r[ip->a] + ip->imm;          NEXT();
+            CASE(OpSubNum) r[ip->dst] = r[ip->a] - ip->imm;          NEXT();
+            CASE(OpMulNum) r[ip->dst] = r[ip->a] * ip->imm;          NEXT();
+            CASE(OpDivNum) r[ip->dst] = r[ip->a] / ip->imm;          NEXT();
+            CASE(OpPowNum) r[ip->dst] = pow(r[ip->a], ip->imm);      NEXT();
+            CASE(OpPowI)   r[ip->dst] = powi(r[ip->a], (int32_t)ip->b); NEXT();
+            CASE(OpNumSub) r[ip->dst] = ip->imm - r[ip->a];          NEXT();
+            CASE(OpNumDiv) r[ip->dst] = ip->imm / r[ip->a];          NEXT();
+            CASE(OpAddVar) r[ip->dst] = r[ip->a] + x[ip->b];         NEXT();
+            CASE(OpSubVar) r[ip->dst] = r[ip->a] - x[ip->b];         NEXT();
+            CASE(OpMulVar) r[ip->dst] = r[ip->a] * x[ip->b];         NEXT();
+            CASE(OpDivVar) r[ip->dst] = r[ip->a] / x[ip->b];         NEXT();
+            CASE(OpVarSub) r[ip->dst] = x[ip->b] - r[ip->a];         NEXT();
+            CASE(OpVarDiv) r[ip->dst] = x[ip->b] / r[ip->a];         NEXT();
+            CASE(OpSin)    r[ip->dst] = sin(r[ip->a]);               NEXT();
+            CASE(OpCos)    r[ip->dst] = cos(r[ip->a]);               NEXT();
+            CASE(OpTan)    r[ip->dst] = tan(r[ip->a]);               NEXT();
+            CASE(OpAsin)   r[ip->dst] = asin(r[ip->a]);              NEXT();
+            CASE(OpAcos)   r[ip->dst] = acos(r[ip->a]);              NEXT();
+            CASE(OpAtan)   r[ip->dst] = atan(r[ip->a]);              NEXT();
+            CASE(OpSinh)   r[ip->dst] = sinh(r[ip->a]);              NEXT();
+            CASE(OpCosh)   r[ip->dst] = cosh(r[ip->a]);              NEXT();
+            CASE(OpTanh)   r[ip->dst] = tanh(r[ip->a]);              NEXT();
+            CASE(OpExp)    r[ip->dst] = exp(r[ip->a]);               NEXT();
+            CASE(OpLog)    r[ip->dst] = log(r[ip->a]);               NEXT();
+            CASE(OpLog10)  r[ip->dst] = log10(r[ip->a]);             NEXT();
+            CASE(OpSqrt)   r[ip->dst] = sqrt(r[ip->a]);              NEXT();
+            CASE(OpAbs)    r[ip->dst] = fabs(r[ip->a]);              NEXT();
+            CASE(OpMin)    r[ip->dst] = intrinsic_min(r[ip->a], r[ip->b]); NEXT();
+            CASE(OpMax)    r[ip->dst] = intrinsic_max(r[ip->a], r[ip->b]); NEXT();
+            CASE(OpHypot)  r[ip->dst] = hypot(r[ip->a], r[ip->b]);   NEXT();
+            CASE(OpCall)   r[ip->dst] = ip->function->func(r + ip->a); NEXT();
+            CASE(OpReturn) return r[ip->a];
+        }
+#undef CASE
+#undef NEXT
+    }
+
+    size_t Bytecode::get_frame_size() const
+    {
+        return frame_size;
+    }
+
+    const vector<Instruction>& Bytecode::get_code() const
+    {
+        return code;
+    }
+}
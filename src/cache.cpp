@@ -0,0 +1,189 @@
+#include "cache.hpp"
+
+#include <cstring>
+
+using std::lock_guard;
+using std::mutex;
+using std::string;
+using std::vector;
+
+namespace nexsys
+{
+    /// @brief Helper function to build a cache key from an expression's lexemes and what each
+    /// symbol resolves to in a `ContextMap`. Variables only contribute their kind, since they are
+    /// referred to by name in the compiled program.
+    static string make_key(const string& expr, const ContextMap& ctx)
+    {
+        string text;
+        string signature;
+        string symbol;
+        Lexer lexer(expr);
+        for (Lexeme lex = lexer.next(); lex.type != LexEnd; lex = lexer.next())
+        {
+            text.append(lex.text.data(), lex.text.size());
+            text.push_back(' ');
+            if (lex.type != LexSymbol)
+            {
+                continue;
+            }
+
+            symbol.assign(lex.text.data(), lex.text.size());
+            auto known = ctx.find(symbol);
+            if (known == ctx.end())
+            {
+                // Either a built-in function or an error, neither of which depends on the context
+                signature.push_back('?');
+                continue;
+            }
+
+            double num;
+            FunctionDataPtr function;
+            char raw[sizeof(double)];
+            if (known->second.try_unwrap_num(num))
+            {
+                memcpy(raw, &num, sizeof(raw));
+                signature.push_back('n');
+                signature.append(raw, sizeof(raw));
+            }
+            else if (known->second.try_unwrap_func_data(function))
+            {
+                memcpy(raw, &function, sizeof(function));
+                signature.push_back('f');
+                signature.append(raw, sizeof(function));
+            }
+            else
+            {
+                signature.push_back('v');
+            }
+        }
+
+        text.push_back('\0');
+        return text + signature;
+    }
+
+    CompileCache::CompileCache(size_t capacity, size_t shard_count): hits(0), misses(0), evictions(0)
+    {
+        if (capacity == 0 || shard_count == 0)
+        {
+            throw std::invalid_argument("cache capacity and shard count must be positive");
+        }
+
+        for (size_t i = 0; i < shard_count; i++)
+        {
+            shards.push_back(std::make_unique<_Shard>());
+        }
+        shard_capacity = (capacity + shard_count - 1) / shard_count;
+    }
+
+    CompiledExpression CompileCache::compile(const string& expr, const ContextMap& ctx, VariableIndex& index)
+    {
+        string key = make_key(expr, ctx);
+        _Shard& shard = *shards[std::hash<string>()(key) % shards.size()];
+
+        CompiledExpression compiled;
+        vector<string> names;
+        bool found = false;
+        {
+            lock_guard<mutex> guard(shard.lock);
+            auto entry = shard.entries.find(key);
+            if (entry != shard.entries.end())
+            {
+                shard.recency.splice(shard.recency.begin(), shard.recency, entry->second.recency);
+                compiled = entry->second.expr;
+                names = entry->second.names;
+                found = true;
+            }
+        }
+
+        if (found)
+        {
+            hits.fetch_add(1, std::memory_order_relaxed);
+        }
+        else
+        {
+            // Compile outside of the lock so that slow compilations do not block other lookups
+            misses.fetch_add(1, std::memory_order_relaxed);
+
+            VariableIndex local;
+            compiled = compile_to_expression(expr, ctx, local);
+            for (size_t slot = 0; slot < local.size(); slot++)
+            {
+                names.push_back(local.get_name(slot));
+            }
+
+            lock_guard<mutex> guard(shard.lock);
+            if (shard.entries.find(key) == shard.entries.end())
+            {
+                shard.recency.push_front(key);
+                shard.entries.emplace(key, _Entry { compiled, names, shard.recency.begin() });
+
+                if (shard.entries.size() > shard_capacity)
+                {
+                    shard.entries.erase(shard.recency.back());
+                    shard.recency.pop_back();
+                    evictions.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+        }
+
+        // Rebind the entry's variables to the caller's index, reusing the lowered program if nothing moved
+        vector<size_t> slots;
+        bool moved = false;
+        for (size_t local_slot = 0; local_slot < names.size(); local_slot++)
+        {
+            slots.push_back(index.insert(names[local_slot]));
+            moved = moved || slots.back() != local_slot;
+        }
+
+        if (!moved)
+        {
+            return compiled;
+        }
+
+        vector<SlotToken> program = compiled.get_program();
+        for (auto& tok: program)
+        {
+            if (tok.type == Var)
+            {
+                tok.operand = slots[tok.operand];
+            }
+        }
+        return CompiledExpression(move(program));
+    }
+
+    void CompileCache::clear()
+    {
+        for (auto& shard: shards)
+        {
+            lock_guard<mutex> guard(shard->lock);
+            shard->entries.clear();
+            shard->recency.clear();
+        }
+    }
+
+    size_t CompileCache::size() const
+    {
+        size_t total = 0;
+        for (auto& shard: shards)
+        {
+            lock_guard<mutex> guard(shard->lock);
+            total += shard->entries.size();
+        }
+        return total;
+    }
+
+    size_t CompileCache::get_hits() const
+    {
+        return hits.load(std::memory_order_relaxed);
+    }
+
+    size_t CompileCache::get_misses() const
+    {
+        return misses.load(std::memory_order_relaxed);
+    }
+
+    size_t CompileCache::get_evictions() const
+    {
+        return evictions.load(std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,339 @@
+#include "compiled.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+using std::move;
+using std::string;
+using std::unordered_map;
+using std::vector;
+
+namespace nexsys
+{
+    VariableIndex::VariableIndex(vector<string> names)
+    {
+        for (auto name: names)
+        {
+            insert(move(name));
+        }
+    }
+
+    size_t VariableIndex::insert(string name)
+    {
+        auto existing = slots.find(name);
+        if (existing != slots.end())
+        {
+            return existing->second;
+        }
+
+        size_t slot = names.size();
+        slots.emplace(name, slot);
+        names.push_back(move(name));
+
+        return slot;
+    }
+
+    bool VariableIndex::try_get_slot(const string& name, size_t& slot) const
+    {
+        auto existing = slots.find(name);
+        if (existing == slots.end())
+        {
+            return false;
+        }
+
+        slot = existing->second;
+        return true;
+    }
+
+    const string& VariableIndex::get_name(size_t slot) const
+    {
+        return names[slot];
+    }
+
+    size_t VariableIndex::size() const
+    {
+        return names.size();
+    }
+
+    vector<double> VariableIndex::to_slots(const unordered_map<string, double>& values) const
+    {
+        vector<double> x(names.size(), 0.0);
+        for (size_t i = 0; i < names.size(); i++)
+        {
+            auto value = values.find(names[i]);
+            if (value == values.end())
+            {
+                throw std::invalid_argument("no value was given for variable '" + names[i] + "'");
+            }
+            x[i] = value->second;
+        }
+
+        return x;
+    }
+
+    unordered_map<string, double> VariableIndex::from_slots(const double* x) const
+    {
+        unordered_map<string, double> values;
+        for (size_t i = 0; i < names.size(); i++)
+        {
+            values.emplace(names[i], x[i]);
+        }
+
+        return values;
+    }
+
+    /// @brief Frames at most this large are placed on the stack when evaluating a `CompiledExpression`
+    constexpr size_t SMALL_FRAME_SIZE = 32;
+
+    CompiledExpression::CompiledExpression(): removed(0)
+    {
+        SlotToken zero;
+        zero.type = Num;
+        zero.operand = 0;
+        zero.value = 0.0;
+        program.push_back(zero);
+        code = Bytecode(program);
+    }
+
+    CompiledExpression::CompiledExpression(vector<SlotToken> program): program(move(program))
+    {
+        removed = simplify_program(this->program);
+        code = Bytecode(this->program);
+    }
+
+    double CompiledExpression::evaluate(const double* x) const
+    {
+        if (code.get_frame_size() <= SMALL_FRAME_SIZE)
+        {
+            double frame[SMALL_FRAME_SIZE];
+            return evaluate(x, frame);
+        }
+
+        thread_local vector<double> frame;
+        if (frame.size() < code.get_frame_size())
+        {
+            frame.resize(code.get_frame_size());
+        }
+        return evaluate(x, frame.data());
+    }
+
+    bool CompiledExpression::try_set_backend(Backend backend)
+    {
+        if (backend == Interpreter)
+        {
+            jit.reset();
+            return true;
+        }
+
+        if (jit)
+        {
+            return true;
+        }
+
+        if (!JitCode::is_supported())
+        {
+            return false;
+        }
+
+        try
+        {
+            jit = std::make_shared<JitCode>(code);
+        }
+        catch (const std::runtime_error&)
+        {
+            return false;
+        }
+        return true;
+    }
+
+    Backend CompiledExpression::get_backend() const
+    {
+        return jit ? Jit : Interpreter;
+    }
+
+    const vector<SlotToken>& CompiledExpression::get_program() const
+    {
+        return program;
+    }
+
+    size_t CompiledExpression::get_removed_count() const
+    {
+        return removed;
+    }
+
+    const Bytecode& CompiledExpression::get_bytecode() const
+    {
+        return code;
+    }
+
+    vector<size_t> CompiledExpression::get_slots() const
+    {
+        vector<size_t> slots;
+        for (auto& tok: program)
+        {
+            if (tok.type == Var)
+            {
+                slots.push_back(tok.operand);
+            }
+        }
+
+        std::sort(slots.begin(), slots.end());
+        slots.erase(std::unique(slots.begin(), slots.end()), slots.end());
+        return slots;
+    }
+
+    size_t CompiledExpression::get_depth() const
+    {
+        return code.get_frame_size();
+    }
+
+    /// @brief Helper function to convert a reverse polish notation expression to a program
+    /// @param slot_of Called as `slot_of(symbol)` with the name of each variable, returning the operand of its `Var` token
+    template<typename SlotOf>
+    static vector<SlotToken> to_program(const vector<Token>& rpn_expr, const vector<std::string_view>& symbols, SlotOf slot_of)
+    {
+        vector<SlotToken> program;
+        program.reserve(rpn_expr.size());
+        for (size_t i = 0; i < rpn_expr.size(); i++)
+        {
+            const Token& tok = rpn_expr[i];
+            SlotToken stok;
+            stok.type = tok.get_type();
+            stok.operand = 0;
+            stok.value = 0.0;
+
+            switch(stok.type)
+            {
+                case Num:
+                    (void)tok.try_unwrap_num(stok.value);
+                    break;
+
+                case Var:
+                    stok.operand = slot_of(symbols[i]);
+                    break;
+
+                case Func:
+                    (void)tok.try_unwrap_func_data(stok.function);
+                    stok.operand = stok.function->argc;
+                    break;
+
+                default:
+                    break;
+            }
+
+            program.push_back(stok);
+        }
+
+        return program;
+    }
+
+    /// @brief Helper function to resolve the variables of a reverse polish notation expression to slots
+    static CompiledExpression to_compiled(const vector<Token>& rpn_expr, const vector<std::string_view>& symbols, VariableIndex& index)
+    {
+        string name;
+        return CompiledExpression(to_program(rpn_expr, symbols, [&](std::string_view symbol) {
+            size_t slot;
+            name.assign(symbol.data(), symbol.size());
+            return index.try_get_slot(name, slot) ? slot : index.insert(name);
+        }));
+    }
+
+    CompiledExpression compile_to_expression(const string& expr, const ContextMap& ctx, VariableIndex& index)
+    {
+        vector<std::string_view> symbols;
+        auto rpn_expr = rpnify(expr, ctx, symbols);
+        return to_compiled(rpn_expr, symbols, index);
+    }
+
+    CompiledExpression compile_to_expression(const string& expr, const ContextView& ctx, VariableIndex& index)
+    {
+        vector<std::string_view> symbols;
+        auto rpn_expr = rpnify(expr, ctx, symbols);
+        return to_compiled(rpn_expr, symbols, index);
+    }
+
+    /// @brief Parsing scratch space owned by one worker of `compile_all`
+    struct _CompileScratch
+    {
+        vector<Token> rpn_expr;
+        vector<std::string_view> symbols;
+    };
+
+    /// @brief Expressions are handed to workers in chunks of this many, so that a few long ones do not leave threads idle
+    constexpr size_t COMPILE_CHUNK = 64;
+
+    vector<CompileResult> compile_all(const vector<string>& exprs, const ContextView& ctx, VariableIndex& index, ThreadPool& pool)
+    {
+        vector<CompileResult> results(exprs.size());
+        vector<vector<SlotToken>> programs(exprs.size());
+        vector<_CompileScratch> scratch(pool.size());
+
+        // Parse in parallel. Variables are numbered by their ID in the context until slots are assigned.
+        pool.parallel_for(exprs.size(), COMPILE_CHUNK, [&](size_t begin, size_t end, size_t worker) {
+            _CompileScratch& local = scratch[worker];
+            for (size_t i = begin; i < end; i++)
+            {
+                try
+                {
+                    rpnify(exprs[i], ctx, local.rpn_expr, local.symbols);
+                    programs[i] = to_program(local.rpn_expr, local.symbols, [&](std::string_view symbol) {
+                        uint32_t id = 0;
+                        (void)ctx.try_get_id(symbol, id);
+                        return (size_t)id;
+                    });
+                }
+                catch (const std::exception& e)
+                {
+                    results[i].error = e.what();
+                }
+            }
+        });
+
+        // Assign slots in input order so that they match a serial compilation
+        vector<size_t> slots(ctx.size(), SIZE_MAX);
+        for (size_t i = 0; i < exprs.size(); i++)
+        {
+            for (auto& tok: programs[i])
+            {
+                if (tok.type != Var)
+                {
+                    continue;
+                }
+
+                size_t& slot = slots[tok.operand];
+                if (slot == SIZE_MAX && !index.try_get_slot(ctx.get_name(tok.operand), slot))
+                {
+                    slot = index.insert(ctx.get_name(tok.operand));
+                }
+                tok.operand = slot;
+            }
+        }
+
+        // Lower to bytecode in parallel
+        pool.parallel_for(exprs.size(), COMPILE_CHUNK, [&](size_t begin, size_t end, size_t) {
+            for (size_t i = begin; i < end; i++)
+            {
+                if (!results[i].ok())
+                {
+                    continue;
+                }
+
+                try
+                {
+                    results[i].expr = CompiledExpression(move(programs[i]));
+                }
+                catch (const std::exception& e)
+                {
+                    results[i].error = e.what();
+                }
+            }
+        });
+
+        return results;
+    }
+
+    vector<CompileResult> compile_all(const vector<string>& exprs, const ContextMap& ctx, VariableIndex& index, ThreadPool& pool)
+    {
+        return compile_all(exprs, ContextView(ctx), index, pool);
+    }
+}
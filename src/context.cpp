@@ -1,9 +1,17 @@
 #include "context.hpp"
+#include <cmath>
+#include <deque>
 #include <iostream>
+#include <mutex>
+#include <stdexcept>
 
+using std::deque;
+using std::lock_guard;
 using std::move;
+using std::mutex;
 using std::pair;
 using std::string;
+using std::vector;
 
 namespace nexsys
 {
@@ -13,11 +21,135 @@ namespace nexsys
         return static_cast<FunctionDataPtr>(value._phantom_ptr);
     }
 
+    /// @brief Helper function to get a stable `FunctionDataPtr` for a function. Each distinct 
+    /// function is stored once for the lifetime of the program so that `Token`s may be 
+    /// freely copied between `ContextMap`s without any ownership concerns.
+    static FunctionDataPtr intern_function(size_t argc, double (*value)(double[]), vector<double (*)(double[])> derivatives)
+    {
+        static mutex interned_lock;
+        static deque<FunctionData> interned;
+
+        if (derivatives.size() != 0 && derivatives.size() != argc)
+        {
+            throw std::invalid_argument("a function must have one derivative per argument");
+        }
+
+        lock_guard<mutex> guard(interned_lock);
+        for (auto& data: interned)
+        {
+            if (data.argc == argc && data.func == value && data.derivatives == derivatives)
+            {
+                return &data;
+            }
+        }
+
+        interned.push_back(FunctionData { argc, value, move(derivatives), IntrNone });
+        return &interned.back();
+    }
+
+    // Scalar implementations of the built-in functions and their partial derivatives, in the
+    // form of user functions
+    static double intr_sin(double args[])   { return sin(args[0]); }
+    static double intr_cos(double args[])   { return cos(args[0]); }
+    static double intr_tan(double args[])   { return tan(args[0]); }
+    static double intr_asin(double args[])  { return asin(args[0]); }
+    static double intr_acos(double args[])  { return acos(args[0]); }
+    static double intr_atan(double args[])  { return atan(args[0]); }
+    static double intr_sinh(double args[])  { return sinh(args[0]); }
+    static double intr_cosh(double args[])  { return cosh(args[0]); }
+    static double intr_tanh(double args[])  { return tanh(args[0]); }
+    static double intr_exp(double args[])   { return exp(args[0]); }
+    static double intr_log(double args[])   { return log(args[0]); }
+    static double intr_log10(double args[]) { return log10(args[0]); }
+    static double intr_sqrt(double args[])  { return sqrt(args[0]); }
+    static double intr_abs(double args[])   { return fabs(args[0]); }
+    static double intr_min(double args[])   { return args[0] < args[1] || args[0] != args[0] ? args[0] : args[1]; }
+    static double intr_max(double args[])   { return args[0] > args[1] || args[0] != args[0] ? args[0] : args[1]; }
+    static double intr_hypot(double args[]) { return hypot(args[0], args[1]); }
+
+    static double intr_neg_sin(double args[])     { return -sin(args[0]); }
+    static double intr_sec2(double args[])        { return 1.0 / (cos(args[0]) * cos(args[0])); }
+    static double intr_asin_prime(double args[])  { return 1.0 / sqrt(1.0 - args[0] * args[0]); }
+    static double intr_acos_prime(double args[])  { return -1.0 / sqrt(1.0 - args[0] * args[0]); }
+    static double intr_atan_prime(double args[])  { return 1.0 / (1.0 + args[0] * args[0]); }
+    static double intr_sech2(double args[])       { return 1.0 / (cosh(args[0]) * cosh(args[0])); }
+    static double intr_reciprocal(double args[])  { return 1.0 / args[0]; }
+    static double intr_log10_prime(double args[]) { return 1.0 / (args[0] * M_LN10); }
+    static double intr_sqrt_prime(double args[])  { return 0.5 / sqrt(args[0]); }
+    static double intr_sign(double args[])        { return args[0] > 0.0 ? 1.0 : (args[0] < 0.0 ? -1.0 : 0.0); }
+    static double intr_min_lhs(double args[])     { return args[0] < args[1] ? 1.0 : 0.0; }
+    static double intr_min_rhs(double args[])     { return args[0] < args[1] ? 0.0 : 1.0; }
+    static double intr_max_lhs(double args[])     { return args[0] > args[1] ? 1.0 : 0.0; }
+    static double intr_max_rhs(double args[])     { return args[0] > args[1] ? 0.0 : 1.0; }
+    static double intr_hypot_lhs(double args[])   { return args[0] / hypot(args[0], args[1]); }
+    static double intr_hypot_rhs(double args[])   { return args[1] / hypot(args[0], args[1]); }
+
+    /// @brief The name and `FunctionData` of each built-in function, indexed by `Intrinsic`
+    struct _IntrinsicTable
+    {
+        vector<FunctionData> functions;
+        vector<string> names;
+
+        _IntrinsicTable()
+        {
+            add("",      IntrNone,  0, nullptr,    {});
+            add("sin",   IntrSin,   1, intr_sin,   {intr_cos});
+            add("cos",   IntrCos,   1, intr_cos,   {intr_neg_sin});
+            add("tan",   IntrTan,   1, intr_tan,   {intr_sec2});
+            add("asin",  IntrAsin,  1, intr_asin,  {intr_asin_prime});
+            add("acos",  IntrAcos,  1, intr_acos,  {intr_acos_prime});
+            add("atan",  IntrAtan,  1, intr_atan,  {intr_atan_prime});
+            add("sinh",  IntrSinh,  1, intr_sinh,  {intr_cosh});
+            add("cosh",  IntrCosh,  1, intr_cosh,  {intr_sinh});
+            add("tanh",  IntrTanh,  1, intr_tanh,  {intr_sech2});
+            add("exp",   IntrExp,   1, intr_exp,   {intr_exp});
+            add("log",   IntrLog,   1, intr_log,   {intr_reciprocal});
+            add("log10", IntrLog10, 1, intr_log10, {intr_log10_prime});
+            add("sqrt",  IntrSqrt,  1, intr_sqrt,  {intr_sqrt_prime});
+            add("abs",   IntrAbs,   1, intr_abs,   {intr_sign});
+            add("min",   IntrMin,   2, intr_min,   {intr_min_lhs, intr_min_rhs});
+            add("max",   IntrMax,   2, intr_max,   {intr_max_lhs, intr_max_rhs});
+            add("hypot", IntrHypot, 2, intr_hypot, {intr_hypot_lhs, intr_hypot_rhs});
+        }
+
+        void add(const char* name, Intrinsic id, size_t argc, double (*value)(double[]), vector<double (*)(double[])> derivatives)
+        {
+            if ((size_t)id != functions.size())
+            {
+                throw std::logic_error("built-in functions must be listed in the order of `Intrinsic`");
+            }
+            functions.push_back(FunctionData { argc, value, move(derivatives), id });
+            names.push_back(name);
+        }
+    };
+
+    /// @brief Helper function to get the table of built-in functions, built on first use
+    static const _IntrinsicTable& intrinsics()
+    {
+        static const _IntrinsicTable table;
+        return table;
+    }
+
+    /// @brief Helper function to get the `Token` of each built-in function, indexed by `Intrinsic`
+    static const vector<Token>& intrinsic_tokens()
+    {
+        static const vector<Token> tokens = []()
+        {
+            vector<Token> built(intrinsics().functions.size());
+            for (size_t id = 1; id < built.size(); id++)
+            {
+                built[id] = Token::intrinsic((Intrinsic)id);
+            }
+            return built;
+        }();
+        return tokens;
+    }
+
     /// @brief Helper function to convert a function pointer to a token's value.
-    static _TokenValue from_function(size_t argc, double (*value)(double[]))
+    static _TokenValue from_function(size_t argc, double (*value)(double[]), vector<double (*)(double[])> derivatives)
     {
         _TokenValue tkv;
-        tkv._phantom_ptr = reinterpret_cast<void*>(value); // Is this safe?
+        tkv._phantom_ptr = const_cast<void*>(static_cast<const void*>(intern_function(argc, value, move(derivatives))));
         return tkv;
     }
 
@@ -131,10 +263,24 @@ namespace nexsys
     }
 
     Token Token::func(size_t argc, double (*value)(double[]))
+    {
+        return Token::func(argc, value, {});
+    }
+
+    Token Token::func(size_t argc, double (*value)(double[]), vector<double (*)(double[])> derivatives)
     {
         Token tk;
         tk.type = Func;
-        tk.value = from_function(argc, value);
+        tk.value = from_function(argc, value, move(derivatives));
+
+        return tk;
+    }
+
+    Token Token::intrinsic(Intrinsic id)
+    {
+        Token tk;
+        tk.type = Func;
+        tk.value._phantom_ptr = const_cast<void*>(static_cast<const void*>(intrinsic_function(id)));
 
         return tk;
     }
@@ -168,16 +314,27 @@ namespace nexsys
 
     bool Token::try_unwrap_func(size_t& argc, double (*& value)(double[])) const
     {
-        if (this->type != Var)
+        if (this->type != Func)
         {
             return false;
         }
 
         auto values = to_function(this->value);
 
-        argc = values->first;
-        value = values->second;
+        argc = values->argc;
+        value = values->func;
+
+        return true;
+    }
+
+    bool Token::try_unwrap_func_data(FunctionDataPtr& value) const
+    {
+        if (this->type != Func)
+        {
+            return false;
+        }
 
+        value = to_function(this->value);
         return true;
     }
 
@@ -211,6 +368,16 @@ namespace nexsys
         ));
     }
 
+    void ContextMap::add_func_to_ctx(string symbol, size_t argc, double (*value)(double[]), vector<double (*)(double[])> derivatives)
+    {
+        this->insert(move(
+            pair<string, Token>(
+                symbol,
+                move(Token::func(argc, value, move(derivatives)))
+            )
+        ));
+    }
+
     ContextMap::~ContextMap()
     {
         for (std::string var: malloced_vars)
@@ -221,6 +388,30 @@ namespace nexsys
         }
     }
 
+    FunctionDataPtr intrinsic_function(Intrinsic id)
+    {
+        auto& table = intrinsics();
+        if (id == IntrNone || (size_t)id >= table.functions.size())
+        {
+            throw std::invalid_argument("not a built-in function");
+        }
+        return &table.functions[id];
+    }
+
+    bool try_get_intrinsic(std::string_view symbol, const Token*& token)
+    {
+        auto& table = intrinsics();
+        for (size_t id = 1; id < table.names.size(); id++)
+        {
+            if (table.names[id] == symbol)
+            {
+                token = &intrinsic_tokens()[id];
+                return true;
+            }
+        }
+        return false;
+    }
+
     /// @brief 
     /// @param expr 
     /// @param result 
@@ -282,7 +473,7 @@ namespace nexsys
         }
     }
 
-    Token tokenize_with_context(std::string token_like, ContextMap ctx)
+    Token tokenize_with_context(const std::string& token_like, const ContextMap& ctx)
     {
         Token token;
         if (try_tokenize(token_like, token))
@@ -297,6 +488,60 @@ namespace nexsys
             return token;
         }
 
-        throw; // TODO
+        const Token* intrinsic;
+        if (try_get_intrinsic(token_like, intrinsic))
+        {
+            return *intrinsic;
+        }
+
+        throw std::invalid_argument("unrecognized symbol '" + token_like + "'");
+    }
+
+    ContextView::ContextView(): data(std::make_shared<_Data>()) {}
+
+    ContextView::ContextView(const ContextMap& ctx)
+    {
+        auto view = std::make_shared<_Data>();
+
+        // Reserve up front so that the interned names never move once `ids` refers to them
+        view->names.reserve(ctx.size());
+        view->tokens.reserve(ctx.size());
+        view->ids.reserve(ctx.size());
+        for (auto& entry: ctx)
+        {
+            uint32_t id = (uint32_t)view->names.size();
+            view->names.push_back(entry.first);
+            view->tokens.push_back(entry.second);
+            view->ids.emplace(std::string_view(view->names.back()), id);
+        }
+
+        data = move(view);
+    }
+
+    bool ContextView::try_get_id(std::string_view symbol, uint32_t& id) const
+    {
+        auto found = data->ids.find(symbol);
+        if (found == data->ids.end())
+        {
+            return false;
+        }
+
+        id = found->second;
+        return true;
+    }
+
+    const Token& ContextView::get_token(uint32_t id) const
+    {
+        return data->tokens[id];
+    }
+
+    const std::string& ContextView::get_name(uint32_t id) const
+    {
+        return data->names[id];
+    }
+
+    size_t ContextView::size() const
+    {
+        return data->names.size();
     }
 }
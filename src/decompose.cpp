@@ -0,0 +1,183 @@
+#include "decompose.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+using std::vector;
+
+namespace nexsys
+{
+    BlockDecomposition::BlockDecomposition(): largest(0) {}
+
+    BlockDecomposition::BlockDecomposition(const vector<CompiledExpression>& system): largest(0)
+    {
+        const size_t none = (size_t)-1;
+        size_t n = system.size();
+
+        vector<vector<size_t>> reads(n);
+        for (size_t i = 0; i < n; i++)
+        {
+            for (size_t slot: system[i].get_slots())
+            {
+                if (slot < n)
+                {
+                    reads[i].push_back(slot);
+                }
+            }
+        }
+
+        // Match what can be matched greedily, then the rest along augmenting paths
+        vector<size_t> matched_unknown(n, none);
+        vector<size_t> matched_equation(n, none);
+        for (size_t i = 0; i < n; i++)
+        {
+            for (size_t j: reads[i])
+            {
+                if (matched_equation[j] == none)
+                {
+                    matched_unknown[i] = j;
+                    matched_equation[j] = i;
+                    break;
+                }
+            }
+        }
+
+        // Each entry of `path` is an equation and how many of the unknowns it reads have been tried
+        vector<size_t> visited(n, none);
+        vector<std::pair<size_t, size_t>> path;
+        for (size_t root = 0; root < n; root++)
+        {
+            if (matched_unknown[root] != none)
+            {
+                continue;
+            }
+
+            bool found = false;
+            path.assign(1, {root, 0});
+            while (!path.empty())
+            {
+                size_t i = path.back().first;
+                size_t tried = path.back().second;
+                if (tried == reads[i].size())
+                {
+                    path.pop_back();
+                    continue;
+                }
+
+                size_t j = reads[i][tried];
+                path.back().second++;
+                if (visited[j] == root)
+                {
+                    continue;
+                }
+                visited[j] = root;
+
+                if (matched_equation[j] == none)
+                {
+                    found = true;
+                    break;
+                }
+                path.push_back({matched_equation[j], 0});
+            }
+
+            if (!found)
+            {
+                throw std::runtime_error("system is structurally singular");
+            }
+
+            // Every equation on the path takes the unknown it last tried, freeing its old one for the equation before it
+            for (auto& [i, tried]: path)
+            {
+                size_t j = reads[i][tried - 1];
+                matched_unknown[i] = j;
+                matched_equation[j] = i;
+            }
+        }
+
+        // Tarjan's algorithm over equations, where each equation points to the ones matched to the unknowns it reads.
+        // Components are completed only after every component they point to, which is the order they must be solved in.
+        vector<size_t> index(n, none);
+        vector<size_t> low(n, 0);
+        vector<bool> on_stack(n, false);
+        vector<size_t> stack;
+        vector<std::pair<size_t, size_t>> calls;
+        size_t counter = 0;
+        for (size_t start = 0; start < n; start++)
+        {
+            if (index[start] != none)
+            {
+                continue;
+            }
+
+            index[start] = low[start] = counter++;
+            stack.push_back(start);
+            on_stack[start] = true;
+            calls.push_back({start, 0});
+            while (!calls.empty())
+            {
+                size_t v = calls.back().first;
+                size_t next = calls.back().second;
+                if (next < reads[v].size())
+                {
+                    calls.back().second++;
+                    size_t w = matched_equation[reads[v][next]];
+                    if (index[w] == none)
+                    {
+                        index[w] = low[w] = counter++;
+                        stack.push_back(w);
+                        on_stack[w] = true;
+                        calls.push_back({w, 0});
+                    }
+                    else if (on_stack[w])
+                    {
+                        low[v] = std::min(low[v], index[w]);
+                    }
+                    continue;
+                }
+
+                calls.pop_back();
+                if (!calls.empty())
+                {
+                    size_t u = calls.back().first;
+                    low[u] = std::min(low[u], low[v]);
+                }
+
+                if (low[v] != index[v])
+                {
+                    continue;
+                }
+
+                Block block;
+                size_t w;
+                do
+                {
+                    w = stack.back();
+                    stack.pop_back();
+                    on_stack[w] = false;
+                    block.equations.push_back(w);
+                    block.unknowns.push_back(matched_unknown[w]);
+                } while (w != v);
+
+                std::sort(block.equations.begin(), block.equations.end());
+                std::sort(block.unknowns.begin(), block.unknowns.end());
+                largest = std::max(largest, block.equations.size());
+                blocks.push_back(std::move(block));
+            }
+        }
+    }
+
+    const vector<Block>& BlockDecomposition::get_blocks() const
+    {
+        return blocks;
+    }
+
+    size_t BlockDecomposition::get_block_count() const
+    {
+        return blocks.size();
+    }
+
+    size_t BlockDecomposition::get_largest_block_size() const
+    {
+        return largest;
+    }
+}
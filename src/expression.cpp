@@ -0,0 +1,452 @@
+#include "expression.hpp"
+
+#include <cmath>
+#include <stdexcept>
+
+using std::make_shared;
+using std::move;
+using std::vector;
+
+namespace nexsys
+{
+    /// @brief Helper function to get the `FunctionDataPtr` of a partial derivative callback. Partial 
+    /// derivatives have no derivatives of their own, so they can only be differentiated once.
+    static FunctionDataPtr partial_function(size_t argc, double (*partial)(double[]))
+    {
+        FunctionDataPtr partial_data;
+        (void)Token::func(argc, partial).try_unwrap_func_data(partial_data);
+        return partial_data;
+    }
+
+    ExprPtr make_num(double value)
+    {
+        auto node = make_shared<ExprNode>();
+        node->type = Num;
+        node->value = value;
+        node->slot = 0;
+        node->function = nullptr;
+        return node;
+    }
+
+    ExprPtr make_var(size_t slot)
+    {
+        auto node = make_shared<ExprNode>();
+        node->type = Var;
+        node->value = 0.0;
+        node->slot = slot;
+        node->function = nullptr;
+        return node;
+    }
+
+    bool is_num(const ExprPtr& node, double value)
+    {
+        return node->type == Num && node->value == value;
+    }
+
+    /// @brief Helper function to apply an operator to two constants
+    static double fold(TokenType type, double lhs, double rhs)
+    {
+        switch(type)
+        {
+            case Plus:  return lhs + rhs;
+            case Minus: return lhs - rhs;
+            case Mul:   return lhs * rhs;
+            case Div:   return lhs / rhs;
+            default:    return pow(lhs, rhs);
+        }
+    }
+
+    ExprPtr make_binary(TokenType type, ExprPtr lhs, ExprPtr rhs)
+    {
+        if (lhs->type == Num && rhs->type == Num)
+        {
+            return make_num(fold(type, lhs->value, rhs->value));
+        }
+
+        switch(type)
+        {
+            case Plus:
+                if (is_num(lhs, 0.0)) return rhs;
+                if (is_num(rhs, 0.0)) return lhs;
+                break;
+
+            case Minus:
+                if (is_num(rhs, 0.0)) return lhs;
+                break;
+
+            case Mul:
+                if (is_num(lhs, 0.0) || is_num(rhs, 0.0)) return make_num(0.0);
+                if (is_num(lhs, 1.0)) return rhs;
+                if (is_num(rhs, 1.0)) return lhs;
+                break;
+
+            case Div:
+                if (is_num(lhs, 0.0)) return make_num(0.0);
+                if (is_num(rhs, 1.0)) return lhs;
+                break;
+
+            case Exp:
+                if (is_num(rhs, 0.0)) return make_num(1.0);
+                if (is_num(rhs, 1.0)) return lhs;
+                break;
+
+            default:
+                throw std::invalid_argument("not a binary operator");
+        }
+
+        auto node = make_shared<ExprNode>();
+        node->type = type;
+        node->value = 0.0;
+        node->slot = 0;
+        node->function = nullptr;
+        node->args = {move(lhs), move(rhs)};
+        return node;
+    }
+
+    ExprPtr make_call(FunctionDataPtr function, vector<ExprPtr> args)
+    {
+        // Built-in functions have no side effects, so they can be evaluated if every argument is known
+        if (function->intrinsic != IntrNone)
+        {
+            double values[2];
+            size_t known = 0;
+            for (; known < args.size() && args[known]->type == Num; known++)
+            {
+                values[known] = args[known]->value;
+            }
+            if (known == args.size())
+            {
+                return make_num(function->func(values));
+            }
+        }
+
+        auto node = make_shared<ExprNode>();
+        node->type = Func;
+        node->value = 0.0;
+        node->slot = 0;
+        node->function = function;
+        node->args = move(args);
+        return node;
+    }
+
+    ExprPtr to_tree(const vector<SlotToken>& program)
+    {
+        vector<ExprPtr> stack;
+        for (auto& tok: program)
+        {
+            switch(tok.type)
+            {
+                case Num:
+                    stack.push_back(make_num(tok.value));
+                    break;
+
+                case Var:
+                    stack.push_back(make_var(tok.operand));
+                    break;
+
+                case Func:
+                {
+                    if (stack.size() < tok.operand)
+                    {
+                        throw std::invalid_argument("function is missing an argument");
+                    }
+                    vector<ExprPtr> args(stack.end() - tok.operand, stack.end());
+                    stack.resize(stack.size() - tok.operand);
+                    stack.push_back(make_call(tok.function, move(args)));
+                    break;
+                }
+
+                default:
+                {
+                    if (stack.size() < 2)
+                    {
+                        throw std::invalid_argument("operator is missing an operand");
+                    }
+                    // Built without `make_binary` so that the tree matches the program exactly
+                    auto node = make_shared<ExprNode>();
+                    node->type = tok.type;
+                    node->value = 0.0;
+                    node->slot = 0;
+                    node->function = nullptr;
+                    node->args = {stack[stack.size() - 2], stack[stack.size() - 1]};
+                    stack.resize(stack.size() - 2);
+                    stack.push_back(node);
+                    break;
+                }
+            }
+        }
+
+        if (stack.size() != 1)
+        {
+            throw std::invalid_argument("expression does not evaluate to a single value");
+        }
+        return stack[0];
+    }
+
+    /// @brief Helper function for `to_rpn`
+    static void append_rpn(const ExprPtr& node, vector<SlotToken>& program)
+    {
+        for (auto& arg: node->args)
+        {
+            append_rpn(arg, program);
+        }
+
+        SlotToken tok;
+        tok.type = node->type;
+        tok.operand = 0;
+        tok.value = 0.0;
+
+        switch(node->type)
+        {
+            case Num:
+                tok.value = node->value;
+                break;
+
+            case Var:
+                tok.operand = node->slot;
+                break;
+
+            case Func:
+                tok.operand = node->args.size();
+                tok.function = node->function;
+                break;
+
+            default:
+                break;
+        }
+
+        program.push_back(tok);
+    }
+
+    vector<SlotToken> to_rpn(const ExprPtr& tree)
+    {
+        vector<SlotToken> program;
+        append_rpn(tree, program);
+        return program;
+    }
+
+    ExprPtr simplify(const ExprPtr& tree)
+    {
+        switch(tree->type)
+        {
+            case Num:
+            case Var:
+                return tree;
+
+            case Func:
+            {
+                vector<ExprPtr> args;
+                for (auto& arg: tree->args)
+                {
+                    args.push_back(simplify(arg));
+                }
+                return make_call(tree->function, move(args));
+            }
+
+            default:
+                return make_binary(tree->type, simplify(tree->args[0]), simplify(tree->args[1]));
+        }
+    }
+
+    /// @brief Helper function to build a call to a built-in function
+    static ExprPtr make_intrinsic(Intrinsic id, vector<ExprPtr> args)
+    {
+        return make_call(intrinsic_function(id), move(args));
+    }
+
+    /// @brief Helper function to differentiate a built-in function whose derivative can be written
+    /// with other built-in functions. Others, such as `min`, fall back to their partial derivative callbacks.
+    /// @return A `bool` indicating if `tree` was differentiated
+    static bool try_differentiate_intrinsic(const ExprPtr& tree, size_t slot, ExprPtr& derivative)
+    {
+        const ExprPtr& u = tree->args[0];
+        ExprPtr du, dv, slope;
+        if (!try_differentiate(u, slot, du))
+        {
+            return false;
+        }
+
+        switch(tree->function->intrinsic)
+        {
+            case IntrSin:
+                slope = make_intrinsic(IntrCos, {u});
+                break;
+
+            case IntrCos:
+                slope = make_binary(Mul, make_num(-1.0), make_intrinsic(IntrSin, {u}));
+                break;
+
+            case IntrTan:
+                slope = make_binary(Div, make_num(1.0), make_binary(Exp, make_intrinsic(IntrCos, {u}), make_num(2.0)));
+                break;
+
+            case IntrAsin:
+                slope = make_binary(Div, make_num(1.0), make_intrinsic(IntrSqrt, {make_binary(Minus, make_num(1.0), make_binary(Exp, u, make_num(2.0)))}));
+                break;
+
+            case IntrAcos:
+                slope = make_binary(Div, make_num(-1.0), make_intrinsic(IntrSqrt, {make_binary(Minus, make_num(1.0), make_binary(Exp, u, make_num(2.0)))}));
+                break;
+
+            case IntrAtan:
+                slope = make_binary(Div, make_num(1.0), make_binary(Plus, make_num(1.0), make_binary(Exp, u, make_num(2.0))));
+                break;
+
+            case IntrSinh:
+                slope = make_intrinsic(IntrCosh, {u});
+                break;
+
+            case IntrCosh:
+                slope = make_intrinsic(IntrSinh, {u});
+                break;
+
+            case IntrTanh:
+                slope = make_binary(Div, make_num(1.0), make_binary(Exp, make_intrinsic(IntrCosh, {u}), make_num(2.0)));
+                break;
+
+            case IntrExp:
+                slope = tree;
+                break;
+
+            case IntrLog:
+                slope = make_binary(Div, make_num(1.0), u);
+                break;
+
+            case IntrLog10:
+                slope = make_binary(Div, make_num(1.0 / M_LN10), u);
+                break;
+
+            case IntrSqrt:
+                slope = make_binary(Div, make_num(0.5), tree);
+                break;
+
+            case IntrHypot:
+            {
+                // d(hypot(u, v)) = (u * du + v * dv) / hypot(u, v)
+                const ExprPtr& v = tree->args[1];
+                if (!try_differentiate(v, slot, dv))
+                {
+                    return false;
+                }
+                derivative = make_binary(Div, make_binary(Plus, make_binary(Mul, u, du), make_binary(Mul, v, dv)), tree);
+                return true;
+            }
+
+            default:
+                return false;
+        }
+
+        derivative = make_binary(Mul, slope, du);
+        return true;
+    }
+
+    bool try_differentiate(const ExprPtr& tree, size_t slot, ExprPtr& derivative)
+    {
+        ExprPtr du, dv;
+        const ExprPtr* u = tree->args.size() > 0 ? &tree->args[0] : nullptr;
+        const ExprPtr* v = tree->args.size() > 1 ? &tree->args[1] : nullptr;
+
+        switch(tree->type)
+        {
+            case Num:
+                derivative = make_num(0.0);
+                return true;
+
+            case Var:
+                derivative = make_num(tree->slot == slot ? 1.0 : 0.0);
+                return true;
+
+            case Func:
+            {
+                if (tree->function->intrinsic != IntrNone && try_differentiate_intrinsic(tree, slot, derivative))
+                {
+                    return true;
+                }
+
+                // Chain rule: sum over each argument of (df/darg_k) * (darg_k/dx)
+                derivative = make_num(0.0);
+                for (size_t k = 0; k < tree->args.size(); k++)
+                {
+                    ExprPtr darg;
+                    if (!try_differentiate(tree->args[k], slot, darg))
+                    {
+                        return false;
+                    }
+                    if (is_num(darg, 0.0))
+                    {
+                        continue;
+                    }
+                    if (tree->function->derivatives.size() == 0)
+                    {
+                        return false;
+                    }
+
+                    auto partial = make_call(partial_function(tree->function->argc, tree->function->derivatives[k]), tree->args);
+                    derivative = make_binary(Plus, derivative, make_binary(Mul, partial, darg));
+                }
+                return true;
+            }
+
+            default:
+                break;
+        }
+
+        if (!try_differentiate(*u, slot, du) || !try_differentiate(*v, slot, dv))
+        {
+            return false;
+        }
+
+        switch(tree->type)
+        {
+            case Plus:
+            case Minus:
+                derivative = make_binary(tree->type, du, dv);
+                break;
+
+            case Mul:
+                derivative = make_binary(Plus, make_binary(Mul, du, *v), make_binary(Mul, *u, dv));
+                break;
+
+            case Div:
+                derivative = make_binary(Div,
+                    make_binary(Minus, make_binary(Mul, du, *v), make_binary(Mul, *u, dv)),
+                    make_binary(Exp, *v, make_num(2.0))
+                );
+                break;
+
+            default: // Exp
+                if (is_num(dv, 0.0))
+                {
+                    // d(u^c) = c * u^(c - 1) * du
+                    derivative = make_binary(Mul,
+                        make_binary(Mul, *v, make_binary(Exp, *u, make_binary(Minus, *v, make_num(1.0)))),
+                        du
+                    );
+                }
+                else
+                {
+                    // d(u^v) = u^v * (dv * ln(u) + v * du / u)
+                    auto ln_u = (*u)->type == Num ? make_num(log((*u)->value)) : make_call(intrinsic_function(IntrLog), {*u});
+                    derivative = make_binary(Mul,
+                        make_binary(Exp, *u, *v),
+                        make_binary(Plus, make_binary(Mul, dv, ln_u), make_binary(Div, make_binary(Mul, *v, du), *u))
+                    );
+                }
+                break;
+        }
+
+        return true;
+    }
+
+    bool try_differentiate(const CompiledExpression& expr, size_t slot, CompiledExpression& derivative)
+    {
+        ExprPtr tree;
+        if (!try_differentiate(to_tree(expr.get_program()), slot, tree))
+        {
+            return false;
+        }
+
+        derivative = CompiledExpression(to_rpn(simplify(tree)));
+        return true;
+    }
+}
@@ -0,0 +1,512 @@
+#include "jacobian.hpp"
+
+#include <algorithm>
+#include <tuple>
+
+using std::vector;
+
+namespace nexsys
+{
+    /// @brief Helper function to zero every element of a jacobian
+    static void clear(Matrix<double>& jacobian)
+    {
+        for (size_t i = 0; i < jacobian.get_rows(); i++)
+        {
+            for (size_t j = 0; j < jacobian.get_cols(); j++)
+            {
+                jacobian.get_index_ref(i, j) = 0.0;
+            }
+        }
+    }
+
+    /// @brief Helper function to zero every entry in the sparsity pattern of a jacobian
+    static void clear(SparseMatrix<double>& jacobian)
+    {
+        std::fill(jacobian.get_values_ref().begin(), jacobian.get_values_ref().end(), 0.0);
+    }
+
+    /// @brief Helper function to write an element of a jacobian
+    static inline void store(Matrix<double>& jacobian, size_t i, size_t j, double value)
+    {
+        jacobian.get_index_ref(i, j) = value;
+    }
+
+    /// @brief Helper function to write an element of a jacobian, skipping elements outside its sparsity pattern, which are structurally zero
+    static inline void store(SparseMatrix<double>& jacobian, size_t i, size_t j, double value)
+    {
+        size_t k;
+        if (jacobian.try_find(i, j, k))
+        {
+            jacobian.get_values_ref()[k] = value;
+        }
+    }
+
+    /// @brief Helper function to write a block of columns of a row of a jacobian from a dual tangent, or zero them if `tangent` is null
+    static inline void store_block(Matrix<double>& jacobian, size_t i, size_t start, size_t stop, const vector<size_t>&, const double* tangent)
+    {
+        for (size_t j = start; j < stop; j++)
+        {
+            jacobian.get_index_ref(i, j) = tangent ? tangent[j - start] : 0.0;
+        }
+    }
+
+    /// @brief Helper function to write a block of columns of a row of a jacobian from a dual tangent, or zero them if `tangent` is null.
+    /// Only the columns the row reads are in the sparsity pattern.
+    static inline void store_block(SparseMatrix<double>& jacobian, size_t i, size_t start, size_t stop, const vector<size_t>& slots, const double* tangent)
+    {
+        for (auto j = std::lower_bound(slots.begin(), slots.end(), start); j != slots.end() && *j < stop; j++)
+        {
+            store(jacobian, i, *j, tangent ? tangent[*j - start] : 0.0);
+        }
+    }
+
+    /// @brief Helper function to pick how many consecutive items of a parallel loop each call of its body takes,
+    /// so that each worker gets a few chunks to balance the load with
+    static inline size_t parallel_chunk(size_t count, const ThreadPool& pool)
+    {
+        return std::max<size_t>(1, count / (4 * pool.size()));
+    }
+
+    /// @brief Helper function to give each worker of a pool its own buffer of at least `size` values
+    template<typename T>
+    static void reserve_workers(vector<vector<T>>& buffers, size_t workers, size_t size)
+    {
+        if (buffers.size() < workers)
+        {
+            buffers.resize(workers);
+        }
+        for (auto& buffer: buffers)
+        {
+            if (buffer.size() < size)
+            {
+                buffer.resize(size);
+            }
+        }
+    }
+
+    /// @brief Helper function to difference the columns `begin` to `end` of a merged system's jacobian
+    static void difference_columns(const CompiledSystem& system, vector<double>& x, const vector<double>& f, Matrix<double>& jacobian, size_t begin, size_t end)
+    {
+        thread_local vector<double> column;
+        column.resize(system.size());
+        for (size_t j = begin; j < end; j++)
+        {
+            double stored = x[j];
+            x[j] += DX;
+            system.evaluate(x.data(), column.data());
+            for (size_t i = 0; i < column.size(); i++)
+            {
+                jacobian.get_index_ref(i, j) = (column[i] - f[i]) / DX;
+            }
+            x[j] = stored;
+        }
+    }
+
+    void finite_difference_jacobian(const vector<CompiledExpression>& system, vector<double>& x, const vector<double>& f, Matrix<double>& jacobian)
+    {
+        for (size_t j = 0; j < jacobian.get_cols(); j++)
+        {
+            double stored = x[j];
+            x[j] += DX;
+            for (size_t i = 0; i < system.size(); i++)
+            {
+                jacobian.get_index_ref(i, j) = (system[i].evaluate(x) - f[i]) / DX;
+            }
+            x[j] = stored;
+        }
+    }
+
+    void finite_difference_jacobian(const CompiledSystem& system, vector<double>& x, const vector<double>& f, Matrix<double>& jacobian, ThreadPool* pool)
+    {
+        if (pool)
+        {
+            // Each worker perturbs its own copy of x
+            auto call = std::tie(system, x, f, jacobian);
+            pool->parallel_for(jacobian.get_cols(), parallel_chunk(jacobian.get_cols(), *pool), [&call](size_t begin, size_t end, size_t) {
+                thread_local vector<double> copy;
+                copy.assign(std::get<1>(call).begin(), std::get<1>(call).end());
+                difference_columns(std::get<0>(call), copy, std::get<2>(call), std::get<3>(call), begin, end);
+            });
+            return;
+        }
+
+        difference_columns(system, x, f, jacobian, 0, jacobian.get_cols());
+    }
+
+    SparseMatrix<double> jacobian_pattern(const vector<CompiledExpression>& system, size_t slots)
+    {
+        vector<size_t> rows, cols;
+        for (size_t i = 0; i < system.size(); i++)
+        {
+            for (size_t j: system[i].get_slots())
+            {
+                if (j < slots)
+                {
+                    rows.push_back(i);
+                    cols.push_back(j);
+                }
+            }
+        }
+        return SparseMatrix<double>::from_triplets(system.size(), slots, rows, cols, vector<double>(rows.size(), 0.0));
+    }
+
+    ColoredJacobian::ColoredJacobian(): n(0), column_start(1, 0), entry_start(1, 0) {}
+
+    ColoredJacobian::ColoredJacobian(const vector<CompiledExpression>& system, size_t slots): n(system.size()), stored(slots)
+    {
+        vector<vector<size_t>> row_slots(n);
+        vector<vector<size_t>> col_rows(slots);
+        for (size_t i = 0; i < n; i++)
+        {
+            for (size_t j: system[i].get_slots())
+            {
+                if (j < slots)
+                {
+                    row_slots[i].push_back(j);
+                    col_rows[j].push_back(i);
+                }
+            }
+        }
+
+        // Color the densest columns first, since they have the most neighbours
+        vector<size_t> order(slots);
+        for (size_t j = 0; j < slots; j++)
+        {
+            order[j] = j;
+        }
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            return col_rows[a].size() > col_rows[b].size();
+        });
+
+        // Two columns conflict if an expression reads both, so each takes the lowest color none of those expressions' other columns have
+        const size_t none = (size_t)-1;
+        colors.assign(slots, none);
+        vector<size_t> forbidden;
+        size_t color_count = 0;
+        for (size_t j: order)
+        {
+            for (size_t i: col_rows[j])
+            {
+                for (size_t k: row_slots[i])
+                {
+                    if (colors[k] != none)
+                    {
+                        forbidden[colors[k]] = j;
+                    }
+                }
+            }
+
+            size_t color = 0;
+            while (color < color_count && forbidden[color] == j)
+            {
+                color++;
+            }
+            if (color == color_count)
+            {
+                color_count++;
+                forbidden.push_back(none);
+            }
+            colors[j] = color;
+        }
+
+        column_start.assign(color_count + 1, 0);
+        entry_start.assign(color_count + 1, 0);
+        for (size_t j = 0; j < slots; j++)
+        {
+            column_start[colors[j] + 1]++;
+            entry_start[colors[j] + 1] += col_rows[j].size();
+        }
+        for (size_t c = 0; c < color_count; c++)
+        {
+            column_start[c + 1] += column_start[c];
+            entry_start[c + 1] += entry_start[c];
+        }
+
+        columns.resize(slots);
+        rows.resize(entry_start[color_count]);
+        cols.resize(entry_start[color_count]);
+        vector<size_t> next_column(column_start.begin(), column_start.end() - 1);
+        vector<size_t> next_entry(entry_start.begin(), entry_start.end() - 1);
+        for (size_t j = 0; j < slots; j++)
+        {
+            size_t c = colors[j];
+            columns[next_column[c]++] = j;
+            for (size_t i: col_rows[j])
+            {
+                rows[next_entry[c]] = i;
+                cols[next_entry[c]] = j;
+                next_entry[c]++;
+            }
+        }
+    }
+
+    void ColoredJacobian::evaluate(const vector<CompiledExpression>& system, vector<double>& x, const vector<double>& f, Matrix<double>& jacobian, ThreadPool* pool)
+    {
+        evaluate_into(system, x, f, jacobian, pool);
+    }
+
+    void ColoredJacobian::evaluate(const vector<CompiledExpression>& system, vector<double>& x, const vector<double>& f, SparseMatrix<double>& jacobian, ThreadPool* pool)
+    {
+        evaluate_into(system, x, f, jacobian, pool);
+    }
+
+    template<typename M>
+    void ColoredJacobian::evaluate_into(const vector<CompiledExpression>& system, vector<double>& x, const vector<double>& f, M& jacobian, ThreadPool* pool)
+    {
+        clear(jacobian);
+
+        if (pool)
+        {
+            // Each worker perturbs its own copy of x, so colors are estimated side by side
+            auto call = std::tie(system, x, f, jacobian);
+            reserve_workers(worker_x, pool->size(), x.size());
+            reserve_workers(worker_saved, pool->size(), x.size());
+            pool->parallel_for(get_color_count(), 1, [this, &call](size_t begin, size_t end, size_t worker) {
+                vector<double>& copy = worker_x[worker];
+                std::copy(std::get<1>(call).begin(), std::get<1>(call).end(), copy.begin());
+                evaluate_colors(std::get<0>(call), copy, worker_saved[worker], std::get<2>(call), std::get<3>(call), begin, end);
+            });
+            return;
+        }
+
+        evaluate_colors(system, x, stored, f, jacobian, 0, get_color_count());
+    }
+
+    template<typename M>
+    void ColoredJacobian::evaluate_colors(const vector<CompiledExpression>& system, vector<double>& x, vector<double>& saved, const vector<double>& f, M& jacobian, size_t begin, size_t end) const
+    {
+        for (size_t c = begin; c < end; c++)
+        {
+            for (size_t k = column_start[c]; k < column_start[c + 1]; k++)
+            {
+                saved[columns[k]] = x[columns[k]];
+                x[columns[k]] += DX;
+            }
+
+            // Each expression reads at most one column of this color, so its change is due to that column alone
+            for (size_t k = entry_start[c]; k < entry_start[c + 1]; k++)
+            {
+                store(jacobian, rows[k], cols[k], (system[rows[k]].evaluate(x) - f[rows[k]]) / DX);
+            }
+
+            for (size_t k = column_start[c]; k < column_start[c + 1]; k++)
+            {
+                x[columns[k]] = saved[columns[k]];
+            }
+        }
+    }
+
+    size_t ColoredJacobian::get_color_count() const
+    {
+        return column_start.size() - 1;
+    }
+
+    size_t ColoredJacobian::get_nonzero_count() const
+    {
+        return rows.size();
+    }
+
+    const vector<size_t>& ColoredJacobian::get_colors() const
+    {
+        return colors;
+    }
+
+    SymbolicJacobian::SymbolicJacobian(): n(0) {}
+
+    SymbolicJacobian::SymbolicJacobian(const vector<CompiledExpression>& system): n(system.size())
+    {
+        for (size_t i = 0; i < system.size(); i++)
+        {
+            vector<size_t> row_cols;
+            vector<CompiledExpression> row_entries;
+            bool differentiable = true;
+
+            vector<size_t> slots = system[i].get_slots();
+            slots.erase(std::lower_bound(slots.begin(), slots.end(), n), slots.end());
+            for (size_t j: slots)
+            {
+                CompiledExpression derivative;
+                if (!try_differentiate(system[i], j, derivative))
+                {
+                    differentiable = false;
+                    break;
+                }
+                row_cols.push_back(j);
+                row_entries.push_back(derivative);
+            }
+
+            if (!differentiable)
+            {
+                fallback_rows.push_back(i);
+                fallback_slots.push_back(slots);
+                continue;
+            }
+
+            for (size_t k = 0; k < row_cols.size(); k++)
+            {
+                rows.push_back(i);
+                cols.push_back(row_cols[k]);
+                entries.push_back(row_entries[k]);
+            }
+        }
+    }
+
+    void SymbolicJacobian::evaluate(const vector<CompiledExpression>& system, vector<double>& x, const vector<double>& f, Matrix<double>& jacobian, ThreadPool* pool) const
+    {
+        evaluate_into(system, x, f, jacobian, pool);
+    }
+
+    void SymbolicJacobian::evaluate(const vector<CompiledExpression>& system, vector<double>& x, const vector<double>& f, SparseMatrix<double>& jacobian, ThreadPool* pool) const
+    {
+        evaluate_into(system, x, f, jacobian, pool);
+    }
+
+    template<typename M>
+    void SymbolicJacobian::evaluate_into(const vector<CompiledExpression>& system, vector<double>& x, const vector<double>& f, M& jacobian, ThreadPool* pool) const
+    {
+        clear(jacobian);
+
+        if (pool)
+        {
+            auto call = std::tie(system, x, f, jacobian);
+            pool->parallel_for(entries.size(), parallel_chunk(entries.size(), *pool), [this, &call](size_t begin, size_t end, size_t) {
+                evaluate_entries(std::get<1>(call), std::get<3>(call), begin, end);
+            });
+
+            // Fallback rows perturb x, so each worker differences them on its own copy
+            reserve_workers(worker_x, fallback_rows.empty() ? 0 : pool->size(), x.size());
+            pool->parallel_for(fallback_rows.size(), 1, [this, &call](size_t begin, size_t end, size_t worker) {
+                vector<double>& copy = worker_x[worker];
+                std::copy(std::get<1>(call).begin(), std::get<1>(call).end(), copy.begin());
+                evaluate_fallbacks(std::get<0>(call), copy, std::get<2>(call), std::get<3>(call), begin, end);
+            });
+            return;
+        }
+
+        evaluate_entries(x, jacobian, 0, entries.size());
+        evaluate_fallbacks(system, x, f, jacobian, 0, fallback_rows.size());
+    }
+
+    template<typename M>
+    void SymbolicJacobian::evaluate_entries(const vector<double>& x, M& jacobian, size_t begin, size_t end) const
+    {
+        for (size_t k = begin; k < end; k++)
+        {
+            store(jacobian, rows[k], cols[k], entries[k].evaluate(x));
+        }
+    }
+
+    template<typename M>
+    void SymbolicJacobian::evaluate_fallbacks(const vector<CompiledExpression>& system, vector<double>& x, const vector<double>& f, M& jacobian, size_t begin, size_t end) const
+    {
+        // Columns a fallback row does not read are left at zero, which is what differencing them would give
+        for (size_t r = begin; r < end; r++)
+        {
+            size_t i = fallback_rows[r];
+            for (size_t j: fallback_slots[r])
+            {
+                double stored = x[j];
+                x[j] += DX;
+                store(jacobian, i, j, (system[i].evaluate(x) - f[i]) / DX);
+                x[j] = stored;
+            }
+        }
+    }
+
+    size_t SymbolicJacobian::get_entry_count() const
+    {
+        return entries.size();
+    }
+
+    const vector<size_t>& SymbolicJacobian::get_fallback_rows() const
+    {
+        return fallback_rows;
+    }
+
+    DualJacobian::DualJacobian() {}
+
+    DualJacobian::DualJacobian(const vector<CompiledExpression>& system)
+    {
+        size_t depth = 1;
+        for (auto& expr: system)
+        {
+            slots.push_back(expr.get_slots());
+            depth = std::max(depth, expr.get_depth());
+        }
+        frame.resize(depth);
+    }
+
+    void DualJacobian::evaluate(const vector<CompiledExpression>& system, const vector<double>& x, vector<double>& f, Matrix<double>& jacobian, ThreadPool* pool)
+    {
+        evaluate_into(system, x, f, jacobian, pool);
+    }
+
+    void DualJacobian::evaluate(const vector<CompiledExpression>& system, const vector<double>& x, vector<double>& f, SparseMatrix<double>& jacobian, ThreadPool* pool)
+    {
+        evaluate_into(system, x, f, jacobian, pool);
+    }
+
+    template<typename M>
+    void DualJacobian::evaluate_into(const vector<CompiledExpression>& system, const vector<double>& x, vector<double>& f, M& jacobian, ThreadPool* pool)
+    {
+        size_t passes = std::max<size_t>(1, (jacobian.get_cols() + DUAL_WIDTH - 1) / DUAL_WIDTH);
+        if (pool)
+        {
+            // Each worker seeds its own dual numbers
+            auto call = std::tie(system, x, f, jacobian);
+            reserve_workers(worker_x, pool->size(), x.size());
+            reserve_workers(worker_frames, pool->size(), frame.size());
+            pool->parallel_for(passes, 1, [this, &call](size_t begin, size_t end, size_t worker) {
+                evaluate_passes(std::get<0>(call), std::get<1>(call), worker_x[worker], worker_frames[worker], std::get<2>(call), std::get<3>(call), begin, end);
+            });
+            return;
+        }
+
+        evaluate_passes(system, x, this->x, frame, f, jacobian, 0, passes);
+    }
+
+    template<typename M>
+    void DualJacobian::evaluate_passes(const vector<CompiledExpression>& system, const vector<double>& x, vector<Dual<DUAL_WIDTH>>& duals, vector<Dual<DUAL_WIDTH>>& scratch, vector<double>& f, M& jacobian, size_t begin, size_t end) const
+    {
+        size_t n = jacobian.get_cols();
+        duals.resize(x.size());
+        for (size_t j = 0; j < x.size(); j++)
+        {
+            duals[j] = Dual<DUAL_WIDTH>(x[j]);
+        }
+
+        for (size_t pass = begin; pass < end; pass++)
+        {
+            size_t start = pass * DUAL_WIDTH;
+            size_t stop = std::min(start + DUAL_WIDTH, n);
+            for (size_t j = start; j < stop; j++)
+            {
+                duals[j].tangent[j - start] = 1.0;
+            }
+
+            for (size_t i = 0; i < system.size(); i++)
+            {
+                // The first pass always runs to produce the residual
+                auto first = std::lower_bound(slots[i].begin(), slots[i].end(), start);
+                bool reads_block = first != slots[i].end() && *first < stop;
+                if (start != 0 && !reads_block)
+                {
+                    store_block(jacobian, i, start, stop, slots[i], nullptr);
+                    continue;
+                }
+
+                auto res = system[i].evaluate(duals.data(), scratch.data());
+                if (start == 0)
+                {
+                    f[i] = res.value;
+                }
+                store_block(jacobian, i, start, stop, slots[i], res.tangent);
+            }
+
+            for (size_t j = start; j < stop; j++)
+            {
+                duals[j].tangent[j - start] = 0.0;
+            }
+        }
+    }
+}
\ No newline at end of file
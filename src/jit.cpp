@@ -0,0 +1,414 @@
+#include "jit.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__x86_64__) && defined(__unix__)
+#include <sys/mman.h>
+#include <unistd.h>
+#define NEXSYS_JIT_SUPPORTED
+#endif
+
+using std::vector;
+
+namespace nexsys
+{
+    // General purpose register numbers. `x` is kept in RBX and the frame in RBP since
+    // both are callee-saved and neither needs a REX prefix or SIB byte to address through.
+    constexpr uint8_t RAX = 0;
+    constexpr uint8_t RBX = 3;
+    constexpr uint8_t RBP = 5;
+
+    // Opcodes of the scalar double-precision SSE2 instructions used, following `0xF2 0x0F`
+    constexpr uint8_t SSE_LOAD  = 0x10;
+    constexpr uint8_t SSE_STORE = 0x11;
+    constexpr uint8_t SSE_ADD   = 0x58;
+    constexpr uint8_t SSE_MUL   = 0x59;
+    constexpr uint8_t SSE_SUB   = 0x5C;
+    constexpr uint8_t SSE_DIV   = 0x5E;
+    constexpr uint8_t SSE_MIN   = 0x5D;
+    constexpr uint8_t SSE_MAX   = 0x5F;
+    constexpr uint8_t SSE_SQRT  = 0x51;
+    constexpr uint8_t SSE_CMP   = 0xC2;
+
+    /// @brief Helper type for appending x86-64 instructions to a buffer
+    struct _Assembler
+    {
+        vector<uint8_t> buf;
+
+        void bytes(std::initializer_list<uint8_t> bs)
+        {
+            buf.insert(buf.end(), bs);
+        }
+
+        void u32(uint32_t v)
+        {
+            for (int i = 0; i < 4; i++)
+            {
+                buf.push_back((uint8_t)(v >> (8 * i)));
+            }
+        }
+
+        void u64(uint64_t v)
+        {
+            for (int i = 0; i < 8; i++)
+            {
+                buf.push_back((uint8_t)(v >> (8 * i)));
+            }
+        }
+
+        /// @brief `op xmm, [base + disp32]`, or `movsd [base + disp32], xmm` for `SSE_STORE`
+        void sse_mem(uint8_t opcode, uint8_t xmm, uint8_t base, uint32_t disp)
+        {
+            bytes({0xF2, 0x0F, opcode, (uint8_t)(0x80 | (xmm << 3) | base)});
+            u32(disp);
+        }
+
+        /// @brief `op dst, src` on two xmm registers
+        void sse_reg(uint8_t opcode, uint8_t dst, uint8_t src)
+        {
+            bytes({0xF2, 0x0F, opcode, (uint8_t)(0xC0 | (dst << 3) | src)});
+        }
+
+        /// @brief Loads a constant into an xmm register through RAX
+        void load_imm(uint8_t xmm, double value)
+        {
+            uint64_t raw;
+            memcpy(&raw, &value, sizeof(raw));
+
+            bytes({0x48, 0xB8});                                // mov rax, imm64
+            u64(raw);
+            bytes({0x66, 0x48, 0x0F, 0x6E, (uint8_t)(0xC0 | (xmm << 3))}); // movq xmm, rax
+        }
+
+        /// @brief `movapd xmm1, xmm0`
+        void save_xmm0()
+        {
+            bytes({0x66, 0x0F, 0x28, 0xC8});
+        }
+
+        /// @brief `andpd dst, src` on two xmm registers
+        void and_pd(uint8_t dst, uint8_t src)
+        {
+            bytes({0x66, 0x0F, 0x54, (uint8_t)(0xC0 | (dst << 3) | src)});
+        }
+
+        /// @brief `orpd dst, src` on two xmm registers
+        void or_pd(uint8_t dst, uint8_t src)
+        {
+            bytes({0x66, 0x0F, 0x56, (uint8_t)(0xC0 | (dst << 3) | src)});
+        }
+
+        /// @brief `cmpunordsd xmm, xmm`, leaving all ones in the register if it held NaN and zero otherwise
+        void is_nan(uint8_t xmm)
+        {
+            sse_reg(SSE_CMP, xmm, xmm);
+            bytes({0x03});
+        }
+
+        /// @brief Raises xmm0 to an integer power in the same order as `powi`, using xmm1 for the base
+        void powi(int32_t exponent)
+        {
+            uint32_t n = exponent < 0 ? 0u - (uint32_t)exponent : (uint32_t)exponent;
+            if (n == 0)
+            {
+                load_imm(0, 1.0);
+                return;
+            }
+
+            // xmm1 holds the base and xmm0 the result, which starts as the lowest set bit's power
+            save_xmm0();
+            while ((n & 1) == 0)
+            {
+                sse_reg(SSE_MUL, 1, 1);
+                n >>= 1;
+            }
+            sse_reg(0x10, 0, 1); // movsd xmm0, xmm1
+            n >>= 1;
+            while (n != 0)
+            {
+                sse_reg(SSE_MUL, 1, 1);
+                if (n & 1)
+                {
+                    sse_reg(SSE_MUL, 0, 1);
+                }
+                n >>= 1;
+            }
+
+            if (exponent < 0)
+            {
+                save_xmm0();
+                load_imm(0, 1.0);
+                sse_reg(SSE_DIV, 0, 1);
+            }
+        }
+
+        /// @brief Calls an absolute address through RAX
+        void call(const void* target)
+        {
+            bytes({0x48, 0xB8});                                // mov rax, imm64
+            u64((uint64_t)target);
+            bytes({0xFF, 0xD0});                                // call rax
+        }
+    };
+
+    /// @brief Helper function to get the SSE2 opcode equivalent to a bytecode operation
+    static uint8_t sse_opcode(OpCode op)
+    {
+        switch(op)
+        {
+            case OpAdd: case OpAddNum: case OpAddVar:
+                return SSE_ADD;
+
+            case OpSub: case OpSubNum: case OpSubVar: case OpNumSub: case OpVarSub:
+                return SSE_SUB;
+
+            case OpMul: case OpMulNum: case OpMulVar:
+                return SSE_MUL;
+
+            default:
+                return SSE_DIV;
+        }
+    }
+
+    /// @brief Helper function to get the libm function evaluating a built-in function that has no SSE2 instruction
+    static const void* libm_function(OpCode op)
+    {
+        static double (*const unary[])(double) = {sin, cos, tan, asin, acos, atan, sinh, cosh, tanh, exp, log, log10};
+        static double (*const hypot_fn)(double, double) = hypot;
+
+        if (op == OpHypot)
+        {
+            return (const void*)hypot_fn;
+        }
+        return (const void*)unary[op - OpSin];
+    }
+
+    /// @brief Helper function to translate a bytecode program to machine code. Every instruction
+    /// leaves its result in both xmm0 and its frame register, so an instruction reading the
+    /// previous result does not need to reload it.
+    static vector<uint8_t> assemble(const vector<Instruction>& code)
+    {
+        static double (*const pow_fn)(double, double) = pow;
+
+        _Assembler as;
+        const uint32_t NONE = UINT32_MAX;
+        uint32_t cached = NONE;
+
+        // Prologue: preserve callee-saved registers and keep the stack 16-byte aligned for calls
+        as.bytes({0x53, 0x55});                 // push rbx; push rbp
+        as.bytes({0x48, 0x83, 0xEC, 0x08});     // sub rsp, 8
+        as.bytes({0x48, 0x89, 0xFB});           // mov rbx, rdi
+        as.bytes({0x48, 0x89, 0xF5});           // mov rbp, rsi
+
+        auto load_a = [&](const Instruction& ins)
+        {
+            if (cached != ins.a)
+            {
+                as.sse_mem(SSE_LOAD, 0, RBP, ins.a * 8);
+            }
+        };
+
+        for (auto& ins: code)
+        {
+            switch(ins.op)
+            {
+                case OpNum:
+                    as.load_imm(0, ins.imm);
+                    break;
+
+                case OpVar:
+                    as.sse_mem(SSE_LOAD, 0, RBX, ins.a * 8);
+                    break;
+
+                case OpAdd:
+                case OpSub:
+                case OpMul:
+                case OpDiv:
+                    load_a(ins);
+                    as.sse_mem(sse_opcode(ins.op), 0, RBP, ins.b * 8);
+                    break;
+
+                case OpAddNum:
+                case OpSubNum:
+                case OpMulNum:
+                case OpDivNum:
+                    load_a(ins);
+                    as.load_imm(1, ins.imm);
+                    as.sse_reg(sse_opcode(ins.op), 0, 1);
+                    break;
+
+                case OpAddVar:
+                case OpSubVar:
+                case OpMulVar:
+                case OpDivVar:
+                    load_a(ins);
+                    as.sse_mem(sse_opcode(ins.op), 0, RBX, ins.b * 8);
+                    break;
+
+                case OpNumSub:
+                case OpNumDiv:
+                case OpVarSub:
+                case OpVarDiv:
+                    // The register operand is on the right, so load the left operand into xmm0 first
+                    if (cached == ins.a)
+                    {
+                        as.save_xmm0();
+                    }
+
+                    if (ins.op == OpNumSub || ins.op == OpNumDiv)
+                    {
+                        as.load_imm(0, ins.imm);
+                    }
+                    else
+                    {
+                        as.sse_mem(SSE_LOAD, 0, RBX, ins.b * 8);
+                    }
+
+                    if (cached == ins.a)
+                    {
+                        as.sse_reg(sse_opcode(ins.op), 0, 1);
+                    }
+                    else
+                    {
+                        as.sse_mem(sse_opcode(ins.op), 0, RBP, ins.a * 8);
+                    }
+                    break;
+
+                case OpPow:
+                    load_a(ins);
+                    as.sse_mem(SSE_LOAD, 1, RBP, ins.b * 8);
+                    as.call((const void*)pow_fn);
+                    break;
+
+                case OpPowNum:
+                    load_a(ins);
+                    if (ins.imm == 2.0)
+                    {
+                        as.sse_reg(SSE_MUL, 0, 0);
+                    }
+                    else
+                    {
+                        as.load_imm(1, ins.imm);
+                        as.call((const void*)pow_fn);
+                    }
+                    break;
+
+                case OpPowI:
+                    load_a(ins);
+                    as.powi((int32_t)ins.b);
+                    break;
+
+                case OpSin: case OpCos: case OpTan: case OpAsin: case OpAcos: case OpAtan:
+                case OpSinh: case OpCosh: case OpTanh: case OpExp: case OpLog: case OpLog10:
+                    load_a(ins);
+                    as.call(libm_function(ins.op));
+                    break;
+
+                case OpHypot:
+                    load_a(ins);
+                    as.sse_mem(SSE_LOAD, 1, RBP, ins.b * 8);
+                    as.call(libm_function(ins.op));
+                    break;
+
+                case OpSqrt:
+                    load_a(ins);
+                    as.sse_reg(SSE_SQRT, 0, 0);
+                    break;
+
+                case OpAbs:
+                {
+                    uint64_t mask = 0x7FFFFFFFFFFFFFFF;
+                    double mask_bits;
+                    memcpy(&mask_bits, &mask, sizeof(mask_bits));
+
+                    load_a(ins);
+                    as.load_imm(1, mask_bits);
+                    as.and_pd(0, 1);
+                    break;
+                }
+
+                case OpMin:
+                case OpMax:
+                    // `minsd` and `maxsd` return their second operand unless the first compares less or greater,
+                    // so a NaN second operand carries through, and a NaN first operand is ORed back in as all ones
+                    load_a(ins);
+                    as.save_xmm0();
+                    as.is_nan(1);
+                    as.sse_mem(ins.op == OpMin ? SSE_MIN : SSE_MAX, 0, RBP, ins.b * 8);
+                    as.or_pd(0, 1);
+                    break;
+
+                case OpCall:
+                    as.bytes({0x48, 0x8D, 0xBD});   // lea rdi, [rbp + disp32]
+                    as.u32(ins.a * 8);
+                    as.call((const void*)ins.function->func);
+                    break;
+
+                case OpReturn:
+                    load_a(ins);
+                    as.bytes({0x48, 0x83, 0xC4, 0x08}); // add rsp, 8
+                    as.bytes({0x5D, 0x5B, 0xC3});       // pop rbp; pop rbx; ret
+                    return as.buf;
+            }
+
+            as.sse_mem(SSE_STORE, 0, RBP, ins.dst * 8);
+            cached = ins.dst;
+        }
+
+        throw std::invalid_argument("bytecode program does not return a value");
+    }
+
+    JitCode::JitCode(): page(nullptr), page_size(0), entry(nullptr) {}
+
+    JitCode::JitCode(const Bytecode& code): JitCode()
+    {
+#ifdef NEXSYS_JIT_SUPPORTED
+        auto machine_code = assemble(code.get_code());
+
+        size_t granularity = (size_t)sysconf(_SC_PAGESIZE);
+        page_size = (machine_code.size() + granularity - 1) / granularity * granularity;
+        page = mmap(nullptr, page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (page == MAP_FAILED)
+        {
+            page = nullptr;
+            throw std::runtime_error("could not map memory for compiled code");
+        }
+
+        memcpy(page, machine_code.data(), machine_code.size());
+
+        // Never leave the page writable and executable at the same time
+        if (mprotect(page, page_size, PROT_READ | PROT_EXEC) != 0)
+        {
+            munmap(page, page_size);
+            page = nullptr;
+            throw std::runtime_error("could not make compiled code executable");
+        }
+
+        entry = (JitFunction)page;
+#else
+        throw std::runtime_error("native code generation is not supported on this platform");
+#endif
+    }
+
+    JitCode::~JitCode()
+    {
+#ifdef NEXSYS_JIT_SUPPORTED
+        if (page != nullptr)
+        {
+            munmap(page, page_size);
+        }
+#endif
+    }
+
+    bool JitCode::is_supported()
+    {
+#ifdef NEXSYS_JIT_SUPPORTED
+        return true;
+#else
+        return false;
+#endif
+    }
+}
@@ -0,0 +1,124 @@
+#include "lexer.hpp"
+
+#include <array>
+#include <charconv>
+#include <cstdint>
+
+using std::string_view;
+
+namespace nexsys
+{
+    /// @brief The classes a character may fall into while lexing
+    enum _CharClass : uint8_t
+    {
+        CharWord,
+        CharSpace,
+        CharDigit,
+        CharPunct,
+    };
+
+    /// @brief Helper function to build the character class lookup table
+    static constexpr std::array<uint8_t, 256> make_char_classes()
+    {
+        std::array<uint8_t, 256> classes {};
+        for (size_t c = 0; c < 256; c++)
+        {
+            classes[c] = CharWord;
+        }
+        for (char c: {' ', '\t', '\n', '\v', '\f', '\r'})
+        {
+            classes[(uint8_t)c] = CharSpace;
+        }
+        for (char c = '0'; c <= '9'; c++)
+        {
+            classes[(uint8_t)c] = CharDigit;
+        }
+        classes['.'] = CharDigit;
+        for (char c: {'+', '-', '*', '/', '^', '(', ')', ','})
+        {
+            classes[(uint8_t)c] = CharPunct;
+        }
+        return classes;
+    }
+
+    static constexpr std::array<uint8_t, 256> CHAR_CLASSES = make_char_classes();
+
+    /// @brief Helper function to classify a character
+    static inline uint8_t classify(char c)
+    {
+        return CHAR_CLASSES[(uint8_t)c];
+    }
+
+    Lexer::Lexer(string_view expr): expr(expr), pos(0) {}
+
+    Lexeme Lexer::next()
+    {
+        while (pos < expr.size() && classify(expr[pos]) == CharSpace)
+        {
+            pos++;
+        }
+
+        Lexeme lex;
+        lex.value = 0.0;
+        if (pos == expr.size())
+        {
+            lex.type = LexEnd;
+            lex.text = expr.substr(pos, 0);
+            return lex;
+        }
+
+        size_t start = pos;
+        char first = expr[pos];
+        if (classify(first) == CharPunct)
+        {
+            pos++;
+            lex.text = expr.substr(start, 1);
+            switch(first)
+            {
+                case '+': lex.type = LexPlus;             break;
+                case '-': lex.type = LexMinus;            break;
+                case '*': lex.type = LexMul;              break;
+                case '/': lex.type = LexDiv;              break;
+                case '^': lex.type = LexExp;              break;
+                case '(': lex.type = LexLeftParenthesis;  break;
+                case ')': lex.type = LexRightParenthesis; break;
+                default:  lex.type = LexComma;            break;
+            }
+            return lex;
+        }
+
+        bool numeric = classify(first) == CharDigit;
+        while (pos < expr.size())
+        {
+            uint8_t cls = classify(expr[pos]);
+            if (cls == CharSpace)
+            {
+                break;
+            }
+
+            // The sign of a number's exponent belongs to the number, not to a binary operator
+            if (cls == CharPunct)
+            {
+                bool exponent_sign = numeric && (expr[pos] == '+' || expr[pos] == '-')
+                    && (expr[pos - 1] == 'e' || expr[pos - 1] == 'E');
+                if (!exponent_sign)
+                {
+                    break;
+                }
+            }
+            pos++;
+        }
+
+        lex.text = expr.substr(start, pos - start);
+        lex.type = LexSymbol;
+        if (numeric)
+        {
+            auto parsed = std::from_chars(lex.text.data(), lex.text.data() + lex.text.size(), lex.value);
+            if (parsed.ec == std::errc() && parsed.ptr == lex.text.data() + lex.text.size())
+            {
+                lex.type = LexNum;
+            }
+        }
+        return lex;
+    }
+}
@@ -1,5 +1,8 @@
 #include "newton.hpp"
 
+#include <cfloat>
+#include <limits>
+
 using std::function;
 using std::string;
 using std::unordered_map;
@@ -7,37 +10,415 @@ using std::vector;
 
 namespace nexsys 
 {
-    double newton_raphson(
-        function<double (double)> func, 
-        double guess, 
-        double min, 
-        double max, 
-        double margin, 
-        size_t limit)
+    ScalarSolver::ScalarSolver(): iterations(0), evaluations(0), derivatives(0) {}
+
+    double ScalarSolver::solve(const function<double (double)>& func, double guess, double min, double max, double margin, size_t limit)
+    {
+        return iterate(func, nullptr, guess, min, max, margin, limit);
+    }
+
+    double ScalarSolver::solve(const function<double (double)>& func, const function<double (double)>& derivative, double guess, double min, double max, double margin, size_t limit)
+    {
+        return iterate(func, &derivative, guess, min, max, margin, limit);
+    }
+
+    double ScalarSolver::iterate(const function<double (double)>& func, const function<double (double)>* derivative, double guess, double min, double max, double margin, size_t limit)
+    {
+        if (margin <= 0.0)
+        {
+            throw std::invalid_argument("margin must be positive");
+        }
+
+        if (!(min <= max))
+        {
+            throw std::invalid_argument("min must not be greater than max");
+        }
+
+        iterations = 0;
+        evaluations = 1;
+        derivatives = 0;
+
+        // Every step stays within [lo, hi]: the bounds at first, then the bracket once the sign changes
+        double lo = min, hi = max, f_lo = 0.0;
+        bool bracketed = false, probed = false;
+
+        double x = std::min(std::max(guess, min), max);
+        double fx = func(x);
+        double previous = x, f_previous = fx;
+        double last_step = hi - lo, older_step = hi - lo;
+        if (fx == 0.0)
+        {
+            return x;
+        }
+
+        for (; iterations < limit; iterations++)
+        {
+            double slope;
+            if (derivative)
+            {
+                slope = (*derivative)(x);
+                derivatives++;
+            }
+            else if (previous != x)
+            {
+                slope = (fx - f_previous) / (x - previous);
+            }
+            else
+            {
+                // Only the first step has no secant, so difference toward the inside of the bounds
+                double dx = x + DX <= hi ? DX : -DX;
+                slope = (func(x + dx) - fx) / dx;
+                evaluations++;
+            }
+
+            double next = x - fx / slope;
+            if (bracketed)
+            {
+                if (!(next > lo && next < hi) || !(std::fabs(next - x) <= 0.5 * std::fabs(older_step)))
+                {
+                    next = 0.5 * (lo + hi);
+                }
+            }
+            else if (std::isnan(next))
+            {
+                throw std::runtime_error("function has no slope to step along and no sign change to bisect");
+            }
+            else
+            {
+                next = std::min(std::max(next, lo), hi);
+            }
+
+            double step = next - x;
+            older_step = last_step;
+            last_step = step;
+
+            previous = x;
+            f_previous = fx;
+            x = next;
+            fx = func(x);
+            evaluations++;
+
+            if (bracketed)
+            {
+                if ((fx < 0.0) == (f_lo < 0.0))
+                {
+                    lo = x;
+                    f_lo = fx;
+                }
+                else
+                {
+                    hi = x;
+                }
+            }
+            else if ((fx < 0.0) != (f_previous < 0.0))
+            {
+                bracketed = true;
+                lo = std::min(x, previous);
+                hi = std::max(x, previous);
+                f_lo = lo == x ? fx : f_previous;
+            }
+            else if (!probed && !(std::fabs(fx) < std::fabs(f_previous)))
+            {
+                // The steps have stopped helping, so look for a sign change between the iterate and each bound
+                probed = true;
+                for (double bound: {min, max})
+                {
+                    if (bracketed || !std::isfinite(bound) || bound == x)
+                    {
+                        continue;
+                    }
+
+                    double f_bound = func(bound);
+                    evaluations++;
+                    if ((f_bound < 0.0) != (fx < 0.0))
+                    {
+                        bracketed = true;
+                        lo = std::min(x, bound);
+                        hi = std::max(x, bound);
+                        f_lo = lo == x ? fx : f_bound;
+                    }
+                }
+            }
+
+            if (fx == 0.0 || (std::fabs(fx) <= margin && (std::fabs(step) <= margin || (bracketed && hi - lo <= margin))))
+            {
+                iterations++;
+                return x;
+            }
+
+            if (step == 0.0 && !bracketed)
+            {
+                throw std::runtime_error("function has no root within the bounds");
+            }
+        }
+
+        throw std::runtime_error("function did not converge within the iteration limit");
+    }
+
+    size_t ScalarSolver::get_iteration_count() const
+    {
+        return iterations;
+    }
+
+    size_t ScalarSolver::get_evaluation_count() const
+    {
+        return evaluations;
+    }
+
+    size_t ScalarSolver::get_derivative_count() const
+    {
+        return derivatives;
+    }
+
+    BatchScalarSolver::BatchScalarSolver(const CompiledExpression& expr, size_t unknown, BatchIsa isa):
+        expr(expr),
+        unknown(unknown),
+        isa(isa),
+        iterations(0),
+        evaluations(0),
+        failures(0)
+    {
+        size_t slots = unknown + 1;
+        for (size_t slot: expr.get_slots())
+        {
+            slots = std::max(slots, slot + 1);
+            if (slot != unknown)
+            {
+                parameters.push_back(slot);
+            }
+        }
+        columns.resize(slots);
+        column_ptrs.assign(slots, nullptr);
+    }
+
+    RootColumns BatchScalarSolver::state()
+    {
+        return {x.data(), fx.data(), previous.data(), f_previous.data(), lo.data(), hi.data(), f_lo.data(), last_step.data(), older_step.data(), bracketed.data(), finished.data(), point.data(), value.data()};
+    }
+
+    void BatchScalarSolver::evaluate(size_t count)
+    {
+        column_ptrs[unknown] = point.data();
+        for (size_t slot: parameters)
+        {
+            column_ptrs[slot] = columns[slot].data();
+        }
+        evaluate_batch(expr.get_bytecode(), column_ptrs.data(), count, value.data(), isa);
+        evaluations += count;
+    }
+
+    void BatchScalarSolver::move_problem(size_t from, size_t to)
+    {
+        id[to] = id[from];
+        x[to] = x[from];
+        fx[to] = fx[from];
+        previous[to] = previous[from];
+        f_previous[to] = f_previous[from];
+        lo[to] = lo[from];
+        hi[to] = hi[from];
+        f_lo[to] = f_lo[from];
+        last_step[to] = last_step[from];
+        older_step[to] = older_step[from];
+        bracketed[to] = bracketed[from];
+        finished[to] = finished[from];
+        for (size_t slot: parameters)
+        {
+            columns[slot][to] = columns[slot][from];
+        }
+    }
+
+    size_t BatchScalarSolver::solve(const double* const* parameter_columns, const double* guess, const double* min, const double* max, size_t count, double margin, size_t limit, double* roots)
+    {
+        if (margin <= 0.0)
+        {
+            throw std::invalid_argument("margin must be positive");
+        }
+
+        for (size_t k = 0; k < count; k++)
+        {
+            if (!(min[k] <= max[k]))
+            {
+                throw std::invalid_argument("min must not be greater than max");
+            }
+        }
+
+        size_t tile = std::min(count, BATCH_SCALAR_TILE);
+        if (id.size() < tile)
+        {
+            for (auto* column: {&x, &fx, &previous, &f_previous, &lo, &hi, &f_lo, &last_step, &older_step, &bracketed, &finished, &point, &value})
+            {
+                column->resize(tile);
+            }
+            id.resize(tile);
+            for (size_t slot: parameters)
+            {
+                columns[slot].resize(tile);
+            }
+        }
+
+        iterations = 0;
+        evaluations = 0;
+        failures = 0;
+        for (size_t offset = 0; offset < count; offset += BATCH_SCALAR_TILE)
+        {
+            size_t n = std::min(count - offset, BATCH_SCALAR_TILE);
+            solve_tile(parameter_columns, offset, guess + offset, min + offset, max + offset, n, margin, limit, roots + offset);
+        }
+        return failures;
+    }
+
+    void BatchScalarSolver::solve_tile(const double* const* parameter_columns, size_t offset, const double* guess, const double* min, const double* max, size_t count, double margin, size_t limit, double* roots)
     {
-        if (limit == 0)
+        // Problems are packed into the front of every column as others finish, so work through plain pointers
+        size_t* ids = id.data();
+        double *X = x.data(), *F = fx.data(), *P = previous.data(), *FP = f_previous.data();
+        double *LO = lo.data(), *HI = hi.data(), *FLO = f_lo.data(), *LAST = last_step.data(), *OLDER = older_step.data();
+        double *POINT = point.data(), *VALUE = value.data();
+        double *B = bracketed.data(), *DONE = finished.data();
+
+        for (size_t k = 0; k < count; k++)
+        {
+            ids[k] = k;
+            X[k] = std::min(std::max(guess[k], min[k]), max[k]);
+            LAST[k] = OLDER[k] = max[k] - min[k];
+
+            // Probe at each finite bound, or just inside the guess on an unbounded side
+            LO[k] = std::isfinite(min[k]) ? min[k] : X[k] - DX;
+            HI[k] = std::isfinite(max[k]) ? max[k] : X[k] + DX;
+        }
+        for (size_t slot: parameters)
+        {
+            std::copy(parameter_columns[slot] + offset, parameter_columns[slot] + offset + count, columns[slot].begin());
+        }
+
+        std::copy(LO, LO + count, POINT);
+        evaluate(count);
+        std::copy(VALUE, VALUE + count, FLO);
+        std::copy(HI, HI + count, POINT);
+        evaluate(count);
+        std::copy(VALUE, VALUE + count, FP);
+        std::copy(X, X + count, POINT);
+        evaluate(count);
+        std::copy(VALUE, VALUE + count, F);
+
+        // A sign change between the probes brackets the root, and the guess already halves the bracket.
+        // The first secant runs through the guess and the probe across the sign change, or the nearest one.
+        for (size_t k = 0; k < count; k++)
         {
-            throw; // TODO
+            double f_hi = FP[k];
+            bool across_lo = (FLO[k] < 0.0) != (F[k] < 0.0) && LO[k] != X[k];
+            bool across_hi = (f_hi < 0.0) != (F[k] < 0.0) && HI[k] != X[k];
+            bool use_lo = across_lo || (!across_hi && (HI[k] == X[k] || (LO[k] != X[k] && X[k] - LO[k] < HI[k] - X[k])));
+            P[k] = use_lo ? LO[k] : HI[k];
+            FP[k] = use_lo ? FLO[k] : f_hi;
+
+            B[k] = across_lo || across_hi;
+            if (across_lo)
+            {
+                HI[k] = X[k];
+            }
+            else if (across_hi)
+            {
+                LO[k] = X[k];
+                FLO[k] = F[k];
+            }
+            else
+            {
+                LO[k] = min[k];
+                HI[k] = max[k];
+            }
         }
 
-        double y        = func(guess);
-        double y_prime  = (func(guess + DX) - y) / DX;
-        double delta    = y_prime / y;
+        size_t active = count;
+        for (size_t k = 0; k < active;)
+        {
+            if (F[k] == 0.0)
+            {
+                // Order does not matter, so the last problem takes the finished one's place
+                roots[ids[k]] = X[k];
+                move_problem(--active, k);
+                continue;
+            }
+            k++;
+        }
 
-        if (abs(func(guess)) < margin && abs(delta) < margin)
+        // Finished problems are masked out in place, and only packed out once they are a fair share of the batch
+        std::fill(DONE, DONE + active, 0.0);
+        RootColumns lanes = state();
+        size_t done = 0, rounds = 0;
+        for (; done < active && rounds < limit; rounds++)
         {
-            if (guess > max)
+            propose_roots(lanes, active, isa);
+            evaluate(active);
+            update_roots(lanes, active, margin, isa);
+
+            // Problems that just finished are marked 1 or 2, and are marked 3 once their roots are written
+            for (size_t k = 0; k < active; k++)
+            {
+                if (DONE[k] == 1.0 || DONE[k] == 2.0)
+                {
+                    bool converged = DONE[k] == 1.0;
+                    roots[ids[k]] = converged ? X[k] : std::numeric_limits<double>::quiet_NaN();
+                    failures += !converged;
+                    DONE[k] = 3.0;
+                    done++;
+                }
+            }
+
+            if (4 * done >= active && done < active)
             {
-                return max;
+                size_t kept = 0;
+                for (size_t k = 0; k < active; k++)
+                {
+                    if (DONE[k] == 0.0)
+                    {
+                        if (kept != k)
+                        {
+                            move_problem(k, kept);
+                        }
+                        kept++;
+                    }
+                }
+                active = kept;
+                done = 0;
             }
-            else if (guess < min)
+        }
+
+        for (size_t k = 0; k < active; k++)
+        {
+            if (DONE[k] == 0.0)
             {
-                return min;
+                roots[ids[k]] = std::numeric_limits<double>::quiet_NaN();
+                failures++;
             }
-            return guess;
         }
-        
-        return newton_raphson(func, guess - delta, min, max, margin, limit - 1);
+        iterations = std::max(iterations, rounds);
+    }
+
+    size_t BatchScalarSolver::get_iteration_count() const
+    {
+        return iterations;
+    }
+
+    size_t BatchScalarSolver::get_evaluation_count() const
+    {
+        return evaluations;
+    }
+
+    size_t BatchScalarSolver::get_failure_count() const
+    {
+        return failures;
+    }
+
+    double newton_raphson(
+        const function<double (double)>& func,
+        double guess,
+        double min,
+        double max,
+        double margin,
+        size_t limit)
+    {
+        return ScalarSolver().solve(func, guess, min, max, margin, limit);
     }
 
     unordered_map<string, double> newton_raphson_multivariate(
@@ -48,92 +429,1308 @@ namespace nexsys
     {
         if (margin <= 0.0)
         {
-            throw; // TODO
-        }
-
-        if (limit == 0)
-        {
-            throw; // TODO
+            throw std::invalid_argument("margin must be positive");
         }
 
         size_t n = system.size();
         if (guess.size() != n)
         {
-            throw; // TODO
+            throw std::invalid_argument("system must have as many equations as unknowns");
         }
 
-        vector<double> elements;
-        vector<double> error;
-        double mag_error = 0;
-        for (auto func: system)
+        // Nothing is inserted while solving, so pointers to the guess's values stay valid
+        vector<double*> values;
+        for (auto& var_val: guess)
         {
-            // Build jacobian with f(x) values. We will mutate to partial derivatives later.
-            double f_of_x = func(guess);
+            values.push_back(&var_val.second);
+        }
 
-            // Write down error values
-            error.push_back(f_of_x);
-            mag_error += powl(f_of_x, 2);
+        vector<double> error(n);
+        Matrix<double> jacobian(n, n);
+        LU<double> factorization(n);
+        vector<double> deltas(n);
 
+        for (size_t iteration = 0; iteration < limit; iteration++)
+        {
+            double mag_error = 0;
             for (size_t i = 0; i < n; i++)
             {
-                elements.push_back(f_of_x);
+                // Build jacobian with f(x) values. We will mutate to partial derivatives later.
+                double f_of_x = system[i](guess);
+
+                // Write down error values
+                error[i] = f_of_x;
+                mag_error += f_of_x * f_of_x;
+
+                for (size_t j = 0; j < n; j++)
+                {
+                    jacobian.get_index_ref(i, j) = f_of_x;
+                }
+            }
+
+            for (size_t j = 0; j < n; j++)
+            {
+                *values[j] += DX;
+                for (size_t i = 0; i < n; i++)
+                {
+                    // mutate jacobian values to partial derivatives
+                    jacobian.get_index_ref(i, j) = (system[i](guess) - jacobian.get_index(i, j)) / DX;
+                }
+                *values[j] -= DX;
+            }
+
+            if (!factorization.try_factor(jacobian))
+            {
+                throw std::runtime_error("jacobian of the system is singular");
+            }
+
+            double mag_delta = 0;
+            factorization.solve(error, deltas);
+            for (size_t j = 0; j < n; j++)
+            {
+                mag_delta += deltas[j] * deltas[j];
+            }
+
+            // If we are within the required radius of the correct value and solution
+            if (sqrtl(mag_delta) <= margin && sqrtl(mag_error) <= margin)
+            {
+                return guess;
+            }
+
+            //...otherwise, modify guess and retry
+            for (size_t j = 0; j < n; j++)
+            {
+                *values[j] -= deltas[j];
+            }
+        }
+
+        throw std::runtime_error("system did not converge within the iteration limit");
+    }
+
+    NewtonSolver::NewtonSolver(const vector<CompiledExpression>& system, JacobianMode mode, ThreadPool& pool):
+        system(system),
+        fused(system),
+        mode(mode),
+        colors(false),
+        sparse(false),
+        pool(&pool),
+        parallel_threshold(PARALLEL_MIN_SIZE),
+        x(system.size()),
+        error(system.size()),
+        jacobian(0, 0),
+        step(system.size()),
+        iterations(0),
+        evaluations(0),
+        jacobians(0),
+        previous(system.size()),
+        scratch(system.size()),
+        left(BROYDEN_UPDATES * system.size()),
+        right(BROYDEN_UPDATES * system.size()),
+        updates(0),
+        normal(0, 0),
+        normal_ready(false)
+    {
+        // Slots read past the unknowns are parameters, held at whatever value the guess gives them
+        size_t n = system.size();
+        for (auto& expr: system)
+        {
+            for (size_t slot: expr.get_slots())
+            {
+                x.resize(std::max(x.size(), slot + 1));
             }
         }
 
-        Matrix<double> jacobian(elements, n);
-        vector<string> vars;
-        for (auto var_val: guess)
+        SparseMatrix<double> pattern = jacobian_pattern(system, n);
+        sparse = n >= SPARSE_MIN_SIZE && pattern.get_nonzero_count() <= SPARSE_DENSITY * n * n;
+        if (sparse)
+        {
+            sparse_jacobian = pattern;
+            sparse_factorization.analyze(pattern);
+        }
+        else
         {
-            vars.push_back(var_val.first);
+            jacobian = Matrix<double>(n, n);
+            factorization = LU<double>(n);
         }
 
-        for (size_t j = 0; j < n; j++)
+        if (mode == Symbolic)
+        {
+            exact = SymbolicJacobian(system);
+        }
+        else if (mode == Automatic)
+        {
+            automatic = DualJacobian(system);
+        }
+        else
+        {
+            // Below half density, evaluating only the expressions each color touches beats re-running the merged system per column
+            colored = ColoredJacobian(system, n);
+            colors = sparse || 2 * colored.get_nonzero_count() <= n * n;
+        }
+    }
+
+    const vector<double>& NewtonSolver::solve(const vector<double>& guess, double margin, size_t limit, JacobianUpdate update, StepControl control)
+    {
+        if (guess.size() != x.size())
+        {
+            throw std::invalid_argument("guess must have a value for every slot the system reads");
+        }
+
+        std::copy(guess.begin(), guess.end(), x.begin());
+        return iterate(nullptr, margin, limit, update, control);
+    }
+
+    const vector<double>& NewtonSolver::solve(const vector<double>& guess, const vector<Interval>& bounds, double margin, size_t limit, JacobianUpdate update, StepControl control)
+    {
+        if (guess.size() != x.size())
+        {
+            throw std::invalid_argument("guess must have a value for every slot the system reads");
+        }
+
+        if (bounds.size() != x.size())
+        {
+            throw std::invalid_argument("bounds must have one domain per slot");
+        }
+
+        std::copy(guess.begin(), guess.end(), x.begin());
+        return iterate(&bounds, margin, limit, update, control);
+    }
+
+    ThreadPool* NewtonSolver::workers() const
+    {
+        return error.size() >= parallel_threshold ? pool : nullptr;
+    }
+
+    void NewtonSolver::evaluate_residual()
+    {
+        evaluations++;
+        if (ThreadPool* workers = this->workers())
+        {
+            // The merged program cannot be split, so each worker evaluates its share of the expressions
+            size_t chunk = std::max<size_t>(1, error.size() / (4 * workers->size()));
+            workers->parallel_for(error.size(), chunk, [this](size_t begin, size_t end, size_t) {
+                for (size_t i = begin; i < end; i++)
+                {
+                    error[i] = system[i].evaluate(x);
+                }
+            });
+            return;
+        }
+
+        fused.evaluate(x.data(), error.data());
+    }
+
+    void NewtonSolver::evaluate_jacobian()
+    {
+        size_t n = error.size();
+        ThreadPool* workers = this->workers();
+        if (mode == Automatic)
+        {
+            // Produces the error along with the jacobian
+            if (sparse)
+            {
+                automatic.evaluate(system, x, error, sparse_jacobian, workers);
+            }
+            else
+            {
+                automatic.evaluate(system, x, error, jacobian, workers);
+            }
+            evaluations += std::max<size_t>(1, (n + DUAL_WIDTH - 1) / DUAL_WIDTH);
+        }
+        else if (mode == Symbolic)
+        {
+            if (sparse)
+            {
+                exact.evaluate(system, x, error, sparse_jacobian, workers);
+            }
+            else
+            {
+                exact.evaluate(system, x, error, jacobian, workers);
+            }
+        }
+        else if (colors)
         {
-            auto var_val = guess.find(vars[j]);
-            if (var_val == guess.end())
+            if (sparse)
+            {
+                colored.evaluate(system, x, error, sparse_jacobian, workers);
+            }
+            else
             {
-                throw; // TODO - This should never be thrown, but might be worth keeping for safety
+                colored.evaluate(system, x, error, jacobian, workers);
             }
+            evaluations += colored.get_color_count();
+        }
+        else
+        {
+            finite_difference_jacobian(fused, x, error, jacobian, workers);
+            evaluations += n;
+        }
+        jacobians++;
+    }
+
+    bool NewtonSolver::try_factor()
+    {
+        return sparse ? sparse_factorization.try_factor(sparse_jacobian) : factorization.try_factor(jacobian);
+    }
 
-            var_val->second += DX;
+    void NewtonSolver::apply_inverse(vector<double>& v)
+    {
+        size_t n = error.size();
+        double weights[BROYDEN_UPDATES];
+        for (size_t k = 0; k < updates; k++)
+        {
+            weights[k] = 0.0;
             for (size_t i = 0; i < n; i++)
             {
-                // mutate jacobian values to partial derivatives
-                jacobian.get_index_ref(i, j) = (system[i](guess) - jacobian.get_index(i, j)) / DX;
+                weights[k] += right[k * n + i] * v[i];
             }
-            var_val->second -= DX;
         }
 
-        if (!jacobian.try_inplace_invert())
+        if (sparse)
         {
-            throw; // TODO - matrix inversion error
+            sparse_factorization.solve(v.data());
+        }
+        else
+        {
+            factorization.solve(v.data());
         }
 
-        double mag_delta = 0;
-        double* mag_delta_ptr = &mag_delta;
-
-        Matrix<double> deltas = jacobian * Matrix<double>::from_col_vec(error);
-        deltas.inplace_map_over(
-            [mag_delta_ptr](double dx)
+        for (size_t k = 0; k < updates; k++)
+        {
+            for (size_t i = 0; i < n; i++)
             {
-                *mag_delta_ptr += powl(dx, 2);
-                return dx;
+                v[i] += weights[k] * left[k * n + i];
             }
-        );
+        }
+    }
 
-        // If we are within the required radius of the correct value and solution
-        if (sqrtl(mag_delta) <= margin && sqrtl(mag_error) <= margin)
+    bool NewtonSolver::try_update(const vector<double>& s)
+    {
+        // With H the current inverse and y the change in the residual over the step s,
+        // H += (s - Hy)(s^T H) / (s^T H y), which makes the new inverse map y to s
+        size_t n = error.size();
+        for (size_t i = 0; i < n; i++)
         {
-            return guess;
+            scratch[i] = error[i] - previous[i];
         }
+        apply_inverse(scratch);
 
-        //...otherwise, modify guess and retry
-        for (auto var_val: guess)
+        double* a = &left[updates * n];
+        double* b = &right[updates * n];
+        std::copy(s.begin(), s.end(), b);
+        if (sparse)
+        {
+            sparse_factorization.solve_transpose(b);
+        }
+        else
         {
-            size_t i = &var_val - &*guess.begin();  // TODO: this is crusty as fuck...
-            var_val.second -= deltas.get_index(i, 0);
+            factorization.solve_transpose(b);
+        }
+        for (size_t k = 0; k < updates; k++)
+        {
+            double weight = 0.0;
+            for (size_t i = 0; i < n; i++)
+            {
+                weight += left[k * n + i] * s[i];
+            }
+            for (size_t i = 0; i < n; i++)
+            {
+                b[i] += weight * right[k * n + i];
+            }
         }
 
-        return newton_raphson_multivariate(system, guess, margin, limit - 1);
+        double denominator = 0.0, mag_s = 0.0, mag_hy = 0.0;
+        for (size_t i = 0; i < n; i++)
+        {
+            denominator += s[i] * scratch[i];
+            mag_s += s[i] * s[i];
+            mag_hy += scratch[i] * scratch[i];
+        }
+
+        if (!(std::fabs(denominator) > DBL_EPSILON * std::sqrt(mag_s * mag_hy)))
+        {
+            return false;
+        }
+
+        for (size_t i = 0; i < n; i++)
+        {
+            a[i] = (s[i] - scratch[i]) / denominator;
+        }
+        updates++;
+        return true;
+    }
+
+    void NewtonSolver::multiply_jacobian(const vector<double>& v, vector<double>& out) const
+    {
+        size_t n = error.size();
+        if (sparse)
+        {
+            sparse_jacobian.multiply(v.data(), out.data());
+            return;
+        }
+
+        for (size_t i = 0; i < n; i++)
+        {
+            double sum = 0.0;
+            for (size_t j = 0; j < n; j++)
+            {
+                sum += jacobian.get_index(i, j) * v[j];
+            }
+            out[i] = sum;
+        }
+    }
+
+    void NewtonSolver::multiply_jacobian_transpose(const vector<double>& v, vector<double>& out) const
+    {
+        size_t n = error.size();
+        if (sparse)
+        {
+            sparse_jacobian.multiply_transpose(v.data(), out.data());
+            return;
+        }
+
+        std::fill(out.begin(), out.begin() + n, 0.0);
+        for (size_t i = 0; i < n; i++)
+        {
+            for (size_t j = 0; j < n; j++)
+            {
+                out[j] += jacobian.get_index(i, j) * v[i];
+            }
+        }
+    }
+
+    void NewtonSolver::prepare_normal()
+    {
+        size_t n = error.size();
+        gram_diagonal.assign(n, 0.0);
+        normal_ready = true;
+        if (!sparse)
+        {
+            normal = Matrix<double>(n, n);
+            normal_factorization = LU<double>(n);
+            return;
+        }
+
+        // Entry (a, b) of J^T J is the sum over rows of J(r, a) * J(r, b), so it is structurally
+        // nonzero wherever two columns share a row. Every pair of positions in the jacobian that
+        // contributes to an entry is listed under it, so each evaluation is a plain gather.
+        // Each row lists the columns it has entries in, with their positions in the jacobian
+        vector<vector<std::pair<size_t, size_t>>> by_row(sparse_jacobian.get_rows());
+        for (size_t col = 0; col < n; col++)
+        {
+            for (size_t p = sparse_jacobian.get_col_start()[col]; p < sparse_jacobian.get_col_start()[col + 1]; p++)
+            {
+                by_row[sparse_jacobian.get_row_index()[p]].push_back({col, p});
+            }
+        }
+
+        vector<size_t> row_of, col_of;
+        for (size_t j = 0; j < n; j++)
+        {
+            row_of.push_back(j);
+            col_of.push_back(j);
+        }
+        for (auto& entries: by_row)
+        {
+            for (auto& a: entries)
+            {
+                for (auto& b: entries)
+                {
+                    row_of.push_back(a.first);
+                    col_of.push_back(b.first);
+                }
+            }
+        }
+        sparse_normal = SparseMatrix<double>::from_triplets(n, n, row_of, col_of, vector<double>(row_of.size(), 0.0));
+
+        normal_diagonal.resize(n);
+        for (size_t j = 0; j < n; j++)
+        {
+            sparse_normal.try_find(j, j, normal_diagonal[j]);
+        }
+
+        // Bucket the pairs by the entry they contribute to
+        size_t nonzeros = sparse_normal.get_nonzero_count();
+        vector<size_t> owner;
+        gram_start.assign(nonzeros + 1, 0);
+        for (auto& entries: by_row)
+        {
+            for (auto& a: entries)
+            {
+                for (auto& b: entries)
+                {
+                    size_t k;
+                    sparse_normal.try_find(a.first, b.first, k);
+                    owner.push_back(k);
+                    gram_start[k + 1]++;
+                }
+            }
+        }
+        for (size_t k = 0; k < nonzeros; k++)
+        {
+            gram_start[k + 1] += gram_start[k];
+        }
+
+        gram_pairs.resize(owner.size());
+        vector<size_t> next(gram_start.begin(), gram_start.end() - 1);
+        size_t e = 0;
+        for (auto& entries: by_row)
+        {
+            for (auto& a: entries)
+            {
+                for (auto& b: entries)
+                {
+                    gram_pairs[next[owner[e++]]++] = {a.second, b.second};
+                }
+            }
+        }
+
+        sparse_normal_factorization.analyze(sparse_normal);
+    }
+
+    void NewtonSolver::evaluate_gram()
+    {
+        size_t n = error.size();
+        if (sparse)
+        {
+            const double* values = sparse_jacobian.get_values().data();
+            for (size_t k = 0; k + 1 < gram_start.size(); k++)
+            {
+                double sum = 0.0;
+                for (size_t e = gram_start[k]; e < gram_start[k + 1]; e++)
+                {
+                    sum += values[gram_pairs[e].first] * values[gram_pairs[e].second];
+                }
+                sparse_normal.get_values_ref()[k] = sum;
+            }
+            for (size_t j = 0; j < n; j++)
+            {
+                gram_diagonal[j] = sparse_normal.get_values()[normal_diagonal[j]];
+            }
+            return;
+        }
+
+        for (size_t a = 0; a < n; a++)
+        {
+            for (size_t b = 0; b <= a; b++)
+            {
+                double sum = 0.0;
+                for (size_t r = 0; r < n; r++)
+                {
+                    sum += jacobian.get_index(r, a) * jacobian.get_index(r, b);
+                }
+                normal.get_index_ref(a, b) = sum;
+                normal.get_index_ref(b, a) = sum;
+            }
+            gram_diagonal[a] = normal.get_index(a, a);
+        }
+    }
+
+    bool NewtonSolver::try_factor_normal(double lambda)
+    {
+        size_t n = error.size();
+        if (sparse)
+        {
+            for (size_t j = 0; j < n; j++)
+            {
+                sparse_normal.get_values_ref()[normal_diagonal[j]] = gram_diagonal[j] + lambda;
+            }
+            return sparse_normal_factorization.try_factor(sparse_normal);
+        }
+
+        for (size_t j = 0; j < n; j++)
+        {
+            normal.get_index_ref(j, j) = gram_diagonal[j] + lambda;
+        }
+        return normal_factorization.try_factor(normal);
+    }
+
+    void NewtonSolver::choose_dogleg_step(bool has_newton, double radius)
+    {
+        // Every step here is subtracted from x, so the steepest descent direction of |f|^2 / 2 is +gradient
+        size_t n = error.size();
+        double mag_newton = 0.0;
+        for (size_t j = 0; j < n; j++)
+        {
+            mag_newton += newton[j] * newton[j];
+        }
+        if (has_newton && std::sqrt(mag_newton) <= radius)
+        {
+            std::copy(newton.begin(), newton.end(), step.begin());
+            return;
+        }
+
+        // The Cauchy point minimizes the linear model along the gradient
+        multiply_jacobian(gradient, product);
+        double mag_gradient = 0.0, mag_product = 0.0;
+        for (size_t j = 0; j < n; j++)
+        {
+            mag_gradient += gradient[j] * gradient[j];
+            mag_product += product[j] * product[j];
+        }
+        double alpha = mag_gradient / mag_product;
+        double mag_cauchy = alpha * std::sqrt(mag_gradient);
+
+        if (!has_newton || mag_cauchy >= radius)
+        {
+            double scale = std::min(alpha, radius / std::sqrt(mag_gradient));
+            for (size_t j = 0; j < n; j++)
+            {
+                step[j] = scale * gradient[j];
+            }
+            return;
+        }
+
+        // Walk from the Cauchy point toward the newton step until leaving the region
+        double a = 0.0, b = 0.0, c = mag_cauchy * mag_cauchy - radius * radius;
+        for (size_t j = 0; j < n; j++)
+        {
+            double d = newton[j] - alpha * gradient[j];
+            a += d * d;
+            b += 2.0 * alpha * gradient[j] * d;
+        }
+        double tau = (-b + std::sqrt(b * b - 4.0 * a * c)) / (2.0 * a);
+        for (size_t j = 0; j < n; j++)
+        {
+            step[j] = alpha * gradient[j] + tau * (newton[j] - alpha * gradient[j]);
+        }
+    }
+
+    const vector<double>& NewtonSolver::iterate_trust_region(const vector<Interval>* bounds, double margin, size_t limit, StepControl control)
+    {
+        size_t n = error.size();
+        gradient.resize(n);
+        newton.resize(n);
+        product.resize(n);
+        accepted.resize(x.size());
+        if (control == LevenbergMarquardt && !normal_ready)
+        {
+            prepare_normal();
+        }
+
+        if (mode != Automatic)
+        {
+            evaluate_residual();
+        }
+
+        double radius = 0.0;
+        for (size_t j = 0; j < n; j++)
+        {
+            radius += x[j] * x[j];
+        }
+        radius = std::max(std::sqrt(radius), 1.0);
+        double lambda = 0.0, growth = 2.0, mag_error = 0.0;
+        bool refresh = true, has_newton = false;
+
+        for (; iterations < limit; iterations++)
+        {
+            if (refresh)
+            {
+                evaluate_jacobian();
+                mag_error = 0.0;
+                for (size_t i = 0; i < n; i++)
+                {
+                    mag_error += error[i] * error[i];
+                }
+                multiply_jacobian_transpose(error, gradient);
+
+                if (control == Dogleg)
+                {
+                    // A singular jacobian still allows steps along the gradient
+                    has_newton = try_factor();
+                    if (has_newton)
+                    {
+                        std::copy(error.begin(), error.end(), newton.begin());
+                        apply_inverse(newton);
+                    }
+                }
+                else
+                {
+                    evaluate_gram();
+                    if (lambda == 0.0)
+                    {
+                        lambda = TRUST_LAMBDA * std::max(1.0, *std::max_element(gram_diagonal.begin(), gram_diagonal.end()));
+                    }
+                }
+                refresh = false;
+            }
+
+            if (control == Dogleg)
+            {
+                choose_dogleg_step(has_newton, radius);
+            }
+            else if (try_factor_normal(lambda))
+            {
+                std::copy(gradient.begin(), gradient.end(), step.begin());
+                if (sparse)
+                {
+                    sparse_normal_factorization.solve(step.data());
+                }
+                else
+                {
+                    normal_factorization.solve(step.data());
+                }
+            }
+            else
+            {
+                lambda *= growth;
+                growth *= 2.0;
+                continue;
+            }
+
+            double mag_delta = 0.0;
+            const vector<double>& full = control == Dogleg && has_newton ? newton : step;
+            for (size_t j = 0; j < n; j++)
+            {
+                mag_delta += full[j] * full[j];
+            }
+
+            // If we are within the required radius of the correct value and solution
+            if (std::sqrt(mag_delta) <= margin && std::sqrt(mag_error) <= margin)
+            {
+                iterations++;
+                return x;
+            }
+
+            // Try the step, keeping the one that was actually taken
+            std::copy(x.begin(), x.end(), accepted.begin());
+            std::copy(error.begin(), error.end(), previous.begin());
+            double mag_step = 0.0;
+            for (size_t j = 0; j < n; j++)
+            {
+                x[j] -= step[j];
+                if (bounds)
+                {
+                    x[j] = std::min(std::max(x[j], (*bounds)[j].lo), (*bounds)[j].hi);
+                }
+                step[j] = accepted[j] - x[j];
+                mag_step += step[j] * step[j];
+            }
+            mag_step = std::sqrt(mag_step);
+
+            // The linear model predicts the residual f - J * step
+            multiply_jacobian(step, product);
+            double mag_predicted = 0.0;
+            for (size_t i = 0; i < n; i++)
+            {
+                double predicted = previous[i] - product[i];
+                mag_predicted += predicted * predicted;
+            }
+
+            evaluate_residual();
+            double mag_next = 0.0;
+            for (size_t i = 0; i < n; i++)
+            {
+                mag_next += error[i] * error[i];
+            }
+
+            // NaN residuals compare false, so they reject the step like any other poor one
+            double ratio = (mag_error - mag_next) / (mag_error - mag_predicted);
+            bool taken = mag_predicted < mag_error && ratio > TRUST_ACCEPT;
+
+            if (control == Dogleg)
+            {
+                if (!(ratio >= 0.25))
+                {
+                    radius = 0.25 * mag_step;
+                }
+                else if (ratio > 0.75 && mag_step >= 0.99 * radius)
+                {
+                    radius *= 2.0;
+                }
+            }
+            else if (taken)
+            {
+                // Nielsen's update, which avoids oscillating between accepting and rejecting steps
+                double shrink = 2.0 * ratio - 1.0;
+                lambda *= std::max(1.0 / 3.0, 1.0 - shrink * shrink * shrink);
+                growth = 2.0;
+            }
+            else
+            {
+                lambda *= growth;
+                growth *= 2.0;
+            }
+
+            if (taken)
+            {
+                refresh = true;
+                continue;
+            }
+
+            std::copy(accepted.begin(), accepted.end(), x.begin());
+            std::copy(previous.begin(), previous.end(), error.begin());
+            if (!(radius > DBL_EPSILON * std::max(1.0, std::sqrt(mag_error))) || !(lambda < DBL_MAX))
+            {
+                throw std::runtime_error("trust region step could not reduce the residual of the system");
+            }
+        }
+
+        throw std::runtime_error("system did not converge within the iteration limit");
+    }
+
+    const vector<double>& NewtonSolver::iterate(const vector<Interval>* bounds, double margin, size_t limit, JacobianUpdate update, StepControl control)
+    {
+        if (margin <= 0.0)
+        {
+            throw std::invalid_argument("margin must be positive");
+        }
+
+        if (control != FullStep && update != Recompute)
+        {
+            throw std::invalid_argument("trust region steps need a fresh jacobian every iteration");
+        }
+
+        size_t n = error.size();
+        iterations = 0;
+        evaluations = 0;
+        jacobians = 0;
+        updates = 0;
+
+        if (control != FullStep)
+        {
+            return iterate_trust_region(bounds, margin, limit, control);
+        }
+
+        bool refresh = true;
+        if (mode != Automatic)
+        {
+            evaluate_residual();
+        }
+
+        for (; iterations < limit; iterations++)
+        {
+            if (refresh)
+            {
+                evaluate_jacobian();
+                if (!try_factor())
+                {
+                    throw std::runtime_error("jacobian of the system is singular");
+                }
+                updates = 0;
+                refresh = update == Recompute;
+            }
+
+            double mag_error = 0;
+            for (size_t i = 0; i < n; i++)
+            {
+                mag_error += error[i] * error[i];
+            }
+
+            // Solve J * step = error
+            double mag_delta = 0;
+            std::copy(error.begin(), error.end(), step.begin());
+            apply_inverse(step);
+            for (size_t j = 0; j < n; j++)
+            {
+                mag_delta += step[j] * step[j];
+            }
+
+            // If we are within the required radius of the correct value and solution
+            if (std::sqrt(mag_delta) <= margin && std::sqrt(mag_error) <= margin)
+            {
+                iterations++;
+                return x;
+            }
+
+            //...otherwise, modify guess and retry, keeping the step that was actually taken
+            for (size_t j = 0; j < n; j++)
+            {
+                double stored = x[j];
+                x[j] -= step[j];
+                if (bounds)
+                {
+                    x[j] = std::min(std::max(x[j], (*bounds)[j].lo), (*bounds)[j].hi);
+                }
+                step[j] = x[j] - stored;
+            }
+
+            if (update == Recompute)
+            {
+                if (mode != Automatic)
+                {
+                    evaluate_residual();
+                }
+                continue;
+            }
+
+            std::copy(error.begin(), error.end(), previous.begin());
+            evaluate_residual();
+
+            double mag_next = 0;
+            for (size_t i = 0; i < n; i++)
+            {
+                mag_next += error[i] * error[i];
+            }
+
+            // Progress has stalled, or the updates have run out: start again from a fresh jacobian
+            refresh = !(mag_next <= BROYDEN_STALL * BROYDEN_STALL * mag_error) || updates == BROYDEN_UPDATES || !try_update(step);
+        }
+
+        throw std::runtime_error("system did not converge within the iteration limit");
+    }
+
+    size_t NewtonSolver::get_iteration_count() const
+    {
+        return iterations;
+    }
+
+    size_t NewtonSolver::get_evaluation_count() const
+    {
+        return evaluations;
+    }
+
+    size_t NewtonSolver::get_jacobian_count() const
+    {
+        return jacobians;
+    }
+
+    bool NewtonSolver::is_sparse() const
+    {
+        return sparse;
+    }
+
+    void NewtonSolver::set_parallel_threshold(size_t threshold)
+    {
+        parallel_threshold = threshold;
+    }
+
+    size_t NewtonSolver::get_parallel_threshold() const
+    {
+        return parallel_threshold;
+    }
+
+    size_t NewtonSolver::size() const
+    {
+        return error.size();
+    }
+
+    BlockSolver::BlockSolver(const vector<CompiledExpression>& system, JacobianMode mode, ThreadPool& pool):
+        decomposition(system),
+        n(system.size()),
+        x(system.size()),
+        iterations(0),
+        evaluations(0)
+    {
+        const size_t none = (size_t)-1;
+        for (auto& expr: system)
+        {
+            for (size_t slot: expr.get_slots())
+            {
+                x.resize(std::max(x.size(), slot + 1));
+            }
+        }
+
+        vector<size_t> local(x.size(), none);
+        for (auto& block: decomposition.get_blocks())
+        {
+            vector<size_t> block_slots = block.unknowns;
+            vector<CompiledExpression> block_system;
+
+            if (block.unknowns.size() == n)
+            {
+                // The system does not decompose, so it is already the block
+                for (size_t slot = n; slot < x.size(); slot++)
+                {
+                    block_slots.push_back(slot);
+                }
+                block_system = system;
+            }
+            else
+            {
+                for (size_t k = 0; k < block_slots.size(); k++)
+                {
+                    local[block_slots[k]] = k;
+                }
+
+                for (size_t i: block.equations)
+                {
+                    vector<SlotToken> program = system[i].get_program();
+                    for (auto& tok: program)
+                    {
+                        if (tok.type != Var)
+                        {
+                            continue;
+                        }
+                        if (local[tok.operand] == none)
+                        {
+                            local[tok.operand] = block_slots.size();
+                            block_slots.push_back(tok.operand);
+                        }
+                        tok.operand = local[tok.operand];
+                    }
+                    block_system.push_back(CompiledExpression(program));
+                    (void)block_system.back().try_set_backend(system[i].get_backend());
+                }
+
+                for (size_t slot: block_slots)
+                {
+                    local[slot] = none;
+                }
+            }
+
+            solvers.push_back(NewtonSolver(block_system, mode, pool));
+            guesses.push_back(vector<double>(block_slots.size()));
+            domains.push_back(vector<Interval>(block_slots.size()));
+            slots.push_back(move(block_slots));
+        }
+    }
+
+    const vector<double>& BlockSolver::solve(const vector<double>& guess, double margin, size_t limit, JacobianUpdate update, StepControl control)
+    {
+        if (guess.size() != x.size())
+        {
+            throw std::invalid_argument("guess must have a value for every slot the system reads");
+        }
+
+        std::copy(guess.begin(), guess.end(), x.begin());
+        return iterate(nullptr, margin, limit, update, control);
+    }
+
+    const vector<double>& BlockSolver::solve(const vector<double>& guess, const vector<Interval>& bounds, double margin, size_t limit, JacobianUpdate update, StepControl control)
+    {
+        if (guess.size() != x.size())
+        {
+            throw std::invalid_argument("guess must have a value for every slot the system reads");
+        }
+
+        if (bounds.size() != x.size())
+        {
+            throw std::invalid_argument("bounds must have one domain per slot");
+        }
+
+        std::copy(guess.begin(), guess.end(), x.begin());
+        return iterate(&bounds, margin, limit, update, control);
+    }
+
+    const vector<double>& BlockSolver::iterate(const vector<Interval>* bounds, double margin, size_t limit, JacobianUpdate update, StepControl control)
+    {
+        iterations = 0;
+        evaluations = 0;
+
+        // Each block reads only its own unknowns and those of the blocks already solved
+        for (size_t b = 0; b < solvers.size(); b++)
+        {
+            vector<double>& local = guesses[b];
+            for (size_t k = 0; k < local.size(); k++)
+            {
+                local[k] = x[slots[b][k]];
+            }
+
+            const vector<double>* root;
+            if (bounds)
+            {
+                for (size_t k = 0; k < local.size(); k++)
+                {
+                    domains[b][k] = (*bounds)[slots[b][k]];
+                }
+                root = &solvers[b].solve(local, domains[b], margin, limit, update, control);
+            }
+            else
+            {
+                root = &solvers[b].solve(local, margin, limit, update, control);
+            }
+
+            for (size_t k = 0; k < solvers[b].size(); k++)
+            {
+                x[slots[b][k]] = (*root)[k];
+            }
+            iterations += solvers[b].get_iteration_count();
+            evaluations += solvers[b].get_evaluation_count();
+        }
+        return x;
+    }
+
+    const BlockDecomposition& BlockSolver::get_decomposition() const
+    {
+        return decomposition;
+    }
+
+    size_t BlockSolver::get_iteration_count() const
+    {
+        return iterations;
+    }
+
+    size_t BlockSolver::get_evaluation_count() const
+    {
+        return evaluations;
+    }
+
+    void BlockSolver::set_parallel_threshold(size_t threshold)
+    {
+        for (auto& solver: solvers)
+        {
+            solver.set_parallel_threshold(threshold);
+        }
+    }
+
+    size_t BlockSolver::size() const
+    {
+        return n;
+    }
+
+    ParameterSweep::ParameterSweep(const vector<CompiledExpression>& system, JacobianMode mode, ThreadPool& pool):
+        n(system.size()),
+        parameters(0),
+        pool(&pool),
+        roots(0, 0),
+        segments(0),
+        iterations(0),
+        failures(0)
+    {
+        size_t slots = n;
+        for (auto& expr: system)
+        {
+            for (size_t slot: expr.get_slots())
+            {
+                slots = std::max(slots, slot + 1);
+            }
+        }
+        parameters = slots - n;
+        if (parameters == 0)
+        {
+            throw std::invalid_argument("system has no parameters to sweep");
+        }
+
+        // Segments already fill the pool, so evaluation within a segment must not be split across it again
+        BlockSolver solver(system, mode, pool);
+        solver.set_parallel_threshold(SIZE_MAX);
+        solvers.assign(pool.size(), solver);
+        inputs.assign(pool.size(), vector<double>(slots));
+        worker_iterations.assign(pool.size(), 0);
+        worker_failures.assign(pool.size(), 0);
+    }
+
+    const Matrix<double>& ParameterSweep::solve(const vector<double>& guess, const Matrix<double>& points, double margin, size_t limit, StepControl control)
+    {
+        if (guess.size() != n)
+        {
+            throw std::invalid_argument("guess must have a value for every unknown");
+        }
+
+        if (points.get_cols() != parameters)
+        {
+            throw std::invalid_argument("points must have a value for every parameter");
+        }
+
+        size_t count = points.get_rows();
+        if (roots.get_rows() != count)
+        {
+            roots = Matrix<double>(count, n);
+            order.resize(count);
+        }
+
+        // Sorting the points by each parameter in turn puts those of a one-parameter sweep in order,
+        // and keeps those of a grid close along its last parameter
+        for (size_t k = 0; k < count; k++)
+        {
+            order[k] = k;
+        }
+        std::sort(order.begin(), order.end(), [&points](size_t a, size_t b) {
+            for (size_t p = 0; p < points.get_cols(); p++)
+            {
+                if (points.get_index(a, p) != points.get_index(b, p))
+                {
+                    return points.get_index(a, p) < points.get_index(b, p);
+                }
+            }
+            return a < b;
+        });
+
+        std::fill(worker_iterations.begin(), worker_iterations.end(), 0);
+        std::fill(worker_failures.begin(), worker_failures.end(), 0);
+        segments = std::max<size_t>(1, std::min(pool->size(), count / SWEEP_MIN_SEGMENT));
+        if (segments == 1)
+        {
+            solve_segment(0, count, 0, guess, points, margin, limit, control);
+        }
+        else
+        {
+            auto call = std::tie(guess, points, margin, limit, control);
+            pool->parallel_for(segments, 1, [this, &call](size_t begin, size_t end, size_t worker) {
+                auto& [guess, points, margin, limit, control] = call;
+                for (size_t segment = begin; segment < end; segment++)
+                {
+                    size_t count = points.get_rows();
+                    solve_segment(segment * count / segments, (segment + 1) * count / segments, worker, guess, points, margin, limit, control);
+                }
+            });
+        }
+
+        iterations = 0;
+        failures = 0;
+        for (size_t worker = 0; worker < solvers.size(); worker++)
+        {
+            iterations += worker_iterations[worker];
+            failures += worker_failures[worker];
+        }
+        return roots;
+    }
+
+    void ParameterSweep::predict(size_t k, size_t history, const vector<double>& guess, const Matrix<double>& points, vector<double>& x) const
+    {
+        if (history == 0)
+        {
+            std::copy(guess.begin(), guess.end(), x.begin());
+            return;
+        }
+
+        size_t last = order[k - 1];
+        if (history == 1)
+        {
+            for (size_t j = 0; j < n; j++)
+            {
+                x[j] = roots.get_index(last, j);
+            }
+            return;
+        }
+
+        // Extend the chord through the last two roots by as far as the point is from the last one
+        size_t before = order[k - 2];
+        double ahead = 0.0, behind = 0.0;
+        for (size_t p = 0; p < parameters; p++)
+        {
+            double a = points.get_index(order[k], p) - points.get_index(last, p);
+            double b = points.get_index(last, p) - points.get_index(before, p);
+            ahead += a * a;
+            behind += b * b;
+        }
+        double scale = behind > 0.0 ? std::sqrt(ahead / behind) : 0.0;
+        for (size_t j = 0; j < n; j++)
+        {
+            x[j] = roots.get_index(last, j) + scale * (roots.get_index(last, j) - roots.get_index(before, j));
+        }
+    }
+
+    void ParameterSweep::solve_segment(size_t begin, size_t end, size_t worker, const vector<double>& guess, const Matrix<double>& points, double margin, size_t limit, StepControl control)
+    {
+        BlockSolver& solver = solvers[worker];
+        vector<double>& x = inputs[worker];
+        size_t history = 0;
+        for (size_t k = begin; k < end; k++)
+        {
+            size_t row = order[k];
+            for (size_t p = 0; p < parameters; p++)
+            {
+                x[n + p] = points.get_index(row, p);
+            }
+
+            // Start from the secant prediction, then fall back to the last root and the cold guess
+            const vector<double>* root = nullptr;
+            for (size_t start = std::min<size_t>(history, 2); !root; start--)
+            {
+                predict(k, start, guess, points, x);
+                try
+                {
+                    root = &solver.solve(x, margin, limit, Recompute, control);
+                }
+                catch (const std::runtime_error&)
+                {
+                    if (start == 0)
+                    {
+                        break;
+                    }
+                }
+            }
+
+            if (!root)
+            {
+                for (size_t j = 0; j < n; j++)
+                {
+                    roots.get_index_ref(row, j) = std::numeric_limits<double>::quiet_NaN();
+                }
+                worker_failures[worker]++;
+                history = 0;
+                continue;
+            }
+
+            for (size_t j = 0; j < n; j++)
+            {
+                roots.get_index_ref(row, j) = (*root)[j];
+            }
+            worker_iterations[worker] += solver.get_iteration_count();
+            history++;
+        }
+    }
+
+    size_t ParameterSweep::get_iteration_count() const
+    {
+        return iterations;
+    }
+
+    size_t ParameterSweep::get_failure_count() const
+    {
+        return failures;
+    }
+
+    size_t ParameterSweep::get_segment_count() const
+    {
+        return segments;
+    }
+
+    size_t ParameterSweep::size() const
+    {
+        return n;
+    }
+
+    size_t ParameterSweep::get_parameter_count() const
+    {
+        return parameters;
+    }
+
+    vector<double> newton_raphson_multivariate(
+        const vector<CompiledExpression>& system,
+        vector<double> guess,
+        double margin,
+        size_t limit,
+        JacobianMode mode,
+        StepControl control)
+    {
+        if (guess.size() != system.size())
+        {
+            throw std::invalid_argument("system must have as many equations as unknowns");
+        }
+
+        return BlockSolver(system, mode).solve(guess, margin, limit, Recompute, control);
+    }
+
+    vector<double> newton_raphson_multivariate(
+        const vector<CompiledExpression>& system,
+        vector<double> guess,
+        vector<Interval> bounds,
+        double margin,
+        size_t limit,
+        JacobianMode mode,
+        StepControl control)
+    {
+        if (guess.size() != system.size())
+        {
+            throw std::invalid_argument("system must have as many equations as unknowns");
+        }
+
+        if (bounds.size() != guess.size())
+        {
+            throw std::invalid_argument("bounds must have one domain per unknown");
+        }
+
+        if (!IntervalPresolve(system).try_tighten(bounds))
+        {
+            throw std::runtime_error("system has no root within the given bounds");
+        }
+
+        return BlockSolver(system, mode).solve(starting_point(bounds, move(guess)), bounds, margin, limit, Recompute, control);
+    }
+
+    unordered_map<string, double> newton_raphson_multivariate(
+        const vector<CompiledExpression>& system,
+        const VariableIndex& index,
+        unordered_map<string, double> guess,
+        double margin,
+        size_t limit,
+        JacobianMode mode,
+        StepControl control)
+    {
+        auto root = newton_raphson_multivariate(system, index.to_slots(guess), margin, limit, mode, control);
+        return index.from_slots(root.data());
     }
 }
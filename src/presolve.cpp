@@ -0,0 +1,420 @@
+#include "presolve.hpp"
+
+#include <deque>
+
+using std::move;
+using std::vector;
+
+namespace nexsys
+{
+    /// @brief Helper function to widen an interval by a relative margin. Covers the error of
+    /// exponents such as `1 / n` that cannot be represented exactly.
+    static Interval widen(const Interval& value, double margin)
+    {
+        if (value.is_empty())
+        {
+            return value;
+        }
+        return Interval(
+            value.lo - std::fabs(value.lo) * margin - DBL_MIN,
+            value.hi + std::fabs(value.hi) * margin + DBL_MIN
+        );
+    }
+
+    /// @brief Helper function to evaluate a built-in function over intervals
+    static Interval apply_intrinsic(Intrinsic id, const Interval* args)
+    {
+        switch(id)
+        {
+            case IntrSin:   return sin(args[0]);
+            case IntrCos:   return cos(args[0]);
+            case IntrTan:   return tan(args[0]);
+            case IntrAsin:  return asin(args[0]);
+            case IntrAcos:  return acos(args[0]);
+            case IntrAtan:  return atan(args[0]);
+            case IntrSinh:  return sinh(args[0]);
+            case IntrCosh:  return cosh(args[0]);
+            case IntrTanh:  return tanh(args[0]);
+            case IntrExp:   return exp(args[0]);
+            case IntrLog:   return log(args[0]);
+            case IntrLog10: return log10(args[0]);
+            case IntrSqrt:  return sqrt(args[0]);
+            case IntrAbs:   return fabs(args[0]);
+            case IntrMin:   return intrinsic_min(args[0], args[1]);
+            case IntrMax:   return intrinsic_max(args[0], args[1]);
+            case IntrHypot: return hypot(args[0], args[1]);
+            default:        return Interval::entire();
+        }
+    }
+
+    /// @brief Helper function to find the values of `x` for which `x^n` lies in `z`
+    static Interval invert_pow(const Interval& z, const Interval& x, double n)
+    {
+        Interval mag = widen(pow(intersect(z, Interval(0.0, INFINITY)), 1.0 / n), 1e-12);
+        if (n != std::trunc(n) || std::fabs(n) > 1024.0)
+        {
+            // Non-integer powers are only defined for non-negative bases
+            return intersect(x, intersect(mag, Interval(0.0, INFINITY)));
+        }
+
+        int32_t k = (int32_t)n;
+        if (k == 0 || (k < 0 && k % 2 != 0))
+        {
+            return x;
+        }
+        if (k % 2 == 0)
+        {
+            // Both signs of the root are possible
+            return hull(intersect(x, mag), intersect(x, Interval(-mag.hi, -mag.lo)));
+        }
+
+        // Odd roots keep the sign of their argument
+        auto root = [n](double v) { return std::copysign(std::pow(std::fabs(v), 1.0 / n), v); };
+        if (z.is_empty())
+        {
+            return Interval::empty();
+        }
+        return intersect(x, widen(Interval(root(z.lo), root(z.hi)), 1e-12));
+    }
+
+    /// @brief Helper function to narrow an interval, reporting if anything is left of it
+    static inline bool narrow(Interval& value, const Interval& projection)
+    {
+        value = intersect(value, projection);
+        return !value.is_empty();
+    }
+
+    /// @brief Helper function to narrow the arguments of a built-in function given its value
+    static bool narrow_intrinsic(Intrinsic id, const Interval& z, Interval* args)
+    {
+        Interval& x = args[0];
+        switch(id)
+        {
+            case IntrAsin:  return narrow(x, Interval(-1.0, 1.0)) && narrow(x, sin(intersect(z, Interval(-M_PI_2, M_PI_2))));
+            case IntrAcos:  return narrow(x, Interval(-1.0, 1.0)) && narrow(x, cos(intersect(z, Interval(0.0, M_PI))));
+            case IntrAtan:  return narrow(x, tan(intersect(z, Interval(-M_PI_2, M_PI_2))));
+            case IntrSinh:  return narrow(x, _increasing(z, [](double v) { return std::asinh(v); }));
+            case IntrTanh:  return narrow(x, _increasing(intersect(z, Interval(-1.0, 1.0)), [](double v) { return std::atanh(v); }));
+            case IntrExp:   return narrow(x, log(z));
+            case IntrLog:   return narrow(x, Interval(0.0, INFINITY)) && narrow(x, exp(z));
+            case IntrLog10: return narrow(x, Interval(0.0, INFINITY)) && narrow(x, widen(exp(z * Interval(M_LN10)), 1e-15));
+            case IntrSqrt:  return narrow(x, Interval(0.0, INFINITY)) && narrow(x, powi(intersect(z, Interval(0.0, INFINITY)), 2));
+            case IntrAbs:
+            case IntrCosh:
+            {
+                // Both are even functions, increasing in the magnitude of their argument
+                Interval mag = intersect(z, Interval(0.0, INFINITY));
+                if (id == IntrCosh)
+                {
+                    mag = _increasing(intersect(z, Interval(1.0, INFINITY)), [](double v) { return std::acosh(v); });
+                    mag = intersect(mag, Interval(0.0, INFINITY));
+                }
+                return !mag.is_empty() && narrow(x, hull(intersect(x, mag), intersect(x, Interval(-mag.hi, -mag.lo))));
+            }
+            case IntrMin:   return narrow(args[0], Interval(z.lo, INFINITY)) && narrow(args[1], Interval(z.lo, INFINITY));
+            case IntrMax:   return narrow(args[0], Interval(-INFINITY, z.hi)) && narrow(args[1], Interval(-INFINITY, z.hi));
+            case IntrHypot: return narrow(args[0], Interval(-z.hi, z.hi)) && narrow(args[1], Interval(-z.hi, z.hi));
+            default:        return true; // Periodic and user functions are not inverted
+        }
+    }
+
+    /// @brief Helper function to check if a domain shrank enough for its readers to be revisited
+    static bool shrank(const Interval& before, const Interval& after, double min_shrink)
+    {
+        if (std::isfinite(before.width()))
+        {
+            return after.width() < before.width() * (1.0 - min_shrink);
+        }
+        return after.lo > before.lo + min_shrink * std::max(1.0, std::fabs(before.lo))
+            || after.hi < before.hi - min_shrink * std::max(1.0, std::fabs(before.hi));
+    }
+
+    IntervalPresolve::IntervalPresolve(): slot_count(0) {}
+
+    IntervalPresolve::IntervalPresolve(const vector<CompiledExpression>& system): slot_count(0)
+    {
+        vector<size_t> stack;
+        for (size_t e = 0; e < system.size(); e++)
+        {
+            _Equation eq;
+            stack.clear();
+            for (const SlotToken& tok: system[e].get_program())
+            {
+                _Node node { tok.type, tok.operand, 0.0, nullptr, eq.args.size() };
+                size_t argc = 0;
+                switch(tok.type)
+                {
+                    case Num:  node.value = tok.value;       break;
+                    case Var:  slot_count = std::max(slot_count, tok.operand + 1); break;
+                    case Func: node.function = tok.function; argc = tok.operand; break;
+                    default:   argc = 2;                      break;
+                }
+
+                eq.args.insert(eq.args.end(), stack.end() - argc, stack.end());
+                stack.resize(stack.size() - argc);
+                stack.push_back(eq.nodes.size());
+                eq.nodes.push_back(node);
+            }
+            equations.push_back(move(eq));
+        }
+
+        readers.resize(slot_count);
+        for (size_t e = 0; e < equations.size(); e++)
+        {
+            for (const _Node& node: equations[e].nodes)
+            {
+                if (node.type == Var && (readers[node.operand].empty() || readers[node.operand].back() != e))
+                {
+                    readers[node.operand].push_back(e);
+                }
+            }
+        }
+    }
+
+    void IntervalPresolve::evaluate_forward(const _Equation& eq, const vector<Interval>& bounds, vector<Interval>& values) const
+    {
+        size_t n = eq.nodes.size();
+        values.resize(n);
+        vector<Interval> scratch;
+        for (size_t i = 0; i < n; i++)
+        {
+            const _Node& node = eq.nodes[i];
+            const size_t* args = eq.args.data() + node.first_arg;
+            switch(node.type)
+            {
+                case Num:   values[i] = Interval(node.value);                  break;
+                case Var:   values[i] = bounds[node.operand];                  break;
+                case Plus:  values[i] = values[args[0]] + values[args[1]];     break;
+                case Minus: values[i] = values[args[0]] - values[args[1]];     break;
+                case Mul:   values[i] = values[args[0]] * values[args[1]];     break;
+                case Div:   values[i] = values[args[0]] / values[args[1]];     break;
+                case Exp:   values[i] = pow(values[args[0]], values[args[1]]); break;
+                default:
+                {
+                    scratch.clear();
+                    for (size_t k = 0; k < node.operand; k++)
+                    {
+                        scratch.push_back(values[args[k]]);
+                    }
+                    values[i] = node.function->intrinsic != IntrNone
+                        ? apply_intrinsic(node.function->intrinsic, scratch.data())
+                        : call_function(node.function, scratch.data());
+                    break;
+                }
+            }
+        }
+    }
+
+    bool IntervalPresolve::try_revise(const _Equation& eq, vector<Interval>& bounds, vector<Interval>& values, vector<size_t>& narrowed, double min_shrink) const
+    {
+        size_t n = eq.nodes.size();
+        vector<Interval> scratch;
+
+        // Forward: the range of every subexpression over the current domains
+        evaluate_forward(eq, bounds, values);
+
+        // The equation holds only where it is zero
+        if (!narrow(values[n - 1], Interval(0.0)))
+        {
+            return false;
+        }
+
+        // Backward: project each operation's narrowed value onto its arguments
+        for (size_t i = n; i-- > 0;)
+        {
+            const _Node& node = eq.nodes[i];
+            const size_t* args = eq.args.data() + node.first_arg;
+            const Interval z = values[i];
+            bool ok = true;
+            switch(node.type)
+            {
+                case Num:
+                case Var:
+                    break;
+                case Plus:
+                    ok = narrow(values[args[0]], z - values[args[1]])
+                        && narrow(values[args[1]], z - values[args[0]]);
+                    break;
+                case Minus:
+                    ok = narrow(values[args[0]], z + values[args[1]])
+                        && narrow(values[args[1]], values[args[0]] - z);
+                    break;
+                case Mul:
+                    ok = narrow(values[args[0]], z / values[args[1]])
+                        && narrow(values[args[1]], z / values[args[0]]);
+                    break;
+                case Div:
+                    ok = narrow(values[args[0]], z * values[args[1]])
+                        && narrow(values[args[1]], values[args[0]] / z);
+                    break;
+                case Exp:
+                {
+                    const Interval& exponent = values[args[1]];
+                    if (exponent.lo == exponent.hi)
+                    {
+                        ok = narrow(values[args[0]], invert_pow(z, values[args[0]], exponent.lo));
+                    }
+                    break;
+                }
+                default:
+                {
+                    if (node.function->intrinsic == IntrNone)
+                    {
+                        break;
+                    }
+                    scratch.clear();
+                    for (size_t k = 0; k < node.operand; k++)
+                    {
+                        scratch.push_back(values[args[k]]);
+                    }
+                    ok = narrow_intrinsic(node.function->intrinsic, z, scratch.data());
+                    for (size_t k = 0; ok && k < node.operand; k++)
+                    {
+                        ok = narrow(values[args[k]], scratch[k]);
+                    }
+                    break;
+                }
+            }
+
+            if (!ok)
+            {
+                return false;
+            }
+        }
+
+        for (size_t i = 0; i < n; i++)
+        {
+            if (eq.nodes[i].type != Var)
+            {
+                continue;
+            }
+
+            Interval& domain = bounds[eq.nodes[i].operand];
+            Interval before = domain;
+            if (!narrow(domain, values[i]))
+            {
+                return false;
+            }
+            if (shrank(before, domain, min_shrink))
+            {
+                narrowed.push_back(eq.nodes[i].operand);
+            }
+        }
+        return true;
+    }
+
+    bool IntervalPresolve::try_tighten(vector<Interval>& bounds, size_t max_passes, double min_shrink) const
+    {
+        if (bounds.size() < slot_count)
+        {
+            throw std::invalid_argument("bounds must cover every slot read by the system");
+        }
+
+        std::deque<size_t> pending;
+        vector<bool> queued(equations.size(), true);
+        for (size_t e = 0; e < equations.size(); e++)
+        {
+            pending.push_back(e);
+        }
+
+        vector<Interval> values;
+        vector<size_t> narrowed;
+        size_t budget = max_passes * equations.size();
+        while (!pending.empty() && budget-- > 0)
+        {
+            size_t e = pending.front();
+            pending.pop_front();
+            queued[e] = false;
+
+            narrowed.clear();
+            if (!try_revise(equations[e], bounds, values, narrowed, min_shrink))
+            {
+                return false;
+            }
+
+            for (size_t slot: narrowed)
+            {
+                for (size_t reader: readers[slot])
+                {
+                    if (!queued[reader])
+                    {
+                        queued[reader] = true;
+                        pending.push_back(reader);
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+    bool IntervalPresolve::may_contain_root(const vector<Interval>& bounds) const
+    {
+        if (bounds.size() < slot_count)
+        {
+            throw std::invalid_argument("bounds must cover every slot read by the system");
+        }
+
+        vector<Interval> values;
+        for (const _Equation& eq: equations)
+        {
+            evaluate_forward(eq, bounds, values);
+            if (!values.back().contains(0.0))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    Interval evaluate_interval(const CompiledExpression& expr, const vector<Interval>& x)
+    {
+        vector<Interval> frame(expr.get_depth());
+        return expr.evaluate(x.data(), frame.data());
+    }
+
+    vector<Interval> bounds_from_context(const ContextMap& ctx, const VariableIndex& index)
+    {
+        vector<Interval> bounds(index.size(), Interval::entire());
+        for (size_t slot = 0; slot < index.size(); slot++)
+        {
+            Variable* var;
+            auto known = ctx.find(index.get_name(slot));
+            if (known != ctx.end() && known->second.try_unwrap_var(var))
+            {
+                bounds[slot] = Interval(var->get_min_bound(), var->get_max_bound());
+            }
+        }
+        return bounds;
+    }
+
+    vector<double> starting_point(const vector<Interval>& bounds, vector<double> guess)
+    {
+        if (guess.size() != bounds.size())
+        {
+            throw std::invalid_argument("guess must have one value per domain");
+        }
+
+        for (size_t slot = 0; slot < guess.size(); slot++)
+        {
+            const Interval& domain = bounds[slot];
+            if (domain.contains(guess[slot]) || domain.is_empty())
+            {
+                continue;
+            }
+
+            if (std::isfinite(domain.lo) && std::isfinite(domain.hi))
+            {
+                guess[slot] = domain.midpoint();
+            }
+            else if (std::isfinite(domain.lo))
+            {
+                guess[slot] = domain.lo + std::max(1.0, std::fabs(domain.lo));
+            }
+            else if (std::isfinite(domain.hi))
+            {
+                guess[slot] = domain.hi - std::max(1.0, std::fabs(domain.hi));
+            }
+        }
+        return guess;
+    }
+}
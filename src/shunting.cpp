@@ -1,193 +1,261 @@
 #include "shunting.hpp"
+#include "compiled.hpp"
 
 using std::function;
-using std::istream_iterator;
 using std::move;
 using std::string;
-using std::stringstream;
 using std::unordered_map;
 using std::vector;
 
 namespace nexsys
 {
-    /// @brief 
-    /// @param op 
-    /// @return 
-    static char precedence(string op)
+    /// @brief An entry on the operator stack of the shunting-yard algorithm
+    struct _Pending
     {
-        if (op.size() != 1)
-        {
-            return 0;
-        }
+        /// @brief An operator, `LexLeftParenthesis`, or `LexSymbol` for a function
+        LexemeType type;
+
+        /// @brief The function token of a `LexSymbol` entry
+        Token function;
+    };
 
-        switch(*(op.c_str()))
+    /// @brief Helper function to get the precedence of an operator. Functions and parentheses have none.
+    static int precedence(LexemeType type)
+    {
+        switch(type)
         {
-            case '^':
+            case LexExp:
                 return 4;
-            case '*':
-            case '/':
+            case LexMul:
+            case LexDiv:
                 return 3;
-            case '+':
-            case '-':
+            case LexPlus:
+            case LexMinus:
                 return 2;
             default:
-                return 1;
+                return 0;
         }
     }
 
-    /// @brief 
-    /// @param o1 
-    /// @param o2 
-    /// @return 
-    static char prec_check(string o1, string o2)
+    /// @brief Helper function to check if the operator on top of the stack must be output before pushing `o1`
+    static bool prec_check(LexemeType o1, LexemeType top)
     {
-        bool check1 = o2 != "(";
-        bool check2 = precedence(o2) > precedence(o1);
-        bool check3 = precedence(o2) == precedence(o1) && o1 != "^";
-
-        return check1 && (check2 || check3);
+        int p1 = precedence(o1);
+        int p2 = precedence(top);
+        return p2 != 0 && (p2 > p1 || (p2 == p1 && o1 != LexExp));
     }
 
-    /// @brief 
-    /// @param expr 
-    /// @return 
-    static string punctuate(string expr)
+    /// @brief Helper function to convert an entry of the operator stack to its `Token`
+    static Token to_token(const _Pending& pending)
     {
-        string output_expr;
-        for (char c : expr)
+        switch(pending.type)
         {
-            switch(OPTOKENS.find(c))
-            {
-                case string::npos:
-                    output_expr.push_back(c);
-                    break;
-
-                default:
-                    output_expr.push_back(' ');
-                    output_expr.push_back(c);
-                    output_expr.push_back(' ');
-                    break;
-            }
+            case LexPlus:  return Token::plus();
+            case LexMinus: return Token::minus();
+            case LexMul:   return Token::mul();
+            case LexDiv:   return Token::div();
+            case LexExp:   return Token::exp();
+            default:       return pending.function;
         }
-
-        return output_expr;
     }
 
-    extern bool try_parse_double(string expr, double& result);
-
-    static vector<Token> rpnify(string expr, ContextMap ctx)
+    /// @brief Helper function implementing the shunting-yard algorithm for any kind of context
+    /// @param resolve Called as `resolve(text, token, name)` to look up a symbol. Must set `token` and
+    /// `name` to the symbol's `Token` and to a name that lives as long as the context, then return `true`.
+    /// @param queue Receives the expression's `Token`s in reverse polish notation
+    /// @param symbols If not null, receives the name each output token was resolved from, or an empty view
+    template<typename Resolve>
+    static void shunting_yard(const string& expr, Resolve resolve, vector<Token>& queue, vector<std::string_view>* symbols)
     {
-        // Get space-delimited vector of words in the expression
-        stringstream ss(punctuate(expr));
-        istream_iterator<string> begin(ss);
-        istream_iterator<string> end;
-        vector<string> words(begin, end);
-
-        // Initialize stack and queue
-        vector<string> stack;
-        vector<Token> queue;
+        // The operator stack is only scratch space, so each thread keeps one for all of its conversions
+        thread_local vector<_Pending> stack;
+        stack.clear();
+        queue.clear();
+        if (symbols != nullptr)
+        {
+            symbols->clear();
+        }
+
+        Lexer lexer(expr);
         bool minus_is_unary = true;
+        const Token* known;
+        std::string_view name;
 
-        for (auto word: words)
+        // Keeps `symbols` the same length as `queue` for tokens that did not come from a symbol
+        auto fill_symbols = [&]()
         {
-            if (word == ",")
+            if (symbols != nullptr)
             {
-                while (stack.size() != 0)
-                {
-                    if (stack.back() == "(")
-                    {
-                        stack.pop_back();
-                        break;
-                    }
-                    queue.push_back(tokenize_with_context(move(stack.back()), ctx));
-                    stack.pop_back();
-                }
-                minus_is_unary = true;
-            }
-            else if (word == "(")
-            {
-                stack.push_back(word);
-                minus_is_unary = false;
+                symbols->resize(queue.size());
             }
-            else if (word == ")")
+        };
+
+        for (Lexeme lex = lexer.next(); lex.type != LexEnd; lex = lexer.next())
+        {
+            switch(lex.type)
             {
-                while (stack.size() != 0)
-                {
-                    if (stack.back() == "(")
+                case LexComma:
+                    while (stack.size() != 0 && stack.back().type != LexLeftParenthesis)
                     {
+                        queue.push_back(to_token(stack.back()));
                         stack.pop_back();
-                        break;
                     }
-                    else
+                    minus_is_unary = true;
+                    break;
+
+                case LexLeftParenthesis:
+                    stack.push_back(_Pending { LexLeftParenthesis, Token() });
+                    minus_is_unary = true;
+                    break;
+
+                case LexRightParenthesis:
+                    while (stack.size() != 0 && stack.back().type != LexLeftParenthesis)
                     {
-                        queue.push_back(tokenize_with_context(word, ctx));
+                        queue.push_back(to_token(stack.back()));
                         stack.pop_back();
                     }
-                }
-                minus_is_unary = true;
-            }
-            else if (word == "+" || word == "-" || word == "*" || word == "/" || word == "^")
-            {
-                string o1 = word;
 
-                if (minus_is_unary && o1 == "-")
-                {
-                    queue.push_back(Token::num(-1.0));
-                    stack.push_back("*");
-                    // do not specify `minus_is_unary`
-                    // minus will be unary following a 
-                    // unary minus for double negation.
-                }
-                else
-                {
-                    while (stack.size() != 0)
+                    if (stack.size() == 0)
                     {
-                        string o2 = stack.back();
+                        throw std::invalid_argument("mismatched parenthesis in expression: " + expr);
+                    }
+                    stack.pop_back();
+
+                    // A function name directly preceding the parenthesis is applied to its arguments
+                    if (stack.size() != 0 && stack.back().type == LexSymbol)
+                    {
+                        queue.push_back(stack.back().function);
                         stack.pop_back();
-                        if (prec_check(o1, o2))
+                    }
+                    minus_is_unary = false;
+                    break;
+
+                case LexNum:
+                    queue.push_back(Token::num(lex.value));
+                    minus_is_unary = false;
+                    break;
+
+                case LexSymbol:
+                    // Built-in functions are only used if the context does not define the symbol
+                    if (!resolve(lex.text, known, name))
+                    {
+                        if (!try_get_intrinsic(lex.text, known))
                         {
-                            queue.push_back(tokenize_with_context(o2, ctx));
+                            throw std::invalid_argument("unrecognized symbol '" + string(lex.text) + "' in expression: " + expr);
                         }
-                        else
+                        name = std::string_view();
+                    }
+
+                    if (known->get_type() == Func)
+                    {
+                        stack.push_back(_Pending { LexSymbol, *known });
+                        minus_is_unary = true; // minus will be unary following an individual function token 
+                    }
+                    else
+                    {
+                        fill_symbols();
+                        queue.push_back(*known);
+                        if (symbols != nullptr)
                         {
-                            stack.push_back(o2);
-                            break;
+                            symbols->push_back(name);
                         }
+                        minus_is_unary = false;
                     }
-                    minus_is_unary = true;
-                }
-            }
-            else // Token is either a yet-to-be-parsed number literal, a ctx-specified token, or garbage
-            {
-                auto in_ctx = ctx.find(word);
-                double num_literal;
+                    break;
 
-                if (in_ctx != ctx.end())
-                {
-                    minus_is_unary = (in_ctx->second.get_type() == Func); // minus will be unary following an individual function token 
-                }
-                else if (try_parse_double(word, num_literal))
-                {
-                    queue.push_back(Token::num(num_literal));
-                }
-                else
-                {
-                    throw; // TODO
-                }
+                default: // Binary operators
+                    if (minus_is_unary && lex.type == LexMinus)
+                    {
+                        queue.push_back(Token::num(-1.0));
+                        stack.push_back(_Pending { LexMul, Token() });
+                        // do not specify `minus_is_unary`
+                        // minus will be unary following a 
+                        // unary minus for double negation.
+                    }
+                    else if (minus_is_unary)
+                    {
+                        throw std::invalid_argument("operator '" + string(lex.text) + "' is missing its left operand in expression: " + expr);
+                    }
+                    else
+                    {
+                        while (stack.size() != 0 && prec_check(lex.type, stack.back().type))
+                        {
+                            queue.push_back(to_token(stack.back()));
+                            stack.pop_back();
+                        }
+                        stack.push_back(_Pending { lex.type, Token() });
+                        minus_is_unary = true;
+                    }
+                    break;
             }
         }
 
         while (stack.size() != 0)
         {
-            if (stack.back() == "(" || stack.back() == ")")
+            if (stack.back().type == LexLeftParenthesis)
             {
-                throw; // TODO
+                throw std::invalid_argument("mismatched parenthesis in expression: " + expr);
             }
-            queue.push_back(tokenize_with_context(stack.back(), ctx));
+            queue.push_back(to_token(stack.back()));
             stack.pop_back();
         }
 
-        return queue;
+        fill_symbols();
+    }
+
+    vector<Token> rpnify(const string& expr, const ContextMap& ctx, vector<std::string_view>& symbols)
+    {
+        vector<Token> rpn_expr;
+        string key;
+        auto resolve = [&ctx, &key](std::string_view text, const Token*& token, std::string_view& name)
+        {
+            key.assign(text.data(), text.size());
+            auto in_ctx = ctx.find(key);
+            if (in_ctx == ctx.end())
+            {
+                return false;
+            }
+            token = &in_ctx->second;
+            name = in_ctx->first;
+            return true;
+        };
+        shunting_yard(expr, resolve, rpn_expr, &symbols);
+        return rpn_expr;
+    }
+
+    vector<Token> rpnify(const string& expr, const ContextView& ctx, vector<std::string_view>& symbols)
+    {
+        vector<Token> rpn_expr;
+        rpnify(expr, ctx, rpn_expr, symbols);
+        return rpn_expr;
+    }
+
+    void rpnify(const string& expr, const ContextView& ctx, vector<Token>& rpn_expr, vector<std::string_view>& symbols)
+    {
+        auto resolve = [&ctx](std::string_view text, const Token*& token, std::string_view& name)
+        {
+            uint32_t id;
+            if (!ctx.try_get_id(text, id))
+            {
+                return false;
+            }
+            token = &ctx.get_token(id);
+            name = ctx.get_name(id);
+            return true;
+        };
+        shunting_yard(expr, resolve, rpn_expr, &symbols);
+    }
+
+    vector<Token> rpnify(const string& expr, const ContextMap& ctx)
+    {
+        vector<std::string_view> symbols;
+        return rpnify(expr, ctx, symbols);
+    }
+
+    vector<Token> rpnify(const string& expr, const ContextView& ctx)
+    {
+        vector<std::string_view> symbols;
+        return rpnify(expr, ctx, symbols);
     }
 
     /// @brief Helper type sized to temporarily store any value contained in a `Token`.
@@ -199,10 +267,7 @@ namespace nexsys
         size_t _uint;
     };
 
-    /// @brief Evaluates a compiled reverse polish notation expression
-    /// @param rpn_expr The reverse polish notation expression as a `std::vector<Token>`
-    /// @return the value of the expression as a `double`
-    static double eval_rpn_expression(vector<Token> rpn_expr)
+    double eval_rpn_expression(vector<Token> rpn_expr)
     {
         vector<double> stack;
         vector<double> args;
@@ -227,7 +292,7 @@ namespace nexsys
                 case Plus:
                     if (stack.size() < 2)
                     {
-                        throw; // TODO
+                        throw std::invalid_argument("reverse polish expression is missing an operand");
                     }
                     _temp2._double = move(stack.back());
                     stack.pop_back();
@@ -239,7 +304,7 @@ namespace nexsys
                 case Minus:
                     if (stack.size() < 2)
                     {
-                        throw; // TODO
+                        throw std::invalid_argument("reverse polish expression is missing an operand");
                     }
                     _temp2._double = move(stack.back());
                     stack.pop_back();
@@ -251,7 +316,7 @@ namespace nexsys
                 case Mul:
                     if (stack.size() < 2)
                     {
-                        throw; // TODO
+                        throw std::invalid_argument("reverse polish expression is missing an operand");
                     }
                     _temp2._double = move(stack.back());
                     stack.pop_back();
@@ -263,7 +328,7 @@ namespace nexsys
                 case Div:
                     if (stack.size() < 2)
                     {
-                        throw; // TODO
+                        throw std::invalid_argument("reverse polish expression is missing an operand");
                     }
                     _temp2._double = move(stack.back());
                     stack.pop_back();
@@ -275,7 +340,7 @@ namespace nexsys
                 case Exp:
                     if (stack.size() < 2)
                     {
-                        throw; // TODO
+                        throw std::invalid_argument("reverse polish expression is missing an operand");
                     }
                     _temp2._double = move(stack.back());
                     stack.pop_back();
@@ -288,12 +353,14 @@ namespace nexsys
                     (void)tok.try_unwrap_func(_temp1._uint, _temp2._func);
                     if (stack.size() < _temp1._uint)
                     {
-                        throw; // TODO
+                        throw std::invalid_argument("reverse polish expression is missing an operand");
                     }
                     
-                    while (args.size() < _temp1._uint)
+                    // Arguments are passed in the order they were written
+                    args.resize(_temp1._uint);
+                    for (size_t i = _temp1._uint; i > 0; i--)
                     {
-                        args.push_back(move(stack.back()));
+                        args[i - 1] = move(stack.back());
                         stack.pop_back();
                     }
 
@@ -302,34 +369,46 @@ namespace nexsys
                     break;
 
                 default:
-                    throw; // TODO
+                    throw std::invalid_argument("reverse polish expression contains a token that cannot be evaluated");
             }
         }
         if (stack.size() != 1)
         {
-            throw; // TODO
+            throw std::invalid_argument("reverse polish expression does not reduce to a single value");
         }
         return stack.back();
     }
 
-    function<double (unordered_map<string, double>)> compile_to_function_of_umap(string expr, ContextMap ctx)
+    function<double (unordered_map<string, double>)> compile_to_function_of_umap(const string& expr, const ContextMap& ctx)
     {
-        auto compiled_expr = move(rpnify(expr, ctx));
-        auto arg_lookup_table = ctx;
+        VariableIndex index;
+        CompiledExpression compiled = compile_to_expression(expr, ctx, index);
+
+        // Only the variables used by the expression are captured, rather than a copy of the whole context
+        vector<Variable*> variables(index.size());
+        for (size_t slot = 0; slot < index.size(); slot++)
+        {
+            (void)ctx.at(index.get_name(slot)).try_unwrap_var(variables[slot]);
+        }
 
-        return [arg_lookup_table, compiled_expr](unordered_map<string, double> x)
+        return [index, compiled, variables](unordered_map<string, double> x)
         {
-            Variable *var;
+            // Values are still assigned through each `Variable`, so they are clamped to its domain and
+            // variables left out of `x` keep whatever value they were last given
+            vector<double> slots(variables.size());
             for (auto var_val: x)
             {
-                auto maybe_var = arg_lookup_table.find(var_val.first);
-                if (maybe_var != arg_lookup_table.end() && 
-                    maybe_var->second.try_unwrap_var(var))
+                size_t slot;
+                if (index.try_get_slot(var_val.first, slot))
                 {
-                    *var = var_val.second;
+                    *variables[slot] = var_val.second;
                 }
             }
-            return eval_rpn_expression(compiled_expr);
+            for (size_t slot = 0; slot < variables.size(); slot++)
+            {
+                slots[slot] = variables[slot]->get_value();
+            }
+            return compiled.evaluate(slots);
         };
     }
 }
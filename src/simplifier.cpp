@@ -0,0 +1,325 @@
+#include "simplifier.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+using std::vector;
+
+namespace nexsys
+{
+    /// @brief A value on the simplifier's stack. Its tokens run from `start` to the start of the next value.
+    struct _Value
+    {
+        size_t start;
+
+        /// @brief If the value is a single `Num` token
+        bool constant;
+
+        /// @brief If the value is `y * -1`, i.e. its tokens are those of `y` followed by `Num(-1)` and `Mul`
+        bool negated;
+    };
+
+    /// @brief Helper function to build a constant token
+    static SlotToken num_token(double value)
+    {
+        SlotToken tok;
+        tok.type = Num;
+        tok.operand = 0;
+        tok.value = value;
+        return tok;
+    }
+
+    /// @brief Helper function to build an operator token
+    static SlotToken op_token(TokenType type)
+    {
+        SlotToken tok;
+        tok.type = type;
+        tok.operand = 0;
+        tok.value = 0.0;
+        return tok;
+    }
+
+    /// @brief Helper function to apply an operator to two constants exactly as the lowered program would
+    static double fold(TokenType type, double lhs, double rhs)
+    {
+        switch(type)
+        {
+            case Plus:  return lhs + rhs;
+            case Minus: return lhs - rhs;
+            case Mul:   return lhs * rhs;
+            case Div:   return lhs / rhs;
+            default:    return is_powi_exponent(rhs) ? powi(lhs, (int32_t)rhs) : std::pow(lhs, rhs);
+        }
+    }
+
+    /// @brief Helper function to check if dividing by a constant is the same as multiplying by its reciprocal
+    static bool has_exact_reciprocal(double value)
+    {
+        int exponent;
+        return std::fpclassify(value) == FP_NORMAL && std::fabs(std::frexp(value, &exponent)) == 0.5
+            && std::fpclassify(1.0 / value) == FP_NORMAL;
+    }
+
+    /// @brief Helper function to order tokens for canonicalization
+    static int compare_tokens(const SlotToken& lhs, const SlotToken& rhs)
+    {
+        if (lhs.type != rhs.type)
+        {
+            return lhs.type < rhs.type ? -1 : 1;
+        }
+
+        switch(lhs.type)
+        {
+            case Num:
+                return memcmp(&lhs.value, &rhs.value, sizeof(double));
+            case Var:
+                return lhs.operand == rhs.operand ? 0 : (lhs.operand < rhs.operand ? -1 : 1);
+            case Func:
+                return lhs.function == rhs.function ? 0 : (std::less<FunctionDataPtr>()(lhs.function, rhs.function) ? -1 : 1);
+            default:
+                return 0;
+        }
+    }
+
+    /// @brief Helper function to check if the operands of a commutative operation should be swapped.
+    /// Compound operands come first, then variables, then constants, which is the order lowering fuses best.
+    static bool out_of_order(const vector<SlotToken>& program, size_t lhs, size_t rhs, size_t end)
+    {
+        auto rank = [&](size_t start, size_t stop) {
+            return stop - start > 1 ? 0 : (program[start].type == Var ? 1 : 2);
+        };
+
+        int lhs_rank = rank(lhs, rhs), rhs_rank = rank(rhs, end);
+        if (lhs_rank != rhs_rank)
+        {
+            return lhs_rank > rhs_rank;
+        }
+
+        for (size_t i = lhs, j = rhs; i < rhs && j < end; i++, j++)
+        {
+            int order = compare_tokens(program[i], program[j]);
+            if (order != 0)
+            {
+                return order > 0;
+            }
+        }
+        return rhs - lhs > end - rhs;
+    }
+
+    size_t simplify_program(vector<SlotToken>& program)
+    {
+        vector<SlotToken> out;
+        out.reserve(program.size());
+        vector<_Value> stack;
+
+        for (auto& tok: program)
+        {
+            switch(tok.type)
+            {
+                case Num:
+                    stack.push_back(_Value { out.size(), true, false });
+                    out.push_back(tok);
+                    break;
+
+                case Var:
+                    stack.push_back(_Value { out.size(), false, false });
+                    out.push_back(tok);
+                    break;
+
+                case Func:
+                {
+                    if (stack.size() < tok.operand)
+                    {
+                        throw std::invalid_argument("function is missing an argument");
+                    }
+
+                    size_t first = stack.size() - tok.operand;
+                    size_t start = tok.operand == 0 ? out.size() : stack[first].start;
+                    bool known = tok.function->intrinsic != IntrNone;
+                    for (size_t i = first; i < stack.size(); i++)
+                    {
+                        known = known && stack[i].constant;
+                    }
+                    stack.resize(first);
+
+                    // Built-in functions have no side effects, so calls with constant arguments are evaluated now
+                    if (known)
+                    {
+                        double args[2];
+                        for (size_t i = 0; i < tok.operand; i++)
+                        {
+                            args[i] = out[start + i].value;
+                        }
+                        out.resize(start);
+                        out.push_back(num_token(tok.function->func(args)));
+                        stack.push_back(_Value { start, true, false });
+                    }
+                    else
+                    {
+                        out.push_back(tok);
+                        stack.push_back(_Value { start, false, false });
+                    }
+                    break;
+                }
+
+                case Plus:
+                case Minus:
+                case Mul:
+                case Div:
+                case Exp:
+                {
+                    if (stack.size() < 2)
+                    {
+                        throw std::invalid_argument("operator is missing an operand");
+                    }
+
+                    _Value lhs = stack[stack.size() - 2];
+                    _Value rhs = stack[stack.size() - 1];
+                    stack.resize(stack.size() - 2);
+
+                    size_t l = lhs.start, r = rhs.start;
+                    double lv = lhs.constant ? out[l].value : 0.0;
+                    double rv = rhs.constant ? out[r].value : 0.0;
+                    TokenType type = tok.type;
+
+                    // Both operands known
+                    if (lhs.constant && rhs.constant)
+                    {
+                        out.resize(l);
+                        out.push_back(num_token(fold(type, lv, rv)));
+                        stack.push_back(_Value { l, true, false });
+                        break;
+                    }
+
+                    // Right identities: x + 0, x - 0, x * 1, x / 1, x ^ 1
+                    if (rhs.constant && ((rv == 0.0 && (type == Plus || type == Minus)) || (rv == 1.0 && type != Plus && type != Minus)))
+                    {
+                        out.resize(r);
+                        stack.push_back(lhs);
+                        break;
+                    }
+
+                    // Left identities: 0 + x, 1 * x
+                    if (lhs.constant && ((lv == 0.0 && type == Plus) || (lv == 1.0 && type == Mul)))
+                    {
+                        out.erase(out.begin() + l);
+                        stack.push_back(_Value { l, rhs.constant, rhs.negated });
+                        break;
+                    }
+
+                    // x ^ 0 is one for every x, NaN included
+                    if (rhs.constant && rv == 0.0 && type == Exp)
+                    {
+                        out.resize(l);
+                        out.push_back(num_token(1.0));
+                        stack.push_back(_Value { l, true, false });
+                        break;
+                    }
+
+                    // Division by a power of two is exactly multiplication by its reciprocal
+                    if (rhs.constant && type == Div && has_exact_reciprocal(rv))
+                    {
+                        rv = 1.0 / rv;
+                        out[r].value = rv;
+                        type = Mul;
+                    }
+
+                    // Negation: -(-y) = y, x + (-y) = x - y, x - (-y) = x + y, c * (-y) = (-c) * y
+                    if (type == Mul && ((lhs.negated && rhs.constant) || (rhs.negated && lhs.constant)))
+                    {
+                        if (lhs.constant)
+                        {
+                            std::swap(lhs, rhs);
+                            std::rotate(out.begin() + l, out.begin() + l + 1, out.end());
+                            r = out.size() - 1;
+                            lhs.start = l;
+                            rhs.start = r;
+                        }
+
+                        // lhs is `y, -1, *` and rhs is the constant
+                        double c = -out[r].value;
+                        out.erase(out.begin() + r - 2, out.begin() + r);
+                        out.back().value = c;
+                        if (c == -1.0)
+                        {
+                            // Still a negation, now of `y` alone
+                            out.push_back(op_token(Mul));
+                            stack.push_back(_Value { l, false, true });
+                        }
+                        else if (c == 1.0)
+                        {
+                            out.pop_back();
+                            stack.push_back(_Value { l, false, false });
+                        }
+                        else
+                        {
+                            out.push_back(op_token(Mul));
+                            stack.push_back(_Value { l, false, false });
+                        }
+                        break;
+                    }
+
+                    if ((type == Div && rhs.constant && lhs.negated) || (type == Div && lhs.constant && rhs.negated))
+                    {
+                        // (-y) / c = y / (-c) and c / (-y) = (-c) / y
+                        if (rhs.constant)
+                        {
+                            out[r].value = -rv;
+                            out.erase(out.begin() + r - 2, out.begin() + r);
+                        }
+                        else
+                        {
+                            out[l].value = -lv;
+                            out.resize(out.size() - 2);
+                        }
+                        out.push_back(op_token(Div));
+                        stack.push_back(_Value { l, false, false });
+                        break;
+                    }
+
+                    if ((type == Plus || type == Minus) && rhs.negated)
+                    {
+                        out.resize(out.size() - 2);
+                        out.push_back(op_token(type == Plus ? Minus : Plus));
+                        stack.push_back(_Value { l, false, false });
+                        break;
+                    }
+
+                    if (type == Plus && lhs.negated)
+                    {
+                        // (-y) + x = x - y
+                        std::rotate(out.begin() + l, out.begin() + r, out.end());
+                        out.resize(out.size() - 2);
+                        out.push_back(op_token(Minus));
+                        stack.push_back(_Value { l, false, false });
+                        break;
+                    }
+
+                    // Canonical operand order. Exact, since a single addition or multiplication commutes.
+                    if ((type == Plus || type == Mul) && out_of_order(out, l, r, out.size()))
+                    {
+                        std::rotate(out.begin() + l, out.begin() + r, out.end());
+                        std::swap(lhs, rhs);
+                        rhs.start = out.size() - (r - l);
+                    }
+
+                    SlotToken op = op_token(type);
+                    bool negation = type == Mul && out[out.size() - 1].type == Num && out[out.size() - 1].value == -1.0
+                        && rhs.constant;
+                    out.push_back(op);
+                    stack.push_back(_Value { l, false, negation });
+                    break;
+                }
+
+                default:
+                    throw std::invalid_argument("illegal token in compiled expression");
+            }
+        }
+
+        size_t removed = program.size() - out.size();
+        program = std::move(out);
+        return removed;
+    }
+}
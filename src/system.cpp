@@ -0,0 +1,530 @@
+#include "system.hpp"
+
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+
+using std::move;
+using std::vector;
+
+namespace nexsys
+{
+    /// @brief A node in the merged expression DAG. Nodes only refer to nodes created before
+    /// them, so their indices are already in evaluation order.
+    struct _DagNode
+    {
+        TokenType type;
+        double value;
+        size_t slot;
+        FunctionDataPtr function;
+        vector<size_t> args;
+    };
+
+    /// @brief Helper type to hash the structure of a `_DagNode`
+    struct _DagNodeHash
+    {
+        size_t operator()(const _DagNode& node) const
+        {
+            uint64_t bits;
+            memcpy(&bits, &node.value, sizeof(bits));
+
+            size_t h = std::hash<int>()(node.type);
+            auto mix = [&h](size_t v) { h ^= v + 0x9E3779B97F4A7C15ULL + (h << 6) + (h >> 2); };
+            mix(bits);
+            mix(node.slot);
+            mix((size_t)node.function);
+            for (size_t arg: node.args)
+            {
+                mix(arg);
+            }
+            return h;
+        }
+    };
+
+    /// @brief Helper type to compare the structure of two `_DagNode`s
+    struct _DagNodeEqual
+    {
+        bool operator()(const _DagNode& lhs, const _DagNode& rhs) const
+        {
+            // Constants are compared bitwise so that `0` and `-0` stay distinct
+            return lhs.type == rhs.type
+                && memcmp(&lhs.value, &rhs.value, sizeof(double)) == 0
+                && lhs.slot == rhs.slot
+                && lhs.function == rhs.function
+                && lhs.args == rhs.args;
+        }
+    };
+
+    /// @brief Helper type for merging expression trees into a single DAG
+    struct _DagBuilder
+    {
+        vector<_DagNode> nodes;
+        vector<size_t> uses;
+        std::unordered_map<_DagNode, size_t, _DagNodeHash, _DagNodeEqual> existing;
+
+        size_t insert(const ExprPtr& tree)
+        {
+            _DagNode node;
+            node.type = tree->type;
+            node.value = tree->type == Num ? tree->value : 0.0;
+            node.slot = tree->type == Var ? tree->slot : 0;
+            node.function = tree->type == Func ? tree->function : nullptr;
+            for (auto& arg: tree->args)
+            {
+                node.args.push_back(insert(arg));
+            }
+
+            // Addition and multiplication commute exactly, so `a + b` and `b + a` can be merged
+            if ((node.type == Plus || node.type == Mul) && node.args[0] > node.args[1])
+            {
+                std::swap(node.args[0], node.args[1]);
+            }
+
+            auto found = existing.find(node);
+            if (found != existing.end())
+            {
+                uses[found->second]++;
+                return found->second;
+            }
+
+            size_t id = nodes.size();
+            existing.emplace(node, id);
+            nodes.push_back(move(node));
+            uses.push_back(1);
+            return id;
+        }
+    };
+
+    /// @brief Helper function to build an `Instruction`
+    static Instruction make_instruction(OpCode op, uint32_t dst, uint32_t a, uint32_t b, double imm)
+    {
+        Instruction ins;
+        ins.op = op;
+        ins.dst = dst;
+        ins.a = a;
+        ins.b = b;
+        ins.imm = imm;
+        return ins;
+    }
+
+    /// @brief Helper type to lower a DAG to bytecode, reusing registers once their value is no longer needed
+    struct _DagLowering
+    {
+        const vector<_DagNode>& nodes;
+        vector<uint32_t> regs;
+        vector<size_t> last_use;
+        vector<bool> pinned;
+        vector<uint32_t> free_regs;
+        vector<Instruction> code;
+        uint32_t frame_size = 0;
+
+        _DagLowering(const vector<_DagNode>& nodes): nodes(nodes), regs(nodes.size(), UINT32_MAX), last_use(nodes.size(), 0), pinned(nodes.size(), false)
+        {
+            for (size_t id = 0; id < nodes.size(); id++)
+            {
+                for (size_t arg: nodes[id].args)
+                {
+                    last_use[arg] = id;
+                }
+            }
+        }
+
+        bool is_leaf(size_t id) const
+        {
+            return nodes[id].type == Num || nodes[id].type == Var;
+        }
+
+        uint32_t allocate()
+        {
+            if (!free_regs.empty())
+            {
+                uint32_t reg = free_regs.back();
+                free_regs.pop_back();
+                return reg;
+            }
+            return frame_size++;
+        }
+
+        /// @brief Loads a leaf into a register
+        void load(size_t id, uint32_t reg)
+        {
+            if (nodes[id].type == Num)
+            {
+                code.push_back(make_instruction(OpNum, reg, 0, 0, nodes[id].value));
+            }
+            else
+            {
+                code.push_back(make_instruction(OpVar, reg, (uint32_t)nodes[id].slot, 0, 0.0));
+            }
+        }
+
+        /// @brief Frees the registers of a node's operands that are not read again
+        void release_args(size_t id)
+        {
+            for (size_t arg: nodes[id].args)
+            {
+                if (!is_leaf(arg) && last_use[arg] == id && !pinned[arg] && regs[arg] != UINT32_MAX)
+                {
+                    free_regs.push_back(regs[arg]);
+                    regs[arg] = UINT32_MAX;
+                }
+            }
+        }
+
+        void lower_binary(size_t id)
+        {
+            const _DagNode& node = nodes[id];
+            size_t lhs = node.args[0], rhs = node.args[1];
+
+            OpCode reg_op, num_op, var_op;
+            switch(node.type)
+            {
+                case Plus:  reg_op = OpAdd; num_op = OpAddNum; var_op = OpAddVar; break;
+                case Minus: reg_op = OpSub; num_op = OpSubNum; var_op = OpSubVar; break;
+                case Mul:   reg_op = OpMul; num_op = OpMulNum; var_op = OpMulVar; break;
+                case Div:   reg_op = OpDiv; num_op = OpDivNum; var_op = OpDivVar; break;
+                default:    reg_op = OpPow; num_op = OpPowNum; var_op = OpPow;    break;
+            }
+
+            bool commutes = node.type == Plus || node.type == Mul;
+            bool reverses = node.type == Minus || node.type == Div;
+
+            if (is_leaf(lhs) && !is_leaf(rhs) && (commutes || reverses))
+            {
+                uint32_t a = regs[rhs];
+                release_args(id);
+                uint32_t dst = allocate();
+                if (nodes[lhs].type == Num)
+                {
+                    OpCode op = commutes ? num_op : (node.type == Minus ? OpNumSub : OpNumDiv);
+                    code.push_back(make_instruction(op, dst, a, 0, nodes[lhs].value));
+                }
+                else
+                {
+                    OpCode op = commutes ? var_op : (node.type == Minus ? OpVarSub : OpVarDiv);
+                    code.push_back(make_instruction(op, dst, a, (uint32_t)nodes[lhs].slot, 0.0));
+                }
+                regs[id] = dst;
+                return;
+            }
+
+            if (!is_leaf(lhs))
+            {
+                uint32_t a = regs[lhs];
+                if (!is_leaf(rhs))
+                {
+                    uint32_t b = regs[rhs];
+                    release_args(id);
+                    regs[id] = allocate();
+                    code.push_back(make_instruction(reg_op, regs[id], a, b, 0.0));
+                    return;
+                }
+                if (nodes[rhs].type == Num || node.type != Exp)
+                {
+                    release_args(id);
+                    regs[id] = allocate();
+                    if (node.type == Exp && is_powi_exponent(nodes[rhs].value))
+                    {
+                        code.push_back(make_instruction(OpPowI, regs[id], a, (uint32_t)(int32_t)nodes[rhs].value, 0.0));
+                    }
+                    else if (nodes[rhs].type == Num)
+                    {
+                        code.push_back(make_instruction(num_op, regs[id], a, 0, nodes[rhs].value));
+                    }
+                    else
+                    {
+                        code.push_back(make_instruction(var_op, regs[id], a, (uint32_t)nodes[rhs].slot, 0.0));
+                    }
+                    return;
+                }
+            }
+
+            // Every other case loads a leaf into a register first, so nothing may be released until
+            // the operation has been emitted or the load could overwrite an operand
+            uint32_t dst = allocate();
+            uint32_t a = dst;
+            if (is_leaf(lhs))
+            {
+                load(lhs, dst);
+            }
+            else
+            {
+                a = regs[lhs];
+            }
+
+            if (is_leaf(rhs) && nodes[rhs].type == Num && node.type == Exp && is_powi_exponent(nodes[rhs].value))
+            {
+                code.push_back(make_instruction(OpPowI, dst, a, (uint32_t)(int32_t)nodes[rhs].value, 0.0));
+            }
+            else if (is_leaf(rhs) && nodes[rhs].type == Num)
+            {
+                code.push_back(make_instruction(num_op, dst, a, 0, nodes[rhs].value));
+            }
+            else if (is_leaf(rhs) && node.type != Exp)
+            {
+                code.push_back(make_instruction(var_op, dst, a, (uint32_t)nodes[rhs].slot, 0.0));
+            }
+            else if (is_leaf(rhs))
+            {
+                uint32_t b = allocate();
+                load(rhs, b);
+                code.push_back(make_instruction(reg_op, dst, a, b, 0.0));
+                free_regs.push_back(b);
+            }
+            else
+            {
+                code.push_back(make_instruction(reg_op, dst, a, regs[rhs], 0.0));
+            }
+
+            release_args(id);
+            regs[id] = dst;
+        }
+
+        /// @brief Lowers a built-in function, which reads its arguments from any registers
+        void lower_intrinsic(size_t id)
+        {
+            const _DagNode& node = nodes[id];
+            OpCode op = intrinsic_opcode(node.function->intrinsic);
+            uint32_t operands[2] = {0, 0};
+
+            bool any_leaf = false;
+            for (size_t k = 0; k < node.args.size(); k++)
+            {
+                any_leaf = any_leaf || is_leaf(node.args[k]);
+                operands[k] = regs[node.args[k]];
+            }
+
+            if (!any_leaf)
+            {
+                release_args(id);
+                regs[id] = allocate();
+                code.push_back(make_instruction(op, regs[id], operands[0], operands[1], 0.0));
+                return;
+            }
+
+            // Leaves are loaded into the destination and a temporary, so nothing may be released
+            // until the operation has been emitted
+            uint32_t dst = allocate();
+            uint32_t temp = UINT32_MAX;
+            for (size_t k = 0; k < node.args.size(); k++)
+            {
+                if (is_leaf(node.args[k]))
+                {
+                    operands[k] = k == 0 ? dst : (temp = allocate());
+                    load(node.args[k], operands[k]);
+                }
+            }
+
+            code.push_back(make_instruction(op, dst, operands[0], operands[1], 0.0));
+            if (temp != UINT32_MAX)
+            {
+                free_regs.push_back(temp);
+            }
+            release_args(id);
+            regs[id] = dst;
+        }
+
+        void lower_call(size_t id)
+        {
+            const _DagNode& node = nodes[id];
+            uint32_t argc = (uint32_t)node.args.size();
+
+            // Arguments must be contiguous, so they are copied into a fresh block of registers
+            uint32_t block = frame_size;
+            frame_size += argc;
+            for (uint32_t k = 0; k < argc; k++)
+            {
+                size_t arg = node.args[k];
+                if (is_leaf(arg))
+                {
+                    load(arg, block + k);
+                }
+                else
+                {
+                    code.push_back(make_instruction(OpMulNum, block + k, regs[arg], 0, 1.0));
+                }
+            }
+
+            release_args(id);
+            uint32_t dst = allocate();
+            code.push_back(make_instruction(OpCall, dst, block, argc, 0.0));
+            code.back().function = node.function;
+            for (uint32_t k = 0; k < argc; k++)
+            {
+                free_regs.push_back(block + k);
+            }
+            regs[id] = dst;
+        }
+    };
+
+    CompiledSystem::CompiledSystem(): shared_count(0)
+    {
+        code = Bytecode({make_instruction(OpNum, 0, 0, 0, 0.0), make_instruction(OpReturn, 0, 0, 0, 0.0)}, 1);
+    }
+
+    CompiledSystem::CompiledSystem(const vector<CompiledExpression>& system): shared_count(0)
+    {
+        _DagBuilder dag;
+        vector<size_t> roots;
+        for (auto& expr: system)
+        {
+            roots.push_back(dag.insert(to_tree(expr.get_program())));
+        }
+
+        for (size_t id = 0; id < dag.nodes.size(); id++)
+        {
+            if (dag.uses[id] > 1 && dag.nodes[id].type != Num && dag.nodes[id].type != Var)
+            {
+                shared_count++;
+            }
+        }
+
+        _DagLowering lowering(dag.nodes);
+        for (size_t root: roots)
+        {
+            lowering.pinned[root] = true;
+        }
+
+        for (size_t id = 0; id < dag.nodes.size(); id++)
+        {
+            switch(dag.nodes[id].type)
+            {
+                case Num:
+                case Var:
+                    break;
+
+                case Func:
+                    if (dag.nodes[id].function->intrinsic != IntrNone)
+                    {
+                        lowering.lower_intrinsic(id);
+                    }
+                    else
+                    {
+                        lowering.lower_call(id);
+                    }
+                    break;
+
+                default:
+                    lowering.lower_binary(id);
+                    break;
+            }
+        }
+
+        for (size_t root: roots)
+        {
+            // Expressions that are a single constant or variable still need a register to be written from
+            if (lowering.is_leaf(root) && lowering.regs[root] == UINT32_MAX)
+            {
+                lowering.regs[root] = lowering.allocate();
+                lowering.load(root, lowering.regs[root]);
+            }
+            outputs.push_back(lowering.regs[root]);
+        }
+
+        uint32_t last = outputs.empty() ? 0 : outputs[0];
+        if (lowering.frame_size == 0)
+        {
+            lowering.frame_size = 1;
+            lowering.code.push_back(make_instruction(OpNum, 0, 0, 0, 0.0));
+        }
+        lowering.code.push_back(make_instruction(OpReturn, 0, last, 0, 0.0));
+        code = Bytecode(move(lowering.code), lowering.frame_size);
+    }
+
+    /// @brief Frames at most this large are placed on the stack when evaluating a `CompiledSystem`
+    constexpr size_t SMALL_FRAME_SIZE = 64;
+
+    void CompiledSystem::evaluate(const double* x, double* frame, double* out) const
+    {
+        if (jit)
+        {
+            jit->run(x, frame);
+        }
+        else
+        {
+            code.run(x, frame);
+        }
+
+        for (size_t i = 0; i < outputs.size(); i++)
+        {
+            out[i] = frame[outputs[i]];
+        }
+    }
+
+    void CompiledSystem::evaluate(const double* x, double* out) const
+    {
+        if (code.get_frame_size() <= SMALL_FRAME_SIZE)
+        {
+            double frame[SMALL_FRAME_SIZE];
+            evaluate(x, frame, out);
+            return;
+        }
+
+        thread_local vector<double> frame;
+        if (frame.size() < code.get_frame_size())
+        {
+            frame.resize(code.get_frame_size());
+        }
+        evaluate(x, frame.data(), out);
+    }
+
+    void CompiledSystem::evaluate(const vector<double>& x, vector<double>& out) const
+    {
+        out.resize(outputs.size());
+        evaluate(x.data(), out.data());
+    }
+
+    bool CompiledSystem::try_set_backend(Backend backend)
+    {
+        if (backend == Interpreter)
+        {
+            jit.reset();
+            return true;
+        }
+
+        if (jit)
+        {
+            return true;
+        }
+
+        if (!JitCode::is_supported())
+        {
+            return false;
+        }
+
+        try
+        {
+            jit = std::make_shared<JitCode>(code);
+        }
+        catch (const std::runtime_error&)
+        {
+            return false;
+        }
+        return true;
+    }
+
+    Backend CompiledSystem::get_backend() const
+    {
+        return jit ? Jit : Interpreter;
+    }
+
+    const Bytecode& CompiledSystem::get_bytecode() const
+    {
+        return code;
+    }
+
+    size_t CompiledSystem::get_frame_size() const
+    {
+        return code.get_frame_size();
+    }
+
+    size_t CompiledSystem::get_shared_count() const
+    {
+        return shared_count;
+    }
+
+    size_t CompiledSystem::size() const
+    {
+        return outputs.size();
+    }
+}
@@ -0,0 +1,133 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+
+using std::lock_guard;
+using std::mutex;
+using std::unique_lock;
+
+namespace nexsys
+{
+    ThreadPool::ThreadPool(size_t threads): body(nullptr), count(0), chunk(1), next(0), running(0), generation(0), stopping(false)
+    {
+        if (threads == 0)
+        {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        // The calling thread is worker 0
+        for (size_t worker = 1; worker < threads; worker++)
+        {
+            workers.emplace_back(&ThreadPool::work, this, worker);
+        }
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
+        }
+        wake.notify_all();
+
+        for (auto& worker: workers)
+        {
+            worker.join();
+        }
+    }
+
+    ThreadPool& ThreadPool::shared()
+    {
+        static ThreadPool pool;
+        return pool;
+    }
+
+    size_t ThreadPool::size() const
+    {
+        return workers.size() + 1;
+    }
+
+    void ThreadPool::work(size_t worker)
+    {
+        uint64_t seen = 0;
+        while (true)
+        {
+            {
+                unique_lock<mutex> guard(lock);
+                wake.wait(guard, [&]() { return stopping || generation != seen; });
+                if (stopping)
+                {
+                    return;
+                }
+                seen = generation;
+            }
+
+            run_chunks(worker);
+
+            lock_guard<mutex> guard(lock);
+            if (--running == 0)
+            {
+                done.notify_one();
+            }
+        }
+    }
+
+    void ThreadPool::run_chunks(size_t worker)
+    {
+        try
+        {
+            for (size_t begin = next.fetch_add(chunk); begin < count; begin = next.fetch_add(chunk))
+            {
+                (*body)(begin, std::min(begin + chunk, count), worker);
+            }
+        }
+        catch (...)
+        {
+            lock_guard<mutex> guard(lock);
+            if (!error)
+            {
+                error = std::current_exception();
+            }
+            next.store(count);
+        }
+    }
+
+    void ThreadPool::parallel_for(size_t count, size_t chunk, const LoopBody& body)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+
+        // Loops run inline still take their turn, since they run as worker 0 like the caller of any other loop
+        lock_guard<mutex> turn(submit);
+        chunk = std::max<size_t>(chunk, 1);
+        if (workers.empty() || count <= chunk)
+        {
+            body(0, count, 0);
+            return;
+        }
+
+        {
+            lock_guard<mutex> guard(lock);
+            this->body = &body;
+            this->count = count;
+            this->chunk = chunk;
+            this->next.store(0);
+            this->running = workers.size();
+            this->error = nullptr;
+            this->generation++;
+        }
+        wake.notify_all();
+
+        run_chunks(0);
+
+        unique_lock<mutex> guard(lock);
+        done.wait(guard, [&]() { return running == 0; });
+        this->body = nullptr;
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+}
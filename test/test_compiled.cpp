@@ -0,0 +1,708 @@
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <tuple>
+
+#include "harness.hpp"
+#include "cache.hpp"
+
+using nexsys::BatchIsa;
+using nexsys::compile_all;
+using nexsys::compile_to_expression;
+using nexsys::CompileCache;
+using nexsys::CompiledExpression;
+using nexsys::compile_to_function_of_umap;
+using nexsys::ContextMap;
+using nexsys::Lexer;
+using nexsys::ThreadPool;
+using nexsys::VariableIndex;
+
+INIT_HARNESS
+
+static double add_2(double args[])
+{
+    return args[0] + args[1];
+}
+
+static double sub_2(double args[])
+{
+    return args[0] - args[1];
+}
+
+TEST(variable_index_assigns_dense_slots_in_order)
+{
+    VariableIndex index({"x", "y"});
+
+    ASSERT_EQ(index.insert("z"), 2)
+    ASSERT_EQ(index.insert("x"), 0)
+    ASSERT_EQ(index.size(), 3)
+    ASSERT_EQ(index.get_name(1), "y")
+}
+
+TEST(lexer_splits_expressions_without_copying)
+{
+    std::string expr = " 2.5e-3*foo_1-(x ,1E+2)^.5 ";
+    Lexer lexer(expr);
+    std::vector<nexsys::LexemeType> types;
+    std::vector<std::string> texts;
+
+    for (auto lex = lexer.next(); lex.type != nexsys::LexEnd; lex = lexer.next())
+    {
+        ASSERT(lex.text.data() >= expr.data() && lex.text.data() < expr.data() + expr.size())
+        types.push_back(lex.type);
+        texts.push_back(std::string(lex.text));
+    }
+
+    std::vector<std::string> expected = {"2.5e-3", "*", "foo_1", "-", "(", "x", ",", "1E+2", ")", "^", ".5"};
+    ASSERT(texts == expected)
+    ASSERT_EQ(types[0], nexsys::LexNum)
+    ASSERT_EQ(types[2], nexsys::LexSymbol)
+    ASSERT_EQ(types[7], nexsys::LexNum)
+    ASSERT_EQ(Lexer("1e5").next().value, 1e5)
+    ASSERT_EQ(Lexer("2x").next().type, nexsys::LexSymbol)
+}
+
+TEST(compiled_expression_respects_precedence)
+{
+    ContextMap ctx;
+    VariableIndex index;
+
+    auto expr = compile_to_expression("2 + 3 * 4 ^ 2 / 8 - 1", ctx, index);
+
+    ASSERT_EQ(expr.evaluate(nullptr), 7.0)
+}
+
+TEST(compiled_expression_handles_unary_minus_and_parentheses)
+{
+    ContextMap ctx;
+    VariableIndex index;
+
+    auto expr = compile_to_expression("-(2 - 5) * -2 - -1", ctx, index);
+
+    ASSERT_EQ(expr.evaluate(nullptr), -5.0)
+}
+
+TEST(compiled_expression_reads_variables_from_slots)
+{
+    ContextMap ctx;
+    ctx.add_var_to_ctx("x");
+    ctx.add_var_to_ctx("y");
+    ctx.add_num_to_ctx("c", 10.0);
+    VariableIndex index({"y", "x"});
+
+    auto expr = compile_to_expression("x - y * c", ctx, index);
+    double x[] = {2.0, 30.0};
+
+    ASSERT_EQ(expr.evaluate(x), 10.0)
+}
+
+TEST(compiled_expression_is_the_same_from_a_context_view)
+{
+    ContextMap ctx;
+    ctx.add_var_to_ctx("x");
+    ctx.add_var_to_ctx("y");
+    ctx.add_num_to_ctx("c", 10.0);
+    ctx.add_func_to_ctx("add", 2, add_2);
+    nexsys::ContextView view(ctx);
+    VariableIndex from_map, from_view;
+
+    auto a = compile_to_expression("add(y, c) / x - -y", ctx, from_map);
+    auto b = compile_to_expression("add(y, c) / x - -y", view, from_view);
+    double x[] = {2.0, 4.0}; // y is read first, so it takes slot 0
+
+    ASSERT_EQ(from_map.get_name(0), from_view.get_name(0))
+    ASSERT_EQ(a.evaluate(x), 5.0)
+    ASSERT_EQ(b.evaluate(x), 5.0)
+}
+
+TEST(compiled_expression_passes_function_args_in_order)
+{
+    ContextMap ctx;
+    ctx.add_var_to_ctx("x");
+    ctx.add_func_to_ctx("add", 2, add_2);
+    ctx.add_func_to_ctx("sub", 2, sub_2);
+    VariableIndex index;
+
+    auto expr = compile_to_expression("sub(add(x, 1), -x) * 2", ctx, index);
+    double x[] = {3.0};
+
+    ASSERT_EQ(expr.evaluate(x), 14.0)
+}
+
+TEST(function_of_umap_evaluates_with_the_context_variables)
+{
+    ContextMap ctx;
+    ctx.add_var_to_ctx("x");
+    ctx.add_var_to_ctx("y");
+    ctx.add_num_to_ctx("c", 10.0);
+    ctx.add_func_to_ctx("sub", 2, sub_2);
+
+    auto f = compile_to_function_of_umap("sub(x, y) * c", ctx);
+    ASSERT_EQ(f({{"x", 5.0}, {"y", 2.0}}), 30.0)
+
+    // A variable left out keeps the value it was last given, and unused names are ignored
+    ASSERT_EQ(f({{"x", 4.0}, {"z", 100.0}}), 20.0)
+}
+
+TEST(bytecode_fuses_operands_into_instructions)
+{
+    ContextMap ctx;
+    ctx.add_var_to_ctx("x");
+    ctx.add_var_to_ctx("y");
+    VariableIndex index({"x", "y"});
+
+    auto expr = compile_to_expression("2 - x * 3 + y / (1 - x) - 4 / y + x ^ y", ctx, index);
+    double x[] = {3.0, 2.0};
+
+    ASSERT_EQ(expr.evaluate(x), 2.0 - 9.0 - 1.0 - 2.0 + 9.0)
+    ASSERT(expr.get_bytecode().get_code().size() < expr.get_program().size())
+}
+
+TEST(batch_evaluation_matches_scalar_evaluation)
+{
+    ContextMap ctx;
+    ctx.add_var_to_ctx("x");
+    ctx.add_var_to_ctx("y");
+    ctx.add_func_to_ctx("add", 2, add_2);
+    VariableIndex index({"x", "y"});
+
+    auto expr = compile_to_expression("x ^ 3 - add(x, y) / (y ^ 0.5) + 2 / x - y * 4", ctx, index);
+
+    size_t count = 1000; // deliberately not a multiple of the block size
+    std::vector<double> xs(count), ys(count), out(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        xs[i] = 0.5 + i * 0.01;
+        ys[i] = 1.0 + i * 0.02;
+    }
+    const double* columns[] = {xs.data(), ys.data()};
+
+    for (BatchIsa isa: {nexsys::Scalar, nexsys::Avx2, nexsys::Avx512})
+    {
+        nexsys::evaluate_batch(expr.get_bytecode(), columns, count, out.data(), isa);
+        for (size_t i = 0; i < count; i++)
+        {
+            double x[] = {xs[i], ys[i]};
+            ASSERT(fabs(out[i] - expr.evaluate(x)) <= 1e-12 * fabs(out[i]))
+        }
+    }
+}
+
+TEST(jit_backend_matches_interpreter)
+{
+    ContextMap ctx;
+    ctx.add_var_to_ctx("x");
+    ctx.add_var_to_ctx("y");
+    ctx.add_func_to_ctx("add", 2, add_2);
+    ctx.add_func_to_ctx("sub", 2, sub_2);
+    VariableIndex index({"x", "y"});
+
+    auto interpreted = compile_to_expression("2 - x * 3 + y / (1 - x) - 4 / y + x ^ y - sub(add(x, 2), y ^ 2) * (x - y) / 7", ctx, index);
+    auto native = interpreted;
+
+    if (!nexsys::JitCode::is_supported())
+    {
+        ASSERT(!native.try_set_backend(nexsys::Jit))
+        return;
+    }
+
+    ASSERT(native.try_set_backend(nexsys::Jit))
+    ASSERT_EQ(native.get_backend(), nexsys::Jit)
+    ASSERT_EQ(interpreted.get_backend(), nexsys::Interpreter)
+
+    for (double x = 0.1; x < 4.0; x += 0.37)
+    {
+        double slots[] = {x, 1.5 - x};
+        ASSERT_EQ(native.evaluate(slots), interpreted.evaluate(slots))
+    }
+}
+
+static double user_sin(double args[])
+{
+    return args[0] + 1.0;
+}
+
+/// @brief Checks if a program calls any function through a pointer
+static bool has_calls(const CompiledExpression& expr)
+{
+    for (auto& ins: expr.get_bytecode().get_code())
+    {
+        if (ins.op == nexsys::OpCall)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+TEST(intrinsics_run_inline_unless_overridden)
+{
+    ContextMap ctx;
+    ctx.add_var_to_ctx("x");
+    ctx.add_var_to_ctx("y");
+    VariableIndex index({"x", "y"});
+
+    auto expr = compile_to_expression("sin(x) + cos(y) * exp(x / 4) - log(y) + sqrt(x) * abs(-y) + min(x, y) - max(x, 2) + hypot(x, y) + x ^ 3", ctx, index);
+    double x[] = {0.7, 2.5};
+    double expected = sin(0.7) + cos(2.5) * exp(0.7 / 4) - log(2.5) + sqrt(0.7) * 2.5 + 0.7 - 2.0 + hypot(0.7, 2.5) + 0.7 * 0.7 * 0.7;
+
+    ASSERT(!has_calls(expr))
+    ASSERT(fabs(expr.evaluate(x) - expected) < 1e-12)
+
+    // Calls with constant arguments are evaluated while compiling, and so is the `4 + 2` they leave
+    auto folded = compile_to_expression("sqrt(16) + max(1, 2)", ctx, index);
+    ASSERT_EQ(folded.get_bytecode().get_code().size(), 2)
+    ASSERT_EQ(folded.evaluate(x), 6.0)
+
+    // A symbol in the context takes precedence over a built-in function of the same name
+    ctx.add_func_to_ctx("sin", 1, user_sin);
+    auto overridden = compile_to_expression("sin(x)", ctx, index);
+    ASSERT(has_calls(overridden))
+    ASSERT_EQ(overridden.evaluate(x), 1.7)
+}
+
+TEST(intrinsics_match_across_backends)
+{
+    ContextMap ctx;
+    ctx.add_var_to_ctx("x");
+    ctx.add_var_to_ctx("y");
+    VariableIndex index({"x", "y"});
+
+    auto expr = compile_to_expression(
+        "exp(x) * log(y) + sin(x) / cosh(y) + x ^ 5 - y ^ -3 + hypot(x, y) - sqrt(abs(x - y)) "
+        "+ min(x, y) * max(tanh(x), atan(y)) + log10(x) + asin(x / 5) + acos(y / 9) - tan(x) * sinh(y / 4)",
+        ctx, index
+    );
+    ASSERT(!has_calls(expr))
+
+    size_t count = 1000;
+    std::vector<double> xs(count), ys(count), out(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        xs[i] = 0.1 + i * 0.0037;
+        ys[i] = 0.2 + i * 0.005;
+    }
+    const double* columns[] = {xs.data(), ys.data()};
+
+    // Vector `exp` and `log` are approximations, so batches may differ in the last few bits
+    for (BatchIsa isa: {nexsys::Scalar, nexsys::Avx2, nexsys::Avx512})
+    {
+        nexsys::evaluate_batch(expr.get_bytecode(), columns, count, out.data(), isa);
+        for (size_t i = 0; i < count; i++)
+        {
+            double x[] = {xs[i], ys[i]};
+            double expected = expr.evaluate(x);
+            ASSERT(fabs(out[i] - expected) <= 1e-13 * (1.0 + fabs(expected)))
+        }
+    }
+
+    if (nexsys::JitCode::is_supported())
+    {
+        auto native = expr;
+        ASSERT(native.try_set_backend(nexsys::Jit))
+        for (size_t i = 0; i < count; i += 7)
+        {
+            double x[] = {xs[i], ys[i]};
+            ASSERT_EQ(native.evaluate(x), expr.evaluate(x))
+        }
+    }
+}
+
+TEST(min_and_max_propagate_nan_on_every_backend)
+{
+    ContextMap ctx;
+    ctx.add_var_to_ctx("x");
+    ctx.add_var_to_ctx("y");
+    VariableIndex index({"x", "y"});
+
+    auto lo = compile_to_expression("min(x, y)", ctx, index);
+    auto hi = compile_to_expression("max(x, y)", ctx, index);
+    std::vector<double> xs = {NAN, 1.0, NAN, 1.0, -0.0, INFINITY, 2.0, -1.0, NAN};
+    std::vector<double> ys = {1.0, NAN, NAN, 2.0, 0.0, INFINITY, -3.0, -INFINITY, 1.0};
+    size_t count = xs.size();
+    std::vector<double> out(count);
+    const double* columns[] = {xs.data(), ys.data()};
+
+    for (auto* expr: {&lo, &hi})
+    {
+        bool is_min = expr == &lo;
+        for (size_t i = 0; i < count; i++)
+        {
+            double x[] = {xs[i], ys[i]};
+            double value = expr->evaluate(x);
+            if (std::isnan(xs[i]) || std::isnan(ys[i]))
+            {
+                ASSERT(std::isnan(value))
+            }
+            else
+            {
+                ASSERT_EQ(value, is_min ? (xs[i] < ys[i] ? xs[i] : ys[i]) : (xs[i] > ys[i] ? xs[i] : ys[i]))
+            }
+        }
+
+        // Odd counts leave a tail, so every lane width and the scalar tail are covered
+        for (BatchIsa isa: {nexsys::Scalar, nexsys::Avx2, nexsys::Avx512})
+        {
+            nexsys::evaluate_batch(expr->get_bytecode(), columns, count, out.data(), isa);
+            for (size_t i = 0; i < count; i++)
+            {
+                double x[] = {xs[i], ys[i]};
+                double expected = expr->evaluate(x);
+                ASSERT((std::isnan(out[i]) && std::isnan(expected)) || (out[i] == expected && std::signbit(out[i]) == std::signbit(expected)))
+            }
+        }
+
+        if (nexsys::JitCode::is_supported())
+        {
+            auto native = *expr;
+            ASSERT(native.try_set_backend(nexsys::Jit))
+            for (size_t i = 0; i < count; i++)
+            {
+                double x[] = {xs[i], ys[i]};
+                double expected = expr->evaluate(x);
+                double value = native.evaluate(x);
+                ASSERT((std::isnan(value) && std::isnan(expected)) || (value == expected && std::signbit(value) == std::signbit(expected)))
+            }
+        }
+    }
+}
+
+TEST(batch_exp_and_log_handle_every_input)
+{
+    ContextMap ctx;
+    ctx.add_var_to_ctx("x");
+    VariableIndex index({"x"});
+    auto exp_expr = compile_to_expression("exp(x)", ctx, index);
+    auto log_expr = compile_to_expression("log(x)", ctx, index);
+
+    std::vector<double> xs = {-800.0, -708.5, -1.0, -0.0, 0.0, 1e-310, 1e-300, 0.5, 1.0, 1.0 + 1e-12, 2.0, 700.0, 709.5, 800.0, INFINITY, -INFINITY, NAN};
+    for (double v = -30.0; v < 30.0; v += 0.173)
+    {
+        xs.push_back(v);
+        xs.push_back(exp(v));
+    }
+
+    std::vector<double> out(xs.size());
+    const double* columns[] = {xs.data()};
+    for (BatchIsa isa: {nexsys::Scalar, nexsys::Avx2, nexsys::Avx512})
+    {
+        nexsys::evaluate_batch(exp_expr.get_bytecode(), columns, xs.size(), out.data(), isa);
+        for (size_t i = 0; i < xs.size(); i++)
+        {
+            double expected = exp(xs[i]);
+            ASSERT(out[i] == expected || fabs(out[i] - expected) <= 4e-16 * expected || (std::isnan(out[i]) && std::isnan(expected)))
+        }
+
+        nexsys::evaluate_batch(log_expr.get_bytecode(), columns, xs.size(), out.data(), isa);
+        for (size_t i = 0; i < xs.size(); i++)
+        {
+            double expected = log(xs[i]);
+            ASSERT(out[i] == expected || fabs(out[i] - expected) <= 4e-16 * fabs(expected) || (std::isnan(out[i]) && std::isnan(expected)))
+        }
+    }
+}
+
+TEST(batch_trig_and_hyperbolic_handle_every_input)
+{
+    ContextMap ctx;
+    ctx.add_var_to_ctx("x");
+    ctx.add_var_to_ctx("y");
+    VariableIndex index({"x", "y"});
+
+    std::vector<std::pair<std::string, double (*)(double, double)>> cases = {
+        {"sin(x)", [](double x, double) { return sin(x); }},
+        {"cos(x)", [](double x, double) { return cos(x); }},
+        {"tan(x)", [](double x, double) { return tan(x); }},
+        {"asin(x)", [](double x, double) { return asin(x); }},
+        {"acos(x)", [](double x, double) { return acos(x); }},
+        {"atan(x)", [](double x, double) { return atan(x); }},
+        {"sinh(x)", [](double x, double) { return sinh(x); }},
+        {"cosh(x)", [](double x, double) { return cosh(x); }},
+        {"tanh(x)", [](double x, double) { return tanh(x); }},
+        {"log10(x)", [](double x, double) { return log10(x); }},
+        {"hypot(x, y)", [](double x, double y) { return hypot(x, y); }},
+    };
+
+    std::vector<double> xs = {-0.0, 0.0, 1e-310, -1e-300, 1.0, -1.0, 1.0 + 1e-15, -1.0 - 1e-15, M_PI_2, -M_PI, 3.0 * M_PI_2, 1e9, 2e9, -1e12,
+                              354.5, -708.5, 710.0, 1e300, 1e308, INFINITY, -INFINITY, NAN};
+    for (double v = -40.0; v < 40.0; v += 0.0731)
+    {
+        xs.push_back(v);
+        xs.push_back(v / 40.0);
+        xs.push_back(v * 1e4);
+    }
+    std::vector<double> ys(xs.rbegin(), xs.rend());
+
+    std::vector<double> out(xs.size());
+    const double* columns[] = {xs.data(), ys.data()};
+    for (auto& [text, f]: cases)
+    {
+        auto expr = compile_to_expression(text, ctx, index);
+        for (BatchIsa isa: {nexsys::Scalar, nexsys::Avx2, nexsys::Avx512})
+        {
+            nexsys::evaluate_batch(expr.get_bytecode(), columns, xs.size(), out.data(), isa);
+            for (size_t i = 0; i < xs.size(); i++)
+            {
+                // Within a few ulp, and signed zeros, infinities and NaN exactly as libm gives them
+                double expected = f(xs[i], ys[i]);
+                ASSERT(out[i] == expected || fabs(out[i] - expected) <= 1e-15 * fabs(expected) || (std::isnan(out[i]) && std::isnan(expected)))
+                ASSERT(std::signbit(out[i]) == std::signbit(expected) || std::isnan(expected))
+            }
+        }
+    }
+}
+
+TEST(simplifier_folds_constants_and_removes_identities)
+{
+    ContextMap ctx;
+    ctx.add_var_to_ctx("x");
+    ctx.add_var_to_ctx("y");
+    ctx.add_func_to_ctx("add", 2, add_2);
+    VariableIndex index({"x", "y"});
+
+    // { expression, instructions left, instructions removed }
+    std::vector<std::tuple<std::string, size_t, size_t>> cases = {
+        {"2 * 3 + 4 ^ 0.5 - sqrt(9)", 1, 9},         // Folds to a single constant
+        {"x * 1 + 0 - 0 + y / 1 + 1 * x ^ 1", 5, 12}, // x + y + x
+        {"-(-x)", 1, 4},                             // Double negation
+        {"x - -y", 3, 2},                            // x + y
+        {"-x + y", 3, 2},                            // y - x
+        {"-3 * -x", 3, 4},                           // x * 3
+        {"x / 4", 3, 0},                             // x * 0.25
+        {"add(2, 3) * x", 5, 0},                     // User functions are never folded
+    };
+
+    double x[] = {1.75, -0.5};
+    for (auto& [text, left, removed]: cases)
+    {
+        auto expr = compile_to_expression(text, ctx, index);
+        ASSERT_EQ(left, expr.get_program().size())
+        ASSERT_EQ(removed, expr.get_removed_count())
+    }
+
+    ASSERT_EQ(2.0 * 3.0 + 2.0 - 3.0, compile_to_expression("2 * 3 + 4 ^ 0.5 - sqrt(9)", ctx, index).evaluate(x))
+    ASSERT_EQ(1.75 * 3.0, compile_to_expression("-3 * -x", ctx, index).evaluate(x))
+    ASSERT_EQ(-0.5 - 1.75, compile_to_expression("-x + y", ctx, index).evaluate(x))
+    ASSERT_EQ(nexsys::Mul, compile_to_expression("x / 4", ctx, index).get_program().back().type)
+    ASSERT_EQ(nexsys::Div, compile_to_expression("x / 3", ctx, index).get_program().back().type)
+
+    // Equal sums and products compile to the same program whatever order they are written in
+    auto a = compile_to_expression("(x + 2) * y * sin(x)", ctx, index).get_program();
+    auto b = compile_to_expression("sin(x) * (y * (2 + x))", ctx, index).get_program();
+    auto c = compile_to_expression("y * (x + 2) * sin(x)", ctx, index).get_program();
+    ASSERT_EQ(a.size(), c.size())
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        ASSERT_EQ(a[i].type, c[i].type)
+        ASSERT_EQ(a[i].operand, c[i].operand)
+    }
+    ASSERT_EQ(a.size(), b.size())
+}
+
+TEST(compile_cache_reuses_and_evicts_entries)
+{
+    ContextMap ctx;
+    ctx.add_var_to_ctx("x");
+    ctx.add_var_to_ctx("y");
+    ctx.add_num_to_ctx("k", 3.0);
+    VariableIndex index;
+    CompileCache cache(2, 1);
+    double x[] = {2.0, 5.0};
+
+    ASSERT_EQ(cache.compile("k * x - y", ctx, index).evaluate(x), 1.0)
+    ASSERT_EQ(cache.compile("k*x   -y", ctx, index).evaluate(x), 1.0)
+    ASSERT_EQ(cache.get_hits(), 1)
+    ASSERT_EQ(cache.get_misses(), 1)
+
+    // A changed constant must not reuse the old program
+    ContextMap other;
+    other.add_var_to_ctx("x");
+    other.add_var_to_ctx("y");
+    other.add_num_to_ctx("k", 4.0);
+    ASSERT_EQ(cache.compile("k * x - y", other, index).evaluate(x), 3.0)
+    ASSERT_EQ(cache.get_misses(), 2)
+
+    ASSERT_EQ(cache.compile("x + y", ctx, index).evaluate(x), 7.0)
+    ASSERT_EQ(cache.get_evictions(), 1)
+    ASSERT_EQ(cache.size(), 2)
+}
+
+TEST(compile_cache_rebinds_variables_to_the_callers_index)
+{
+    ContextMap ctx;
+    ctx.add_var_to_ctx("x");
+    ctx.add_var_to_ctx("y");
+    CompileCache cache;
+
+    VariableIndex first;
+    auto a = cache.compile("x - y / 2", ctx, first);
+
+    VariableIndex second({"y", "x"});
+    auto b = cache.compile("x - y / 2", ctx, second);
+
+    double xy[] = {4.0, 2.0};
+    double yx[] = {2.0, 4.0};
+    ASSERT_EQ(cache.get_hits(), 1)
+    ASSERT_EQ(a.evaluate(xy), 3.0)
+    ASSERT_EQ(b.evaluate(yx), 3.0)
+}
+
+TEST(compile_cache_is_safe_to_share_between_threads)
+{
+    ContextMap ctx;
+    ctx.add_var_to_ctx("x");
+    CompileCache cache(8, 4);
+    std::vector<std::thread> threads;
+    std::vector<int> failures(4, 0);
+
+    for (size_t t = 0; t < 4; t++)
+    {
+        threads.emplace_back([&, t]()
+        {
+            for (size_t i = 0; i < 200; i++)
+            {
+                VariableIndex index;
+                double n = (double)(i % 16);
+                double x[] = {2.0};
+                auto expr = cache.compile("x * " + std::to_string(i % 16), ctx, index);
+                failures[t] += expr.evaluate(x) != 2.0 * n;
+            }
+        });
+    }
+    for (auto& thread: threads)
+    {
+        thread.join();
+    }
+
+    ASSERT_EQ(failures[0] + failures[1] + failures[2] + failures[3], 0)
+    ASSERT_EQ(cache.get_hits() + cache.get_misses(), 800)
+    ASSERT(cache.size() <= 8)
+}
+
+TEST(thread_pool_runs_every_index_once)
+{
+    ThreadPool pool(4);
+    std::vector<int> visits(1000, 0);
+    std::vector<size_t> chunks(pool.size(), 0);
+
+    pool.parallel_for(visits.size(), 7, [&](size_t begin, size_t end, size_t worker) {
+        chunks[worker]++;
+        for (size_t i = begin; i < end; i++)
+        {
+            visits[i]++;
+        }
+    });
+
+    size_t total = 0;
+    for (size_t count: chunks)
+    {
+        total += count;
+    }
+    ASSERT_EQ(4, pool.size())
+    ASSERT_EQ((size_t)(1000 + 6) / 7, total)
+    ASSERT(std::all_of(visits.begin(), visits.end(), [](int v) { return v == 1; }))
+
+    bool rethrown = false;
+    try
+    {
+        pool.parallel_for(100, 1, [](size_t begin, size_t, size_t) {
+            if (begin == 42)
+            {
+                throw std::runtime_error("index 42");
+            }
+        });
+    }
+    catch (const std::runtime_error& e)
+    {
+        rethrown = std::string(e.what()) == "index 42";
+    }
+    ASSERT(rethrown)
+}
+
+TEST(thread_pool_never_shares_a_worker_between_loops)
+{
+    ThreadPool pool(2);
+    std::vector<std::atomic<bool>> busy(pool.size());
+    std::atomic<bool> shared(false);
+
+    // Small loops run inline, and must still not overlap with each other or with a large loop's worker 0
+    auto run = [&](size_t count, size_t chunk) {
+        for (int i = 0; i < 200; i++)
+        {
+            pool.parallel_for(count, chunk, [&](size_t, size_t, size_t worker) {
+                if (busy[worker].exchange(true))
+                {
+                    shared = true;
+                }
+                std::this_thread::yield();
+                busy[worker] = false;
+            });
+        }
+    };
+
+    std::thread small([&]() { run(1, 1); });
+    std::thread other([&]() { run(1, 1); });
+    run(8, 1);
+    small.join();
+    other.join();
+
+    ASSERT(!shared)
+}
+
+TEST(compile_all_matches_serial_compilation)
+{
+    ContextMap ctx;
+    ctx.add_num_to_ctx("c", 3.0);
+    ctx.add_func_to_ctx("add", 2, add_2);
+    std::vector<std::string> exprs;
+    for (size_t i = 0; i < 500; i++)
+    {
+        std::string a = "v" + std::to_string(i), b = "v" + std::to_string((i * 7) % 500);
+        ctx.add_var_to_ctx(a);
+        exprs.push_back(a + " * c - add(" + b + ", " + std::to_string(i) + ") + sin(" + a + ")");
+    }
+    exprs[17] = "v1 + (v2";
+    exprs[300] = "v3 + nope";
+
+    ThreadPool pool(4);
+    VariableIndex parallel_index({"v5"}), serial_index({"v5"});
+    auto results = compile_all(exprs, ctx, parallel_index, pool);
+
+    ASSERT_EQ(exprs.size(), results.size())
+    std::vector<double> x(500);
+    for (size_t i = 0; i < x.size(); i++)
+    {
+        x[i] = 0.01 * (double)i;
+    }
+
+    for (size_t i = 0; i < exprs.size(); i++)
+    {
+        std::string serial_error;
+        CompiledExpression serial;
+        try
+        {
+            serial = compile_to_expression(exprs[i], ctx, serial_index);
+        }
+        catch (const std::exception& e)
+        {
+            serial_error = e.what();
+        }
+
+        // Failures are reported per expression with the same message, and do not affect the rest
+        ASSERT_EQ(serial_error, results[i].error)
+        ASSERT_EQ(serial_error.empty(), results[i].ok())
+        if (results[i].ok())
+        {
+            ASSERT_EQ(serial.evaluate(x.data()), results[i].expr.evaluate(x.data()))
+        }
+    }
+
+    ASSERT(!results[17].ok() && !results[300].ok())
+    ASSERT_EQ(serial_index.size(), parallel_index.size())
+    for (size_t slot = 0; slot < serial_index.size(); slot++)
+    {
+        ASSERT_EQ(serial_index.get_name(slot), parallel_index.get_name(slot))
+    }
+}
+
+RUN_TESTS
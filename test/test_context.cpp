@@ -2,6 +2,7 @@
 #include "context.hpp"
 
 using nexsys::ContextMap;
+using nexsys::ContextView;
 using nexsys::tokenize_with_context;
 using nexsys::Token;
 using nexsys::TokenType;
@@ -40,4 +41,25 @@ TEST(try_tokenize_creates_correct_tokens) // TODO: Something smells undefined he
     ASSERT_EQ(tok.get_type(), TokenType::Num) // also failed here when pasted up top...
 }
 
+TEST(contextview_interns_every_symbol)
+{
+    ContextMap ctx;
+    ctx.add_var_to_ctx("x");
+    ctx.add_num_to_ctx("pi", 3.14);
+    ContextView view(ctx);
+    ContextView copy = view;
+
+    // Later changes to the context are not reflected in the view
+    ctx.add_num_to_ctx("e", 2.72);
+
+    uint32_t id;
+    double value;
+    ASSERT_EQ(copy.size(), 2)
+    ASSERT(!copy.try_get_id("e", id))
+    ASSERT(copy.try_get_id(std::string("pi x").substr(0, 2), id))
+    ASSERT_EQ(copy.get_name(id), "pi")
+    ASSERT(copy.get_token(id).try_unwrap_num(value))
+    ASSERT_EQ(value, 3.14)
+}
+
 RUN_TESTS
\ No newline at end of file
@@ -0,0 +1,1180 @@
+#include "harness.hpp"
+#include "newton.hpp"
+
+using nexsys::BlockDecomposition;
+using nexsys::BlockSolver;
+using nexsys::compile_to_expression;
+using nexsys::ColoredJacobian;
+using nexsys::CompiledExpression;
+using nexsys::ContextMap;
+using nexsys::DualJacobian;
+using nexsys::Interval;
+using nexsys::LU;
+using nexsys::Matrix;
+using nexsys::newton_raphson_multivariate;
+using nexsys::NewtonSolver;
+using nexsys::SparseLU;
+using nexsys::SparseMatrix;
+using nexsys::SymbolicJacobian;
+using nexsys::ThreadPool;
+using nexsys::try_differentiate;
+using nexsys::VariableIndex;
+
+INIT_HARNESS
+
+// Counts every heap allocation made by the test program
+static size_t allocations = 0;
+
+void* operator new(size_t size)
+{
+    allocations++;
+    if (void* ptr = malloc(size))
+    {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+static double sq(double args[])
+{
+    return args[0] * args[0];
+}
+
+static double sq_prime(double args[])
+{
+    return 2.0 * args[0];
+}
+
+static double cube(double args[])
+{
+    return args[0] * args[0] * args[0];
+}
+
+TEST(differentiation_matches_analytic_derivatives)
+{
+    ContextMap ctx;
+    ctx.add_var_to_ctx("x");
+    ctx.add_var_to_ctx("y");
+    ctx.add_func_to_ctx("sq", 1, sq, {sq_prime});
+    VariableIndex index({"x", "y"});
+
+    auto expr = compile_to_expression("x^3 * y - x / y + sq(x * y) + 2^x", ctx, index);
+    CompiledExpression dx, dy;
+    double x[] = {1.5, 2.0};
+
+    ASSERT(try_differentiate(expr, 0, dx))
+    ASSERT(try_differentiate(expr, 1, dy))
+
+    // d/dx = 3x^2y - 1/y + 2xy^2 + 2^x ln(2),  d/dy = x^3 + x/y^2 + 2x^2y
+    ASSERT(fabs(dx.evaluate(x) - (13.5 - 0.5 + 12.0 + pow(2.0, 1.5) * log(2.0))) < 1e-12)
+    ASSERT(fabs(dy.evaluate(x) - (3.375 + 0.375 + 9.0)) < 1e-12)
+}
+
+TEST(differentiation_fails_without_function_derivatives)
+{
+    ContextMap ctx;
+    ctx.add_var_to_ctx("x");
+    ctx.add_var_to_ctx("y");
+    ctx.add_func_to_ctx("cube", 1, cube);
+    VariableIndex index({"x", "y"});
+
+    std::vector<CompiledExpression> system = {
+        compile_to_expression("cube(x) - y", ctx, index),
+        compile_to_expression("x * y - 2", ctx, index),
+    };
+    CompiledExpression derivative;
+
+    ASSERT(!try_differentiate(system[0], 0, derivative))
+    ASSERT(try_differentiate(system[0], 1, derivative))
+
+    SymbolicJacobian jacobian(system);
+    ASSERT_EQ(jacobian.get_entry_count(), 2)
+    ASSERT_EQ(jacobian.get_fallback_rows().size(), 1)
+    ASSERT_EQ(jacobian.get_fallback_rows()[0], 0)
+}
+
+TEST(scalar_solver_brackets_where_newton_diverges)
+{
+    nexsys::ScalarSolver solver;
+
+    // Full newton steps on atan overshoot further every iteration from this far out
+    auto flat = [](double x) { return atan(x - 1.0); };
+    auto flat_prime = [](double x) { return 1.0 / (1.0 + (x - 1.0) * (x - 1.0)); };
+    ASSERT(fabs(solver.solve(flat, 8.0, -20.0, 20.0, 1e-12, 100) - 1.0) < 1e-12)
+    ASSERT_EQ(solver.get_derivative_count(), 0)
+    ASSERT(solver.get_evaluation_count() <= 40)
+
+    ASSERT(fabs(solver.solve(flat, flat_prime, 8.0, -20.0, 20.0, 1e-12, 100) - 1.0) < 1e-12)
+    ASSERT_EQ(solver.get_derivative_count(), solver.get_iteration_count())
+    ASSERT_EQ(solver.get_evaluation_count(), solver.get_iteration_count() + 1)
+    ASSERT(solver.get_evaluation_count() <= 40)
+
+    // Newton's method cycles between 0 and 1 on this cubic
+    auto cycling = [](double x) { return x * x * x - 2.0 * x + 2.0; };
+    auto cycling_prime = [](double x) { return 3.0 * x * x - 2.0; };
+    double root = solver.solve(cycling, cycling_prime, 0.0, -3.0, 3.0, 1e-12, 100);
+    ASSERT(fabs(cycling(root)) < 1e-12)
+    ASSERT(root >= -3.0 && root <= 3.0)
+
+    // Unbounded searches step freely until the sign changes
+    ASSERT(fabs(solver.solve(cycling, 0.5, -INFINITY, INFINITY, 1e-12, 100) - root) < 1e-10)
+    ASSERT(fabs(nexsys::newton_raphson(cycling, 0.5, -INFINITY, INFINITY, 1e-12, 100) - root) < 1e-10)
+
+    bool threw = false;
+    try
+    {
+        solver.solve([](double x) { return x * x + 1.0; }, 0.5, -1.0, 1.0, 1e-12, 100);
+    }
+    catch (const std::runtime_error&)
+    {
+        threw = true;
+    }
+    ASSERT(threw)
+}
+
+TEST(batch_scalar_solver_matches_scalar_solver)
+{
+    ContextMap ctx;
+    ctx.add_var_to_ctx("E");
+    ctx.add_var_to_ctx("e");
+    ctx.add_var_to_ctx("M");
+    VariableIndex index({"E", "e", "M"});
+
+    // Kepler's equation for the eccentric anomaly E, one orbit per problem
+    CompiledExpression kepler = compile_to_expression("E - e * sin(E) - M", ctx, index);
+    size_t count = 1000;
+    std::vector<double> e(count), M(count), guess(count), min(count, 0.0), max(count, 2.0 * M_PI), roots(count);
+    for (size_t k = 0; k < count; k++)
+    {
+        e[k] = 0.99 * ((k * 37) % count) / count;
+        M[k] = 2.0 * M_PI * ((k * 101) % count) / count;
+        guess[k] = M[k];
+    }
+    const double* columns[] = {nullptr, e.data(), M.data()};
+
+    nexsys::BatchScalarSolver batch(kepler, 0);
+    ASSERT_EQ(batch.solve(columns, guess.data(), min.data(), max.data(), count, 1e-12, 100, roots.data()), 0)
+
+    nexsys::ScalarSolver scalar;
+    for (size_t k = 0; k < count; k++)
+    {
+        double point[3] = {0.0, e[k], M[k]};
+        auto func = [&](double E) { point[0] = E; return kepler.evaluate(point); };
+        ASSERT(fabs(roots[k] - scalar.solve(func, guess[k], min[k], max[k], 1e-12, 100)) < 1e-10)
+        point[0] = roots[k];
+        ASSERT(fabs(kepler.evaluate(point)) < 1e-12)
+    }
+    ASSERT(batch.get_evaluation_count() < 12 * count)
+
+    size_t before = allocations;
+    batch.solve(columns, guess.data(), min.data(), max.data(), count, 1e-12, 100, roots.data());
+    ASSERT_EQ(allocations, before)
+
+    // Problems with no root fail on their own, without holding the rest back
+    for (size_t k = 0; k < count; k++)
+    {
+        M[k] = k % 2 ? 10.0 : 1.0;
+    }
+    ASSERT_EQ(batch.solve(columns, guess.data(), min.data(), max.data(), count, 1e-12, 100, roots.data()), count / 2)
+    for (size_t k = 0; k < count; k++)
+    {
+        ASSERT(k % 2 ? std::isnan(roots[k]) : fabs(roots[k] - e[k] * sin(roots[k]) - 1.0) < 1e-12)
+    }
+}
+
+TEST(multivariate_newton_solves_compiled_system)
+{
+    ContextMap ctx;
+    ctx.add_var_to_ctx("x");
+    ctx.add_var_to_ctx("y");
+    VariableIndex index({"x", "y"});
+
+    std::vector<CompiledExpression> system = {
+        compile_to_expression("x^2 + y^2 - 25", ctx, index),
+        compile_to_expression("x - y - 1", ctx, index),
+    };
+
+    auto root = newton_raphson_multivariate(system, index, {{"x", 5.0}, {"y", 2.0}}, 1e-9, 50);
+
+    ASSERT(fabs(root["x"] - 4.0) < 1e-6)
+    ASSERT(fabs(root["y"] - 3.0) < 1e-6)
+}
+
+TEST(multivariate_newton_solves_large_linear_system)
+{
+    ContextMap ctx;
+    VariableIndex index;
+    std::vector<CompiledExpression> system;
+    size_t n = 6;
+
+    std::string sum = "0";
+    for (size_t i = 0; i < n; i++)
+    {
+        ctx.add_var_to_ctx("x" + std::to_string(i));
+        index.insert("x" + std::to_string(i));
+        sum += " + x" + std::to_string(i);
+    }
+    for (size_t i = 0; i < n; i++)
+    {
+        // x_i + (x_0 + ... + x_5) = i + 15  =>  x_i = i
+        std::string eq = "x" + std::to_string(i) + " + (" + sum + ") - " + std::to_string(i + 15);
+        system.push_back(compile_to_expression(eq, ctx, index));
+    }
+
+    auto root = newton_raphson_multivariate(system, std::vector<double>(n, 0.5), 1e-9, 50);
+
+    for (size_t i = 0; i < n; i++)
+    {
+        ASSERT(fabs(root[i] - (double)i) < 1e-6)
+    }
+}
+
+TEST(colored_jacobian_matches_dense_finite_differences)
+{
+    ContextMap ctx;
+    VariableIndex index;
+    std::vector<CompiledExpression> system;
+    size_t n = 20;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        ctx.add_var_to_ctx("x" + std::to_string(i));
+        index.insert("x" + std::to_string(i));
+    }
+    for (size_t i = 0; i < n; i++)
+    {
+        // Each expression reads itself, its neighbours and one far-off variable
+        std::string xi = "x" + std::to_string(i);
+        std::string prev = "x" + std::to_string((i + n - 1) % n);
+        std::string next = "x" + std::to_string((i + 1) % n);
+        std::string far = "x" + std::to_string((i * 7 + 5) % n);
+        system.push_back(compile_to_expression(prev + " * " + xi + " - sin(" + next + ") + " + far + " ^ 2 - " + std::to_string(i), ctx, index));
+    }
+
+    std::vector<double> x(n), f(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        x[i] = 0.3 + 0.05 * i;
+    }
+    for (size_t i = 0; i < n; i++)
+    {
+        f[i] = system[i].evaluate(x);
+    }
+
+    ColoredJacobian colored(system, n);
+    ASSERT(colored.get_color_count() < n / 2)
+    ASSERT(colored.get_nonzero_count() <= 4 * n)
+
+    // No expression reads two columns of the same color
+    for (auto& expr: system)
+    {
+        std::vector<bool> seen(colored.get_color_count(), false);
+        for (size_t j: expr.get_slots())
+        {
+            ASSERT(!seen[colored.get_colors()[j]])
+            seen[colored.get_colors()[j]] = true;
+        }
+    }
+
+    Matrix<double> dense(n, n), sparse(n, n);
+    nexsys::finite_difference_jacobian(system, x, f, dense);
+    colored.evaluate(system, x, f, sparse);
+    for (size_t i = 0; i < n; i++)
+    {
+        ASSERT_EQ(x[i], 0.3 + 0.05 * i)
+        for (size_t j = 0; j < n; j++)
+        {
+            ASSERT_EQ(sparse.get_index(i, j), dense.get_index(i, j))
+        }
+    }
+}
+
+TEST(dual_jacobian_matches_symbolic_jacobian)
+{
+    ContextMap ctx;
+    ctx.add_func_to_ctx("sq", 1, sq, {sq_prime});
+    VariableIndex index;
+    std::vector<CompiledExpression> system;
+    size_t n = 11; // Spans more than one block of dual tangents
+
+    for (size_t i = 0; i < n; i++)
+    {
+        ctx.add_var_to_ctx("x" + std::to_string(i));
+        index.insert("x" + std::to_string(i));
+    }
+    for (size_t i = 0; i < n; i++)
+    {
+        std::string xi = "x" + std::to_string(i);
+        std::string xj = "x" + std::to_string((i * 5 + 3) % n);
+        system.push_back(compile_to_expression(xi + " ^ " + xj + " + sq(" + xi + " / " + xj + ") - " + xj + " ^ 3", ctx, index));
+    }
+
+    std::vector<double> x(n), f(n), f_dual(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        x[i] = 1.0 + 0.1 * i;
+    }
+    for (size_t i = 0; i < n; i++)
+    {
+        f[i] = system[i].evaluate(x);
+    }
+
+    Matrix<double> exact(n, n), automatic(n, n);
+    SymbolicJacobian(system).evaluate(system, x, f, exact);
+    DualJacobian dual(system);
+    dual.evaluate(system, x, f_dual, automatic);
+
+    for (size_t i = 0; i < n; i++)
+    {
+        ASSERT_EQ(f_dual[i], f[i])
+        for (size_t j = 0; j < n; j++)
+        {
+            ASSERT(fabs(automatic.get_index(i, j) - exact.get_index(i, j)) < 1e-9)
+        }
+    }
+}
+
+TEST(dual_jacobian_ignores_infinite_slopes_of_constant_terms)
+{
+    ContextMap ctx;
+    ctx.add_var_to_ctx("x");
+    ctx.add_var_to_ctx("y");
+    ctx.add_var_to_ctx("p");
+    VariableIndex index({"x", "y", "p"});
+
+    // sqrt has an infinite slope at p = 0, but nothing is differentiated with respect to p
+    std::vector<CompiledExpression> system = {
+        compile_to_expression("x + y * sqrt(p) - 2", ctx, index),
+        compile_to_expression("x - y - 1", ctx, index),
+    };
+    std::vector<double> x = {0.5, 0.5, 0.0}, f(2);
+
+    Matrix<double> exact(2, 2), automatic(2, 2);
+    SymbolicJacobian(system).evaluate(system, x, f, exact);
+    DualJacobian(system).evaluate(system, x, f, automatic);
+    for (size_t i = 0; i < 2; i++)
+    {
+        for (size_t j = 0; j < 2; j++)
+        {
+            ASSERT_EQ(automatic.get_index(i, j), exact.get_index(i, j))
+        }
+    }
+
+    NewtonSolver solver(system, nexsys::Automatic);
+    auto root = solver.solve(x, 1e-9, 50);
+    ASSERT(fabs(root[0] - 2.0) < 1e-9)
+    ASSERT(fabs(root[1] - 1.0) < 1e-9)
+}
+
+TEST(intrinsics_differentiate_symbolically_and_with_dual_numbers)
+{
+    ContextMap ctx;
+    ctx.add_var_to_ctx("x");
+    ctx.add_var_to_ctx("y");
+    VariableIndex index({"x", "y"});
+
+    std::vector<CompiledExpression> system = {
+        compile_to_expression("sin(x * y) + cos(x) * tan(y) - asin(x / 4) + acos(y / 4) * atan(x)", ctx, index),
+        compile_to_expression("sinh(x) - cosh(y) * tanh(x * y) + exp(x - y) * log(y) + log10(x)", ctx, index),
+        compile_to_expression("sqrt(x + y) * hypot(x, y ^ 2) + x ^ -2 + abs(x - y) ^ 3", ctx, index),
+        compile_to_expression("min(x, y) * max(x ^ 2, y) - min(2, x)", ctx, index),
+    };
+
+    std::vector<double> x = {1.3, 0.6}, f(system.size()), f_dual(system.size());
+    for (size_t i = 0; i < system.size(); i++)
+    {
+        f[i] = system[i].evaluate(x);
+    }
+
+    // `min`, `max` and `abs` are piecewise, so they are differentiated through their partial derivative callbacks
+    SymbolicJacobian symbolic(system);
+    ASSERT_EQ(symbolic.get_fallback_rows().size(), 0)
+
+    Matrix<double> exact(system.size(), 2), automatic(system.size(), 2);
+    symbolic.evaluate(system, x, f, exact);
+    DualJacobian(system).evaluate(system, x, f_dual, automatic);
+
+    // Near (1.3, 0.6) the last row is y * x^2 - x, so its d/dx is 2xy - 1
+    ASSERT(fabs(exact.get_index(3, 0) - (2.0 * 1.3 * 0.6 - 1.0)) < 1e-12)
+    for (size_t i = 0; i < system.size(); i++)
+    {
+        ASSERT_EQ(f_dual[i], f[i])
+        for (size_t j = 0; j < 2; j++)
+        {
+            ASSERT(fabs(automatic.get_index(i, j) - exact.get_index(i, j)) < 1e-12 * (1.0 + fabs(exact.get_index(i, j))))
+        }
+    }
+}
+
+TEST(multivariate_newton_solves_with_exact_jacobians)
+{
+    ContextMap ctx;
+    ctx.add_var_to_ctx("x");
+    ctx.add_var_to_ctx("y");
+    ctx.add_func_to_ctx("sq", 1, sq, {sq_prime});
+    ctx.add_func_to_ctx("cube", 1, cube);
+    VariableIndex index({"x", "y"});
+
+    std::vector<CompiledExpression> system = {
+        compile_to_expression("sq(x) + y^2 - 25", ctx, index),
+        compile_to_expression("cube(x) - 16 * y - 16", ctx, index),
+    };
+
+    auto root = newton_raphson_multivariate(system, index, {{"x", 5.0}, {"y", 2.0}}, 1e-9, 50, nexsys::Symbolic);
+
+    ASSERT(fabs(root["x"] - 4.0) < 1e-6)
+    ASSERT(fabs(root["y"] - 3.0) < 1e-6)
+
+    root = newton_raphson_multivariate(system, index, {{"x", 5.0}, {"y", 2.0}}, 1e-9, 50, nexsys::Automatic);
+
+    ASSERT(fabs(root["x"] - 4.0) < 1e-6)
+    ASSERT(fabs(root["y"] - 3.0) < 1e-6)
+}
+
+TEST(bounded_newton_presolves_and_stays_in_bounds)
+{
+    ContextMap ctx;
+    ctx.add_var_to_ctx("x");
+    ctx.add_var_to_ctx("y");
+    VariableIndex index({"x", "y"});
+
+    std::vector<CompiledExpression> system = {
+        compile_to_expression("log(x) - y", ctx, index),
+        compile_to_expression("x + y^2 - 2", ctx, index),
+    };
+
+    // Unbounded, the first step leaves the domain of log and never recovers
+    bool failed = false;
+    try
+    {
+        newton_raphson_multivariate(system, std::vector<double> {-1.0, 5.0}, 1e-9, 50);
+    }
+    catch(const std::runtime_error&)
+    {
+        failed = true;
+    }
+    ASSERT(failed)
+
+    std::vector<Interval> bounds = {Interval(0.0, 10.0), Interval(-10.0, 10.0)};
+    auto root = newton_raphson_multivariate(system, {-1.0, 5.0}, bounds, 1e-9, 50);
+    ASSERT(root[0] > 0.0 && root[0] <= 10.0)
+    ASSERT(fabs(log(root[0]) - root[1]) < 1e-9)
+    ASSERT(fabs(root[0] + root[1] * root[1] - 2.0) < 1e-9)
+
+    // No root has x > 2, which the presolve proves before iterating
+    failed = false;
+    try
+    {
+        newton_raphson_multivariate(system, {3.0, 0.0}, {Interval(2.5, 10.0), Interval(-10.0, 10.0)}, 1e-9, 50);
+    }
+    catch(const std::runtime_error& e)
+    {
+        failed = std::string(e.what()).find("no root") != std::string::npos;
+    }
+    ASSERT(failed)
+}
+
+TEST(lu_solves_systems_that_need_pivoting)
+{
+    // Tridiagonal with a zero leading element, so elimination without row swaps fails immediately
+    size_t n = 6;
+    Matrix<double> a(n, n);
+    for (size_t i = 0; i < n; i++)
+    {
+        a.get_index_ref(i, i) = i == 0 ? 0.0 : 2.0;
+        if (i > 0) a.get_index_ref(i, i - 1) = -1.0;
+        if (i + 1 < n) a.get_index_ref(i, i + 1) = -1.0;
+    }
+
+    std::vector<double> expected = {1.0, -2.0, 3.0, 0.5, -0.25, 4.0}, b(n, 0.0), x;
+    for (size_t i = 0; i < n; i++)
+    {
+        for (size_t j = 0; j < n; j++)
+        {
+            b[i] += a.get_index(i, j) * expected[j];
+        }
+    }
+
+    LU<double> lu(n);
+    ASSERT(lu.try_factor(a))
+    lu.solve(b, x);
+    for (size_t i = 0; i < n; i++)
+    {
+        ASSERT(fabs(x[i] - expected[i]) < 1e-12)
+    }
+
+    // A^T x = b
+    std::vector<double> bt(n, 0.0);
+    for (size_t i = 0; i < n; i++)
+    {
+        for (size_t j = 0; j < n; j++)
+        {
+            bt[i] += a.get_index(j, i) * expected[j];
+        }
+    }
+    lu.solve_transpose(bt.data());
+    for (size_t i = 0; i < n; i++)
+    {
+        ASSERT(fabs(bt[i] - expected[i]) < 1e-12)
+    }
+
+    // Inversion shares the factorization, so it no longer gives up on zero off-diagonal elements
+    Matrix<double> inverse = a;
+    ASSERT(inverse.try_inplace_invert())
+    Matrix<double> product = inverse * a;
+    for (size_t i = 0; i < n; i++)
+    {
+        for (size_t j = 0; j < n; j++)
+        {
+            ASSERT(fabs(product.get_index(i, j) - (i == j ? 1.0 : 0.0)) < 1e-12)
+        }
+    }
+
+    // Singular matrices are reported rather than producing infinities
+    a.get_index_ref(n - 1, n - 1) = 0.0;
+    a.get_index_ref(n - 1, n - 2) = 0.0;
+    ASSERT(!lu.try_factor(a))
+    ASSERT(!a.try_inplace_invert())
+}
+
+TEST(sparse_matrix_converts_between_forms)
+{
+    // Duplicate entries are summed
+    auto a = SparseMatrix<double>::from_triplets(3, 4, {0, 2, 1, 2, 0}, {1, 0, 3, 0, 3}, {1.0, 2.0, 3.0, 4.0, 5.0});
+    ASSERT_EQ(a.get_nonzero_count(), 4)
+    ASSERT_EQ(a.get_index(2, 0), 6.0)
+    ASSERT_EQ(a.get_index(0, 3), 5.0)
+    ASSERT_EQ(a.get_index(1, 1), 0.0)
+
+    auto t = a.transpose();
+    ASSERT_EQ(t.get_rows(), 4)
+    ASSERT_EQ(t.get_index(3, 1), 3.0)
+    ASSERT_EQ(t.get_index(0, 2), 6.0)
+
+    auto dense = a.to_dense();
+    auto again = SparseMatrix<double>::from_dense(dense);
+    ASSERT(again.get_col_start() == a.get_col_start())
+    ASSERT(again.get_row_index() == a.get_row_index())
+
+    double x[] = {1.0, 2.0, 3.0, 4.0}, y[3];
+    a.multiply(x, y);
+    ASSERT_EQ(y[0], 22.0)
+    ASSERT_EQ(y[1], 12.0)
+    ASSERT_EQ(y[2], 6.0)
+
+    bool thrown = false;
+    try
+    {
+        a.get_index_ref(1, 1) = 1.0;
+    }
+    catch(const std::out_of_range&)
+    {
+        thrown = true;
+    }
+    ASSERT(thrown)
+}
+
+TEST(sparse_lu_matches_dense_lu)
+{
+    size_t n = 60;
+    std::vector<size_t> rows, cols;
+    std::vector<double> vals;
+    for (size_t j = 0; j < n; j++)
+    {
+        // Every fifth diagonal element is zero, so rows must be pivoted
+        size_t others[] = {j, (j + 1) % n, (j * 7 + 3) % n, (j * 13 + 5) % n};
+        for (size_t k = 0; k < 4; k++)
+        {
+            rows.push_back(others[k]);
+            cols.push_back(j);
+            vals.push_back(k == 0 ? (j % 5 == 0 ? 0.0 : 4.0 + 0.01 * j) : 1.0 / (1.0 + k + 0.1 * j));
+        }
+    }
+    auto a = SparseMatrix<double>::from_triplets(n, n, rows, cols, vals);
+
+    LU<double> dense(n);
+    SparseLU<double> sparse;
+    sparse.analyze(a);
+    ASSERT(dense.try_factor(a.to_dense()))
+
+    for (size_t pass = 0; pass < 3; pass++)
+    {
+        ASSERT(sparse.try_factor(a))
+
+        std::vector<double> b(n), expected, x, xt;
+        for (size_t i = 0; i < n; i++)
+        {
+            b[i] = sin(1.0 + i);
+        }
+        dense.solve(b, expected);
+        x = b;
+        sparse.solve(x.data());
+        for (size_t i = 0; i < n; i++)
+        {
+            ASSERT(fabs(x[i] - expected[i]) < 1e-10)
+        }
+
+        expected = b;
+        dense.solve_transpose(expected.data());
+        xt = b;
+        sparse.solve_transpose(xt.data());
+        for (size_t i = 0; i < n; i++)
+        {
+            ASSERT(fabs(xt[i] - expected[i]) < 1e-10)
+        }
+
+        // New values with the same pattern reuse the analysis and the last pivots, until
+        // shrinking the diagonal makes those pivots unstable
+        for (size_t j = 0; j < n; j++)
+        {
+            for (size_t p = a.get_col_start()[j]; p < a.get_col_start()[j + 1]; p++)
+            {
+                a.get_values_ref()[p] *= pass == 0 ? 1.5 : (a.get_row_index()[p] == j ? 1e-6 : 1.0);
+            }
+        }
+        ASSERT(dense.try_factor(a.to_dense()))
+    }
+
+    // A zero column is singular
+    for (size_t p = a.get_col_start()[7]; p < a.get_col_start()[8]; p++)
+    {
+        a.get_values_ref()[p] = 0.0;
+    }
+    ASSERT(!sparse.try_factor(a))
+}
+
+TEST(sparse_lu_orders_columns_to_limit_fill)
+{
+    // An arrow matrix: eliminating its dense first column first would fill in every entry
+    size_t n = 400;
+    std::vector<size_t> rows, cols;
+    std::vector<double> vals;
+    for (size_t i = 0; i < n; i++)
+    {
+        rows.push_back(i);
+        cols.push_back(i);
+        vals.push_back(n);
+        if (i > 0)
+        {
+            rows.insert(rows.end(), {0, i});
+            cols.insert(cols.end(), {i, 0});
+            vals.insert(vals.end(), {1.0, 1.0});
+        }
+    }
+    auto a = SparseMatrix<double>::from_triplets(n, n, rows, cols, vals);
+
+    SparseLU<double> lu;
+    ASSERT(lu.try_factor(a))
+    ASSERT(lu.get_column_order()[0] != 0)
+    ASSERT(lu.get_nonzero_count() <= a.get_nonzero_count() + n)
+}
+
+TEST(newton_solver_reuses_its_workspace)
+{
+    ContextMap ctx;
+    ctx.add_var_to_ctx("x");
+    ctx.add_var_to_ctx("y");
+    ctx.add_func_to_ctx("sq", 1, sq, {sq_prime});
+    VariableIndex index({"x", "y"});
+
+    std::vector<CompiledExpression> system = {
+        compile_to_expression("sq(x) + y^2 - 25", ctx, index),
+        compile_to_expression("x - y - 1", ctx, index),
+    };
+    std::vector<double> guess = {5.0, 2.0};
+    std::vector<Interval> bounds = {Interval(0.0, 10.0), Interval(0.0, 10.0)};
+
+    for (auto mode: {nexsys::FiniteDifference, nexsys::Symbolic, nexsys::Automatic})
+    {
+        NewtonSolver solver(system, mode);
+        ASSERT(!solver.is_sparse())
+        auto expected = newton_raphson_multivariate(system, guess, 1e-9, 50, mode);
+        auto root = solver.solve(guess, 1e-9, 50);
+        ASSERT_EQ(root[0], expected[0])
+        ASSERT_EQ(root[1], expected[1])
+        ASSERT(solver.get_iteration_count() > 1)
+
+        // The first solve warms up any thread-local frames, after which solving allocates nothing
+        size_t before = allocations;
+        const std::vector<double>& again = solver.solve(guess, 1e-9, 50);
+        solver.solve(guess, bounds, 1e-9, 50);
+        ASSERT(fabs(again[0] - 4.0) < 1e-6)
+        ASSERT(fabs(again[1] - 3.0) < 1e-6)
+        solver.solve(guess, 1e-9, 50, nexsys::Broyden);
+        ASSERT_EQ(allocations, before)
+    }
+}
+
+TEST(broyden_updates_save_system_evaluations)
+{
+    ContextMap ctx;
+    VariableIndex index;
+    std::vector<CompiledExpression> system;
+    size_t n = 12;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        ctx.add_var_to_ctx("x" + std::to_string(i));
+        index.insert("x" + std::to_string(i));
+    }
+    for (size_t i = 0; i < n; i++)
+    {
+        // A discretized boundary value problem with a nonlinear source term
+        std::string xi = "x" + std::to_string(i);
+        std::string prev = i == 0 ? "0" : "x" + std::to_string(i - 1);
+        std::string next = i == n - 1 ? "1" : "x" + std::to_string(i + 1);
+        system.push_back(compile_to_expression(prev + " - 2 * " + xi + " + " + next + " - 0.05 * exp(" + xi + ")", ctx, index));
+    }
+
+    std::vector<double> guess(n, 0.5);
+    NewtonSolver solver(system);
+    auto newton = solver.solve(guess, 1e-10, 50);
+    size_t newton_evaluations = solver.get_evaluation_count();
+    ASSERT_EQ(solver.get_jacobian_count(), solver.get_iteration_count())
+    // The system is tridiagonal, so its finite difference jacobian takes three colored passes
+    ASSERT_EQ(newton_evaluations, solver.get_iteration_count() * (1 + 3))
+
+    auto broyden = solver.solve(guess, 1e-10, 50, nexsys::Broyden);
+    ASSERT(solver.get_evaluation_count() < newton_evaluations)
+    ASSERT(solver.get_jacobian_count() < solver.get_iteration_count())
+    for (size_t i = 0; i < n; i++)
+    {
+        ASSERT(fabs(broyden[i] - newton[i]) < 1e-9)
+    }
+
+    // Exact jacobians are updated in the same way
+    NewtonSolver automatic(system, nexsys::Automatic);
+    broyden = automatic.solve(guess, 1e-10, 50, nexsys::Broyden);
+    ASSERT_EQ(automatic.get_jacobian_count(), 1)
+    for (size_t i = 0; i < n; i++)
+    {
+        ASSERT(fabs(broyden[i] - newton[i]) < 1e-9)
+    }
+}
+
+TEST(newton_solver_factors_large_sparse_systems)
+{
+    ContextMap ctx;
+    ctx.add_func_to_ctx("sq", 1, sq, {sq_prime});
+    VariableIndex index;
+    std::vector<CompiledExpression> system;
+    size_t n = 200;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        ctx.add_var_to_ctx("x" + std::to_string(i));
+        index.insert("x" + std::to_string(i));
+    }
+    for (size_t i = 0; i < n; i++)
+    {
+        // A boundary value problem with a far-off coupling term
+        std::string xi = "x" + std::to_string(i);
+        std::string prev = i == 0 ? "0" : "x" + std::to_string(i - 1);
+        std::string next = i == n - 1 ? "1" : "x" + std::to_string(i + 1);
+        std::string far = "x" + std::to_string((i * 37 + 11) % n);
+        system.push_back(compile_to_expression(prev + " - 2 * " + xi + " + " + next + " - 0.0001 * (exp(" + xi + ") + sq(" + far + "))", ctx, index));
+    }
+
+    std::vector<double> guess(n, 0.5);
+    for (auto mode: {nexsys::FiniteDifference, nexsys::Symbolic, nexsys::Automatic})
+    {
+        NewtonSolver solver(system, mode);
+        ASSERT(solver.is_sparse())
+
+        for (auto update: {nexsys::Recompute, nexsys::Broyden})
+        {
+            auto root = solver.solve(guess, 1e-9, 100, update);
+            for (size_t i = 0; i < n; i++)
+            {
+                ASSERT(fabs(system[i].evaluate(root)) < 1e-9)
+            }
+        }
+
+        size_t before = allocations;
+        solver.solve(guess, 1e-9, 100);
+        ASSERT_EQ(allocations, before)
+    }
+}
+
+TEST(newton_iterates_without_recursing)
+{
+    ContextMap ctx;
+    ctx.add_var_to_ctx("x");
+    VariableIndex index({"x"});
+
+    // Linear convergence from far away takes many iterations, each of which used to take a stack frame
+    std::vector<CompiledExpression> system = {compile_to_expression("x ^ 40", ctx, index)};
+    NewtonSolver solver(system);
+    auto root = solver.solve({1e6}, 1e-3, 100000);
+    ASSERT(fabs(root[0]) < 0.1)
+    ASSERT(solver.get_iteration_count() > 500)
+
+    std::function<double (std::unordered_map<std::string, double>)> f = [](std::unordered_map<std::string, double> x) { return pow(x["x"], 40); };
+    auto umap_root = newton_raphson_multivariate({f}, {{"x", 1e6}}, 1e-3, 100000);
+    ASSERT(fabs(umap_root["x"]) < 0.1)
+}
+
+TEST(function_system_throws_when_it_cannot_converge)
+{
+    // No real root, so every step overshoots and the limit runs out
+    std::function<double (std::unordered_map<std::string, double>)> f = [](std::unordered_map<std::string, double> x) { return x["x"] * x["x"] + 1.0; };
+    bool failed = false;
+    try
+    {
+        newton_raphson_multivariate({f}, {{"x", 1.0}}, 1e-9, 20);
+    }
+    catch(const std::runtime_error& e)
+    {
+        failed = std::string(e.what()).find("did not converge") != std::string::npos;
+    }
+    ASSERT(failed)
+
+    failed = false;
+    try
+    {
+        newton_raphson_multivariate({f}, {{"x", 1.0}}, 0.0, 20);
+    }
+    catch(const std::invalid_argument&)
+    {
+        failed = true;
+    }
+    ASSERT(failed)
+
+    // Neither equation moves with x, so the jacobian has no inverse
+    std::function<double (std::unordered_map<std::string, double>)> g = [](std::unordered_map<std::string, double> x) { return x["y"] - 1.0; };
+    failed = false;
+    try
+    {
+        newton_raphson_multivariate({g, g}, {{"x", 1.0}, {"y", 0.0}}, 1e-9, 20);
+    }
+    catch(const std::runtime_error& e)
+    {
+        failed = std::string(e.what()).find("singular") != std::string::npos;
+    }
+    ASSERT(failed)
+}
+
+TEST(block_decomposition_orders_blocks_to_be_solved)
+{
+    ContextMap ctx;
+    for (auto name: {"x0", "x1", "x2", "x3"})
+    {
+        ctx.add_var_to_ctx(name);
+    }
+    VariableIndex index({"x0", "x1", "x2", "x3"});
+
+    // Listed out of order: x0 comes first, then x1 and x2 together, then x3
+    std::vector<CompiledExpression> system = {
+        compile_to_expression("x3 - x1 * x2", ctx, index),
+        compile_to_expression("x1 + x2 - 2 * x0", ctx, index),
+        compile_to_expression("x0 - 3", ctx, index),
+        compile_to_expression("x1 - x2 - 1", ctx, index),
+    };
+
+    BlockDecomposition decomposition(system);
+    ASSERT_EQ(decomposition.get_block_count(), 3)
+    ASSERT_EQ(decomposition.get_largest_block_size(), 2)
+
+    auto& blocks = decomposition.get_blocks();
+    ASSERT(blocks[0].equations == std::vector<size_t>({2}) && blocks[0].unknowns == std::vector<size_t>({0}))
+    ASSERT(blocks[1].equations == std::vector<size_t>({1, 3}) && blocks[1].unknowns == std::vector<size_t>({1, 2}))
+    ASSERT(blocks[2].equations == std::vector<size_t>({0}) && blocks[2].unknowns == std::vector<size_t>({3}))
+
+    BlockSolver solver(system);
+    auto root = solver.solve({0.0, 0.0, 0.0, 0.0}, 1e-12, 20);
+    ASSERT(fabs(root[0] - 3.0) < 1e-12)
+    ASSERT(fabs(root[1] - 3.5) < 1e-12)
+    ASSERT(fabs(root[2] - 2.5) < 1e-12)
+    ASSERT(fabs(root[3] - 8.75) < 1e-12)
+
+    // The second and third equations only read x1, so they cannot each be matched to a different unknown
+    std::vector<CompiledExpression> singular = {
+        compile_to_expression("x1 - x0", ctx, index),
+        compile_to_expression("x1 + 1", ctx, index),
+        compile_to_expression("x1 * 2 - 3", ctx, index),
+        compile_to_expression("x2 + x3", ctx, index),
+    };
+    bool failed = false;
+    try
+    {
+        BlockDecomposition bad(singular);
+    }
+    catch(const std::runtime_error& e)
+    {
+        failed = std::string(e.what()).find("structurally singular") != std::string::npos;
+    }
+    ASSERT(failed)
+}
+
+TEST(block_solver_matches_solving_the_whole_system)
+{
+    ContextMap ctx;
+    VariableIndex index;
+    std::vector<CompiledExpression> system;
+    size_t n = 120, width = 6;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        ctx.add_var_to_ctx("x" + std::to_string(i));
+        index.insert("x" + std::to_string(i));
+    }
+    for (size_t i = 0; i < n; i++)
+    {
+        // A chain of coupled blocks, each driven by the last unknown of the one before
+        size_t first = i - i % width;
+        std::string xi = "x" + std::to_string(i);
+        std::string partner = "x" + std::to_string(first + (i + 1) % width);
+        std::string driver = first == 0 ? "1" : "x" + std::to_string(first - 1);
+        system.push_back(compile_to_expression("3 * " + xi + " + 0.1 * exp(" + partner + ") - " + driver, ctx, index));
+    }
+
+    std::vector<double> guess(n, 0.0);
+    BlockSolver blocks(system, nexsys::Symbolic);
+    ASSERT_EQ(blocks.get_decomposition().get_block_count(), n / width)
+    ASSERT_EQ(blocks.get_decomposition().get_largest_block_size(), width)
+
+    auto expected = NewtonSolver(system, nexsys::Symbolic).solve(guess, 1e-12, 50);
+    auto root = blocks.solve(guess, 1e-12, 50);
+    for (size_t i = 0; i < n; i++)
+    {
+        ASSERT(fabs(root[i] - expected[i]) < 1e-10)
+        ASSERT(fabs(system[i].evaluate(root)) < 1e-10)
+    }
+
+    size_t before = allocations;
+    blocks.solve(guess, 1e-12, 50);
+    ASSERT_EQ(allocations, before)
+}
+
+TEST(trust_region_converges_where_full_steps_diverge)
+{
+    for (size_t n: {2, 40})
+    {
+        ContextMap ctx;
+        VariableIndex index;
+        std::vector<CompiledExpression> system;
+        for (size_t i = 0; i < n; i++)
+        {
+            ctx.add_var_to_ctx("x" + std::to_string(i));
+            index.insert("x" + std::to_string(i));
+        }
+        for (size_t i = 0; i < n; i++)
+        {
+            // atan flattens out far from its root, so full newton steps overshoot further every iteration
+            std::string xi = "x" + std::to_string(i);
+            std::string next = "x" + std::to_string((i + 1) % n);
+            system.push_back(compile_to_expression("atan(" + xi + " - 1) + 0.05 * (" + xi + " - " + next + ")", ctx, index));
+        }
+
+        std::vector<double> guess(n, 4.0);
+        for (size_t i = 0; i < n; i++)
+        {
+            guess[i] += 0.1 * i;
+        }
+
+        NewtonSolver solver(system, nexsys::Symbolic);
+        ASSERT_EQ(solver.is_sparse(), n >= nexsys::SPARSE_MIN_SIZE)
+
+        bool diverged = false;
+        try
+        {
+            solver.solve(guess, 1e-10, 50);
+        }
+        catch (const std::runtime_error&)
+        {
+            diverged = true;
+        }
+        ASSERT(diverged)
+
+        for (auto control: {nexsys::Dogleg, nexsys::LevenbergMarquardt})
+        {
+            auto root = solver.solve(guess, 1e-10, 100, nexsys::Recompute, control);
+            for (size_t i = 0; i < n; i++)
+            {
+                ASSERT(fabs(root[i] - 1.0) < 1e-9)
+            }
+
+            size_t before = allocations;
+            solver.solve(guess, 1e-10, 100, nexsys::Recompute, control);
+            ASSERT_EQ(allocations, before)
+        }
+    }
+
+    ContextMap ctx;
+    ctx.add_var_to_ctx("x");
+    VariableIndex index({"x"});
+    std::vector<CompiledExpression> system = {compile_to_expression("x - 1", ctx, index)};
+
+    bool threw = false;
+    try
+    {
+        NewtonSolver(system).solve({0.0}, 1e-10, 10, nexsys::Broyden, nexsys::Dogleg);
+    }
+    catch (const std::invalid_argument&)
+    {
+        threw = true;
+    }
+    ASSERT(threw)
+}
+
+TEST(parameter_sweep_warm_starts_along_the_points)
+{
+    ContextMap ctx;
+    ctx.add_var_to_ctx("x");
+    ctx.add_var_to_ctx("y");
+    ctx.add_var_to_ctx("p");
+    VariableIndex index({"x", "y", "p"});
+
+    // `p` is read past the unknowns, so it is the swept parameter
+    std::vector<CompiledExpression> system = {
+        compile_to_expression("x ^ 3 + x - p", ctx, index),
+        compile_to_expression("exp(y) - x - 20", ctx, index),
+    };
+
+    // Points out of order, so the sweep must sort them and still report in the order given
+    size_t count = 400;
+    Matrix<double> points(count, 1);
+    for (size_t k = 0; k < count; k++)
+    {
+        points.get_index_ref(k, 0) = -50.0 + 100.0 * ((k * 151) % count) / count;
+    }
+
+    ThreadPool pool(4);
+    nexsys::ParameterSweep sweep(system, nexsys::Symbolic, pool);
+    ASSERT_EQ(sweep.get_parameter_count(), 1)
+
+    std::vector<double> guess = {0.0, 1.0};
+    const Matrix<double>& roots = sweep.solve(guess, points, 1e-12, 50);
+    ASSERT_EQ(sweep.get_segment_count(), 4)
+    ASSERT_EQ(sweep.get_failure_count(), 0)
+
+    size_t cold_iterations = 0;
+    BlockSolver cold(system, nexsys::Symbolic);
+    for (size_t k = 0; k < count; k++)
+    {
+        auto expected = cold.solve({guess[0], guess[1], points.get_index(k, 0)}, 1e-12, 50);
+        cold_iterations += cold.get_iteration_count();
+        ASSERT(fabs(roots.get_index(k, 0) - expected[0]) < 1e-10)
+        ASSERT(fabs(roots.get_index(k, 1) - expected[1]) < 1e-10)
+    }
+    ASSERT(2 * sweep.get_iteration_count() < cold_iterations)
+
+    size_t before = allocations;
+    sweep.solve(guess, points, 1e-12, 50);
+    ASSERT_EQ(allocations, before)
+
+    // A point with no root gets a row of NaNs without stopping the sweep
+    VariableIndex single({"x", "p"});
+    std::vector<CompiledExpression> rootless = {compile_to_expression("x ^ 2 + p", ctx, single)};
+    nexsys::ParameterSweep partial(rootless);
+    Matrix<double> signs(std::vector<double>{-4.0, 1.0, -9.0}, 1);
+    const Matrix<double>& some = partial.solve({1.0}, signs, 1e-12, 50);
+    ASSERT_EQ(partial.get_failure_count(), 1)
+    ASSERT(fabs(some.get_index(0, 0) - 2.0) < 1e-10)
+    ASSERT(std::isnan(some.get_index(1, 0)))
+    ASSERT(fabs(some.get_index(2, 0) - 3.0) < 1e-10)
+}
+
+TEST(parallel_evaluation_matches_serial_bit_for_bit)
+{
+    ContextMap ctx;
+    ctx.add_func_to_ctx("sq", 1, sq, {sq_prime});
+    ctx.add_func_to_ctx("cube", 1, cube);
+    VariableIndex index;
+    std::vector<CompiledExpression> system;
+    size_t n = 150;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        ctx.add_var_to_ctx("x" + std::to_string(i));
+        index.insert("x" + std::to_string(i));
+    }
+    for (size_t i = 0; i < n; i++)
+    {
+        // Every tenth row calls a function without a derivative, so symbolic jacobians fall back to differencing it
+        std::string xi = "x" + std::to_string(i);
+        std::string prev = i == 0 ? "0" : "x" + std::to_string(i - 1);
+        std::string next = i == n - 1 ? "1" : "x" + std::to_string(i + 1);
+        std::string far = "x" + std::to_string((i * 37 + 11) % n);
+        std::string source = i % 10 == 0 ? "cube(" + far + ")" : "sq(" + far + ")";
+        system.push_back(compile_to_expression(prev + " - 2 * " + xi + " + " + next + " - 0.0001 * (exp(" + xi + ") + " + source + ")", ctx, index));
+    }
+
+    ThreadPool pool(4);
+    std::vector<double> x(n), f(n), f_parallel(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        x[i] = 0.5 + 0.01 * i;
+        f[i] = system[i].evaluate(x);
+    }
+
+    Matrix<double> serial(n, n), parallel(n, n);
+    auto same = [&]() {
+        for (size_t i = 0; i < n; i++)
+        {
+            for (size_t j = 0; j < n; j++)
+            {
+                if (serial.get_index(i, j) != parallel.get_index(i, j))
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    };
+
+    ColoredJacobian colored(system, n);
+    colored.evaluate(system, x, f, serial);
+    colored.evaluate(system, x, f, parallel, &pool);
+    ASSERT(same())
+
+    SymbolicJacobian exact(system);
+    ASSERT_EQ(exact.get_fallback_rows().size(), n / 10)
+    exact.evaluate(system, x, f, serial);
+    exact.evaluate(system, x, f, parallel, &pool);
+    ASSERT(same())
+
+    DualJacobian automatic(system);
+    automatic.evaluate(system, x, f, serial);
+    automatic.evaluate(system, x, f_parallel, parallel, &pool);
+    ASSERT(same())
+    ASSERT(f == f_parallel)
+
+    nexsys::CompiledSystem fused(system);
+    nexsys::finite_difference_jacobian(fused, x, f, serial);
+    nexsys::finite_difference_jacobian(fused, x, f, parallel, &pool);
+    ASSERT(same())
+
+    std::vector<double> guess(n, 0.5);
+    for (auto mode: {nexsys::FiniteDifference, nexsys::Symbolic, nexsys::Automatic})
+    {
+        NewtonSolver one(system, mode);
+        NewtonSolver many(system, mode, pool);
+        one.set_parallel_threshold(SIZE_MAX);
+        many.set_parallel_threshold(0);
+
+        for (auto update: {nexsys::Recompute, nexsys::Broyden})
+        {
+            auto expected = one.solve(guess, 1e-9, 100, update);
+            auto root = many.solve(guess, 1e-9, 100, update);
+            ASSERT(root == expected)
+            ASSERT_EQ(many.get_iteration_count(), one.get_iteration_count())
+        }
+
+        size_t before = allocations;
+        many.solve(guess, 1e-9, 100);
+        ASSERT_EQ(allocations, before)
+    }
+}
+
+RUN_TESTS
@@ -0,0 +1,190 @@
+#include "harness.hpp"
+#include "presolve.hpp"
+
+using nexsys::bounds_from_context;
+using nexsys::compile_to_expression;
+using nexsys::CompiledExpression;
+using nexsys::ContextMap;
+using nexsys::evaluate_interval;
+using nexsys::Interval;
+using nexsys::IntervalPresolve;
+using nexsys::starting_point;
+using nexsys::Variable;
+using nexsys::VariableIndex;
+
+INIT_HARNESS
+
+static double twice(double args[])
+{
+    return 2.0 * args[0];
+}
+
+TEST(interval_evaluation_encloses_every_point)
+{
+    ContextMap ctx;
+    ctx.add_var_to_ctx("x");
+    ctx.add_var_to_ctx("y");
+    ctx.add_func_to_ctx("twice", 1, twice);
+    VariableIndex index({"x", "y"});
+
+    std::vector<std::string> exprs = {
+        "x^3 * y - x / (y + 2)",
+        "sin(x * y) + exp(x) - log(x) * cos(y)",
+        "hypot(x, y) / (x + 1) - y^2 + tan(x / 4)",
+        "sqrt(x) * atan(y) + min(x, y) - abs(y) + max(x, 1)",
+        "(x - y)^4 - tanh(y) * x^-2 + cosh(y) - sinh(x)",
+        "2^y + x^0.5 - log10(x) + asin(x / 2) * acos(y / 3)",
+        "twice(1.5) * x",
+    };
+
+    std::vector<Interval> box = {Interval(0.5, 2.0), Interval(-1.5, 3.0)};
+    for (auto& text: exprs)
+    {
+        CompiledExpression expr = compile_to_expression(text, ctx, index);
+        Interval range = evaluate_interval(expr, box);
+
+        for (size_t i = 0; i <= 24; i++)
+        {
+            for (size_t j = 0; j <= 24; j++)
+            {
+                double x[] = {0.5 + 1.5 * i / 24.0, -1.5 + 4.5 * j / 24.0};
+                ASSERT(range.contains(expr.evaluate(x)))
+
+                // Evaluating at a single point should stay within a few ulps of it
+                Interval point = evaluate_interval(expr, {Interval(x[0]), Interval(x[1])});
+                ASSERT(point.contains(expr.evaluate(x)))
+                ASSERT(point.width() <= 1e-12 * std::max(1.0, fabs(point.lo)))
+            }
+        }
+    }
+}
+
+TEST(interval_functions_respect_their_domains)
+{
+    ASSERT(nexsys::log(Interval(-2.0, -1.0)).is_empty())
+    ASSERT(nexsys::sqrt(Interval(-2.0, 4.0)).lo == 0.0)
+    ASSERT(nexsys::powi(Interval(-3.0, 2.0), 2).lo == 0.0)
+    ASSERT(nexsys::powi(Interval(-3.0, 2.0), 2).hi >= 9.0)
+    ASSERT(nexsys::sin(Interval(0.0, 2.0)).hi == 1.0)
+    ASSERT(nexsys::cos(Interval(3.0, 3.5)).lo == -1.0)
+
+    // Exact sums and products are not widened
+    Interval sum = Interval(1.0, 2.0) + Interval(0.5, 0.25 + 0.5);
+    ASSERT_EQ(1.5, sum.lo)
+    ASSERT_EQ(2.75, sum.hi)
+
+    Interval inexact = Interval(0.1) + Interval(0.2);
+    ASSERT(inexact.lo < inexact.hi)
+    ASSERT(inexact.contains(0.1 + 0.2))
+    ASSERT((Interval(1.0) / Interval(-1.0, 1.0)).lo == -INFINITY)
+}
+
+TEST(presolve_tightens_bounds_across_the_system)
+{
+    ContextMap ctx;
+    ctx.add_var_to_ctx("x");
+    ctx.add_var_to_ctx("y");
+    ctx.add_var_to_ctx("z");
+    VariableIndex index({"x", "y", "z"});
+
+    std::vector<CompiledExpression> system = {
+        compile_to_expression("x^2 - 36", ctx, index),
+        compile_to_expression("x + y - 10", ctx, index),
+        compile_to_expression("log(z) - y / 4", ctx, index),
+    };
+
+    IntervalPresolve presolve(system);
+    std::vector<Interval> bounds = {Interval(0.0, 100.0), Interval(0.0, 100.0), Interval::entire()};
+    ASSERT(presolve.try_tighten(bounds, 64, 1e-6))
+
+    // The only root is x = 6, y = 4, z = e
+    ASSERT(bounds[0].contains(6.0) && bounds[0].width() < 1e-3)
+    ASSERT(bounds[1].contains(4.0) && bounds[1].width() < 1e-3)
+    ASSERT(bounds[2].contains(exp(1.0)) && bounds[2].width() < 1e-2)
+
+    // Even powers keep both roots until a bound rules one out
+    CompiledExpression square = compile_to_expression("x^2 - 4", ctx, index);
+    std::vector<Interval> both = {Interval(-10.0, 10.0), Interval::entire(), Interval::entire()};
+    ASSERT(IntervalPresolve({square}).try_tighten(both))
+    ASSERT(both[0].contains(-2.0) && both[0].contains(2.0) && both[0].width() < 4.001)
+
+    std::vector<Interval> positive = {Interval(0.0, 10.0), Interval::entire(), Interval::entire()};
+    ASSERT(IntervalPresolve({square}).try_tighten(positive))
+    ASSERT(positive[0].contains(2.0) && positive[0].width() < 1e-9)
+}
+
+TEST(presolve_proves_infeasibility)
+{
+    ContextMap ctx;
+    ctx.add_var_to_ctx("x");
+    ctx.add_var_to_ctx("y");
+    VariableIndex index({"x", "y"});
+
+    std::vector<Interval> bounds = {Interval(-5.0, 5.0), Interval(-5.0, 5.0)};
+    for (std::string text: {"x^2 + 1", "sqrt(x) + 1", "exp(x) + y^2", "abs(x) + abs(y) + 0.5"})
+    {
+        std::vector<CompiledExpression> system = {compile_to_expression(text, ctx, index)};
+        std::vector<Interval> tightened = bounds;
+        ASSERT(!IntervalPresolve(system).try_tighten(tightened))
+        ASSERT(!IntervalPresolve(system).may_contain_root(bounds))
+    }
+
+    // Each equation alone is satisfiable within the bounds, but not both together
+    std::vector<CompiledExpression> system = {
+        compile_to_expression("x - y - 3", ctx, index),
+        compile_to_expression("x + y - 8", ctx, index),
+    };
+    std::vector<Interval> tightened = bounds;
+    ASSERT(IntervalPresolve(system).may_contain_root(bounds))
+    ASSERT(!IntervalPresolve(system).try_tighten(tightened))
+}
+
+TEST(presolve_agrees_with_min_and_max_of_undefined_values)
+{
+    ContextMap ctx;
+    ctx.add_var_to_ctx("x");
+    ctx.add_var_to_ctx("y");
+    VariableIndex index({"x", "y"});
+    std::vector<Interval> bounds = {Interval(0.0, 4.0), Interval(0.0, 4.0)};
+
+    // sqrt is undefined for every x in the bounds, and min and max carry the NaN through like any other operation
+    for (std::string text: {"min(sqrt(x - 5), y) - 1", "max(y, sqrt(x - 5)) - 1"})
+    {
+        std::vector<CompiledExpression> system = {compile_to_expression(text, ctx, index)};
+        double point[] = {2.0, 1.0};
+        ASSERT(std::isnan(system[0].evaluate(point)))
+
+        std::vector<Interval> tightened = bounds;
+        ASSERT(!IntervalPresolve(system).may_contain_root(bounds))
+        ASSERT(!IntervalPresolve(system).try_tighten(tightened))
+    }
+
+    // Where sqrt is defined for part of the bounds, the root there is kept
+    std::vector<CompiledExpression> system = {compile_to_expression("min(sqrt(x - 1), y) - 1", ctx, index)};
+    std::vector<Interval> tightened = bounds;
+    ASSERT(IntervalPresolve(system).try_tighten(tightened))
+    ASSERT(tightened[0].contains(2.0) && tightened[1].contains(1.0))
+}
+
+TEST(bounds_and_starting_points_come_from_variables)
+{
+    ContextMap ctx;
+    ctx.add_var_to_ctx("p", new Variable(1.0, 0.0, 10.0));
+    ctx.add_var_to_ctx("t", new Variable(300.0, 250.0, INFINITY));
+    ctx.add_var_to_ctx("q");
+    VariableIndex index({"p", "t", "q"});
+
+    std::vector<Interval> bounds = bounds_from_context(ctx, index);
+    ASSERT_EQ(0.0, bounds[0].lo)
+    ASSERT_EQ(10.0, bounds[0].hi)
+    ASSERT_EQ(250.0, bounds[1].lo)
+    ASSERT_EQ(INFINITY, bounds[1].hi)
+    ASSERT_EQ(-INFINITY, bounds[2].lo)
+
+    auto start = starting_point(bounds, {20.0, 100.0, -7.0});
+    ASSERT_EQ(5.0, start[0])
+    ASSERT_EQ(500.0, start[1])
+    ASSERT_EQ(-7.0, start[2])
+}
+
+RUN_TESTS
@@ -0,0 +1,97 @@
+#include "harness.hpp"
+#include "system.hpp"
+
+using nexsys::compile_to_expression;
+using nexsys::CompiledExpression;
+using nexsys::CompiledSystem;
+using nexsys::ContextMap;
+using nexsys::VariableIndex;
+
+INIT_HARNESS
+
+static double hyp(double args[])
+{
+    return sqrt(args[0] * args[0] + args[1] * args[1]);
+}
+
+static std::vector<CompiledExpression> shared_system(VariableIndex& index)
+{
+    ContextMap ctx;
+    ctx.add_var_to_ctx("p1");
+    ctx.add_var_to_ctx("p2");
+    ctx.add_var_to_ctx("q");
+    ctx.add_func_to_ctx("hyp", 2, hyp);
+
+    return {
+        compile_to_expression("(p1 - p2)^2 * q - hyp(p1, q) + 3", ctx, index),
+        compile_to_expression("2 / (p1 - p2)^2 + hyp(p1, q) * (p1 - p2)^2", ctx, index),
+        compile_to_expression("q * (p1 - p2)^2 - p2 ^ q + 2 ^ p1 - 1 * 4", ctx, index),
+        compile_to_expression("p2", ctx, index),
+        compile_to_expression("7", ctx, index),
+        compile_to_expression("(p1 - p2)^2 * q - hyp(p1, q) + 3", ctx, index),
+        compile_to_expression("sin(p1 - p2) * hypot(p1, 2) - min(q, sqrt((p1 - p2)^2 + 4))", ctx, index),
+        compile_to_expression("exp(-q) + sin(p1 - p2) / max(p2, 0.75) + abs(p2 - q) ^ 3", ctx, index),
+    };
+}
+
+TEST(compiled_system_matches_each_expression)
+{
+    VariableIndex index;
+    auto system = shared_system(index);
+    CompiledSystem fused(system);
+
+    std::vector<double> out;
+    for (double p = 0.5; p < 3.0; p += 0.25)
+    {
+        std::vector<double> x = {p, 1.0 / p, p + 0.5};
+        fused.evaluate(x, out);
+
+        ASSERT_EQ(out.size(), system.size())
+        for (size_t i = 0; i < system.size(); i++)
+        {
+            ASSERT_EQ(out[i], system[i].evaluate(x))
+        }
+    }
+}
+
+TEST(compiled_system_evaluates_shared_subexpressions_once)
+{
+    VariableIndex index;
+    auto system = shared_system(index);
+    CompiledSystem fused(system);
+
+    size_t separate = 0;
+    for (auto& expr: system)
+    {
+        separate += expr.get_bytecode().get_code().size();
+    }
+
+    ASSERT(fused.get_shared_count() >= 3) // `p1 - p2`, its square, `hyp(p1, q)`, ...
+    ASSERT(fused.get_bytecode().get_code().size() < separate)
+}
+
+TEST(compiled_system_jit_matches_interpreter)
+{
+    VariableIndex index;
+    auto system = shared_system(index);
+    CompiledSystem interpreted(system);
+    CompiledSystem native = interpreted;
+    if (!native.try_set_backend(nexsys::Jit))
+    {
+        return;
+    }
+
+    std::vector<double> a, b;
+    for (double p = 0.5; p < 3.0; p += 0.25)
+    {
+        std::vector<double> x = {p, 1.0 / p, p + 0.5};
+        interpreted.evaluate(x, a);
+        native.evaluate(x, b);
+        for (size_t i = 0; i < a.size(); i++)
+        {
+            ASSERT_EQ(a[i], b[i])
+        }
+    }
+}
+
+RUN_TESTS